@@ -31,8 +31,16 @@
 %ignore pushInterleaved;
 %ignore pushRawInterleaved;
 %ignore pushBytes;
+%ignore synthesizeRaw(unsigned int, short *, unsigned int);
 %ignore getVoltageP;
 %ignore getVoltageRawP;
+%ignore getSamplesView;
+%ignore popStreamingBlock;
+%ignore startStreaming(unsigned int, std::function< void (const libm2k::STREAMING_BLOCK &) >, bool, unsigned int);
+%ignore startStreaming(unsigned int, std::function< bool (const libm2k::GENERATOR_BLOCK &) >, bool);
+%ignore getSamplesInterleaved(double *, unsigned int);
+%ignore acquireBuffer;
+%ignore commitBuffer;
 %rename(pushBytes) push(unsigned short*, unsigned int);
 
 #ifdef SWIGPYTHON
@@ -95,11 +103,15 @@ namespace std {
 	%template(VectorI) vector<int>;
 	%template(VectorS) vector<short>;
 	%template(VectorUS) vector<unsigned short>;
+	%template(VectorUI) vector<unsigned int>;
 	%template(VectorD) vector<double>;
+	%template(VectorF) vector<float>;
 	%template(VectorStr) vector<string>;
 	%template(VectorVectorD) vector< vector<double> >;
 	%template(VectorVectorS) vector< vector<int> >;
 	%template(VectorVectorUS) vector< vector<unsigned short> >;
+	%template(VectorVectorF) vector< vector<float> >;
+	%template(VectorVectorShort) vector< vector<short> >;
 	%template(PairDD) std::pair<double, double>;
 	%template(VectorPairDD) std::vector<std::pair<std::string, std::pair <double, double>>>;
 }
@@ -118,6 +130,7 @@ namespace std {
 	#include <libm2k/analog/genericanalogin.hpp>
 	#include <libm2k/analog/genericanalogout.hpp>
 	#include <libm2k/m2khardwaretrigger.hpp>
+	#include <libm2k/analog/m2krecording.hpp>
 	#include <libm2k/analog/m2kanalogin.hpp>
 	#include <libm2k/analog/m2kanalogout.hpp>
 	#include <libm2k/analog/m2kpowersupply.hpp>
@@ -236,6 +249,7 @@ namespace std {
 %include <libm2k/analog/genericanalogin.hpp>
 %include <libm2k/analog/genericanalogout.hpp>
 %include <libm2k/m2khardwaretrigger.hpp>
+%include <libm2k/analog/m2krecording.hpp>
 %include <libm2k/analog/m2kanalogin.hpp>
 %include <libm2k/analog/m2kanalogout.hpp>
 %include <libm2k/analog/m2kpowersupply.hpp>
@@ -269,6 +283,10 @@ namespace std {
 %template(M2kConditionAnalog) std::vector<libm2k::M2K_TRIGGER_CONDITION_ANALOG>;
 %template(M2kConditionDigital) std::vector<libm2k::M2K_TRIGGER_CONDITION_DIGITAL>;
 %template(M2kModes) std::vector<libm2k::M2K_TRIGGER_MODE>;
+%template(M2kRanges) std::vector<libm2k::analog::M2K_RANGE>;
+%template(MeasurementResults) std::vector<libm2k::analog::MEASUREMENT_RESULTS>;
+%template(Spectra) std::vector<libm2k::analog::SPECTRUM>;
+%template(SynthTones) std::vector<libm2k::analog::SYNTH_TONE>;
 
 #ifdef SWIGPYTHON
 	%template(IioBuffers) std::vector<struct iio_buffer*>;
@@ -48,6 +48,30 @@ namespace analog {
 	};
 
 
+	/**
+	* @struct MEASUREMENT_RESULTS
+	* @brief Measurements of the waveform of one channel
+	*
+	* @note The frequency, period and duty cycle are computed from the crossings of the middle
+	* level (with a hysteresis of 10% of the peak-to-peak amplitude) over complete periods
+	* @note The periods are only counted once the levels settle: while the amplitude seen so far
+	* still grows enough to move them, the edges found are dropped
+	*
+	*/
+	struct MEASUREMENT_RESULTS {
+		unsigned long long nb_samples; ///< Number of samples measured
+		double mean; ///< Average, in Volts
+		double rms; ///< Root mean square, in Volts
+		double ac_rms; ///< Root mean square of the signal without its average, in Volts
+		double min; ///< Minimum, in Volts
+		double max; ///< Maximum, in Volts
+		double peak_to_peak; ///< Difference between the maximum and the minimum, in Volts
+		double frequency; ///< Frequency, in Hz; 0 until a complete period was seen
+		double period; ///< Period, in seconds; 0 until a complete period was seen
+		double duty_cycle; ///< Fraction of the period spent above the middle level, between 0 and 1
+	};
+
+
 	/**
 	* @enum ANALOG_IN_CHANNEL
 	* @brief Indexes of the channels
@@ -70,6 +94,174 @@ namespace analog {
 		PLUS_MINUS_25V = 0,
 		PLUS_MINUS_2_5V = 1
 	};
+
+
+	/**
+	* @enum M2K_DECIMATION_MODE
+	* @brief Software decimation applied to the streamed samples
+	*
+	*/
+	enum M2K_DECIMATION_MODE {
+		DECIMATION_BOXCAR = 0, ///< Average of every window of samples
+		DECIMATION_CIC = 1, ///< Cascaded integrator-comb filter, normalized to unity gain
+		DECIMATION_MIN_MAX = 2 ///< Minimum and maximum of every window of samples
+	};
+
+
+	/**
+	* @enum M2K_STREAMING_TRIGGER_CONDITION
+	* @brief Condition of the software trigger applied to the streamed samples
+	*
+	*/
+	enum M2K_STREAMING_TRIGGER_CONDITION {
+		STREAMING_TRIGGER_RISING_EDGE = 0, ///< The signal reaches the level after being below level - hysteresis
+		STREAMING_TRIGGER_FALLING_EDGE = 1, ///< The signal reaches the level after being above level + hysteresis
+		STREAMING_TRIGGER_HIGH_LEVEL = 2, ///< The signal is at or above the level
+		STREAMING_TRIGGER_LOW_LEVEL = 3, ///< The signal is at or below the level
+		STREAMING_TRIGGER_WINDOW_ENTER = 4, ///< The signal enters [level, level_high] after being outside of it by more than the hysteresis
+		STREAMING_TRIGGER_WINDOW_EXIT = 5 ///< The signal leaves [level, level_high] after being inside of it by more than the hysteresis
+	};
+
+
+	/**
+	* @struct STREAMING_TRIGGER
+	* @brief Settings of the software trigger applied to the streamed samples
+	*
+	* @note Each trigger produces a frame of pre_samples + post_samples samples of every channel;
+	* the trigger sample is the one at index pre_samples. The search resumes after the end of the frame.
+	*
+	*/
+	struct STREAMING_TRIGGER {
+		bool enabled; ///< If false, the streaming callback receives the acquired blocks
+		unsigned int channel; ///< Index of the channel the condition is evaluated on
+		M2K_STREAMING_TRIGGER_CONDITION condition; ///< Condition of the trigger
+		double level; ///< Trigger level, or lower bound of the window, in Volts
+		double level_high; ///< Upper bound of the window, in Volts
+		double hysteresis; ///< Distance, in Volts, the signal has to cover before an edge or a window condition is armed again
+		unsigned int pre_samples; ///< Number of samples before the trigger sample
+		unsigned int post_samples; ///< Number of samples from the trigger sample on, at least 1
+	};
+
+
+	/**
+	* @enum M2K_SPECTRUM_WINDOW
+	* @brief Window applied to every segment of samples before its FFT
+	*
+	*/
+	enum M2K_SPECTRUM_WINDOW {
+		SPECTRUM_WINDOW_RECTANGULAR = 0, ///< No window; best resolution, most leakage
+		SPECTRUM_WINDOW_HANN = 1, ///< Hann window
+		SPECTRUM_WINDOW_HAMMING = 2, ///< Hamming window
+		SPECTRUM_WINDOW_BLACKMAN_HARRIS = 3, ///< 4-term Blackman-Harris window; sidelobes below -92 dB
+		SPECTRUM_WINDOW_FLAT_TOP = 4 ///< Flat top window; accurate amplitudes between the bins
+	};
+
+
+	/**
+	* @enum M2K_SPECTRUM_UNIT
+	* @brief Unit of the values of a spectrum
+	*
+	*/
+	enum M2K_SPECTRUM_UNIT {
+		SPECTRUM_DBFS = 0, ///< dB relative to a full-scale sine of the current range; a full-scale sine reads 0 dBFS
+		SPECTRUM_VOLTS_RMS = 1, ///< RMS amplitude of the tone at each bin, in Volts
+		SPECTRUM_DBV = 2, ///< RMS amplitude of the tone at each bin, in dB relative to 1 Volt
+		SPECTRUM_VOLTS_PER_SQRT_HZ = 3 ///< Noise density, in Volts per square root of Hz
+	};
+
+
+	/**
+	* @struct SPECTRUM_SETTINGS
+	* @brief Settings of the spectrum analysis
+	*
+	* @note The FFT size has to be even, at least 8 and at most 1048576, and half of it a product of
+	* powers of 2, 3 and 5 (e.g. 1024, 1000, 4800, 65536)
+	*
+	*/
+	struct SPECTRUM_SETTINGS {
+		unsigned int fft_size; ///< Number of samples of each segment; the spectrum has fft_size / 2 + 1 bins
+		M2K_SPECTRUM_WINDOW window; ///< Window applied to each segment
+		double overlap; ///< Fraction of each segment shared with the next one, in [0, 1)
+		M2K_SPECTRUM_UNIT unit; ///< Unit of the values
+	};
+
+
+	/**
+	* @struct SPECTRUM
+	* @brief The averaged spectrum of one channel
+	*
+	* @note Bin k is centered on k * bin_width Hz; the power of the segments is averaged (Welch's method)
+	*
+	*/
+	struct SPECTRUM {
+		std::vector<double> values; ///< One value per bin, from DC to the Nyquist frequency, in the unit of the settings
+		double bin_width; ///< Frequency step between two bins, in Hz
+		unsigned long long nb_averages; ///< Number of segments averaged; the values are empty while it is 0
+	};
+
+
+	/**
+	* @struct WAVEFORM_INFO
+	* @brief Description of a waveform registered on the analog output
+	*
+	* @note The per-channel vectors have one element for each channel; a channel that is not
+	* part of the waveform has 0 samples
+	*
+	*/
+	struct WAVEFORM_INFO {
+		std::string id; ///< The name the waveform was registered under
+		std::vector<unsigned int> nb_samples; ///< Number of samples stored for each channel
+		std::vector<double> sample_rate; ///< Sample rate each channel is switched to on activation
+		std::vector<int> oversampling_ratio; ///< Oversampling ratio each channel is switched to on activation
+		unsigned long long nb_activations; ///< Number of times the waveform was activated
+		double last_switch_latency; ///< Duration, in seconds, of the last activation
+		double max_switch_latency; ///< Longest activation, in seconds
+	};
+
+
+	/**
+	* @enum M2K_SYNTH_WAVEFORM
+	* @brief Shape of a tone of the waveform synthesizer
+	*
+	* @note All the shapes start at 0 and rise for a phase of 0 degrees, like the sine
+	*
+	*/
+	enum M2K_SYNTH_WAVEFORM {
+		SYNTH_SINE = 0, ///< Sine, from a lookup table with linear interpolation
+		SYNTH_SQUARE = 1, ///< Square; the duty cycle sets the fraction of the period at the high level
+		SYNTH_TRIANGLE = 2, ///< Triangle
+		SYNTH_SAWTOOTH = 3 ///< Rising sawtooth
+	};
+
+
+	/**
+	* @struct SYNTH_TONE
+	* @brief One tone of the waveform synthesizer
+	*
+	* @note With a sweep duration, the frequency rises or falls linearly from frequency to stop_frequency
+	* and starts over at the end of the sweep; a sweeping sine is a chirp
+	*
+	*/
+	struct SYNTH_TONE {
+		M2K_SYNTH_WAVEFORM waveform; ///< Shape of the tone
+		double frequency; ///< Frequency, in Hz, or start frequency of the sweep
+		double amplitude; ///< Peak amplitude, in Volts
+		double phase; ///< Phase at the start, in degrees
+		double duty_cycle; ///< Fraction of the period at the high level of a square, in [0, 1]
+		double stop_frequency; ///< End frequency of the sweep, in Hz
+		double sweep_duration; ///< Duration of the sweep, in seconds; 0 for a fixed frequency
+	};
+
+
+	/**
+	* @struct SYNTH_SETTINGS
+	* @brief The waveform of the synthesizer of one channel: the sum of its tones, plus an offset
+	*
+	*/
+	struct SYNTH_SETTINGS {
+		std::vector<SYNTH_TONE> tones; ///< Tones added together
+		double offset; ///< DC offset, in Volts
+	};
 }
 }
 
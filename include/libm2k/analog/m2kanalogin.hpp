@@ -23,11 +23,14 @@
 #define M2KANALOGIN_HPP
 
 #include <libm2k/m2kglobal.hpp>
+#include <libm2k/enums.hpp>
 #include <libm2k/analog/enums.hpp>
 #include <libm2k/m2khardwaretrigger.hpp>
+#include <libm2k/analog/m2krecording.hpp>
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
 
 namespace libm2k {
 /**
@@ -91,15 +94,50 @@ public:
 	virtual std::vector<std::vector<double>> getSamplesRaw(unsigned int nb_samples) = 0;
 
 
+	/**
+	* @brief Retrieve a specific number of samples from each channel, in single precision
+	*
+	* @param nb_samples The number of samples that will be retrieved
+	* @return A list containing lists of samples for each channel
+	*
+	* @note The index of the list corresponds to the index of the channel
+	* @note Uses half the memory of getSamples; float is far more precise than the 12-bit ADC
+	*/
+	virtual std::vector<std::vector<float>> getSamplesFloat(unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Retrieve a specific number of raw samples from each channel, as 16-bit ADC codes
+	*
+	* @param nb_samples The number of samples that will be retrieved
+	* @return A list containing lists of raw samples for each channel
+	*
+	* @note The index of the list corresponds to the index of the channel
+	* @note Use convertRawToVolts to obtain the voltage of a sample
+	*/
+	virtual std::vector<std::vector<short>> getSamplesRawShort(unsigned int nb_samples) = 0;
+
+
 	/**
 	* @brief Retrieve a specific number of samples from both channels
 	*
 	* @param nb_samples The number of samples that will be retrieved
 	* @return A pointer to the interleaved samples
+	*
+	* @note The samples are stored in memory owned by the M2kAnalogIn object, valid until the next call
 	*/
 	virtual const double* getSamplesInterleaved(unsigned int nb_samples) = 0;
 
 
+	/**
+	* @brief Retrieve a specific number of samples from both channels into memory owned by the client
+	*
+	* @param data A pointer to memory that can hold nb_samples values for each channel
+	* @param nb_samples The number of samples that will be retrieved
+	*/
+	virtual void getSamplesInterleaved(double *data, unsigned int nb_samples) = 0;
+
+
 	/**
 	* @brief Retrieve a specific number of raw samples from both channels
 	*
@@ -109,6 +147,244 @@ public:
 	virtual const short* getSamplesRawInterleaved(unsigned int nb_samples) = 0;
 
 
+	/**
+	* @brief Retrieve a specific number of raw samples from each channel, without copying them
+	*
+	* @param nb_samples The number of samples that will be retrieved
+	* @return A list containing a view over the raw samples of each channel
+	*
+	* @note The index of the list corresponds to the index of the channel; disabled channels have empty views
+	* @note The views point inside the internal buffer and are valid only until the next acquisition
+	* @note Use convertRawToVolts to obtain the voltage of a sample
+	*/
+	virtual std::vector<libm2k::SAMPLE_VIEW<short>> getSamplesView(unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Acquire a specific number of samples and measure the waveform of each channel
+	*
+	* @param nb_samples The number of samples that will be measured
+	* @return A list containing the mean, RMS, extremes, frequency and duty cycle of each channel
+	*
+	* @note The index of the list corresponds to the index of the channel; disabled channels are not measured
+	* @note The raw samples are measured in place and only the results are converted to Volts
+	*/
+	virtual std::vector<MEASUREMENT_RESULTS> getMeasurements(unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Set the FFT size, the window, the overlap and the unit of the spectra
+	*
+	* @param settings The settings of the spectrum analysis
+	*
+	* @note The defaults are 4096 samples, a Blackman-Harris window, 50% overlap and dBFS
+	* @note 0 dBFS is a full-scale sine of the current range: an amplitude of 2048 raw codes, or
+	* 2048 * getScalingFactor Volts
+	*/
+	virtual void setSpectrumSettings(const SPECTRUM_SETTINGS &settings) = 0;
+
+
+	/**
+	* @brief Retrieve the settings of the spectrum analysis
+	*
+	* @return The FFT size, the window, the overlap and the unit
+	*/
+	virtual SPECTRUM_SETTINGS getSpectrumSettings() = 0;
+
+
+	/**
+	* @brief Acquire a specific number of samples and compute the averaged spectrum of each channel
+	*
+	* @param nb_samples The number of samples to analyze; at least the FFT size
+	* @return A list containing the spectrum of each channel
+	*
+	* @note The samples are split in overlapping segments of the FFT size, whose power is averaged
+	* (Welch's method); the FFT runs on the raw samples, in place
+	* @note The index of the list corresponds to the index of the channel; disabled channels are not analyzed
+	*/
+	virtual std::vector<SPECTRUM> getSpectrum(unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Start a continuous acquisition on a dedicated thread
+	*
+	* @param nb_samples The number of samples per channel in each block
+	* @param queue_depth The number of acquired blocks that can wait to be consumed
+	*
+	* @note Both channels are acquired while streaming, regardless of their enable state
+	* @note Blocks that find the queue full are dropped and counted as overruns
+	*/
+	virtual void startStreaming(unsigned int nb_samples, unsigned int queue_depth = 8) = 0;
+
+
+	/**
+	* @brief Set the software trigger of the streaming callbacks
+	*
+	* @param trigger The condition, the source channel, the levels in Volts and the frame length
+	*
+	* @note With the trigger enabled, the callback passed to startStreaming receives one frame per
+	* trigger instead of the acquired blocks, while the acquisition keeps running; the position of
+	* the frame in the stream is given by STREAMING_BLOCK::first_sample
+	* @note The levels are converted to raw codes when the streaming starts, and the condition is
+	* evaluated on the raw samples of every block, at the full sample rate
+	* @note The trigger can not be combined with setStreamingDecimation and does not apply to
+	* popStreamingBlock or to the recordings
+	* @note The numbers of triggered frames and of missed triggers are reported by getStreamingStatistics
+	*/
+	virtual void setStreamingTrigger(const STREAMING_TRIGGER &trigger) = 0;
+
+
+	/**
+	* @brief Retrieve the software trigger of the streaming callbacks
+	*
+	* @return The settings of the trigger
+	*/
+	virtual STREAMING_TRIGGER getStreamingTrigger() = 0;
+
+
+	/**
+	* @brief Measure every block of the streams started afterwards
+	*
+	* @param enable If true, the waveform of each channel is measured over all the streamed samples
+	*
+	* @note The blocks are measured at the full sample rate, before any decimation, on the thread
+	* that consumes them: the callback thread or the caller of popStreamingBlock
+	*/
+	virtual void setStreamingMeasurements(bool enable) = 0;
+
+
+	/**
+	* @brief Retrieve the measurements accumulated since the streaming started or since the last reset
+	*
+	* @return A list containing the measurements of each channel
+	*
+	* @note The results remain available after stopStreaming
+	* @note Dropped blocks are left out; the periods spanning a gap are not counted
+	*/
+	virtual std::vector<MEASUREMENT_RESULTS> getStreamingMeasurements() = 0;
+
+
+	/**
+	* @brief Restart the accumulation of the streaming measurements
+	*/
+	virtual void resetStreamingMeasurements() = 0;
+
+
+	/**
+	* @brief Compute the averaged spectrum of every block of the streams started afterwards
+	*
+	* @param enable If true, the segments of each channel are averaged over all the streamed samples
+	*
+	* @note The settings of setSpectrumSettings are used; the blocks are analyzed at the full sample rate,
+	* before any decimation, on the thread that consumes them, like the streaming measurements
+	* @note A segment may span consecutive blocks; the partial segment is dropped when a block is lost
+	*/
+	virtual void setStreamingSpectrum(bool enable) = 0;
+
+
+	/**
+	* @brief Retrieve the spectra averaged since the streaming started or since the last reset
+	*
+	* @return A list containing the spectrum of each channel
+	*
+	* @note The results remain available after stopStreaming
+	*/
+	virtual std::vector<SPECTRUM> getStreamingSpectrum() = 0;
+
+
+	/**
+	* @brief Restart the averaging of the streaming spectra
+	*/
+	virtual void resetStreamingSpectrum() = 0;
+
+
+	/**
+	* @brief Decimate the blocks delivered to the streaming callbacks and written by the recordings
+	*
+	* @param mode The decimation filter: boxcar average, CIC or min/max envelope
+	* @param factor The number of input samples per output sample; 1 disables the decimation
+	* @param order The number of stages of the CIC filter, between 1 and 6
+	*
+	* @note The raw samples are decimated with integer arithmetic, before the conversion to Volts;
+	* boxcar and CIC keep the raw scale, so the conversion coefficients still apply
+	* @note With DECIMATION_MIN_MAX every window produces two samples: its minimum and its maximum
+	* @note The filter state carries over from one block to the next and is reset after a dropped block
+	* @note The setting applies to the streams started afterwards; popStreamingBlock is not decimated
+	*/
+	virtual void setStreamingDecimation(M2K_DECIMATION_MODE mode, unsigned int factor, unsigned int order = 3) = 0;
+
+
+	/**
+	* @brief Start a continuous acquisition delivering every block to a callback
+	*
+	* @param nb_samples The number of samples per channel in each block
+	* @param callback The function called, on a dedicated thread, for every acquired block
+	* @param processed If true, each block also carries the samples converted to Volts
+	* @param queue_depth The number of acquired blocks that can wait for the callback
+	*
+	* @note The refill thread copies each block into the queue once; the callback reads it in place
+	* @note Blocks that find the queue full are dropped and counted as overruns; the gaps also show in the block index
+	* @note Use setKernelBuffersCount before starting to tune the depth of the device buffering
+	* @note The callback must not call stopStreaming; if it throws, the acquisition stops and
+	* stopStreaming reports the error
+	*/
+	virtual void startStreaming(unsigned int nb_samples, std::function<void(const libm2k::STREAMING_BLOCK &)> callback,
+				    bool processed = false, unsigned int queue_depth = 8) = 0;
+
+
+	/**
+	* @brief Stop the continuous acquisition and drop the blocks that were not consumed
+	*
+	* @note If a streaming callback threw, its error is reported here
+	* @note A streaming that ended on an error still has to be stopped before starting a new one
+	*/
+	virtual void stopStreaming() = 0;
+
+
+	/**
+	* @brief Retrieve the oldest block acquired by the streaming thread
+	*
+	* @param timeout_ms The maximum time, in milliseconds, to wait for a block
+	* @return A pointer to the interleaved raw samples of both channels or nullptr if no block arrived in time
+	*
+	* @note The block is valid until the next call of popStreamingBlock or stopStreaming
+	*/
+	virtual const short* popStreamingBlock(unsigned int timeout_ms = 1000) = 0;
+
+
+	/**
+	* @brief Retrieve the counters of the continuous acquisition
+	*
+	* @return A structure containing the number of acquired, delivered and dropped blocks,
+	* the refill latencies and the delays of the callbacks
+	*/
+	virtual libm2k::STREAMING_STATISTICS getStreamingStatistics() = 0;
+
+
+	/**
+	* @brief Record the raw samples of both channels to a file, written on a dedicated thread
+	*
+	* @param path The path of the file to create
+	* @param nb_samples The number of samples per channel in each block written to the file
+	* @param queue_depth The number of acquired blocks that can wait to be written
+	*
+	* @note The file holds a header with the sample rate, the ranges, the calibration and the
+	* trigger settings, followed by the raw interleaved samples; read it with openRecording
+	* @note The recording uses the streaming threads; the dropped blocks are reported by
+	* getStreamingStatistics and stored in the header
+	* @note The samples are decimated as set by setStreamingDecimation; the settings are stored in the header
+	*/
+	virtual void startRecording(const std::string &path, unsigned int nb_samples = 65536, unsigned int queue_depth = 8) = 0;
+
+
+	/**
+	* @brief Stop the recording and complete the header of the file
+	*
+	* @return The number of samples of each channel written to the file
+	*/
+	virtual unsigned long long stopRecording() = 0;
+
+
 	/**
 	* @brief Retrieve the average raw value of the given channel
 	*
@@ -169,6 +445,8 @@ public:
 	* @brief Retrieve the average raw value for both channels
 	*
 	* @return A pointer to the average raw value of both channels
+	*
+	* @note The values are stored in memory owned by the M2kAnalogIn object, valid until the next call
 	*/
 	virtual const short *getVoltageRawP() = 0;
 
@@ -177,9 +455,67 @@ public:
 	* @brief Retrieve the average voltage for both channels
 	*
 	* @return A pointer to the average voltage of both channels
+	*
+	* @note The values are stored in memory owned by the M2kAnalogIn object, valid until the next call
 	*/
 	virtual const double *getVoltageP() = 0;
 
+
+	/**
+	* @brief Keep the acquisition configured for DC measurements
+	*
+	* @param nb_samples The number of samples averaged for each reading
+	*
+	* @note While the voltmeter runs, getVoltage and getVoltageRaw reuse the RX buffer, the trigger
+	* and the channel configuration between calls; the raw codes are summed in integers and only
+	* the mean is converted to Volts
+	* @note The voltmeter is an acquisition session (see startSession) with the trigger mode of every
+	* channel set to ALWAYS
+	*/
+	virtual void startVoltmeter(unsigned int nb_samples = 100) = 0;
+
+
+	/**
+	* @brief Restore the trigger modes and the enabled channels saved by startVoltmeter
+	*/
+	virtual void stopVoltmeter() = 0;
+
+
+	/**
+	* @brief Check if the voltmeter mode is active
+	*
+	* @return True if startVoltmeter was called and the voltmeter was not stopped
+	*/
+	virtual bool isVoltmeterRunning() = 0;
+
+
+	/**
+	* @brief Start an acquisition session, keeping the acquisition configured between captures
+	*
+	* @param nb_samples The number of samples per channel of every capture in the session
+	*
+	* @note For the lifetime of the session the enabled channels, the buffer size, the sample rate
+	* and the conversion coefficients are pinned, so the captures do no configuration I/O
+	* @note Changing the enabled channels, the sample rate, the oversampling ratio, the range, the
+	* vertical offset or the ADC calibration throws until stopSession is called
+	* @note Every capture must request nb_samples samples
+	*/
+	virtual void startSession(unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Stop the acquisition session and restore the enabled channels
+	*/
+	virtual void stopSession() = 0;
+
+
+	/**
+	* @brief Check if an acquisition session is active
+	*
+	* @return True if startSession or startVoltmeter was called and the session was not stopped
+	*/
+	virtual bool isSessionRunning() = 0;
+
 	/**
 	 * @brief Set the vertical offset, in Volts, of a specific channel
 	 * @param channel the index of the channel
@@ -448,6 +784,30 @@ public:
 	*/
 	virtual void getSamples(std::vector<std::vector<double>> &data, unsigned int nb_samples) = 0;
 
+
+	/**
+	* @brief Retrieve a specific number of samples from each channel, in single precision
+	*
+	* @param data - a reference to a vector owned/created by the client
+	* @param nb_samples The number of samples that will be retrieved
+	*
+	* @note The vector will be cleaned and then filled with samples
+	* @note The index of the list corresponds to the index of the channel
+	*/
+	virtual void getSamples(std::vector<std::vector<float>> &data, unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Retrieve a specific number of raw samples from each channel, as 16-bit ADC codes
+	*
+	* @param data - a reference to a vector owned/created by the client
+	* @param nb_samples The number of samples that will be retrieved
+	*
+	* @note The vector will be cleaned and then filled with samples
+	* @note The index of the list corresponds to the index of the channel
+	*/
+	virtual void getSamplesRaw(std::vector<std::vector<short>> &data, unsigned int nb_samples) = 0;
+
 	/**
 	 * @brief Get the channel name for each ADC channel
 	 * @param channel - unsigned int representing the index of the channel
@@ -455,6 +815,48 @@ public:
 	 */
 	virtual std::string getChannelName(unsigned int channel) = 0;
 
+	/**
+	 * @brief Enable or disable the attribute cache of the instrument
+	 * @param enable A boolean value corresponding to the state of the cache
+	 *
+	 * @note When enabled, the attributes changed only by the library (sampling frequency,
+	 * oversampling ratio, gain, calibration) are read back once after each write and then
+	 * served from memory. Call invalidateAttributeCache() if they were changed by another client.
+	 */
+	virtual void setAttributeCaching(bool enable) = 0;
+
+	/**
+	 * @brief Drop the cached attribute values; the next accesses read them from the device
+	 */
+	virtual void invalidateAttributeCache() = 0;
+
+	/**
+	 * @brief Start collecting the attribute writes of the instrument instead of sending them
+	 *
+	 * @note Calls can be nested; the writes are sent by the outermost commitConfiguration().
+	 * While the configuration is open, the setters return the requested values and the getters
+	 * return the staged values.
+	 */
+	virtual void beginConfiguration() = 0;
+
+	/**
+	 * @brief Send the collected attribute writes in one batch
+	 *
+	 * @note Only the attributes whose value differs from the value read back after the last write are sent.
+	 * A failed write does not stop the batch; the failures are reported once all the values were sent.
+	 * @throw EXC_INVALID_PARAMETER No configuration in progress, the configuration was cancelled by a
+	 * nested call or an attribute could not be written
+	 */
+	virtual void commitConfiguration() = 0;
+
+	/**
+	 * @brief Drop the collected attribute writes without sending them
+	 *
+	 * @note A nested call cancels the whole configuration: the outermost
+	 * commitConfiguration() drops the writes and throws.
+	 */
+	virtual void cancelConfiguration() = 0;
+
 };
 }
 }
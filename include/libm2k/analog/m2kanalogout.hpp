@@ -24,7 +24,10 @@
 
 #include <libm2k/m2kglobal.hpp>
 #include <libm2k/enums.hpp>
+#include <libm2k/analog/enums.hpp>
 #include <vector>
+#include <string>
+#include <functional>
 #include <memory>
 #include <map>
 
@@ -246,6 +249,7 @@ public:
 	* @note Make sure the samples are interleaved
 	* @note Streaming data is possible - required multiple kernel buffers
 	* @note The given channel will be synchronized with the other channel
+	* @throw EXC_OUT_OF_RANGE No such channel
 	*/
 	virtual void pushInterleaved(double *data, unsigned int nb_channels, unsigned int nb_samples) = 0;
 
@@ -259,6 +263,7 @@ public:
 	* @note Make sure the raw samples are interleaved
 	* @note Streaming data is possible - required multiple kernel buffers
 	* @note The given channel will be synchronized with the other channel
+	* @throw EXC_OUT_OF_RANGE No such channel
 	*/
 	virtual void pushRawInterleaved(short *data, unsigned int nb_channels, unsigned int nb_samples) = 0;
 
@@ -313,6 +318,236 @@ public:
 	virtual void pushRaw(std::vector<std::vector<short>> const &data) = 0;
 
 
+	/**
+	* @brief Retrieve writable memory for the next buffer of the given channel
+	*
+	* @param chnIdx The index corresponding to the channel
+	* @param nb_samples The number of samples of the buffer
+	* @return A pointer to nb_samples raw samples, to be filled by the client
+	*
+	* @note The samples are raw DAC values, see convertVoltsToRaw and getScalingFactor
+	* @note Nothing is sent until commitBuffer is called for the same channel
+	* @note The given channel won't be synchronized with the other channel
+	* @throw EXC_OUT_OF_RANGE No such channel
+	*/
+	virtual short *acquireBuffer(unsigned int chnIdx, unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Send the buffer previously retrieved with acquireBuffer
+	*
+	* @param chnIdx The index corresponding to the channel
+	*
+	* @note Streaming data is possible - required multiple kernel buffers
+	* @throw EXC_OUT_OF_RANGE No such channel
+	*/
+	virtual void commitBuffer(unsigned int chnIdx) = 0;
+
+
+	/**
+	* @brief Store a waveform under the given id, to be activated later with activateWaveform
+	*
+	* @param id The name of the waveform; an existing waveform with the same id is replaced
+	* @param data A list containing lists of samples, in Volts
+	*
+	* @note The index of each list of samples represents the channel's index; an empty list
+	* leaves the channel out of the waveform
+	* @note The samples are converted once, with the current calibration, sample rate and
+	* oversampling ratio of each channel; the waveform has to be registered again after calibrating
+	* @throw EXC_INVALID_PARAMETER No samples or too many channels
+	*/
+	virtual void registerWaveform(const std::string &id, std::vector<std::vector<double>> const &data) = 0;
+
+
+	/**
+	* @brief Store a waveform of raw samples under the given id, to be activated later with activateWaveform
+	*
+	* @param id The name of the waveform; an existing waveform with the same id is replaced
+	* @param data A list containing lists of raw samples
+	*
+	* @note The index of each list of samples represents the channel's index; an empty list
+	* leaves the channel out of the waveform
+	* @note The current sample rate and oversampling ratio of each channel are stored with the samples
+	* @throw EXC_INVALID_PARAMETER No samples or too many channels
+	*/
+	virtual void registerWaveformRaw(const std::string &id, std::vector<std::vector<short>> const &data) = 0;
+
+
+	/**
+	* @brief Generate a registered waveform on its channels
+	*
+	* @param id The name of the waveform
+	* @return The switch latency, in seconds
+	*
+	* @note The sample rate and the oversampling ratio are written only when they differ from the
+	* ones the waveform was registered with; nothing is sent when the waveform is still being generated
+	* @note The channels are synchronized only when the waveform is activated on both of them
+	* @throw EXC_INVALID_PARAMETER No such waveform
+	*/
+	virtual double activateWaveform(const std::string &id) = 0;
+
+
+	/**
+	* @brief Remove a registered waveform
+	*
+	* @param id The name of the waveform
+	*
+	* @note A waveform that is being generated keeps running
+	* @throw EXC_INVALID_PARAMETER No such waveform
+	*/
+	virtual void unregisterWaveform(const std::string &id) = 0;
+
+
+	/**
+	* @brief Retrieve the ids of all registered waveforms
+	*
+	* @return A list containing the ids, in alphabetical order
+	*/
+	virtual std::vector<std::string> getWaveforms() = 0;
+
+
+	/**
+	* @brief Retrieve the description of a registered waveform
+	*
+	* @param id The name of the waveform
+	* @return A structure containing the samples per channel, the sample rates and the switch latency
+	* @throw EXC_INVALID_PARAMETER No such waveform
+	*/
+	virtual libm2k::analog::WAVEFORM_INFO getWaveformInfo(const std::string &id) = 0;
+
+
+	/**
+	* @brief Start a continuous generation fed by a producer
+	*
+	* @param nb_samples The number of samples per channel in each block
+	* @param producer The function called, on a dedicated thread, to fill every block; returning
+	* false ends the stream after the blocks already pushed
+	* @param processed If true, the producer fills the blocks in Volts and they are converted to raw samples
+	*
+	* @note The enabled channels are streamed, in non-cyclic mode; the producer writes straight into the TX buffers
+	* @note The stream starts once the kernel buffers are full, see setKernelBuffersCount; both channels start synchronized
+	* @note When the kernel buffers are found empty, the underrun is counted and the channels are synchronized again
+	* @note Until stopStreaming or stop is called, the pushes, the waveform activation and the changes of the
+	* sample rate, oversampling ratio, cyclic mode and kernel buffers throw EXC_INVALID_PARAMETER; the stream
+	* keeps the rates and the calibration it was started with
+	* @note The producer must not call stopStreaming; if it throws, the generation stops and
+	* stopStreaming reports the error
+	* @throw EXC_INVALID_PARAMETER Streaming already started, no channel enabled or no samples
+	*/
+	virtual void startStreaming(unsigned int nb_samples, std::function<bool(const libm2k::GENERATOR_BLOCK &)> producer,
+				    bool processed = false) = 0;
+
+
+	/**
+	* @brief Stop the continuous generation and drop the samples waiting in the kernel buffers
+	*
+	* @note If the producer threw, its error is reported here
+	*/
+	virtual void stopStreaming() = 0;
+
+
+	/**
+	* @brief Check whether the producer is still called
+	*
+	* @return False once the producer ended the stream or failed, or after stopStreaming
+	*/
+	virtual bool isStreaming() = 0;
+
+
+	/**
+	* @brief Retrieve the counters of the continuous generation
+	*
+	* @return A structure containing the number of blocks and underruns, the occupancy of the kernel
+	* buffers, the latency and the duration of the producer calls
+	*/
+	virtual libm2k::GENERATOR_STATISTICS getStreamingStatistics() = 0;
+
+
+	/**
+	* @brief Set the waveform synthesized for the given channel
+	*
+	* @param chnIdx The index corresponding to the channel
+	* @param settings The tones, added together, and the offset
+	*
+	* @note The synthesis starts over from the phases of the settings
+	* @throw EXC_OUT_OF_RANGE No such channel
+	* @throw EXC_INVALID_PARAMETER A frequency above half the sample rate or an invalid duty cycle or sweep
+	*/
+	virtual void setSynthesizer(unsigned int chnIdx, const libm2k::analog::SYNTH_SETTINGS &settings) = 0;
+
+
+	/**
+	* @brief Retrieve the waveform synthesized for the given channel
+	*
+	* @param chnIdx The index corresponding to the channel
+	* @return The settings of the synthesizer; no tones and no offset when none was set
+	* @throw EXC_OUT_OF_RANGE No such channel
+	*/
+	virtual libm2k::analog::SYNTH_SETTINGS getSynthesizer(unsigned int chnIdx) = 0;
+
+
+	/**
+	* @brief Synthesize the next samples of the given channel, as raw DAC values
+	*
+	* @param chnIdx The index corresponding to the channel
+	* @param data The memory to fill, with nb_samples raw samples
+	* @param nb_samples The number of samples
+	*
+	* @note The phase continues from the previous call, so that consecutive blocks, e.g. the blocks
+	* of startStreaming, form one continuous waveform
+	* @note The samples are scaled with the current calibration, sample rate and oversampling ratio
+	* @throw EXC_OUT_OF_RANGE No such channel
+	* @throw EXC_INVALID_PARAMETER No synthesizer set for the channel
+	*/
+	virtual void synthesizeRaw(unsigned int chnIdx, short *data, unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Synthesize the next samples of the given channel, as raw DAC values
+	*
+	* @param chnIdx The index corresponding to the channel
+	* @param nb_samples The number of samples
+	* @return A list containing the raw samples
+	*
+	* @note The phase continues from the previous call
+	* @throw EXC_OUT_OF_RANGE No such channel
+	* @throw EXC_INVALID_PARAMETER No synthesizer set for the channel
+	*/
+	virtual std::vector<short> synthesizeRaw(unsigned int chnIdx, unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Generate the synthesized waveform of the given channel, as one seamless loop
+	*
+	* @param chnIdx The index corresponding to the channel
+	* @return The number of samples of the buffer
+	*
+	* @note The buffer is synthesized in place and holds one sweep or whole periods of every tone,
+	* up to 1048576 samples; the frequencies that do not fit exactly are rounded to whole periods
+	* @note A sweep must last at most 1048576 samples at the output rate (sample rate / oversampling ratio)
+	* and all the sweeps of the channel must last the same; use startStreaming with synthesizeRaw
+	* for the longer or the unequal sweeps
+	* @note The loop starts from the phases of the settings and does not move the phase of synthesizeRaw
+	* @note The given channel won't be synchronized with the other channel
+	* @throw EXC_OUT_OF_RANGE No such channel
+	* @throw EXC_INVALID_PARAMETER No synthesizer set for the channel, a sweep longer than the loop limit
+	* or sweeps of different durations
+	*/
+	virtual unsigned int pushSynthesized(unsigned int chnIdx) = 0;
+
+
+	/**
+	* @brief Generate the synthesized waveforms of all the channels that have a synthesizer, synchronized
+	*
+	* @return The number of samples of the buffer of each channel; 0 for the channels without a synthesizer
+	*
+	* @note Each channel gets its own seamless loop, as in pushSynthesized(chnIdx), with the same sweep limits
+	* @throw EXC_INVALID_PARAMETER No synthesizer set, a sweep longer than the loop limit or sweeps of
+	* different durations on a channel
+	*/
+	virtual std::vector<unsigned int> pushSynthesized() = 0;
+
+
 	/**
 	* @brief Stop all channels from sending the signals.
 	*
@@ -382,6 +617,9 @@ public:
 	 * @param channel The index corresponding to the channel
 	 * @param voltage The volts value of a sample
 	 * @return The value of a sample converted into raw
+	 *
+	 * @note The value is rounded to the nearest code and saturated to the 16-bit range,
+	 * the same way push converts the samples
 	 */
 	virtual short convertVoltsToRaw(unsigned int channel, double voltage) = 0;
 
@@ -403,6 +641,15 @@ public:
 	virtual struct IIO_OBJECTS getIioObjects() = 0;
 
 
+	/**
+	 * @brief Retrieve the buffer counters of the given channel
+	 * @param chnIdx The index corresponding to the channel
+	 * @return A structure containing the number of pushes, the created and reused buffers and the push latency
+	 * @throw EXC_OUT_OF_RANGE No such channel
+	 */
+	virtual struct BUFFER_STATISTICS getBufferStatistics(unsigned int chnIdx) = 0;
+
+
 	/**
 	* @brief Retrieve the number of analogical channels
 	* @return The number of channels
@@ -416,6 +663,49 @@ public:
 	 * @return std::string - name of the channel
 	 */
 	virtual std::string getChannelName(unsigned int channel) = 0;
+
+	/**
+	 * @brief Enable or disable the attribute cache of the instrument
+	 * @param enable A boolean value corresponding to the state of the cache
+	 *
+	 * @note When enabled, the attributes changed only by the library (sampling frequency,
+	 * oversampling ratio, gain, calibration) are read back once after each write and then
+	 * served from memory. Call invalidateAttributeCache() if they were changed by another client.
+	 */
+	virtual void setAttributeCaching(bool enable) = 0;
+
+	/**
+	 * @brief Drop the cached attribute values; the next accesses read them from the device
+	 */
+	virtual void invalidateAttributeCache() = 0;
+
+	/**
+	 * @brief Start collecting the attribute writes of the instrument instead of sending them
+	 *
+	 * @note Calls can be nested; the writes are sent by the outermost commitConfiguration().
+	 * While the configuration is open, the setters return the requested values and the getters
+	 * return the staged values.
+	 */
+	virtual void beginConfiguration() = 0;
+
+	/**
+	 * @brief Send the collected attribute writes in one batch
+	 *
+	 * @note Only the attributes whose value differs from the value read back after the last write are sent.
+	 * A failed write does not stop the batch; the failures are reported once all the values were sent.
+	 * @throw EXC_INVALID_PARAMETER No configuration in progress, the configuration was cancelled by a
+	 * nested call or an attribute could not be written
+	 */
+	virtual void commitConfiguration() = 0;
+
+	/**
+	 * @brief Drop the collected attribute writes without sending them
+	 *
+	 * @note A nested call cancels the whole configuration: the outermost
+	 * commitConfiguration() drops the writes and throws.
+	 */
+	virtual void cancelConfiguration() = 0;
+
 };
 }
 }
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef M2KRECORDING_HPP
+#define M2KRECORDING_HPP
+
+#include <libm2k/m2kglobal.hpp>
+#include <libm2k/enums.hpp>
+#include <libm2k/analog/enums.hpp>
+#include <string>
+#include <vector>
+
+namespace libm2k {
+namespace analog {
+
+/**
+ * @struct RECORDING_INFO
+ * @brief Acquisition settings stored in the header of a raw recording
+ */
+struct RECORDING_INFO {
+	double sample_rate; ///< Sample rate of the ADC, in samples per second; divide by decimation_factor for the stored rate
+	int oversampling_ratio; ///< Oversampling ratio of the ADC
+	unsigned int nb_channels; ///< Number of interleaved channels
+	unsigned long long nb_samples; ///< Number of samples of each channel, after decimation
+	unsigned long long dropped_blocks; ///< Number of blocks lost while recording; 0 for a gap-free recording
+	std::vector<M2K_RANGE> ranges; ///< Input range of each channel
+	std::vector<double> calib_gains; ///< ADC calibration gain of each channel
+	std::vector<int> calib_offsets; ///< ADC calibration offset of each channel, in raw codes
+	std::vector<double> vertical_offsets; ///< Vertical offset of each channel, in Volts
+	std::vector<double> scales; ///< Conversion of each channel: volts = raw * scale + offset
+	std::vector<double> offsets; ///< Conversion of each channel: volts = raw * scale + offset
+	std::vector<libm2k::M2K_TRIGGER_MODE> trigger_modes; ///< Trigger mode of each channel
+	std::vector<libm2k::M2K_TRIGGER_CONDITION_ANALOG> trigger_conditions; ///< Trigger condition of each channel
+	std::vector<int> trigger_levels; ///< Trigger level of each channel, in raw codes
+	std::vector<double> trigger_hysteresis; ///< Trigger hysteresis of each channel, in Volts
+	libm2k::M2K_TRIGGER_SOURCE_ANALOG trigger_source; ///< Trigger source
+	int trigger_delay; ///< Trigger delay, in samples
+	M2K_DECIMATION_MODE decimation_mode; ///< Decimation filter applied before storing the samples
+	unsigned int decimation_factor; ///< Decimation factor; 1 if the samples were stored undecimated
+	unsigned int decimation_order; ///< Number of stages of the CIC decimation filter
+};
+
+
+/**
+ * @defgroup m2krecording M2kRecording
+ * @brief Contains the reader of the raw recordings written by M2kAnalogIn::startRecording
+ * @{
+ * @class M2kRecording
+ * @brief Memory-mapped reader of a raw recording
+ *
+ * The samples are read lazily from the mapped file; nothing is loaded or converted
+ * until it is requested.
+ *
+ * A recording is little-endian, with the natural alignment of each field:
+ * - A 72-byte file header, at offset 0:
+ *   | Offset | Type     | Field                                   |
+ *   |--------|----------|-----------------------------------------|
+ *   | 0      | char[8]  | magic, "LM2KRAW\0"                      |
+ *   | 8      | uint32   | version of the format, currently 2      |
+ *   | 12     | uint32   | nb_channels                             |
+ *   | 16     | uint64   | data_offset, the offset of the samples  |
+ *   | 24     | uint64   | nb_samples of each channel              |
+ *   | 32     | uint64   | dropped_blocks                          |
+ *   | 40     | double   | sample_rate                             |
+ *   | 48     | int32    | oversampling_ratio                      |
+ *   | 52     | int32    | trigger_source                          |
+ *   | 56     | int32    | trigger_delay                           |
+ *   | 60     | int32    | decimation_mode                         |
+ *   | 64     | uint32   | decimation_factor                       |
+ *   | 68     | uint32   | decimation_order                        |
+ * - A 64-byte channel header for each channel, from offset 72:
+ *   | Offset | Type     | Field                                   |
+ *   |--------|----------|-----------------------------------------|
+ *   | 0      | double   | calib_gain                              |
+ *   | 8      | double   | vertical_offset                         |
+ *   | 16     | double   | scale                                   |
+ *   | 24     | double   | offset                                  |
+ *   | 32     | double   | trigger_hysteresis                      |
+ *   | 40     | int32    | range                                   |
+ *   | 44     | int32    | calib_offset                            |
+ *   | 48     | int32    | trigger_mode                            |
+ *   | 52     | int32    | trigger_condition                       |
+ *   | 56     | int32    | trigger_level                           |
+ *   | 60     | int32    | reserved, 0                             |
+ * - The int16 raw samples of all the channels, interleaved, from data_offset
+ *   (72 + 64 * nb_channels) to the end of the file.
+ *
+ * The enumerations are stored as their integer values and the doubles as IEEE-754
+ * binary64. The fields are written in the byte order of the host, little-endian on
+ * every supported platform; a file of the other byte order fails the version check
+ * and is rejected as invalid.
+ */
+class LIBM2K_API M2kRecording
+{
+public:
+	/**
+	* @private
+	*/
+	virtual ~M2kRecording() {}
+
+
+	/**
+	* @brief Retrieve the acquisition settings stored in the header of the recording
+	*
+	* @return The settings of the recording
+	*/
+	virtual RECORDING_INFO getInfo() = 0;
+
+
+	/**
+	* @brief Retrieve the number of channels stored in the recording
+	*
+	* @return The number of channels
+	*/
+	virtual unsigned int getNbChannels() = 0;
+
+
+	/**
+	* @brief Retrieve the number of samples of each channel
+	*
+	* @return The number of samples
+	*/
+	virtual unsigned long long getNbSamples() = 0;
+
+
+	/**
+	* @brief Retrieve a view over the raw samples of a channel, inside the mapped file
+	*
+	* @param channel The index of the channel
+	* @param first The index of the first sample
+	* @param nb_samples The number of samples
+	* @return A view over the raw samples of the channel
+	*
+	* @note The view is valid until the recording is closed
+	*/
+	virtual libm2k::SAMPLE_VIEW<short> getSamplesView(unsigned int channel, unsigned long long first,
+							   unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Retrieve the raw samples of a channel
+	*
+	* @param channel The index of the channel
+	* @param first The index of the first sample
+	* @param nb_samples The number of samples
+	* @return A list containing the raw samples
+	*/
+	virtual std::vector<short> getSamplesRaw(unsigned int channel, unsigned long long first,
+						 unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Retrieve the samples of a channel, converted to Volts
+	*
+	* @param channel The index of the channel
+	* @param first The index of the first sample
+	* @param nb_samples The number of samples
+	* @return A list containing the voltages
+	*/
+	virtual std::vector<double> getSamples(unsigned int channel, unsigned long long first,
+					       unsigned int nb_samples) = 0;
+};
+
+
+/**
+* @brief Open a raw recording
+*
+* @param path The path of the file written by M2kAnalogIn::startRecording
+* @return A reader for the recording
+*
+* @note The reader must be released with closeRecording
+*/
+LIBM2K_API M2kRecording *openRecording(const std::string &path);
+
+
+/**
+* @brief Close a raw recording, releasing the mapped file
+*
+* @param recording The reader returned by openRecording
+*/
+LIBM2K_API void closeRecording(M2kRecording *recording);
+/** @} */
+}
+}
+
+#endif //M2KRECORDING_HPP
@@ -131,6 +131,24 @@ public:
 	virtual void push(unsigned short *data, unsigned int nb_samples) = 0;
 
 
+	/**
+	* @brief Retrieve writable memory for the next buffer of the digital channels
+	*
+	* @param nb_samples The number of samples of the buffer
+	* @return A pointer to nb_samples samples, to be filled by the client
+	*
+	* @note Each sample holds the state of all 16 digital channels
+	* @note Nothing is sent until commitBuffer is called
+	*/
+	virtual unsigned short *acquireBuffer(unsigned int nb_samples) = 0;
+
+
+	/**
+	* @brief Send the buffer previously retrieved with acquireBuffer
+	*/
+	virtual void commitBuffer() = 0;
+
+
 	/**
 	* @brief Set the raw value of a given digital channel
 	*
@@ -215,6 +233,46 @@ public:
 	 */
 	virtual const unsigned short *getSamplesP(unsigned int nb_samples) = 0;
 
+
+	/**
+	 * @brief Retrieve a specific number of samples, without copying them
+	 * @param nb_samples The number of samples that will be retrieved
+	 * @return A view over the samples; each sample holds the state of all 16 digital channels
+	 * @note The view points inside the internal buffer and is valid only until the next acquisition
+	 */
+	virtual libm2k::SAMPLE_VIEW<unsigned short> getSamplesView(unsigned int nb_samples) = 0;
+
+
+	/**
+	 * @brief Start a continuous acquisition on a dedicated thread
+	 * @param nb_samples The number of samples in each block
+	 * @param queue_depth The number of acquired blocks that can wait to be consumed
+	 * @note Blocks that find the queue full are dropped and counted as overruns
+	 */
+	virtual void startStreaming(unsigned int nb_samples, unsigned int queue_depth = 8) = 0;
+
+
+	/**
+	 * @brief Stop the continuous acquisition and drop the blocks that were not consumed
+	 */
+	virtual void stopStreaming() = 0;
+
+
+	/**
+	 * @brief Retrieve the oldest block acquired by the streaming thread
+	 * @param timeout_ms The maximum time, in milliseconds, to wait for a block
+	 * @return A pointer to the samples of the block or nullptr if no block arrived in time
+	 * @note The block is valid until the next call of popStreamingBlock or stopStreaming
+	 */
+	virtual const unsigned short *popStreamingBlock(unsigned int timeout_ms = 1000) = 0;
+
+
+	/**
+	 * @brief Retrieve the counters of the continuous acquisition
+	 * @return A structure containing the number of acquired, delivered and dropped blocks
+	 */
+	virtual libm2k::STREAMING_STATISTICS getStreamingStatistics() = 0;
+
 	/* Enable/disable TX channels only*/
 
 
@@ -397,6 +455,48 @@ public:
 	 */
 	virtual void getSamples(std::vector<unsigned short> &data, unsigned int nb_samples) = 0;
 
+	/**
+	 * @brief Enable or disable the attribute cache of the instrument
+	 * @param enable A boolean value corresponding to the state of the cache
+	 *
+	 * @note When enabled, the attributes changed only by the library (sampling frequency,
+	 * oversampling ratio, gain, calibration) are read back once after each write and then
+	 * served from memory. Call invalidateAttributeCache() if they were changed by another client.
+	 */
+	virtual void setAttributeCaching(bool enable) = 0;
+
+	/**
+	 * @brief Drop the cached attribute values; the next accesses read them from the device
+	 */
+	virtual void invalidateAttributeCache() = 0;
+
+	/**
+	 * @brief Start collecting the attribute writes of the instrument instead of sending them
+	 *
+	 * @note Calls can be nested; the writes are sent by the outermost commitConfiguration().
+	 * While the configuration is open, the setters return the requested values and the getters
+	 * return the staged values.
+	 */
+	virtual void beginConfiguration() = 0;
+
+	/**
+	 * @brief Send the collected attribute writes in one batch
+	 *
+	 * @note Only the attributes whose value differs from the value read back after the last write are sent.
+	 * A failed write does not stop the batch; the failures are reported once all the values were sent.
+	 * @throw EXC_INVALID_PARAMETER No configuration in progress, the configuration was cancelled by a
+	 * nested call or an attribute could not be written
+	 */
+	virtual void commitConfiguration() = 0;
+
+	/**
+	 * @brief Drop the collected attribute writes without sending them
+	 *
+	 * @note A nested call cancels the whole configuration: the outermost
+	 * commitConfiguration() drops the writes and throws.
+	 */
+	virtual void cancelConfiguration() = 0;
+
 };
 }
 }
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
 
 extern "C" {
 	struct iio_context;
@@ -185,6 +186,115 @@ namespace libm2k {
 	};
 
 
+	/**
+	 * @struct SAMPLE_VIEW
+	 * @brief Non-owning view over the samples of one channel, stored inside a refilled IIO buffer
+	 *
+	 * @note The view is only valid until the next refill of the buffer it was taken from
+	 * (next acquisition, stopAcquisition or destruction of the instrument)
+	 */
+	template <typename T>
+	struct SAMPLE_VIEW {
+		const T *data; ///< Pointer to the first sample of the channel, nullptr for disabled channels
+		std::ptrdiff_t step; ///< Distance, in elements, between two consecutive samples of the channel
+		unsigned int nb_samples; ///< Number of samples available in the view
+
+		/**
+		 * @brief Retrieve the sample found at the given index
+		 * @param index The index of the sample, smaller than nb_samples
+		 * @return The raw value of the sample
+		 */
+		T operator[](unsigned int index) const { return data[index * step]; }
+	};
+
+
+	/**
+	 * @struct STREAMING_STATISTICS
+	 * @brief Counters describing a continuous acquisition
+	 */
+	struct STREAMING_STATISTICS {
+		unsigned long long blocks_acquired; ///< Number of blocks refilled from the device
+		unsigned long long blocks_delivered; ///< Number of blocks handed to the consumer
+		unsigned long long overruns; ///< Number of blocks dropped because the queue was full
+		unsigned int queue_depth; ///< Number of blocks waiting to be consumed
+		unsigned int queue_capacity; ///< Maximum number of blocks that can wait to be consumed
+		double last_refill_latency; ///< Duration, in seconds, of the last buffer refill
+		double max_refill_latency; ///< Longest buffer refill, in seconds
+		double total_refill_latency; ///< Sum of all buffer refills, in seconds
+		double last_callback_delay; ///< Time, in seconds, between the refill of the last delivered block and the start of its callback
+		double max_callback_delay; ///< Longest delay, in seconds, between the refill of a block and the start of its callback
+		unsigned long long triggered_frames; ///< Number of frames delivered by the software trigger
+		unsigned long long missed_triggers; ///< Number of triggers without a complete frame, at the start of the stream or around dropped blocks
+	};
+
+
+	/**
+	 * @struct STREAMING_BLOCK
+	 * @brief One block handed to the streaming callback
+	 *
+	 * @note The pointers are only valid during the callback
+	 */
+	struct STREAMING_BLOCK {
+		const short *raw; ///< Raw samples of all the channels, interleaved
+		const double *volts; ///< Converted samples, interleaved as raw; nullptr when the conversion was not requested
+		unsigned int nb_samples; ///< Number of samples of each channel
+		unsigned int nb_channels; ///< Number of interleaved channels
+		unsigned long long index; ///< Sequence number of the block; a gap means blocks were dropped. Sequence number of the frame, for the software trigger
+		unsigned long long first_sample; ///< Position of the first sample in the stream, counted in samples of each channel acquired since the start
+	};
+
+
+	/**
+	 * @struct GENERATOR_BLOCK
+	 * @brief One block requested from the streaming producer of the analog output
+	 *
+	 * @note The pointers are only valid during the producer call
+	 */
+	struct GENERATOR_BLOCK {
+		short *const *raw; ///< One pointer per streamed channel, to the raw samples to fill; nullptr when Volts were requested
+		double *const *volts; ///< One pointer per streamed channel, to the samples to fill in Volts; nullptr when raw samples were requested
+		const unsigned int *channels; ///< Index of each streamed channel
+		unsigned int nb_samples; ///< Number of samples to fill for each channel
+		unsigned int nb_channels; ///< Number of streamed channels
+		unsigned long long index; ///< Sequence number of the block
+		unsigned long long first_sample; ///< Position of the first sample in the stream, counted in samples of each channel
+	};
+
+
+	/**
+	 * @struct GENERATOR_STATISTICS
+	 * @brief Counters describing a continuous generation
+	 *
+	 * @note The occupancy is read from the data_available buffer attribute; it stays 0 and the underruns
+	 * are not detected on firmware versions that lack it
+	 */
+	struct GENERATOR_STATISTICS {
+		unsigned long long blocks_generated; ///< Number of blocks filled by the producer and pushed
+		unsigned long long underruns; ///< Number of times the kernel buffers were found empty before a push
+		unsigned int queued_samples; ///< Samples of each channel waiting in the kernel buffers before the last push
+		unsigned int min_queued_samples; ///< Fewest samples found waiting since the start, the closest the stream got to an underrun
+		unsigned int queue_capacity; ///< Samples of each channel the kernel buffers can hold
+		double last_latency; ///< Time, in seconds, between the push of the last block and the start of its generation
+		double max_latency; ///< Longest wait, in seconds, between the push of a block and the start of its generation
+		double last_producer_duration; ///< Duration, in seconds, of the last producer call
+		double max_producer_duration; ///< Longest producer call, in seconds
+	};
+
+
+	/**
+	 * @struct BUFFER_STATISTICS
+	 * @brief Counters describing the buffer operations of an output device
+	 */
+	struct BUFFER_STATISTICS {
+		unsigned long long nb_pushes; ///< Number of buffers pushed
+		unsigned long long buffers_created; ///< Number of IIO buffers created
+		unsigned long long buffers_reused; ///< Number of requests served by the existing IIO buffer
+		double last_push_latency; ///< Duration, in seconds, of the last push: buffer setup, copy and transfer
+		double max_push_latency; ///< Longest push duration, in seconds
+		double total_push_latency; ///< Sum of all push durations, in seconds
+	};
+
+
 	/**
 	 * @private
 	 */
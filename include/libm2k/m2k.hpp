@@ -258,6 +258,26 @@ public:
 	* @return Otherwise, false
 	*/
 	virtual bool getLed() = 0;
+
+
+	/**
+	* @brief Enable or disable the attribute cache of all the instruments
+	*
+	* @param enable A boolean value corresponding to the state of the cache
+	*
+	* @note When enabled, the attributes changed only by the library (sampling frequency,
+	* oversampling ratio, gain, calibration) are read back once after each write and then
+	* served from memory, removing the attribute round trips from each acquisition.
+	*/
+	virtual void setAttributeCaching(bool enable) = 0;
+
+
+	/**
+	* @brief Drop the cached attribute values of all the instruments
+	*
+	* @note Use it when the device was reconfigured by another client.
+	*/
+	virtual void invalidateAttributeCache() = 0;
 };
 }
 }
@@ -307,7 +307,7 @@ public:
 	/**
 	* @private
 	*/
-	virtual void setCalibParameters(unsigned int chnIdx, double scaling, double vert_offset) = 0;
+	virtual void setCalibParameters(unsigned int chnIdx, double scaling, double offset) = 0;
 
 
 	/**
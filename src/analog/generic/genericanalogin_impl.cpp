@@ -50,14 +50,22 @@ std::shared_ptr<DeviceIn> GenericAnalogInImpl::getAdcDevice(unsigned int index)
 	return m_devices_in.at(index);
 }
 
-double GenericAnalogInImpl::processSample(int16_t sample, unsigned int channel)
-{
-	return sample;
-}
-
 const double *GenericAnalogInImpl::getSamplesInterleaved(unsigned int nb_samples)
 {
-	return getAdcDevice(0)->getSamplesInterleaved(nb_samples, processSample);
+	auto dev = getAdcDevice(0);
+	unsigned int nb_channels = 0;
+	for (unsigned int i = 0; i < dev->getNbChannels(false); i++) {
+		if (dev->isChannelEnabled(i, false)) {
+			nb_channels++;
+		}
+	}
+
+	/* Reused between calls; the returned pointer is valid until the next call */
+	if (m_samples_interleaved.size() < nb_samples * nb_channels) {
+		m_samples_interleaved.resize(nb_samples * nb_channels);
+	}
+	dev->getSamplesInterleaved(m_samples_interleaved.data(), nb_samples, std::vector<CHANNEL_COEFFICIENTS>());
+	return m_samples_interleaved.data();
 }
 
 const short *GenericAnalogInImpl::getSamplesRawInterleaved(unsigned int nb_samples)
@@ -52,10 +52,10 @@ public:
 private:
 	std::vector<std::shared_ptr<libm2k::utils::DeviceIn>> m_devices_in;
 	std::string m_dev_name;
+	std::vector<double> m_samples_interleaved;
 	unsigned int m_nb_channels;
 	bool m_cyclic;
 	std::shared_ptr<libm2k::utils::DeviceIn> getAdcDevice(unsigned int index);
-	static double processSample(int16_t sample, unsigned int channel);
 };
 }
 }
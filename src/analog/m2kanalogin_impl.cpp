@@ -22,21 +22,21 @@
 #include "m2kanalogin_impl.hpp"
 #include <libm2k/m2kexceptions.hpp>
 #include <algorithm>
+#include <cmath>
 #include "utils/channel.hpp"
 
 using namespace libm2k;
 using namespace libm2k::analog;
 using namespace libm2k::utils;
-using namespace std::placeholders;
 
 #define HIGH_MAX 2.5
 #define HIGH_MIN -2.5
 #define LOW_MAX 25
 #define LOW_MIN -25
+#define DC_AVERAGE_SAMPLES 100
 
 M2kAnalogInImpl::M2kAnalogInImpl(iio_context * ctx, std::string adc_dev, bool sync, M2kHardwareTrigger *trigger) :
 	M2kAnalogIn(),
-	m_need_processing(false),
 	m_trigger(trigger)
 {
 	m_m2k_adc = make_shared<DeviceIn>(ctx, adc_dev);
@@ -55,6 +55,22 @@ M2kAnalogInImpl::M2kAnalogInImpl(iio_context * ctx, std::string adc_dev, bool sy
 	// calibbias attribute is only available in firmware versions newer than 0.26
 	m_calibbias_available = m_m2k_adc->getChannel(ANALOG_IN_CHANNEL_1, false)->hasAttribute("calibbias");
 	m_samplerate = 1E8;
+	m_voltmeter_running = false;
+	m_streaming_callback = false;
+	m_streaming_trigger = STREAMING_TRIGGER();
+	m_spectrum_settings = SPECTRUM_SETTINGS{4096, SPECTRUM_WINDOW_BLACKMAN_HARRIS, 0.5, SPECTRUM_DBFS};
+	m_streaming_spectrum = false;
+	m_streaming_measure = false;
+	m_stream_measure_next = 0;
+	m_stream_nb_samples = 0;
+	m_stream_next_index = 0;
+	m_stream_frames = 0;
+	m_stream_missed_triggers = 0;
+	m_decimation_mode = DECIMATION_BOXCAR;
+	m_decimation_factor = 1;
+	m_decimation_order = 3;
+	m_session_running = false;
+	m_session_samples = 0;
 
 	for (unsigned int i = 0; i < getNbChannels(); i++) {
 		m_input_range.push_back(PLUS_MINUS_25V);
@@ -62,23 +78,33 @@ M2kAnalogInImpl::M2kAnalogInImpl(iio_context * ctx, std::string adc_dev, bool sy
 		m_adc_calib_gain.push_back(1);
 		m_adc_hw_vert_offset.push_back(0);
                 m_adc_hw_offset_raw.push_back(2048);
-		m_trigger->setCalibParameters(i, getScalingFactor(i), m_adc_hw_vert_offset.at(i));
 	}
+	m_calib_coefficients.resize(getNbChannels());
+	m_raw_coefficients.assign(getNbChannels(), Conversion::identity());
+	updateCalibCoefficients();
 
 	if (sync) {
 		syncDevice();
 	}
 }
 
-M2kAnalogInImpl::~M2kAnalogInImpl() = default;
+M2kAnalogInImpl::~M2kAnalogInImpl()
+{
+	/* The streaming thread may still be writing through the recorder */
+	m_m2k_adc->stopStreaming();
+}
 
 void M2kAnalogInImpl::enableChannel(unsigned int chn_idx, bool enable)
 {
+	checkSessionStopped("the enabled channels");
 	m_m2k_adc->enableChannel(chn_idx, enable, false);
 }
 
 bool M2kAnalogInImpl::isChannelEnabled(unsigned int chn_idx)
 {
+	if (m_session_running) {
+		return m_session_channels_enabled.at(chn_idx);
+	}
 	return m_m2k_adc->isChannelEnabled(chn_idx, false);
 }
 
@@ -90,19 +116,27 @@ unsigned int M2kAnalogInImpl::getNbChannels()
 void M2kAnalogInImpl::reset()
 {
 	stopAcquisition();
-	setOversamplingRatio(1);
-	setSampleRate(1E8);
-
-	for (unsigned int i = 0; i < m_m2k_adc->getNbChannels(false); i++) {
-		enableChannel(i, false);
-		auto ch = static_cast<ANALOG_IN_CHANNEL>(i);
-		m_trigger->setAnalogMode(ch, ALWAYS);
-		setRange(ch, PLUS_MINUS_25V);
-		m_adc_calib_gain.at(i) = 1;
-		setCalibscale(i, m_adc_calib_gain.at(i));
-		setAdcCalibOffset(ch, 2048);
-		setVerticalOffset(ch, 0);
+
+	beginConfiguration();
+	__try {
+		setOversamplingRatio(1);
+		setSampleRate(1E8);
+
+		for (unsigned int i = 0; i < m_m2k_adc->getNbChannels(false); i++) {
+			enableChannel(i, false);
+			auto ch = static_cast<ANALOG_IN_CHANNEL>(i);
+			m_trigger->setAnalogMode(ch, ALWAYS);
+			setRange(ch, PLUS_MINUS_25V);
+			m_adc_calib_gain.at(i) = 1;
+			setCalibscale(i, m_adc_calib_gain.at(i));
+			setAdcCalibOffset(ch, 2048);
+			setVerticalOffset(ch, 0);
+		}
+	} __catch (exception_type &e) {
+		cancelConfiguration();
+		throw_exception(EXC_INVALID_PARAMETER, e.what());
 	}
+	commitConfiguration();
 	setKernelBuffersCount(4);
 }
 
@@ -121,22 +155,20 @@ void M2kAnalogInImpl::syncDevice()
 		}
 		m_adc_hw_offset_raw.at(i) = m_ad5625_dev->getLongValue(2 + i, "raw", true);
 		m_adc_hw_vert_offset.at(i) = convertRawToVoltsVerticalOffset(static_cast<ANALOG_IN_CHANNEL>(i), m_adc_hw_offset_raw.at(i) - m_adc_calib_offset.at(i));
-
-		m_samplerate = m_m2k_adc->getLongValue("sampling_frequency");
-
-		m_trigger->setCalibParameters(i, getScalingFactor(i), m_adc_hw_vert_offset.at(i));
 	}
+	updateCalibCoefficients();
 }
 
 void M2kAnalogInImpl::setAdcCalibGain(ANALOG_IN_CHANNEL channel, double gain)
 {
-
+	checkSessionStopped("the calibration gain");
 	m_adc_calib_gain.at(channel) = gain;
-	m_trigger->setCalibParameters(channel, getScalingFactor(channel), m_adc_hw_vert_offset.at(channel));
+	updateCalibCoefficients(channel);
 }
 
 void M2kAnalogInImpl::setAdcCalibOffset(ANALOG_IN_CHANNEL channel, int raw_offset)
 {
+	checkSessionStopped("the calibration offset");
 	const int rawVertOffset = m_adc_hw_offset_raw.at(channel) - m_adc_calib_offset.at(channel);
 	if (m_calibbias_available) {
                 m_adc_calib_offset.at(channel) = m_m2k_adc->setLongValue(channel, raw_offset, "calibbias", false);
@@ -147,7 +179,7 @@ void M2kAnalogInImpl::setAdcCalibOffset(ANALOG_IN_CHANNEL channel, int raw_offse
 	int hw_offset_raw = rawVertOffset + m_adc_calib_offset.at(channel);
 	m_adc_hw_offset_raw.at(channel) = m_ad5625_dev->setLongValue(channel + 2, hw_offset_raw, "raw", true);
 
-	m_trigger->setCalibParameters(channel, getScalingFactor(channel), m_adc_hw_vert_offset.at(channel));
+	updateCalibCoefficients(channel);
 }
 
 double M2kAnalogInImpl::convRawToVolts(int sample, double correctionGain,
@@ -160,28 +192,14 @@ double M2kAnalogInImpl::convRawToVolts(int sample, double correctionGain,
 
 double M2kAnalogInImpl::convertRawToVolts(unsigned int channel, short sample)
 {
-	return convRawToVolts(sample,
-			      m_adc_calib_gain.at(channel),
-			      getValueForRange(m_input_range.at(channel)),
-			      getFilterCompensation(m_samplerate),
-			      -m_adc_hw_vert_offset.at(channel));
-}
-
-short M2kAnalogInImpl::convVoltsToRaw(double voltage, double correctionGain,
-				      double hw_gain, double filterCompensation, double offset)
-{
-	// TO DO: explain this formula
-	return (short)(((voltage - offset) / (correctionGain * filterCompensation) *
-			(2048 * 1.3 * hw_gain) / 0.78));
+	const CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(channel);
+	return sample * c.scale + c.offset;
 }
 
 short M2kAnalogInImpl::convertVoltsToRaw(unsigned int channel, double voltage)
 {
-	return convVoltsToRaw(voltage,
-			      m_adc_calib_gain.at(channel),
-			      getValueForRange(m_input_range.at(channel)),
-			      getFilterCompensation(m_samplerate),
-			      -m_adc_hw_vert_offset.at(channel));
+	const CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(channel);
+	return (short)((voltage - c.offset) / c.scale);
 }
 
 double M2kAnalogInImpl::getCalibscale(unsigned int index)
@@ -191,6 +209,7 @@ double M2kAnalogInImpl::getCalibscale(unsigned int index)
 
 double M2kAnalogInImpl::setCalibscale(unsigned int index, double calibscale)
 {
+	checkSessionStopped("the calibration gain");
 	return m_m2k_adc->setDoubleValue(index, calibscale, "calibscale");
 }
 
@@ -203,40 +222,140 @@ libm2k::M2kHardwareTrigger *M2kAnalogInImpl::getTrigger()
 void M2kAnalogInImpl::startAcquisition(unsigned int nb_samples)
 {
 	m_m2k_adc->initializeBuffer(nb_samples);
+	m_samples_interleaved.resize(nb_samples * getNbChannels());
 }
 
 void M2kAnalogInImpl::stopAcquisition()
 {
+	stopSession();
 	m_m2k_adc->flushBuffer();
 }
 
-/**
-	 * @brief Utility method to be used before and after ADC getSamples calls.
-	 * For the m2k-adc, all the channels have to be enabled before refilling
-	 */
-void M2kAnalogInImpl::handleChannelsEnableState(bool before_refill)
+/*
+ * For the m2k-adc, all the channels have to be enabled while refilling. Outside a session
+ * the user's channel mask is saved, every channel is enabled and the mask is restored when
+ * the guard goes out of scope, also when the refill throws. Inside a session the channels
+ * are already enabled and the guard only checks the number of samples
+ */
+M2kAnalogInImpl::RefillGuard::RefillGuard(M2kAnalogInImpl *analog_in, unsigned int nb_samples) :
+	m_analog_in(analog_in),
+	m_restore(false)
 {
-	if (before_refill) {
-		bool anyChannelEnabled = false;
-		for (unsigned int i = 0; i < getNbChannels(); i++) {
-			bool en  = isChannelEnabled(i);
-			m_channels_enabled.push_back(en);
-			anyChannelEnabled = en ? true : anyChannelEnabled;
-		}
-		if (!anyChannelEnabled) {
-			throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: No channel enabled for RX buffer");
+	/* The channels must not change under the streaming refill thread */
+	if (m_analog_in->m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not acquire samples; streaming in progress");
+	}
+	if (m_analog_in->m_session_running) {
+		if (nb_samples != m_analog_in->m_session_samples) {
+			throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: The session acquires " +
+					std::to_string(m_analog_in->m_session_samples) + " samples per channel");
 		}
+		m_channels_enabled = m_analog_in->m_session_channels_enabled;
+		return;
+	}
 
-		for (unsigned int i = 0; i < getNbChannels(); i++) {
-			enableChannel(i, true);
-		}
-	} else {
-		for (unsigned int i = 0; i < getNbChannels(); i++) {
-			enableChannel(i, m_channels_enabled.at(i));
+	bool anyChannelEnabled = false;
+	auto adc = m_analog_in->m_m2k_adc;
+	for (unsigned int i = 0; i < adc->getNbChannels(false); i++) {
+		bool en = adc->isChannelEnabled(i, false);
+		m_channels_enabled.push_back(en);
+		anyChannelEnabled = en ? true : anyChannelEnabled;
+	}
+	if (!anyChannelEnabled) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: No channel enabled for RX buffer");
+	}
+
+	for (unsigned int i = 0; i < m_channels_enabled.size(); i++) {
+		adc->enableChannel(i, true, false);
+	}
+	m_restore = true;
+}
+
+M2kAnalogInImpl::RefillGuard::~RefillGuard()
+{
+	if (!m_restore) {
+		return;
+	}
+	for (unsigned int i = 0; i < m_channels_enabled.size(); i++) {
+		m_analog_in->m_m2k_adc->enableChannel(i, m_channels_enabled.at(i), false);
+	}
+}
+
+const std::vector<bool> &M2kAnalogInImpl::RefillGuard::getChannelsEnabled() const
+{
+	return m_channels_enabled;
+}
+
+void M2kAnalogInImpl::startSession(unsigned int nb_samples)
+{
+	if (m_session_running) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Session already started");
+	}
+	openSession(nb_samples);
+}
+
+void M2kAnalogInImpl::stopSession()
+{
+	if (m_voltmeter_running) {
+		stopVoltmeter();
+		return;
+	}
+	closeSession();
+}
+
+bool M2kAnalogInImpl::isSessionRunning()
+{
+	return m_session_running;
+}
+
+void M2kAnalogInImpl::openSession(unsigned int nb_samples)
+{
+	if (nb_samples == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: The number of samples must be greater than 0");
+	}
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not start a session; streaming in progress");
+	}
+
+	/* All the channels stay enabled for the whole session; the user's mask is kept aside */
+	std::vector<bool> channels_enabled;
+	for (unsigned int i = 0; i < getNbChannels(); i++) {
+		channels_enabled.push_back(m_m2k_adc->isChannelEnabled(i, false));
+		m_m2k_adc->enableChannel(i, true, false);
+	}
+
+	__try {
+		m_m2k_adc->initializeBuffer(nb_samples);
+	} __catch (exception_type &e) {
+		for (unsigned int i = 0; i < channels_enabled.size(); i++) {
+			m_m2k_adc->enableChannel(i, channels_enabled.at(i), false);
 		}
-		m_channels_enabled.clear();
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: " + string(e.what()));
 	}
 
+	m_session_channels_enabled = channels_enabled;
+	m_session_samples = nb_samples;
+	m_session_running = true;
+}
+
+void M2kAnalogInImpl::closeSession()
+{
+	if (!m_session_running) {
+		return;
+	}
+	m_session_running = false;
+	for (unsigned int i = 0; i < m_session_channels_enabled.size(); i++) {
+		m_m2k_adc->enableChannel(i, m_session_channels_enabled.at(i), false);
+	}
+	m_session_channels_enabled.clear();
+}
+
+void M2kAnalogInImpl::checkSessionStopped(const std::string &setting)
+{
+	if (m_session_running) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not change " + setting +
+				" while a session is running");
+	}
 }
 
 std::vector<std::vector<double>> M2kAnalogInImpl::getSamples(unsigned int nb_samples)
@@ -249,35 +368,51 @@ std::vector<std::vector<double>> M2kAnalogInImpl::getSamplesRaw(unsigned int nb_
 	return this->getSamples(nb_samples, false);
 }
 
-std::vector<std::vector<double>> M2kAnalogInImpl::getSamples(unsigned int nb_samples, bool processed)
+std::vector<std::vector<float>> M2kAnalogInImpl::getSamplesFloat(unsigned int nb_samples)
 {
-	if (processed) {
-		m_need_processing = true;
-	}
-	m_samplerate = getSampleRate();
-	handleChannelsEnableState(true);
+	std::vector<std::vector<float>> data;
+	captureSamples(data, nb_samples, true);
+	return data;
+}
 
-	auto fp = std::bind(&M2kAnalogInImpl::processSample, this, std::placeholders::_1, std::placeholders::_2);
-	auto samps = m_m2k_adc->getSamples(nb_samples, fp);
+std::vector<std::vector<short>> M2kAnalogInImpl::getSamplesRawShort(unsigned int nb_samples)
+{
+	std::vector<std::vector<short>> data;
+	captureSamples(data, nb_samples, false);
+	return data;
+}
 
-	handleChannelsEnableState(false);
-	if (processed) {
-		m_need_processing = false;
-	}
-	return samps;
+std::vector<std::vector<double>> M2kAnalogInImpl::getSamples(unsigned int nb_samples, bool processed)
+{
+	std::vector<std::vector<double>> data;
+	captureSamples(data, nb_samples, processed);
+	return data;
 }
 
 void M2kAnalogInImpl::getSamples(std::vector<std::vector<double> > &data, unsigned int nb_samples)
 {
-	m_need_processing = true;
-	m_samplerate = getSampleRate();
-	handleChannelsEnableState(true);
+	captureSamples(data, nb_samples, true);
+}
+
+void M2kAnalogInImpl::getSamples(std::vector<std::vector<float> > &data, unsigned int nb_samples)
+{
+	captureSamples(data, nb_samples, true);
+}
 
-	auto fp = std::bind(&M2kAnalogInImpl::processSample, this, _1, _2);
-	m_m2k_adc->getSamples(data, nb_samples, fp);
+void M2kAnalogInImpl::getSamplesRaw(std::vector<std::vector<short> > &data, unsigned int nb_samples)
+{
+	captureSamples(data, nb_samples, false);
+}
 
-	handleChannelsEnableState(false);
-	m_need_processing = false;
+/*
+ * Every capture returning one list per channel ends here; the conversion kernel
+ * is chosen by the element type: double or float volts, or the raw codes (short)
+ */
+template <typename T>
+void M2kAnalogInImpl::captureSamples(std::vector<std::vector<T>> &data, unsigned int nb_samples, bool processed)
+{
+	RefillGuard guard(this, nb_samples);
+	m_m2k_adc->getSamples(data, nb_samples, getConversionCoefficients(processed));
 }
 
 string M2kAnalogInImpl::getChannelName(unsigned int channel)
@@ -295,43 +430,550 @@ const double* M2kAnalogInImpl::getSamplesInterleaved(unsigned int nb_samples)
 	return this->getSamplesInterleaved(nb_samples, true);
 }
 
+/*
+ * The samples are stored in memory owned by this instance, sized by startAcquisition and
+ * grown only when needed, so repeated captures do not allocate; the returned pointer is
+ * valid until the next call
+ */
 const double *M2kAnalogInImpl::getSamplesInterleaved(unsigned int nb_samples, bool processed)
 {
-	if (processed) {
-		m_need_processing = true;
+	size_t size = nb_samples * getNbChannels();
+	if (m_samples_interleaved.size() < size) {
+		m_samples_interleaved.resize(size);
 	}
-	m_samplerate = getSampleRate();
-	handleChannelsEnableState(true);
 
-	auto fp = std::bind(&M2kAnalogInImpl::processSample, this, std::placeholders::_1, std::placeholders::_2);
-	auto samps = (const double *)m_m2k_adc->getSamplesInterleaved(nb_samples, fp);
+	RefillGuard guard(this, nb_samples);
+	m_m2k_adc->getSamplesInterleaved(m_samples_interleaved.data(), nb_samples, getConversionCoefficients(processed));
+	return m_samples_interleaved.data();
+}
 
-	handleChannelsEnableState(false);
-	if (processed) {
-		m_need_processing = false;
-	}
-	return samps;
+void M2kAnalogInImpl::getSamplesInterleaved(double *data, unsigned int nb_samples)
+{
+	RefillGuard guard(this, nb_samples);
+	m_m2k_adc->getSamplesInterleaved(data, nb_samples, getConversionCoefficients(true));
 }
 
 const short *M2kAnalogInImpl::getSamplesRawInterleaved(unsigned int nb_samples)
 {
-	m_samplerate = getSampleRate();
-	handleChannelsEnableState(true);
-	auto samps = m_m2k_adc->getSamplesRawInterleaved(nb_samples);
-	handleChannelsEnableState(false);
-	return samps;
+	RefillGuard guard(this, nb_samples);
+	return m_m2k_adc->getSamplesRawInterleaved(nb_samples);
+}
+
+std::vector<libm2k::SAMPLE_VIEW<short>> M2kAnalogInImpl::getSamplesView(unsigned int nb_samples)
+{
+	RefillGuard guard(this, nb_samples);
+	const std::vector<bool> &channels_enabled = guard.getChannelsEnabled();
+	auto views = m_m2k_adc->getSamplesView(nb_samples);
+
+	/* All the channels are enabled while refilling; only expose the ones the user asked for */
+	for (unsigned int i = 0; i < views.size() && i < channels_enabled.size(); i++) {
+		if (!channels_enabled.at(i)) {
+			views.at(i) = libm2k::SAMPLE_VIEW<short>{nullptr, 0, 0};
+		}
+	}
+	return views;
+}
+
+std::vector<MEASUREMENT_RESULTS> M2kAnalogInImpl::getMeasurements(unsigned int nb_samples)
+{
+	RefillGuard guard(this, nb_samples);
+	const std::vector<bool> &channels_enabled = guard.getChannelsEnabled();
+	auto views = m_m2k_adc->getSamplesView(nb_samples);
+	double sample_rate = getMeasurementSampleRate();
+
+	std::vector<MEASUREMENT_RESULTS> results(getNbChannels(), MEASUREMENT_RESULTS());
+	for (unsigned int i = 0; i < views.size() && i < results.size(); i++) {
+		if (i < channels_enabled.size() && !channels_enabled.at(i)) {
+			continue;
+		}
+		MeasurementAccumulator measurement;
+		measurement.update(views.at(i).data, views.at(i).step, views.at(i).nb_samples);
+		results.at(i) = measurement.getResults(m_calib_coefficients.at(i), sample_rate);
+	}
+	return results;
+}
+
+void M2kAnalogInImpl::setSpectrumSettings(const SPECTRUM_SETTINGS &settings)
+{
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not change the spectrum settings while streaming");
+	}
+	__try {
+		SpectrumAnalyzer analyzer(settings);
+	} __catch (exception_type &e) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: " + string(e.what()));
+	}
+	m_spectrum_settings = settings;
+}
+
+SPECTRUM_SETTINGS M2kAnalogInImpl::getSpectrumSettings()
+{
+	return m_spectrum_settings;
+}
+
+std::vector<SPECTRUM> M2kAnalogInImpl::getSpectrum(unsigned int nb_samples)
+{
+	if (nb_samples < m_spectrum_settings.fft_size) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: The spectrum needs at least fft_size samples");
+	}
+	RefillGuard guard(this, nb_samples);
+	const std::vector<bool> &channels_enabled = guard.getChannelsEnabled();
+	auto views = m_m2k_adc->getSamplesView(nb_samples);
+	auto analyzers = createSpectrumAnalyzers();
+
+	for (unsigned int i = 0; i < views.size() && i < analyzers.size(); i++) {
+		if (i < channels_enabled.size() && !channels_enabled.at(i)) {
+			continue;
+		}
+		analyzers.at(i).update(views.at(i).data, views.at(i).step, views.at(i).nb_samples);
+	}
+	return getSpectrumResults(analyzers);
+}
+
+/* The offset of each channel is added in raw codes, so the DC bin reads the average in Volts */
+std::vector<SpectrumAnalyzer> M2kAnalogInImpl::createSpectrumAnalyzers()
+{
+	std::vector<SpectrumAnalyzer> analyzers;
+	for (unsigned int i = 0; i < getNbChannels(); i++) {
+		const CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(i);
+		analyzers.push_back(SpectrumAnalyzer(m_spectrum_settings, c.offset / c.scale));
+	}
+	return analyzers;
+}
+
+std::vector<SPECTRUM> M2kAnalogInImpl::getSpectrumResults(const std::vector<SpectrumAnalyzer> &analyzers)
+{
+	double sample_rate = getMeasurementSampleRate();
+	std::vector<SPECTRUM> results;
+	for (unsigned int i = 0; i < analyzers.size(); i++) {
+		results.push_back(analyzers.at(i).getResults(m_calib_coefficients.at(i).scale, sample_rate,
+							     m_spectrum_settings.unit));
+	}
+	return results;
+}
+
+void M2kAnalogInImpl::setStreamingTrigger(const STREAMING_TRIGGER &trigger)
+{
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not change the trigger while streaming");
+	}
+	if (trigger.enabled && trigger.channel >= getNbChannels()) {
+		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogIn: The trigger channel is out of range");
+	}
+	m_streaming_trigger = trigger;
+}
+
+STREAMING_TRIGGER M2kAnalogInImpl::getStreamingTrigger()
+{
+	return m_streaming_trigger;
+}
+
+/*
+ * The levels are converted when the streaming starts, with the coefficients the hardware
+ * trigger also converts its levels with (see setCalibParameters), rounded and clamped
+ * to the raw codes
+ */
+SOFTWARE_TRIGGER_SETTINGS M2kAnalogInImpl::getRawStreamingTrigger()
+{
+	const STREAMING_TRIGGER &trigger = m_streaming_trigger;
+	SOFTWARE_TRIGGER_SETTINGS settings = {};
+	if (!trigger.enabled) {
+		return settings;
+	}
+
+	const CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(trigger.channel);
+	auto toRaw = [&c](double volts) {
+		double raw = std::round((volts - c.offset) / c.scale);
+		return (int)std::min(std::max(raw, -32768.0), 32767.0);
+	};
+	settings.enabled = true;
+	settings.channel = trigger.channel;
+	settings.condition = trigger.condition;
+	settings.level = toRaw(trigger.level);
+	settings.level_high = toRaw(trigger.level_high);
+	settings.hysteresis = (int)std::min(std::round(std::fabs(trigger.hysteresis / c.scale)), 65535.0);
+	settings.pre_samples = trigger.pre_samples;
+	settings.post_samples = trigger.post_samples;
+	return settings;
+}
+
+void M2kAnalogInImpl::setStreamingMeasurements(bool enable)
+{
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not change the measurements while streaming");
+	}
+	m_streaming_measure = enable;
+}
+
+/* The results use the conversion coefficients and the sample rate in effect when they are read */
+std::vector<MEASUREMENT_RESULTS> M2kAnalogInImpl::getStreamingMeasurements()
+{
+	std::vector<MeasurementAccumulator> measurements;
+	{
+		std::lock_guard<std::mutex> lock(m_stream_measure_mutex);
+		measurements = m_stream_measurements;
+	}
+	double sample_rate = getMeasurementSampleRate();
+	std::vector<MEASUREMENT_RESULTS> results;
+	for (unsigned int i = 0; i < measurements.size(); i++) {
+		results.push_back(measurements.at(i).getResults(m_calib_coefficients.at(i), sample_rate));
+	}
+	return results;
+}
+
+void M2kAnalogInImpl::resetStreamingMeasurements()
+{
+	std::lock_guard<std::mutex> lock(m_stream_measure_mutex);
+	for (auto &measurement : m_stream_measurements) {
+		measurement.reset();
+	}
+	m_stream_measure_next = 0;
+}
+
+void M2kAnalogInImpl::setStreamingSpectrum(bool enable)
+{
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not change the spectrum while streaming");
+	}
+	m_streaming_spectrum = enable;
+}
+
+std::vector<SPECTRUM> M2kAnalogInImpl::getStreamingSpectrum()
+{
+	std::vector<SpectrumAnalyzer> analyzers;
+	{
+		std::lock_guard<std::mutex> lock(m_stream_measure_mutex);
+		analyzers = m_stream_spectra;
+	}
+	return getSpectrumResults(analyzers);
+}
+
+void M2kAnalogInImpl::resetStreamingSpectrum()
+{
+	std::lock_guard<std::mutex> lock(m_stream_measure_mutex);
+	for (auto &analyzer : m_stream_spectra) {
+		analyzer.reset();
+	}
+}
+
+/* Each sample of the buffer averages oversampling_ratio conversions of the ADC */
+double M2kAnalogInImpl::getMeasurementSampleRate()
+{
+	int ratio = getOversamplingRatio();
+	return (ratio > 0) ? m_samplerate / ratio : m_samplerate;
+}
+
+void M2kAnalogInImpl::setStreamingDecimation(M2K_DECIMATION_MODE mode, unsigned int factor, unsigned int order)
+{
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not change the decimation while streaming");
+	}
+	__try {
+		/* Validates the settings now rather than when the stream starts */
+		Decimator check(mode, factor, 1, order);
+	} __catch (exception_type &e) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: " + string(e.what()));
+	}
+	m_decimation_mode = mode;
+	m_decimation_factor = factor;
+	m_decimation_order = order;
+}
+
+void M2kAnalogInImpl::startStreaming(unsigned int nb_samples, unsigned int queue_depth)
+{
+	startStreamingThreads(nb_samples, queue_depth, nullptr, false);
+}
+
+void M2kAnalogInImpl::startStreaming(unsigned int nb_samples, std::function<void(const libm2k::STREAMING_BLOCK &)> callback,
+				     bool processed, unsigned int queue_depth)
+{
+	if (!callback) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Invalid streaming callback");
+	}
+	startStreamingThreads(nb_samples, queue_depth, callback, processed, true);
+}
+
+void M2kAnalogInImpl::startStreamingThreads(unsigned int nb_samples, unsigned int queue_depth,
+					    std::function<void(const libm2k::STREAMING_BLOCK &)> callback, bool processed,
+					    bool triggered)
+{
+	/* Also after the threads ended on an error; stopStreaming reports it and restores the channels */
+	if (m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Streaming already started; stop it first");
+	}
+	if (m_session_running) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not start streaming while a session is running");
+	}
+
+	/* For the m2k-adc, all the channels have to be enabled while refilling */
+	m_streaming_channels_enabled.clear();
+	for (unsigned int i = 0; i < getNbChannels(); i++) {
+		m_streaming_channels_enabled.push_back(isChannelEnabled(i));
+		enableChannel(i, true);
+	}
+
+	/* The converted blocks use the coefficients in effect when the streaming starts */
+	std::vector<CHANNEL_COEFFICIENTS> coefficients;
+	if (callback && processed) {
+		coefficients = getConversionCoefficients(true);
+	}
+
+	std::function<void(const libm2k::STREAMING_BLOCK &)> chain;
+	if (callback) {
+		chain = [this](const libm2k::STREAMING_BLOCK &block) {
+			processStreamingBlock(block);
+		};
+	}
+	std::function<void(const short *, unsigned long long)> hook;
+	if (m_streaming_measure || m_streaming_spectrum) {
+		hook = [this](const short *block, unsigned long long index) {
+			measureStreamingBlock(block, index);
+		};
+	}
+
+	__try {
+		createStreamingStages(nb_samples, callback, coefficients, triggered);
+		m_m2k_adc->startStreaming(nb_samples, queue_depth, chain, hook);
+	} __catch (exception_type &e) {
+		stopStreaming();
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: " + string(e.what()));
+	}
+	m_streaming_callback = (callback != nullptr);
 }
 
-double M2kAnalogInImpl::processSample(int16_t sample, unsigned int channel)
+/*
+ * The analog stages run in the callback chain of the raw blocks handed by the m2k-adc:
+ * the software trigger or the decimation, then the conversion to Volts and the callback.
+ * The measurements and the spectra see the raw blocks through the hook, in both modes.
+ */
+void M2kAnalogInImpl::createStreamingStages(unsigned int nb_samples,
+					    std::function<void(const libm2k::STREAMING_BLOCK &)> callback,
+					    const std::vector<CHANNEL_COEFFICIENTS> &coefficients, bool triggered)
+{
+	/* All the channels are enabled while streaming */
+	unsigned int nb_channels = getNbChannels();
+	size_t block_size = (size_t)nb_samples * nb_channels;
+	SOFTWARE_TRIGGER_SETTINGS trigger = triggered ? getRawStreamingTrigger() : SOFTWARE_TRIGGER_SETTINGS();
+
+	m_stream_trigger.reset();
+	m_stream_decimator.reset();
+	if (callback && trigger.enabled) {
+		if (m_decimation_factor > 1) {
+			throw_exception(EXC_INVALID_PARAMETER, "The software trigger can not be combined with the decimation");
+			return;
+		}
+		m_stream_trigger = std::unique_ptr<SoftwareTrigger>(new SoftwareTrigger(trigger, nb_channels, nb_samples));
+		block_size = (size_t)m_stream_trigger->getFrameSamples() * nb_channels;
+	} else if (callback && m_decimation_factor > 1) {
+		m_stream_decimator = std::unique_ptr<Decimator>(new Decimator(m_decimation_mode, m_decimation_factor,
+									      nb_channels, m_decimation_order));
+		m_stream_decimated.resize((size_t)m_stream_decimator->getMaxOutputSamples(nb_samples) * nb_channels);
+		block_size = m_stream_decimated.size();
+	}
+	m_stream_consumer = callback;
+	m_stream_coefficients = coefficients;
+	m_stream_volts.assign(coefficients.empty() ? 0 : block_size, 0);
+	m_stream_nb_samples = nb_samples;
+	m_stream_next_index = 0;
+	m_stream_frames = 0;
+	m_stream_missed_triggers = 0;
+
+	std::lock_guard<std::mutex> lock(m_stream_measure_mutex);
+	m_stream_measurements.assign(m_streaming_measure ? nb_channels : 0, MeasurementAccumulator());
+	m_stream_spectra = m_streaming_spectrum ? createSpectrumAnalyzers() : std::vector<SpectrumAnalyzer>();
+	m_stream_measure_next = 0;
+}
+
+void M2kAnalogInImpl::measureStreamingBlock(const short *block, unsigned long long index)
+{
+	std::lock_guard<std::mutex> lock(m_stream_measure_mutex);
+	/* Each enabled analysis has one entry per channel */
+	unsigned int nb_channels = std::max(m_stream_measurements.size(), m_stream_spectra.size());
+	bool contiguous = (index == m_stream_measure_next);
+	m_stream_measure_next = index + 1;
+	for (unsigned int ch = 0; ch < m_stream_measurements.size(); ch++) {
+		if (!contiguous) {
+			m_stream_measurements[ch].restart();
+		}
+		m_stream_measurements[ch].update(block + ch, nb_channels, m_stream_nb_samples);
+	}
+	/* A segment can not span a dropped block */
+	for (unsigned int ch = 0; ch < m_stream_spectra.size(); ch++) {
+		if (!contiguous) {
+			m_stream_spectra[ch].restart();
+		}
+		m_stream_spectra[ch].update(block + ch, nb_channels, m_stream_nb_samples);
+	}
+}
+
+void M2kAnalogInImpl::processStreamingBlock(const libm2k::STREAMING_BLOCK &block)
 {
-	if (m_need_processing) {
-		return convRawToVolts(sample,
-				      m_adc_calib_gain.at(channel),
-				      getValueForRange(m_input_range.at(channel)),
-				      getFilterCompensation(m_samplerate),
-				      -m_adc_hw_vert_offset.at(channel));
+	if (m_stream_trigger) {
+		/* Every frame completed by this block goes to the callback; they may reach
+		 * back into the previous blocks, kept by the trigger */
+		m_stream_trigger->push(block.raw, block.index);
+		unsigned long long first_sample = 0;
+		const short *frame;
+		while ((frame = m_stream_trigger->nextFrame(first_sample))) {
+			libm2k::STREAMING_BLOCK triggered = {frame, nullptr, m_stream_trigger->getFrameSamples(),
+							     block.nb_channels, m_stream_frames, first_sample};
+			m_stream_frames++;
+			deliverStreamingBlock(triggered);
+		}
+		m_stream_missed_triggers = m_stream_trigger->getMissedTriggers();
+	} else if (m_stream_decimator) {
+		/* A dropped block breaks the signal; do not let a window span the gap */
+		if (block.index != m_stream_next_index) {
+			m_stream_decimator->reset();
+		}
+		m_stream_next_index = block.index + 1;
+		libm2k::STREAMING_BLOCK decimated = block;
+		decimated.raw = m_stream_decimated.data();
+		decimated.nb_samples = m_stream_decimator->process(block.raw, block.nb_samples,
+								    m_stream_decimated.data());
+		if (decimated.nb_samples > 0) {
+			deliverStreamingBlock(decimated);
+		}
 	} else {
-		return (double)sample;
+		libm2k::STREAMING_BLOCK delivered = block;
+		deliverStreamingBlock(delivered);
+	}
+}
+
+void M2kAnalogInImpl::deliverStreamingBlock(libm2k::STREAMING_BLOCK &block)
+{
+	if (!m_stream_volts.empty()) {
+		Conversion::rawToScaledInterleaved(block.raw, block.nb_channels, block.nb_samples,
+						   m_stream_coefficients.data(), m_stream_volts.data());
+		block.volts = m_stream_volts.data();
+	}
+	m_stream_consumer(block);
+}
+
+void M2kAnalogInImpl::stopStreaming()
+{
+	m_m2k_adc->stopStreaming();
+	m_stream_consumer = nullptr;
+	m_stream_trigger.reset();
+	m_stream_decimator.reset();
+	for (unsigned int i = 0; i < m_streaming_channels_enabled.size(); i++) {
+		enableChannel(i, m_streaming_channels_enabled.at(i));
+	}
+	m_streaming_channels_enabled.clear();
+
+	/* With a callback there is no pop call to report a failure, so it is reported here */
+	std::string error = m_streaming_callback ? m_m2k_adc->getStreamingError() : "";
+	m_streaming_callback = false;
+	if (!error.empty()) {
+		throw_exception(EXC_RUNTIME_ERROR, "M2kAnalogIn: Streaming stopped; " + error);
+	}
+}
+
+const short *M2kAnalogInImpl::popStreamingBlock(unsigned int timeout_ms)
+{
+	return m_m2k_adc->popStreamingBlock(timeout_ms);
+}
+
+void M2kAnalogInImpl::startRecording(const std::string &path, unsigned int nb_samples, unsigned int queue_depth)
+{
+	if (m_recorder || m_m2k_adc->isStreaming()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Streaming already started");
+	}
+
+	m_recorder = std::unique_ptr<RecordingWriter>(new RecordingWriter(path, getRecordingInfo()));
+	RecordingWriter *recorder = m_recorder.get();
+	__try {
+		startStreamingThreads(nb_samples, queue_depth, [recorder](const libm2k::STREAMING_BLOCK &block) {
+			recorder->write(block.raw, block.nb_samples);
+		}, false);
+	} __catch (exception_type &e) {
+		m_recorder.reset();
+		throw_exception(EXC_INVALID_PARAMETER, e.what());
+	}
+}
+
+unsigned long long M2kAnalogInImpl::stopRecording()
+{
+	if (!m_recorder) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Recording not started");
+		return 0;
+	}
+
+	/* A write error stops the streaming; the file is still completed before reporting it */
+	std::string error;
+	__try {
+		stopStreaming();
+	} __catch (exception_type &e) {
+		error = e.what();
+	}
+
+	std::unique_ptr<RecordingWriter> recorder = std::move(m_recorder);
+	recorder->close(getStreamingStatistics().overruns);
+	if (!error.empty()) {
+		throw_exception(EXC_RUNTIME_ERROR, error);
+	}
+	return recorder->getNbSamples();
+}
+
+RECORDING_INFO M2kAnalogInImpl::getRecordingInfo()
+{
+	RECORDING_INFO info = {};
+	info.sample_rate = m_samplerate;
+	info.oversampling_ratio = getOversamplingRatio();
+	info.nb_channels = getNbChannels();
+	info.trigger_source = m_trigger->getAnalogSource();
+	info.trigger_delay = m_trigger->getAnalogDelay();
+	info.decimation_mode = m_decimation_mode;
+	info.decimation_factor = m_decimation_factor;
+	info.decimation_order = m_decimation_order;
+	for (unsigned int i = 0; i < info.nb_channels; i++) {
+		info.ranges.push_back(m_input_range.at(i));
+		info.calib_gains.push_back(m_adc_calib_gain.at(i));
+		info.calib_offsets.push_back(m_adc_calib_offset.at(i));
+		info.vertical_offsets.push_back(m_adc_hw_vert_offset.at(i));
+		info.scales.push_back(m_calib_coefficients.at(i).scale);
+		info.offsets.push_back(m_calib_coefficients.at(i).offset);
+		info.trigger_modes.push_back(m_trigger->getAnalogMode(i));
+		info.trigger_conditions.push_back(m_trigger->getAnalogCondition(i));
+		info.trigger_levels.push_back(m_trigger->getAnalogLevelRaw(i));
+		info.trigger_hysteresis.push_back(m_trigger->getAnalogHysteresis(i));
+	}
+	return info;
+}
+
+libm2k::STREAMING_STATISTICS M2kAnalogInImpl::getStreamingStatistics()
+{
+	libm2k::STREAMING_STATISTICS stats = m_m2k_adc->getStreamingStatistics();
+	stats.triggered_frames = m_stream_frames;
+	stats.missed_triggers = m_stream_missed_triggers;
+	return stats;
+}
+
+const std::vector<CHANNEL_COEFFICIENTS> &M2kAnalogInImpl::getConversionCoefficients(bool processed)
+{
+	return processed ? m_calib_coefficients : m_raw_coefficients;
+}
+
+/*
+ * The conversion of a raw sample is affine. The gain and the offset of a channel are
+ * resolved here, whenever the range, the calibration, the vertical offset or the sample
+ * rate change, so the acquisitions only read the table. The trigger converts its levels
+ * with the same coefficients.
+ */
+void M2kAnalogInImpl::updateCalibCoefficients(unsigned int channel)
+{
+	CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(channel);
+	c.scale = convRawToVolts(1, m_adc_calib_gain.at(channel),
+				 getValueForRange(m_input_range.at(channel)),
+				 getFilterCompensation(m_samplerate), 0);
+	c.offset = -m_adc_hw_vert_offset.at(channel);
+	m_trigger->setCalibParameters(channel, c.scale, c.offset);
+}
+
+void M2kAnalogInImpl::updateCalibCoefficients()
+{
+	for (unsigned int i = 0; i < m_calib_coefficients.size(); i++) {
+		updateCalibCoefficients(i);
 	}
 }
 
@@ -343,56 +985,28 @@ short M2kAnalogInImpl::getVoltageRaw(unsigned int ch)
 
 short M2kAnalogInImpl::getVoltageRaw(ANALOG_IN_CHANNEL ch)
 {
-	unsigned int num_samples = 100;
-	M2K_TRIGGER_MODE mode;
-	bool enabled;
-
 	if (ch >= getNbChannels()) {
 		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: no such channel");
 		return -1;
 	}
-
-	mode = m_trigger->getAnalogMode(ch);
-	m_trigger->setAnalogMode(ch, ALWAYS);
-
-	enabled = isChannelEnabled(ch);
-	enableChannel(ch, true);
-
-	auto samps = getSamples(num_samples, false);
-	double avg = Utils::average(samps.at(ch).data(), num_samples);
-
-	m_trigger->setAnalogMode(ch, mode);
-	enableChannel(ch, enabled);
-	return (short)avg;
+	return (short)getAverageRaw(ch).at(ch);
 }
 
 std::vector<short> M2kAnalogInImpl::getVoltageRaw()
 {
-	unsigned int num_samples = 100;
 	std::vector<short> avgs;
-	std::vector<M2K_TRIGGER_MODE> modes = {};
-	std::vector<bool> enabled = {};
-
+	auto means = getAverageRaw();
 	for (unsigned int i = 0; i < getNbChannels(); i++) {
-		enabled.push_back(isChannelEnabled(i));
-		enableChannel(i, true);
-		modes.push_back(m_trigger->getAnalogMode(i));
-		m_trigger->setAnalogMode(i, ALWAYS);
-	}
-	auto samps = getSamples(num_samples, false);
-	for (unsigned int i = 0; i < getNbChannels(); i++) {
-		auto avg = (short)(Utils::average(samps.at(i).data(), num_samples));
-		avgs.push_back(avg);
-		m_trigger->setAnalogMode(i, modes.at(i));
-		enableChannel(i, enabled.at(i));
+		avgs.push_back((short)means.at(i));
 	}
 	return avgs;
 }
 
+/* The averages are kept by this instance; the returned pointer is valid until the next call */
 const short *M2kAnalogInImpl::getVoltageRawP()
 {
-	std::vector<short> avgs = getVoltageRaw();
-	return avgs.data();
+	m_voltage_raw = getVoltageRaw();
+	return m_voltage_raw.data();
 }
 
 double M2kAnalogInImpl::getVoltage(unsigned int ch)
@@ -403,62 +1017,140 @@ double M2kAnalogInImpl::getVoltage(unsigned int ch)
 
 double M2kAnalogInImpl::getVoltage(ANALOG_IN_CHANNEL ch)
 {
-	unsigned int num_samples = 100;
-	M2K_TRIGGER_MODE mode;
-	bool enabled;
-
 	if (ch >= getNbChannels()) {
 		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogIn: no such channel");
 		return -1;
 	}
-	mode = m_trigger->getAnalogMode(ch);
-	m_trigger->setAnalogMode(ch, ALWAYS);
-
-	enabled = isChannelEnabled(ch);
-	enableChannel(ch, true);
-
-	auto samps = getSamples(num_samples, true);
-	double avg = Utils::average(samps.at(ch).data(), num_samples);
-
-	m_trigger->setAnalogMode(ch, mode);
-	enableChannel(ch, enabled);
-	return avg;
+	const CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(ch);
+	return getAverageRaw(ch).at(ch) * c.scale + c.offset;
 }
 
 std::vector<double> M2kAnalogInImpl::getVoltage()
 {
-	size_t num_samples = 100;
 	std::vector<double> avgs;
-	std::vector<M2K_TRIGGER_MODE> modes = {};
-	std::vector<bool> enabled = {};
+	auto means = getAverageRaw();
+	for (unsigned int i = 0; i < getNbChannels(); i++) {
+		const CHANNEL_COEFFICIENTS &c = m_calib_coefficients.at(i);
+		avgs.push_back(means.at(i) * c.scale + c.offset);
+	}
+	return avgs;
+}
+
+const double *M2kAnalogInImpl::getVoltageP()
+{
+	m_voltage = getVoltage();
+	return m_voltage.data();
+}
+
+void M2kAnalogInImpl::startVoltmeter(unsigned int nb_samples)
+{
+	if (nb_samples == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: The number of averaged samples must be greater than 0");
+	}
+	if (m_session_running && !m_voltmeter_running) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: Can not start the voltmeter while a session is running");
+	}
+
+	/* The voltmeter is a session acquiring nb_samples with the trigger set to ALWAYS */
+	if (m_voltmeter_running) {
+		if (nb_samples == m_session_samples) {
+			return;
+		}
+		closeSession();
+		__try {
+			openSession(nb_samples);
+		} __catch (exception_type &e) {
+			/* The voltmeter does not outlive its session */
+			stopVoltmeter();
+			throw_exception(EXC_INVALID_PARAMETER, e.what());
+		}
+		return;
+	}
 
+	openSession(nb_samples);
+	m_voltmeter_modes.clear();
 	for (unsigned int i = 0; i < getNbChannels(); i++) {
-		enabled.push_back(isChannelEnabled(i));
-		enableChannel(i, true);
-		modes.push_back(m_trigger->getAnalogMode(i));
+		m_voltmeter_modes.push_back(m_trigger->getAnalogMode(i));
 		m_trigger->setAnalogMode(i, ALWAYS);
 	}
-	auto samps = getSamples(num_samples, true);
-	for (unsigned int i = 0; i < getNbChannels(); i++) {
-		avgs.push_back(Utils::average(samps.at(i).data(), num_samples));
-		m_trigger->setAnalogMode(i, modes.at(i));
-		enableChannel(i, enabled.at(i));
+	m_voltmeter_running = true;
+}
+
+void M2kAnalogInImpl::stopVoltmeter()
+{
+	if (!m_voltmeter_running) {
+		return;
 	}
-	return avgs;
+	m_voltmeter_running = false;
+	for (unsigned int i = 0; i < m_voltmeter_modes.size(); i++) {
+		m_trigger->setAnalogMode(i, m_voltmeter_modes.at(i));
+	}
+	m_voltmeter_modes.clear();
+	closeSession();
 }
 
-const double *M2kAnalogInImpl::getVoltageP()
+bool M2kAnalogInImpl::isVoltmeterRunning()
 {
-	std::vector<double> avgs = getVoltage();
-	return avgs.data();
+	return m_voltmeter_running;
+}
+
+/*
+ * Mean raw code of each channel, accumulated in integers straight from the RX buffer.
+ * Inside a session (the voltmeter is one) the acquisition is already configured and one
+ * capture of the session is averaged; otherwise the trigger of the requested channels
+ * (all of them when channel is negative) is set to ALWAYS and restored afterwards
+ */
+std::vector<double> M2kAnalogInImpl::getAverageRaw(int channel)
+{
+	std::vector<double> means(getNbChannels(), 0);
+	std::vector<libm2k::SAMPLE_VIEW<short>> views;
+
+	if (m_session_running) {
+		views = m_m2k_adc->getSamplesView(m_session_samples);
+	} else {
+		/* For the m2k-adc, all the channels have to be enabled while refilling */
+		unsigned int first = (channel < 0) ? 0 : channel;
+		unsigned int last = (channel < 0) ? getNbChannels() : channel + 1;
+		std::vector<bool> enabled;
+		std::vector<M2K_TRIGGER_MODE> modes;
+		for (unsigned int i = 0; i < getNbChannels(); i++) {
+			enabled.push_back(isChannelEnabled(i));
+			enableChannel(i, true);
+		}
+		for (unsigned int i = first; i < last; i++) {
+			modes.push_back(m_trigger->getAnalogMode(i));
+			m_trigger->setAnalogMode(i, ALWAYS);
+		}
+		auto restore = [&]() {
+			for (unsigned int i = first; i < last; i++) {
+				m_trigger->setAnalogMode(i, modes.at(i - first));
+			}
+			for (unsigned int i = 0; i < enabled.size(); i++) {
+				enableChannel(i, enabled.at(i));
+			}
+		};
+
+		__try {
+			views = m_m2k_adc->getSamplesView(DC_AVERAGE_SAMPLES);
+		} __catch (exception_type &e) {
+			restore();
+			throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogIn: " + string(e.what()));
+		}
+		restore();
+	}
+
+	for (unsigned int i = 0; i < views.size() && i < means.size(); i++) {
+		const libm2k::SAMPLE_VIEW<short> &view = views.at(i);
+		if (view.data && view.nb_samples) {
+			means.at(i) = (double)Conversion::sum(view.data, view.step, view.nb_samples) / view.nb_samples;
+		}
+	}
+	return means;
 }
 
 double M2kAnalogInImpl::getScalingFactor(ANALOG_IN_CHANNEL ch)
 {
-	return (0.78 / ((1u << 11u) * 1.3 *
-			getValueForRange(m_input_range.at(ch))) *
-		m_adc_calib_gain.at(ch) *
-		getFilterCompensation(getSampleRate()));
+	return m_calib_coefficients.at(ch).scale;
 }
 
 double M2kAnalogInImpl::getScalingFactor(unsigned int ch)
@@ -475,6 +1167,7 @@ std::pair<double, double> M2kAnalogInImpl::getHysteresisRange(ANALOG_IN_CHANNEL
 
 void M2kAnalogInImpl::setRange(ANALOG_IN_CHANNEL channel, M2K_RANGE range)
 {
+	checkSessionStopped("the range");
 	const char *str_gain_mode;
 
 	m_input_range[channel] = range;
@@ -485,7 +1178,7 @@ void M2kAnalogInImpl::setRange(ANALOG_IN_CHANNEL channel, M2K_RANGE range)
 	}
 
 	m_m2k_fabric->setStringValue(channel, "gain", std::string(str_gain_mode));
-	m_trigger->setCalibParameters(channel, getScalingFactor(channel), m_adc_hw_vert_offset.at(channel));
+	updateCalibCoefficients(channel);
 }
 
 void M2kAnalogInImpl::setRange(ANALOG_IN_CHANNEL channel, double min, double max)
@@ -541,12 +1234,12 @@ std::vector<std::pair<std::string, std::pair<double, double>>> M2kAnalogInImpl::
 
 void M2kAnalogInImpl::setVerticalOffset(ANALOG_IN_CHANNEL channel, double vertOffset)
 {
-
+	checkSessionStopped("the vertical offset");
 	int raw_vert_offset = convertVoltsToRawVerticalOffset(channel, vertOffset);
 	m_adc_hw_vert_offset.at(channel) = vertOffset;
 	const int hw_offset_raw = raw_vert_offset + m_adc_calib_offset.at(channel);
 	m_adc_hw_offset_raw.at(channel) = m_ad5625_dev->setLongValue(channel + 2, hw_offset_raw, "raw", true);
-	m_trigger->setCalibParameters(channel, getScalingFactor(channel), m_adc_hw_vert_offset.at(channel));
+	updateCalibCoefficients(channel);
 }
 
 double M2kAnalogInImpl::getVerticalOffset(ANALOG_IN_CHANNEL channel)
@@ -566,11 +1259,13 @@ int M2kAnalogInImpl::getOversamplingRatio(unsigned int chn_idx)
 
 int M2kAnalogInImpl::setOversamplingRatio(int oversampling_ratio)
 {
+	checkSessionStopped("the oversampling ratio");
 	return m_m2k_adc->setLongValue(oversampling_ratio, "oversampling_ratio");
 }
 
 int M2kAnalogInImpl::setOversamplingRatio(unsigned int chn_idx, int oversampling_ratio)
 {
+	checkSessionStopped("the oversampling ratio");
 	return m_m2k_adc->setLongValue(chn_idx, oversampling_ratio, "oversampling_ratio");
 }
 
@@ -587,17 +1282,25 @@ double M2kAnalogInImpl::getSampleRate(unsigned int chn_idx)
 
 double M2kAnalogInImpl::setSampleRate(double samplerate)
 {
-	m_samplerate = m_m2k_adc->setLongValue((int)samplerate, "sampling_frequency");
-	m_trigger->setCalibParameters(0, getScalingFactor(0), m_adc_hw_vert_offset.at(0));
-	m_trigger->setCalibParameters(1, getScalingFactor(1), m_adc_hw_vert_offset.at(1));
+	checkSessionStopped("the sample rate");
+	double rate = m_m2k_adc->setLongValue((int)samplerate, "sampling_frequency");
+	if (m_m2k_adc->isTransactionOpen()) {
+		/* the device snaps the rate; commitConfiguration reads it back */
+		return rate;
+	}
+	m_samplerate = rate;
+	updateCalibCoefficients();
 	return m_samplerate;
 }
 
+/* The sample rate is shared by the channels; the index is only validated */
 double M2kAnalogInImpl::setSampleRate(unsigned int chn_idx, double samplerate)
 {
-	m_samplerate = m_m2k_adc->setLongValue((int)samplerate, "sampling_frequency");
-	m_trigger->setCalibParameters(chn_idx, getScalingFactor(chn_idx), m_adc_hw_vert_offset.at(chn_idx));
-	return m_samplerate;
+	if (chn_idx >= getNbChannels()) {
+		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogIn: no such channel");
+		return -1;
+	}
+	return setSampleRate(samplerate);
 }
 
 double M2kAnalogInImpl::getFilterCompensation(double samplerate)
@@ -627,6 +1330,74 @@ struct libm2k::IIO_OBJECTS M2kAnalogInImpl::getIioObjects()
 	return m_m2k_adc->getIioObjects();
 }
 
+void M2kAnalogInImpl::setAttributeCaching(bool enable)
+{
+	m_m2k_adc->setAttributeCaching(enable);
+	m_m2k_fabric->setAttributeCaching(enable);
+}
+
+void M2kAnalogInImpl::invalidateAttributeCache()
+{
+	m_m2k_adc->invalidateAttributeCache();
+	m_m2k_fabric->invalidateAttributeCache();
+}
+
+void M2kAnalogInImpl::beginConfiguration()
+{
+	if (!m_m2k_adc->isTransactionOpen()) {
+		/* the calibration gains are not attributes; they are restored if the configuration is dropped */
+		m_configuration_calib_gain = m_adc_calib_gain;
+	}
+	m_m2k_adc->beginTransaction();
+	m_m2k_fabric->beginTransaction();
+	m_ad5625_dev->beginTransaction();
+}
+
+/*
+ * Every device is committed even if an earlier one fails, so none is left in a transaction.
+ * After the outermost commit, the conversion settings are reloaded from the values the
+ * devices settled on.
+ */
+void M2kAnalogInImpl::commitConfiguration()
+{
+	std::string error;
+	bool cancelled = m_m2k_adc->isTransactionCancelled();
+
+	std::vector<DeviceGeneric*> devices = {m_m2k_adc.get(), m_m2k_fabric.get(), m_ad5625_dev.get()};
+	for (auto dev : devices) {
+		__try {
+			dev->commitTransaction();
+		} __catch (exception_type &e) {
+			if (error.empty()) {
+				error = e.what();
+			}
+		}
+	}
+
+	if (!m_m2k_adc->isTransactionOpen()) {
+		if (cancelled) {
+			m_adc_calib_gain = m_configuration_calib_gain;
+		}
+		syncDevice();
+	}
+	if (!error.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, error);
+	}
+}
+
+void M2kAnalogInImpl::cancelConfiguration()
+{
+	bool open = m_m2k_adc->isTransactionOpen();
+	m_m2k_adc->cancelTransaction();
+	m_m2k_fabric->cancelTransaction();
+	m_ad5625_dev->cancelTransaction();
+	if (open && !m_m2k_adc->isTransactionOpen()) {
+		/* the staged values never reached the device; reload the conversion settings */
+		m_adc_calib_gain = m_configuration_calib_gain;
+		syncDevice();
+	}
+}
+
 void M2kAnalogInImpl::cancelAcquisition()
 {
 	m_m2k_adc->cancelBuffer();
@@ -690,11 +1461,12 @@ void M2kAnalogInImpl::setRawVerticalOffset(ANALOG_IN_CHANNEL channel, int rawVer
 	m_adc_hw_vert_offset.at(channel) = vertOffset;
 	const int hw_offset_raw = rawVertOffset + m_adc_calib_offset.at(channel);
 	m_adc_hw_offset_raw.at(channel) = m_ad5625_dev->setLongValue(channel + 2, hw_offset_raw, "raw", true);
-	m_trigger->setCalibParameters(channel, getScalingFactor(channel), m_adc_hw_vert_offset.at(channel));
+	updateCalibCoefficients(channel);
 }
 
 void M2kAnalogInImpl::setAdcCalibOffset(ANALOG_IN_CHANNEL channel, int calib_offset, int vert_offset)
 {
+	checkSessionStopped("the calibration offset");
 	double vertOffset = convertRawToVoltsVerticalOffset(channel, vert_offset);
 	m_adc_hw_vert_offset.at(channel) = vertOffset;
 
@@ -707,7 +1479,7 @@ void M2kAnalogInImpl::setAdcCalibOffset(ANALOG_IN_CHANNEL channel, int calib_off
 	const int hw_offset_raw = vert_offset + m_adc_calib_offset.at(channel);
 	m_adc_hw_offset_raw.at(channel) = m_ad5625_dev->setLongValue(channel + 2, hw_offset_raw, "raw", true);
 
-	m_trigger->setCalibParameters(channel, getScalingFactor(channel), m_adc_hw_vert_offset.at(channel));
+	updateCalibCoefficients(channel);
 }
 
 int M2kAnalogInImpl::getAdcCalibOffset(ANALOG_IN_CHANNEL channel)
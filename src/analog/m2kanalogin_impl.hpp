@@ -25,10 +25,19 @@
 #include <libm2k/analog/m2kanalogin.hpp>
 #include "utils/devicegeneric.hpp"
 #include "utils/devicein.hpp"
+#include "utils/conversion.hpp"
+#include "utils/decimator.hpp"
+#include "utils/measurement.hpp"
+#include "utils/softwaretrigger.hpp"
+#include "utils/spectrum.hpp"
+#include "analog/m2krecording_impl.hpp"
 #include <libm2k/analog/enums.hpp>
 #include <libm2k/m2khardwaretrigger.hpp>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 namespace libm2k {
 namespace analog {
@@ -44,9 +53,36 @@ public:
 
 	std::vector<std::vector<double>> getSamples(unsigned int nb_samples) override;
 	std::vector<std::vector<double>> getSamplesRaw(unsigned int nb_samples) override;
+	std::vector<std::vector<float>> getSamplesFloat(unsigned int nb_samples) override;
+	std::vector<std::vector<short>> getSamplesRawShort(unsigned int nb_samples) override;
 
 	const double* getSamplesInterleaved(unsigned int nb_samples) override;
+	void getSamplesInterleaved(double *data, unsigned int nb_samples) override;
 	const short* getSamplesRawInterleaved(unsigned int nb_samples) override;
+	std::vector<libm2k::SAMPLE_VIEW<short>> getSamplesView(unsigned int nb_samples) override;
+	std::vector<MEASUREMENT_RESULTS> getMeasurements(unsigned int nb_samples) override;
+	void setSpectrumSettings(const SPECTRUM_SETTINGS &settings) override;
+	SPECTRUM_SETTINGS getSpectrumSettings() override;
+	std::vector<SPECTRUM> getSpectrum(unsigned int nb_samples) override;
+
+	void setStreamingTrigger(const STREAMING_TRIGGER &trigger) override;
+	STREAMING_TRIGGER getStreamingTrigger() override;
+	void setStreamingMeasurements(bool enable) override;
+	std::vector<MEASUREMENT_RESULTS> getStreamingMeasurements() override;
+	void resetStreamingMeasurements() override;
+	void setStreamingSpectrum(bool enable) override;
+	std::vector<SPECTRUM> getStreamingSpectrum() override;
+	void resetStreamingSpectrum() override;
+	void setStreamingDecimation(M2K_DECIMATION_MODE mode, unsigned int factor, unsigned int order = 3) override;
+	void startStreaming(unsigned int nb_samples, unsigned int queue_depth = 8) override;
+	void startStreaming(unsigned int nb_samples, std::function<void(const libm2k::STREAMING_BLOCK &)> callback,
+			    bool processed = false, unsigned int queue_depth = 8) override;
+	void stopStreaming() override;
+	const short* popStreamingBlock(unsigned int timeout_ms = 1000) override;
+	libm2k::STREAMING_STATISTICS getStreamingStatistics() override;
+
+	void startRecording(const std::string &path, unsigned int nb_samples = 65536, unsigned int queue_depth = 8) override;
+	unsigned long long stopRecording() override;
 
 	short getVoltageRaw(unsigned int ch) override;
 	double getVoltage(unsigned int ch) override;
@@ -57,6 +93,14 @@ public:
 	const short *getVoltageRawP() override;
 	const double *getVoltageP() override;
 
+	void startVoltmeter(unsigned int nb_samples = 100) override;
+	void stopVoltmeter() override;
+	bool isVoltmeterRunning() override;
+
+	void startSession(unsigned int nb_samples) override;
+	void stopSession() override;
+	bool isSessionRunning() override;
+
 	void setVerticalOffset(ANALOG_IN_CHANNEL channel, double vertOffset) override;
 	void setRawVerticalOffset(ANALOG_IN_CHANNEL channel, int rawVertOffset);
 	double getVerticalOffset(ANALOG_IN_CHANNEL channel) override;
@@ -120,14 +164,22 @@ public:
 
 	void cancelAcquisition() override;
 
-	void getSamples(std::vector<std::vector<double> > &data, unsigned int nb_samples);
+	void getSamples(std::vector<std::vector<double> > &data, unsigned int nb_samples) override;
+	void getSamples(std::vector<std::vector<float> > &data, unsigned int nb_samples) override;
+	void getSamplesRaw(std::vector<std::vector<short> > &data, unsigned int nb_samples) override;
 
 	std::string getChannelName(unsigned int channel);
+
+	void setAttributeCaching(bool enable) override;
+	void invalidateAttributeCache() override;
+
+	void beginConfiguration() override;
+	void commitConfiguration() override;
+	void cancelConfiguration() override;
 private:
 	std::shared_ptr<libm2k::utils::DeviceGeneric> m_ad5625_dev;
 	std::shared_ptr<libm2k::utils::DeviceGeneric> m_m2k_fabric;
 	std::shared_ptr<libm2k::utils::DeviceIn> m_m2k_adc;
-	bool m_need_processing;
 
 	double m_samplerate;
 	libm2k::M2kHardwareTrigger *m_trigger;
@@ -135,27 +187,98 @@ private:
 
 	bool m_calibbias_available;
 	std::vector<double> m_adc_calib_gain;
+	std::vector<double> m_configuration_calib_gain;
 	std::vector<int> m_adc_calib_offset;
 	std::vector<int> m_adc_hw_offset_raw;
 	std::vector<double> m_adc_hw_vert_offset;
 	std::map<double, double> m_filter_compensation_table;
-	std::vector<bool> m_channels_enabled;
+	std::vector<bool> m_streaming_channels_enabled;
+	bool m_streaming_callback;
+	STREAMING_TRIGGER m_streaming_trigger;
+	SPECTRUM_SETTINGS m_spectrum_settings;
+	bool m_streaming_spectrum;
+	bool m_streaming_measure;
+	M2K_DECIMATION_MODE m_decimation_mode;
+	unsigned int m_decimation_factor;
+	unsigned int m_decimation_order;
+	/* The analyses of the streamed blocks, made on the consumer thread; they persist after
+	 * the streaming stops, until reset or restarted */
+	std::mutex m_stream_measure_mutex;
+	std::vector<libm2k::utils::MeasurementAccumulator> m_stream_measurements;
+	std::vector<libm2k::utils::SpectrumAnalyzer> m_stream_spectra;
+	unsigned long long m_stream_measure_next;
+	unsigned int m_stream_nb_samples;
+	/* The stages of the callback chain, used by the callback thread only */
+	std::function<void(const libm2k::STREAMING_BLOCK &)> m_stream_consumer;
+	std::vector<libm2k::utils::CHANNEL_COEFFICIENTS> m_stream_coefficients;
+	std::unique_ptr<libm2k::utils::SoftwareTrigger> m_stream_trigger;
+	std::unique_ptr<libm2k::utils::Decimator> m_stream_decimator;
+	std::vector<short> m_stream_decimated;
+	std::vector<double> m_stream_volts;
+	unsigned long long m_stream_next_index;
+	std::atomic<unsigned long long> m_stream_frames;
+	std::atomic<unsigned long long> m_stream_missed_triggers;
+	std::unique_ptr<RecordingWriter> m_recorder;
+	std::vector<libm2k::utils::CHANNEL_COEFFICIENTS> m_calib_coefficients;
+	std::vector<libm2k::utils::CHANNEL_COEFFICIENTS> m_raw_coefficients;
+	std::vector<double> m_samples_interleaved;
+	std::vector<short> m_voltage_raw;
+	std::vector<double> m_voltage;
+	bool m_voltmeter_running;
+	std::vector<M2K_TRIGGER_MODE> m_voltmeter_modes;
+	bool m_session_running;
+	unsigned int m_session_samples;
+	std::vector<bool> m_session_channels_enabled;
+
+	class RefillGuard
+	{
+	public:
+		RefillGuard(M2kAnalogInImpl *analog_in, unsigned int nb_samples);
+		~RefillGuard();
+		const std::vector<bool> &getChannelsEnabled() const;
+	private:
+		M2kAnalogInImpl *m_analog_in;
+		std::vector<bool> m_channels_enabled;
+		bool m_restore;
+	};
 
 	void syncDevice();
 
 	M2K_RANGE getRangeDevice(ANALOG_IN_CHANNEL channel);
 
-	static short convVoltsToRaw(double voltage, double correctionGain, double hw_gain, double filterCompensation, double offset);
-
 	double getScalingFactor(unsigned int ch);
 
 	std::vector<std::vector<double>> getSamples(unsigned int nb_samples, bool processed);
 
-	void handleChannelsEnableState(bool before_refill);
+	template <typename T>
+	void captureSamples(std::vector<std::vector<T>> &data, unsigned int nb_samples, bool processed);
+
+	void startStreamingThreads(unsigned int nb_samples, unsigned int queue_depth,
+				   std::function<void(const libm2k::STREAMING_BLOCK &)> callback, bool processed,
+				   bool triggered = false);
+	void createStreamingStages(unsigned int nb_samples, std::function<void(const libm2k::STREAMING_BLOCK &)> callback,
+				   const std::vector<libm2k::utils::CHANNEL_COEFFICIENTS> &coefficients, bool triggered);
+	void measureStreamingBlock(const short *block, unsigned long long index);
+	void processStreamingBlock(const libm2k::STREAMING_BLOCK &block);
+	void deliverStreamingBlock(libm2k::STREAMING_BLOCK &block);
+	libm2k::utils::SOFTWARE_TRIGGER_SETTINGS getRawStreamingTrigger();
+	std::vector<libm2k::utils::SpectrumAnalyzer> createSpectrumAnalyzers();
+	std::vector<SPECTRUM> getSpectrumResults(const std::vector<libm2k::utils::SpectrumAnalyzer> &analyzers);
+
+	RECORDING_INFO getRecordingInfo();
+	double getMeasurementSampleRate();
+
+	void openSession(unsigned int nb_samples);
+	void closeSession();
+	void checkSessionStopped(const std::string &setting);
+
+	std::vector<double> getAverageRaw(int channel = -1);
 
 	const double *getSamplesInterleaved(unsigned int nb_samples, bool processed = false);
 
-	double processSample(int16_t sample, unsigned int channel);
+	const std::vector<libm2k::utils::CHANNEL_COEFFICIENTS> &getConversionCoefficients(bool processed);
+	void updateCalibCoefficients(unsigned int channel);
+	void updateCalibCoefficients();
 
 	const int convertVoltsToRawVerticalOffset(ANALOG_IN_CHANNEL channel, double vertOffset);
 	const double convertRawToVoltsVerticalOffset(ANALOG_IN_CHANNEL channel, int rawVertOffset);
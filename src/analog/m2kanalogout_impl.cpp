@@ -21,6 +21,7 @@
 #include "m2kanalogout_impl.hpp"
 #include "utils/devicegeneric.hpp"
 #include "utils/deviceout.hpp"
+#include "utils/conversion.hpp"
 #include <libm2k/m2kexceptions.hpp>
 #include <libm2k/utils/utils.hpp>
 #include "utils/channel.hpp"
@@ -36,7 +37,13 @@ using namespace libm2k::analog;
 using namespace libm2k::utils;
 using namespace std;
 
-M2kAnalogOutImpl::M2kAnalogOutImpl(iio_context *ctx, std::vector<std::string> dac_devs, bool sync)
+/* Longest loop of pushSynthesized, in samples */
+static const unsigned int MAX_SYNTH_CYCLE_SAMPLES = 1u << 20;
+
+M2kAnalogOutImpl::M2kAnalogOutImpl(iio_context *ctx, std::vector<std::string> dac_devs, bool sync) :
+	m_stream_stop(false),
+	m_stream_running(false),
+	m_stream_statistics()
 {
 	m_dac_devices.push_back(new DeviceOut(ctx, dac_devs.at(0)));
 	m_dac_devices.push_back(new DeviceOut(ctx, dac_devs.at(1)));
@@ -59,7 +66,11 @@ M2kAnalogOutImpl::M2kAnalogOutImpl(iio_context *ctx, std::vector<std::string> da
 	for (unsigned int i = 0; i < m_dac_devices.size(); i++) {
 		m_cyclic.push_back(true);
 		m_samplerate.push_back(75E6);
+		m_oversampling_ratio.push_back(1);
 		m_nb_kernel_buffers.push_back(4);
+		m_active_waveform.push_back("");
+		m_active_waveform_pushes.push_back(0);
+		m_synthesizers.push_back(nullptr);
 	}
 
 	if (sync) {
@@ -99,6 +110,8 @@ void M2kAnalogOutImpl::syncDevice()
 {
 	m_samplerate.at(0) = getSampleRate(0);
 	m_samplerate.at(1) = getSampleRate(1);
+	m_oversampling_ratio.at(0) = getOversamplingRatio(0);
+	m_oversampling_ratio.at(1) = getOversamplingRatio(1);
 	//enable???
 }
 
@@ -129,10 +142,12 @@ int M2kAnalogOutImpl::getOversamplingRatio(unsigned int chn_idx)
 
 std::vector<int> M2kAnalogOutImpl::setOversamplingRatio(std::vector<int> oversampling_ratio)
 {
+	checkStreamingStopped("change the oversampling ratio while streaming");
 	std::vector<int> values = {};
 	for (unsigned int i = 0; i < oversampling_ratio.size(); i++) {
 		int val = m_dac_devices.at(i)->setLongValue(oversampling_ratio.at(i),
 							    "oversampling_ratio");
+		m_oversampling_ratio.at(i) = val;
 		values.push_back(val);
 	}
 	return values;
@@ -140,8 +155,10 @@ std::vector<int> M2kAnalogOutImpl::setOversamplingRatio(std::vector<int> oversam
 
 int M2kAnalogOutImpl::setOversamplingRatio(unsigned int chn_idx, int oversampling_ratio)
 {
-	return getDacDevice(chn_idx)->setLongValue(oversampling_ratio,
-						   "oversampling_ratio");
+	checkStreamingStopped("change the oversampling ratio while streaming");
+	m_oversampling_ratio.at(chn_idx) = getDacDevice(chn_idx)->setLongValue(oversampling_ratio,
+										"oversampling_ratio");
+	return m_oversampling_ratio.at(chn_idx);
 }
 
 std::vector<double> M2kAnalogOutImpl::getSampleRate()
@@ -161,6 +178,7 @@ double M2kAnalogOutImpl::getSampleRate(unsigned int chn_idx)
 
 std::vector<double> M2kAnalogOutImpl::setSampleRate(std::vector<double> samplerates)
 {
+	checkStreamingStopped("change the sample rate while streaming");
 	if (samplerates.size() >= m_dac_devices.size()) {
 		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
 	}
@@ -175,6 +193,7 @@ std::vector<double> M2kAnalogOutImpl::setSampleRate(std::vector<double> samplera
 
 double M2kAnalogOutImpl::setSampleRate(unsigned int chn_idx, double samplerate)
 {
+	checkStreamingStopped("change the sample rate while streaming");
 	if (chn_idx >= m_dac_devices.size()) {
 		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
 	}
@@ -222,6 +241,7 @@ bool M2kAnalogOutImpl::getSyncedStartDma(int chn)
 
 void M2kAnalogOutImpl::setCyclic(bool en)
 {
+	checkStreamingStopped("change the cyclic mode while streaming");
 	for (unsigned int i = 0; i < m_dac_devices.size(); i++) {
 		m_cyclic.at(i) = en;
 		m_dac_devices.at(i)->setCyclic(en);
@@ -230,6 +250,7 @@ void M2kAnalogOutImpl::setCyclic(bool en)
 
 void M2kAnalogOutImpl::setCyclic(unsigned int chn, bool en)
 {
+	checkStreamingStopped("change the cyclic mode while streaming");
 	getDacDevice(chn)->setCyclic(en);
 	m_cyclic.at(chn) = en;
 }
@@ -246,7 +267,48 @@ short M2kAnalogOutImpl::convVoltsToRaw(double voltage, double vlsb,
 				       double filterCompensation)
 {
 	// TO DO: explain this formula....
-	return voltage * ((-1 * (1 / vlsb) * 16) / filterCompensation);
+	short raw;
+	Conversion::scaledToRaw(&voltage, 1, 1, (-1 * (1 / vlsb) * 16) / filterCompensation, &raw);
+	return raw;
+}
+
+/* The factor of convVoltsToRaw, with the sample rate cached by setSampleRate */
+double M2kAnalogOutImpl::getRawScale(unsigned int chnIdx)
+{
+	return (-1 * (1 / m_calib_vlsb.at(chnIdx)) * 16) /
+			getFilterCompensation(m_samplerate.at(chnIdx));
+}
+
+/*
+ * The volts are converted with one factor per channel, straight into the memory of the
+ * next TX buffer; no intermediate raw buffer is built. An empty push still goes through
+ * DeviceOut::push, which removes the previous buffer.
+ */
+void M2kAnalogOutImpl::pushConverted(unsigned int chnIdx, const double *data, std::ptrdiff_t step,
+				     unsigned int nb_samples)
+{
+	DeviceOut *dac = m_dac_devices.at(chnIdx);
+	if (nb_samples == 0) {
+		dac->push(std::vector<short>(), 0, getCyclic(chnIdx));
+		return;
+	}
+	short *raw = static_cast<short*>(dac->acquireBuffer(nb_samples, getCyclic(chnIdx)));
+	Conversion::scaledToRaw(data, step, nb_samples, getRawScale(chnIdx), raw);
+	dac->commitBuffer();
+}
+
+/* The raw samples of one channel, picked with the given step straight into the next TX buffer */
+void M2kAnalogOutImpl::pushExtracted(unsigned int chnIdx, const short *data, std::ptrdiff_t step,
+				     unsigned int nb_samples)
+{
+	DeviceOut *dac = m_dac_devices.at(chnIdx);
+	if (nb_samples == 0) {
+		dac->push(std::vector<short>(), 0, getCyclic(chnIdx));
+		return;
+	}
+	short *raw = static_cast<short*>(dac->acquireBuffer(nb_samples, getCyclic(chnIdx)));
+	Conversion::extract(data, step, nb_samples, raw);
+	dac->commitBuffer();
 }
 
 short M2kAnalogOutImpl::convertVoltsToRaw(unsigned int channel, double voltage)
@@ -290,6 +352,7 @@ void M2kAnalogOutImpl::pushRaw(unsigned int chnIdx, std::vector<short> const &da
 
 void M2kAnalogOutImpl::pushRawBytes(unsigned int chnIdx, short *data, unsigned int nb_samples)
 {
+	checkStreamingStopped("push while streaming");
 	if (chnIdx >= m_dac_devices.size()) {
 		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
 	}
@@ -300,6 +363,529 @@ void M2kAnalogOutImpl::pushRawBytes(unsigned int chnIdx, short *data, unsigned i
 }
 
 
+short *M2kAnalogOutImpl::acquireBuffer(unsigned int chnIdx, unsigned int nb_samples)
+{
+	checkStreamingStopped("push while streaming");
+	if (chnIdx >= m_dac_devices.size()) {
+		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
+	}
+
+	return static_cast<short*>(m_dac_devices.at(chnIdx)->acquireBuffer(nb_samples, getCyclic(chnIdx)));
+}
+
+void M2kAnalogOutImpl::commitBuffer(unsigned int chnIdx)
+{
+	if (chnIdx >= m_dac_devices.size()) {
+		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
+	}
+
+	m_dac_devices.at(chnIdx)->commitBuffer();
+
+	setSyncedDma(false, chnIdx);
+}
+
+void M2kAnalogOutImpl::registerWaveform(const std::string &id, std::vector<std::vector<double>> const &data)
+{
+	std::vector<unsigned int> nb_samples;
+	for (auto &samples : data) {
+		nb_samples.push_back(samples.size());
+	}
+	checkWaveformChannels(id, nb_samples);
+
+	std::vector<std::vector<short>> raw(getNbChannels());
+	for (unsigned int chn = 0; chn < data.size(); chn++) {
+		raw.at(chn).resize(data.at(chn).size());
+		if (!data.at(chn).empty()) {
+			Conversion::scaledToRaw(data.at(chn).data(), 1, data.at(chn).size(),
+						getRawScale(chn), raw.at(chn).data());
+		}
+	}
+	storeWaveform(id, std::move(raw), m_calib_vlsb);
+}
+
+void M2kAnalogOutImpl::registerWaveformRaw(const std::string &id, std::vector<std::vector<short>> const &data)
+{
+	std::vector<unsigned int> nb_samples;
+	for (auto &samples : data) {
+		nb_samples.push_back(samples.size());
+	}
+	checkWaveformChannels(id, nb_samples);
+
+	std::vector<std::vector<short>> raw(data.begin(), data.end());
+	raw.resize(getNbChannels());
+	storeWaveform(id, std::move(raw), {});
+}
+
+/*
+ * A cyclic buffer can't be updated once pushed, so changing the waveform always recreates it;
+ * what is saved on activation is the conversion, the attribute writes for settings that did
+ * not change and, when the waveform is still running, the whole push. A waveform registered on
+ * several channels is always pushed on all of them, with the DMA handshake, to keep them aligned.
+ */
+double M2kAnalogOutImpl::activateWaveform(const std::string &id)
+{
+	checkStreamingStopped("activate a waveform while streaming");
+	auto start = std::chrono::steady_clock::now();
+	auto it = m_waveforms.find(id);
+	if (it == m_waveforms.end()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No such waveform: " + id);
+	}
+	CachedWaveform &waveform = it->second;
+
+	std::vector<unsigned int> channels;
+	bool running = true;
+	for (unsigned int chn = 0; chn < waveform.samples.size(); chn++) {
+		if (waveform.samples.at(chn).empty()) {
+			continue;
+		}
+		if (!waveform.calib_vlsb.empty() && waveform.calib_vlsb.at(chn) != m_calib_vlsb.at(chn)) {
+			throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: The waveform " + id +
+					" was converted with a different calibration; it has to be registered again");
+		}
+		channels.push_back(chn);
+		running &= isWaveformActive(chn, id);
+	}
+
+	for (unsigned int chn : channels) {
+		if (m_samplerate.at(chn) != waveform.info.sample_rate.at(chn)) {
+			setSampleRate(chn, waveform.info.sample_rate.at(chn));
+		}
+		if (m_oversampling_ratio.at(chn) != waveform.info.oversampling_ratio.at(chn)) {
+			setOversamplingRatio(chn, waveform.info.oversampling_ratio.at(chn));
+		}
+	}
+
+	if (!running) {
+		std::vector<unsigned int> nb_samples;
+		for (unsigned int chn : channels) {
+			nb_samples.push_back(waveform.samples.at(chn).size());
+		}
+		pushBuffers(channels, nb_samples, [&waveform](unsigned int chn, short *raw) {
+			const std::vector<short> &samples = waveform.samples.at(chn);
+			memcpy(raw, samples.data(), samples.size() * sizeof(short));
+		});
+		for (unsigned int chn : channels) {
+			m_active_waveform.at(chn) = id;
+			m_active_waveform_pushes.at(chn) = m_dac_devices.at(chn)->getBufferStatistics().nb_pushes;
+		}
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	waveform.info.nb_activations++;
+	waveform.info.last_switch_latency = elapsed.count();
+	waveform.info.max_switch_latency = std::max(waveform.info.max_switch_latency, elapsed.count());
+	return elapsed.count();
+}
+
+void M2kAnalogOutImpl::unregisterWaveform(const std::string &id)
+{
+	if (m_waveforms.erase(id) == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No such waveform: " + id);
+	}
+	for (auto &active : m_active_waveform) {
+		if (active == id) {
+			active.clear();
+		}
+	}
+}
+
+std::vector<std::string> M2kAnalogOutImpl::getWaveforms()
+{
+	std::vector<std::string> ids;
+	for (auto &waveform : m_waveforms) {
+		ids.push_back(waveform.first);
+	}
+	return ids;
+}
+
+libm2k::analog::WAVEFORM_INFO M2kAnalogOutImpl::getWaveformInfo(const std::string &id)
+{
+	auto it = m_waveforms.find(id);
+	if (it == m_waveforms.end()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No such waveform: " + id);
+	}
+	return it->second.info;
+}
+
+void M2kAnalogOutImpl::startStreaming(unsigned int nb_samples,
+				      std::function<bool(const libm2k::GENERATOR_BLOCK &)> producer, bool processed)
+{
+	if (m_stream_thread.joinable()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: Streaming already started");
+	}
+	if (nb_samples == 0 || !producer) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: Invalid streaming block size or producer");
+	}
+	std::vector<unsigned int> channels;
+	for (unsigned int chn = 0; chn < getNbChannels(); chn++) {
+		if (isChannelEnabled(chn)) {
+			channels.push_back(chn);
+		}
+	}
+	if (channels.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No channel enabled for streaming");
+	}
+
+	unsigned int capacity = nb_samples * (m_nb_kernel_buffers.at(channels.front()) - 1);
+	for (unsigned int chn : channels) {
+		if (m_nb_kernel_buffers.at(chn) < 2) {
+			throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: Streaming needs at least 2 kernel buffers");
+		}
+	}
+	for (unsigned int chn : channels) {
+		setCyclic(chn, false);
+		capacity = std::min(capacity, nb_samples * (m_nb_kernel_buffers.at(chn) - 1));
+	}
+	/* the thread works on a snapshot of the rates and of the conversion of the channels */
+	std::vector<double> rates, raw_scale;
+	for (unsigned int chn : channels) {
+		rates.push_back(m_samplerate.at(chn) / m_oversampling_ratio.at(chn));
+		raw_scale.push_back(getRawScale(chn));
+	}
+	m_stream_channels = channels;
+	m_stream_producer = producer;
+	m_stream_error.clear();
+	m_stream_statistics = GENERATOR_STATISTICS();
+	m_stream_statistics.queue_capacity = capacity;
+	m_stream_statistics.min_queued_samples = capacity;
+	deactivateWaveform();
+	m_stream_stop = false;
+	m_stream_running = true;
+	m_stream_thread = std::thread(&M2kAnalogOutImpl::streamingThread, this, nb_samples, processed,
+				      rates, raw_scale);
+}
+
+void M2kAnalogOutImpl::stopStreaming()
+{
+	joinStreaming();
+
+	std::string error = m_stream_error;
+	m_stream_error.clear();
+	if (!error.empty()) {
+		throw_exception(EXC_RUNTIME_ERROR, "M2kAnalogOut: Streaming stopped; " + error);
+	}
+}
+
+bool M2kAnalogOutImpl::isStreaming()
+{
+	return m_stream_running;
+}
+
+libm2k::GENERATOR_STATISTICS M2kAnalogOutImpl::getStreamingStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_stream_mutex);
+	return m_stream_statistics;
+}
+
+/* The generator thread owns the TX buffers and the rates it was started with, until it is joined */
+void M2kAnalogOutImpl::checkStreamingStopped(const std::string &operation)
+{
+	if (m_stream_thread.joinable()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: Can not " + operation +
+				"; call stopStreaming() first");
+	}
+}
+
+/* Stops the generation without reporting the producer errors, so that stop() never throws */
+void M2kAnalogOutImpl::joinStreaming()
+{
+	if (!m_stream_thread.joinable()) {
+		return;
+	}
+	m_stream_stop = true;
+	for (unsigned int chn : m_stream_channels) {
+		m_dac_devices.at(chn)->cancelBuffer();
+	}
+	m_stream_thread.join();
+
+	/* A cancelled buffer can not be pushed again */
+	for (unsigned int chn : m_stream_channels) {
+		m_dac_devices.at(chn)->stop();
+	}
+	m_stream_producer = nullptr;
+	m_stream_running = false;
+}
+
+/*
+ * The producer fills the TX buffers in place; each push blocks while the kernel buffers are
+ * full, which paces the thread on the DAC. The channels are held by the DMA sync until the
+ * kernel buffers are filled, at the start and after every underrun, so they start aligned
+ * and with the whole queue ahead of them.
+ */
+void M2kAnalogOutImpl::streamingThread(unsigned int nb_samples, bool processed,
+				       std::vector<double> rates, std::vector<double> raw_scale)
+{
+	const std::vector<unsigned int> &channels = m_stream_channels;
+	unsigned int nb_channels = channels.size();
+	std::vector<short*> raw(nb_channels);
+	std::vector<std::vector<double>> volts(processed ? nb_channels : 0, std::vector<double>(nb_samples));
+	std::vector<double*> volts_ptr;
+	for (unsigned int i = 0; i < volts.size(); i++) {
+		volts_ptr.push_back(volts.at(i).data());
+	}
+
+	unsigned int nb_prime = m_nb_kernel_buffers.at(channels.front()) - 1;
+	for (unsigned int chn : channels) {
+		nb_prime = std::min(nb_prime, m_nb_kernel_buffers.at(chn) - 1);
+	}
+	unsigned int priming = nb_prime;
+	bool ended = false;
+
+	libm2k::GENERATOR_BLOCK block = {};
+	block.raw = processed ? nullptr : raw.data();
+	block.volts = processed ? volts_ptr.data() : nullptr;
+	block.channels = channels.data();
+	block.nb_samples = nb_samples;
+	block.nb_channels = nb_channels;
+
+	__try {
+		while (!m_stream_stop && !ended) {
+			for (unsigned int i = 0; i < nb_channels; i++) {
+				raw[i] = static_cast<short*>(m_dac_devices.at(channels.at(i))->acquireBuffer(nb_samples, false));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			ended = !m_stream_producer(block);
+			double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (m_stream_stop) {
+				break;
+			}
+			for (unsigned int i = 0; i < volts.size(); i++) {
+				Conversion::scaledToRaw(volts_ptr[i], 1, nb_samples, raw_scale[i], raw[i]);
+			}
+
+			if (priming == 0 && !readStreamingOccupancy(nb_samples, rates)) {
+				priming = nb_prime;
+			}
+			if (priming == nb_prime) {
+				setSyncedDma(true);
+			}
+			for (unsigned int i = 0; i < nb_channels; i++) {
+				m_dac_devices.at(channels.at(i))->commitBuffer();
+			}
+			if (priming > 0 && (--priming == 0 || ended)) {
+				if (m_dma_start_sync_available && (nb_channels == getNbChannels())) {
+					setSyncedStartDma(true);
+				}
+				setSyncedDma(false);
+				priming = 0;
+			}
+
+			block.index++;
+			block.first_sample += nb_samples;
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			m_stream_statistics.blocks_generated++;
+			m_stream_statistics.last_producer_duration = duration;
+			m_stream_statistics.max_producer_duration = std::max(m_stream_statistics.max_producer_duration,
+									     duration);
+		}
+	} __catch (exception_type &e) {
+		if (!m_stream_stop) {
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			m_stream_error = e.what();
+		}
+	}
+	m_stream_running = false;
+}
+
+/*
+ * Updates the occupancy counters from the free space of the kernel buffers of every channel;
+ * returns false when they were all drained, an underrun
+ */
+bool M2kAnalogOutImpl::readStreamingOccupancy(unsigned int nb_samples, std::vector<double> const &rates)
+{
+	if (!m_dma_data_available) {
+		return true;
+	}
+
+	unsigned int queued = m_stream_statistics.queue_capacity;
+	bool empty = true;
+	double latency = 0;
+	for (unsigned int i = 0; i < m_stream_channels.size(); i++) {
+		unsigned int chn = m_stream_channels.at(i);
+		// data_available is the unused space, in bytes, as in push
+		unsigned int capacity = nb_samples * (m_nb_kernel_buffers.at(chn) - 1);
+		unsigned int unused = m_dac_devices.at(chn)->getBufferLongValue("data_available") / sizeof(short);
+		unsigned int chn_queued = (unused < capacity) ? (capacity - unused) : 0;
+		empty &= (chn_queued == 0);
+		queued = std::min(queued, chn_queued);
+		latency = std::max(latency, chn_queued / rates.at(i));
+	}
+
+	std::lock_guard<std::mutex> lock(m_stream_mutex);
+	m_stream_statistics.queued_samples = queued;
+	m_stream_statistics.min_queued_samples = std::min(m_stream_statistics.min_queued_samples, queued);
+	m_stream_statistics.last_latency = latency;
+	m_stream_statistics.max_latency = std::max(m_stream_statistics.max_latency, latency);
+	if (empty) {
+		m_stream_statistics.underruns++;
+	}
+	return !empty;
+}
+
+void M2kAnalogOutImpl::setSynthesizer(unsigned int chnIdx, const libm2k::analog::SYNTH_SETTINGS &settings)
+{
+	if (chnIdx >= m_dac_devices.size()) {
+		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogOut: No such channel");
+	}
+	Synthesizer::validate(settings, m_samplerate.at(chnIdx) / m_oversampling_ratio.at(chnIdx));
+	m_synthesizers.at(chnIdx) = std::unique_ptr<Synthesizer>(new Synthesizer(settings));
+}
+
+libm2k::analog::SYNTH_SETTINGS M2kAnalogOutImpl::getSynthesizer(unsigned int chnIdx)
+{
+	if (chnIdx >= m_dac_devices.size()) {
+		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogOut: No such channel");
+	}
+	if (!m_synthesizers.at(chnIdx)) {
+		return SYNTH_SETTINGS();
+	}
+	return m_synthesizers.at(chnIdx)->getSettings();
+}
+
+void M2kAnalogOutImpl::synthesizeRaw(unsigned int chnIdx, short *data, unsigned int nb_samples)
+{
+	getConfiguredSynthesizer(chnIdx)->synthesize(data, nb_samples);
+}
+
+std::vector<short> M2kAnalogOutImpl::synthesizeRaw(unsigned int chnIdx, unsigned int nb_samples)
+{
+	std::vector<short> data(nb_samples);
+	synthesizeRaw(chnIdx, data.data(), nb_samples);
+	return data;
+}
+
+unsigned int M2kAnalogOutImpl::pushSynthesized(unsigned int chnIdx)
+{
+	checkStreamingStopped("push while streaming");
+	Synthesizer loop = *getConfiguredSynthesizer(chnIdx);
+	unsigned int nb_samples = loop.tuneToCycle(MAX_SYNTH_CYCLE_SAMPLES);
+	pushBuffers({chnIdx}, {nb_samples}, [&loop, nb_samples](unsigned int, short *raw) {
+		loop.synthesize(raw, nb_samples);
+	});
+	return nb_samples;
+}
+
+std::vector<unsigned int> M2kAnalogOutImpl::pushSynthesized()
+{
+	checkStreamingStopped("push while streaming");
+	std::vector<unsigned int> channels;
+	std::vector<Synthesizer> loops;
+	std::vector<unsigned int> nb_samples(getNbChannels(), 0);
+	for (unsigned int chn = 0; chn < getNbChannels(); chn++) {
+		if (m_synthesizers.at(chn)) {
+			loops.push_back(*getConfiguredSynthesizer(chn));
+			nb_samples.at(chn) = loops.back().tuneToCycle(MAX_SYNTH_CYCLE_SAMPLES);
+			channels.push_back(chn);
+		}
+	}
+	if (channels.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No synthesizer set");
+	}
+
+	std::vector<unsigned int> loop_samples;
+	for (unsigned int chn : channels) {
+		loop_samples.push_back(nb_samples.at(chn));
+	}
+	unsigned int index = 0;
+	pushBuffers(channels, loop_samples, [&](unsigned int chn, short *raw) {
+		loops.at(index++).synthesize(raw, nb_samples.at(chn));
+	});
+	return nb_samples;
+}
+
+/* The synthesizer of the channel, following the current sample rate and calibration */
+Synthesizer *M2kAnalogOutImpl::getConfiguredSynthesizer(unsigned int chnIdx)
+{
+	if (chnIdx >= m_dac_devices.size()) {
+		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogOut: No such channel");
+	}
+	Synthesizer *synthesizer = m_synthesizers.at(chnIdx).get();
+	if (!synthesizer) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No synthesizer set for the channel");
+	}
+	synthesizer->configure(m_samplerate.at(chnIdx) / m_oversampling_ratio.at(chnIdx), getRawScale(chnIdx));
+	return synthesizer;
+}
+
+/*
+ * One buffer per channel, filled in place; several channels are pushed with the DMA sync
+ * handshake, so that they start together
+ */
+void M2kAnalogOutImpl::pushBuffers(std::vector<unsigned int> const &channels, std::vector<unsigned int> const &nb_samples,
+				   std::function<void(unsigned int, short*)> fill)
+{
+	bool synced = (channels.size() > 1);
+	if (synced) {
+		setSyncedDma(true);
+	}
+	for (unsigned int i = 0; i < channels.size(); i++) {
+		DeviceOut *dac = m_dac_devices.at(channels.at(i));
+		short *raw = static_cast<short*>(dac->acquireBuffer(nb_samples.at(i), getCyclic(channels.at(i))));
+		fill(channels.at(i), raw);
+		dac->commitBuffer();
+	}
+	if (synced) {
+		if (m_dma_start_sync_available && (channels.size() == getNbChannels())) {
+			setSyncedStartDma(true);
+		}
+		setSyncedDma(false);
+	} else {
+		setSyncedDma(false, channels.front());
+	}
+}
+
+void M2kAnalogOutImpl::checkWaveformChannels(const std::string &id, std::vector<unsigned int> const &nb_samples)
+{
+	if (nb_samples.size() > getNbChannels()) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: Too many channels for the waveform " + id);
+	}
+	if (std::all_of(nb_samples.begin(), nb_samples.end(), [] (unsigned int n) { return n == 0; })) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kAnalogOut: No samples for the waveform " + id);
+	}
+}
+
+void M2kAnalogOutImpl::storeWaveform(const std::string &id, std::vector<std::vector<short>> &&samples,
+				     std::vector<double> const &calib_vlsb)
+{
+	CachedWaveform waveform;
+	waveform.info = {};
+	waveform.info.id = id;
+	for (unsigned int chn = 0; chn < samples.size(); chn++) {
+		waveform.info.nb_samples.push_back(samples.at(chn).size());
+		waveform.info.sample_rate.push_back(m_samplerate.at(chn));
+		waveform.info.oversampling_ratio.push_back(m_oversampling_ratio.at(chn));
+	}
+	waveform.samples = std::move(samples);
+	waveform.calib_vlsb = calib_vlsb;
+
+	// the samples of a replaced waveform may differ from the ones being generated
+	for (auto &active : m_active_waveform) {
+		if (active == id) {
+			active.clear();
+		}
+	}
+	m_waveforms[id] = std::move(waveform);
+}
+
+/* The channel still generates the waveform when no buffer was pushed nor stopped since its activation */
+bool M2kAnalogOutImpl::isWaveformActive(unsigned int chnIdx, const std::string &id)
+{
+	return (m_active_waveform.at(chnIdx) == id) && getCyclic(chnIdx) &&
+			(m_dac_devices.at(chnIdx)->getBufferStatistics().nb_pushes == m_active_waveform_pushes.at(chnIdx));
+}
+
+void M2kAnalogOutImpl::deactivateWaveform(int chn)
+{
+	if (chn < 0) {
+		for (auto &active : m_active_waveform) {
+			active.clear();
+		}
+	} else {
+		m_active_waveform.at(chn).clear();
+	}
+}
+
 void M2kAnalogOutImpl::push(unsigned int chnIdx, std::vector<double> const &data)
 {
 	double *ptr = (double*)data.data();
@@ -309,15 +895,11 @@ void M2kAnalogOutImpl::push(unsigned int chnIdx, std::vector<double> const &data
 
 void M2kAnalogOutImpl::pushBytes(unsigned int chnIdx, double *data, unsigned int nb_samples)
 {
+	checkStreamingStopped("push while streaming");
 	if (chnIdx >= m_dac_devices.size()) {
 		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
 	}
-	std::vector<short> raw_data_buffer = {};
-
-	for (unsigned int i = 0; i < nb_samples; i++) {
-		raw_data_buffer.push_back(convertVoltsToRaw(chnIdx, data[i]));
-	}
-	m_dac_devices.at(chnIdx)->push(raw_data_buffer, 0, getCyclic(chnIdx));
+	pushConverted(chnIdx, data, 1, nb_samples);
 }
 
 
@@ -326,6 +908,7 @@ void M2kAnalogOutImpl::pushBytes(unsigned int chnIdx, double *data, unsigned int
 	 */
 void M2kAnalogOutImpl::pushRaw(std::vector<std::vector<short>> const &data)
 {
+	checkStreamingStopped("push while streaming");
 	std::vector<std::vector<short>> data_buffers;
 	bool streamingData = true;
 	bool isBufferEmpty = true;
@@ -354,9 +937,7 @@ void M2kAnalogOutImpl::pushRaw(std::vector<std::vector<short>> const &data)
 	}
 
 	for (unsigned int chn = 0; chn < data.size(); chn++) {
-		size_t size = data.at(chn).size();
-		std::vector<short> raw_data_buffer(data.at(chn).data(), data.at(chn).data() + size);
-		m_dac_devices.at(chn)->push(raw_data_buffer, 0, getCyclic(chn));
+		m_dac_devices.at(chn)->push(data.at(chn), 0, getCyclic(chn));
 	}
 
 	if ((streamingData && isBufferEmpty) || !streamingData) {
@@ -369,10 +950,13 @@ void M2kAnalogOutImpl::pushRaw(std::vector<std::vector<short>> const &data)
 
 void M2kAnalogOutImpl::pushRawInterleaved(short *data, unsigned int nb_channels, unsigned int nb_samples)
 {
+	checkStreamingStopped("push while streaming");
+	if (nb_channels == 0 || nb_channels > getNbChannels()) {
+		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
+	}
 	if ((nb_samples % nb_channels) !=0) {
 		throw_exception(EXC_INVALID_PARAMETER, "Analog Out: Input array length must be multiple of channels");
 	}
-	std::vector<std::vector<short>> data_buffers;
 	unsigned int bufferSize = nb_samples/nb_channels;
 	bool streamingData = true;
 	bool isBufferEmpty = true;
@@ -399,11 +983,7 @@ void M2kAnalogOutImpl::pushRawInterleaved(short *data, unsigned int nb_channels,
 	}
 
 	for (unsigned int chn = 0; chn < nb_channels; chn++) {
-		std::vector<short> raw_data_buffer = {};
-		for (unsigned int i = 0, off = 0; i < (bufferSize); i++, off += nb_channels) {
-			raw_data_buffer.push_back(data[chn + off]);
-		}
-		m_dac_devices.at(chn)->push(raw_data_buffer, 0, getCyclic(chn));
+		pushExtracted(chn, data + chn, nb_channels, bufferSize);
 	}
 
 	if ((streamingData && isBufferEmpty) || !streamingData) {
@@ -420,7 +1000,7 @@ void M2kAnalogOutImpl::pushRawInterleaved(short *data, unsigned int nb_channels,
 	 */
 void M2kAnalogOutImpl::push(std::vector<std::vector<double>> const &data)
 {
-	std::vector<std::vector<short>> data_buffers;
+	checkStreamingStopped("push while streaming");
 	bool streamingData = true;
 	bool isBufferEmpty = true;
 	bool allChannelsPushed = (data.size() != getNbChannels()) ? false : true;
@@ -449,13 +1029,7 @@ void M2kAnalogOutImpl::push(std::vector<std::vector<double>> const &data)
 	}
 
 	for (unsigned int chn = 0; chn < data.size(); chn++) {
-		size_t size = data.at(chn).size();
-		std::vector<short> raw_data_buffer = {};
-		for (unsigned int i = 0; i < size; i++) {
-			raw_data_buffer.push_back(convertVoltsToRaw(chn, data[chn][i]));
-		}
-		m_dac_devices.at(chn)->push(raw_data_buffer, 0, getCyclic(chn));
-		data_buffers.push_back(raw_data_buffer);
+		pushConverted(chn, data.at(chn).data(), 1, data.at(chn).size());
 	}
 
 	if ((streamingData && isBufferEmpty) || !streamingData) {
@@ -468,10 +1042,13 @@ void M2kAnalogOutImpl::push(std::vector<std::vector<double>> const &data)
 
 void M2kAnalogOutImpl::pushInterleaved(double *data, unsigned int nb_channels, unsigned int nb_samples)
 {
+	checkStreamingStopped("push while streaming");
+	if (nb_channels == 0 || nb_channels > getNbChannels()) {
+		throw_exception(EXC_OUT_OF_RANGE, "Analog Out: No such channel");
+	}
 	if ((nb_samples % nb_channels) !=0) {
 		throw_exception(EXC_INVALID_PARAMETER, "Analog Out: Input array length must be multiple of channels");
 	}
-	std::vector<std::vector<short>> data_buffers;
 	unsigned int bufferSize = nb_samples/nb_channels;
 	bool streamingData = true;
 	bool isBufferEmpty = true;
@@ -497,12 +1074,7 @@ void M2kAnalogOutImpl::pushInterleaved(double *data, unsigned int nb_channels, u
 		setSyncedDma(true);
 	}
 	for (unsigned int chn = 0; chn < nb_channels; chn++) {
-		std::vector<short> raw_data_buffer = {};
-		for (unsigned int i = 0, off = 0; i < (bufferSize); i++, off += nb_channels) {
-			raw_data_buffer.push_back(convertVoltsToRaw(chn, data[chn + off]));
-		}
-		m_dac_devices.at(chn)->push(raw_data_buffer, 0, getCyclic(chn));
-		data_buffers.push_back(raw_data_buffer);
+		pushConverted(chn, data + chn, nb_channels, bufferSize);
 	}
 
 	if ((streamingData && isBufferEmpty) || !streamingData) {
@@ -529,6 +1101,7 @@ double M2kAnalogOutImpl::getFilterCompensation(double samplerate)
 
 void M2kAnalogOutImpl::stop()
 {
+	joinStreaming();
 	m_m2k_fabric->setBoolValue(0, true, "powerdown", true);
 	m_m2k_fabric->setBoolValue(1, true, "powerdown", true);
 	setSyncedDma(true, 0);
@@ -537,13 +1110,16 @@ void M2kAnalogOutImpl::stop()
 	for (DeviceOut* dev : m_dac_devices) {
 		dev->stop();
 	}
+	deactivateWaveform();
 }
 
 void M2kAnalogOutImpl::stop(unsigned int chn)
 {
+	joinStreaming();
 	m_m2k_fabric->setBoolValue(chn, true, "powerdown", true);
 	setSyncedDma(true, chn);
 	getDacDevice(chn)->stop();
+	deactivateWaveform(chn);
 }
 
 void M2kAnalogOutImpl::enableChannel(unsigned int chnIdx, bool enable)
@@ -579,6 +1155,7 @@ std::vector<double> M2kAnalogOutImpl::getAvailableSampleRates(unsigned int chnId
 
 void M2kAnalogOutImpl::setKernelBuffersCount(unsigned int chnIdx, unsigned int count)
 {
+	checkStreamingStopped("change the kernel buffers while streaming");
 	if (chnIdx >= m_dac_devices.size()) {
 		throw_exception(EXC_OUT_OF_RANGE, "M2kAnalogOut: No such channel");
 	}
@@ -586,6 +1163,70 @@ void M2kAnalogOutImpl::setKernelBuffersCount(unsigned int chnIdx, unsigned int c
 	m_nb_kernel_buffers[chnIdx] = count;
 }
 
+void M2kAnalogOutImpl::setAttributeCaching(bool enable)
+{
+	for (auto dac : m_dac_devices) {
+		dac->setAttributeCaching(enable);
+	}
+	m_m2k_fabric->setAttributeCaching(enable);
+}
+
+void M2kAnalogOutImpl::invalidateAttributeCache()
+{
+	for (auto dac : m_dac_devices) {
+		dac->invalidateAttributeCache();
+	}
+	m_m2k_fabric->invalidateAttributeCache();
+}
+
+void M2kAnalogOutImpl::beginConfiguration()
+{
+	for (auto dac : m_dac_devices) {
+		dac->beginTransaction();
+	}
+	m_m2k_fabric->beginTransaction();
+}
+
+/*
+ * Every device is committed even if an earlier one fails; the rates are then reloaded
+ * from the values the devices settled on
+ */
+void M2kAnalogOutImpl::commitConfiguration()
+{
+	std::string error;
+	std::vector<DeviceGeneric*> devices(m_dac_devices.begin(), m_dac_devices.end());
+	devices.push_back(m_m2k_fabric.get());
+
+	for (auto dev : devices) {
+		__try {
+			dev->commitTransaction();
+		} __catch (exception_type &e) {
+			if (error.empty()) {
+				error = e.what();
+			}
+		}
+	}
+
+	if (!m_m2k_fabric->isTransactionOpen()) {
+		syncDevice();
+	}
+	if (!error.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, error);
+	}
+}
+
+void M2kAnalogOutImpl::cancelConfiguration()
+{
+	bool open = m_m2k_fabric->isTransactionOpen();
+	for (auto dac : m_dac_devices) {
+		dac->cancelTransaction();
+	}
+	m_m2k_fabric->cancelTransaction();
+	if (open && !m_m2k_fabric->isTransactionOpen()) {
+		syncDevice();
+	}
+}
+
 struct IIO_OBJECTS M2kAnalogOutImpl::getIioObjects()
 {
 	auto dev_a_iio = getDacDevice(0)->getIioObjects();
@@ -596,16 +1237,23 @@ struct IIO_OBJECTS M2kAnalogOutImpl::getIioObjects()
 	return dev_a_iio;
 }
 
+struct BUFFER_STATISTICS M2kAnalogOutImpl::getBufferStatistics(unsigned int chnIdx)
+{
+	return getDacDevice(chnIdx)->getBufferStatistics();
+}
+
 void M2kAnalogOutImpl::cancelBuffer()
 {
 	for (DeviceOut *dev : m_dac_devices) {
 		dev->cancelBuffer();
 	}
+	deactivateWaveform();
 }
 
 void M2kAnalogOutImpl::cancelBuffer(unsigned int chn)
 {
 	getDacDevice(chn)->cancelBuffer();
+	deactivateWaveform(chn);
 }
 
 unsigned int M2kAnalogOutImpl::getNbChannels()
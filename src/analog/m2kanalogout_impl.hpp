@@ -4,10 +4,15 @@
 #include <libm2k/analog/m2kanalogout.hpp>
 #include "utils/devicegeneric.hpp"
 #include "utils/deviceout.hpp"
+#include "utils/synthesizer.hpp"
 #include <libm2k/enums.hpp>
 #include <vector>
 #include <memory>
 #include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 using namespace libm2k;
 using namespace libm2k::utils;
@@ -68,6 +73,29 @@ public:
 	void push(std::vector<std::vector<double>> const &data);
 	void pushRaw(std::vector<std::vector<short>> const &data);
 
+	short *acquireBuffer(unsigned int chnIdx, unsigned int nb_samples);
+	void commitBuffer(unsigned int chnIdx);
+
+	void registerWaveform(const std::string &id, std::vector<std::vector<double>> const &data);
+	void registerWaveformRaw(const std::string &id, std::vector<std::vector<short>> const &data);
+	double activateWaveform(const std::string &id);
+	void unregisterWaveform(const std::string &id);
+	std::vector<std::string> getWaveforms();
+	libm2k::analog::WAVEFORM_INFO getWaveformInfo(const std::string &id);
+
+	void startStreaming(unsigned int nb_samples, std::function<bool(const libm2k::GENERATOR_BLOCK &)> producer,
+			    bool processed = false);
+	void stopStreaming();
+	bool isStreaming();
+	libm2k::GENERATOR_STATISTICS getStreamingStatistics();
+
+	void setSynthesizer(unsigned int chnIdx, const libm2k::analog::SYNTH_SETTINGS &settings);
+	libm2k::analog::SYNTH_SETTINGS getSynthesizer(unsigned int chnIdx);
+	void synthesizeRaw(unsigned int chnIdx, short *data, unsigned int nb_samples);
+	std::vector<short> synthesizeRaw(unsigned int chnIdx, unsigned int nb_samples);
+	unsigned int pushSynthesized(unsigned int chnIdx);
+	std::vector<unsigned int> pushSynthesized();
+
 	void stop();
 	void stop(unsigned int chn);
 
@@ -80,17 +108,26 @@ public:
 	double convertRawToVolts(unsigned int channel, short raw);
 
 	struct IIO_OBJECTS getIioObjects();
+	struct BUFFER_STATISTICS getBufferStatistics(unsigned int chnIdx);
 
 	void cancelBuffer();
 	void cancelBuffer(unsigned int chn);
 
 	unsigned int getNbChannels();
 	std::string getChannelName(unsigned int channel);
+
+	void setAttributeCaching(bool enable);
+	void invalidateAttributeCache();
+
+	void beginConfiguration();
+	void commitConfiguration();
+	void cancelConfiguration();
 private:
 	std::shared_ptr<libm2k::utils::DeviceGeneric> m_m2k_fabric;
 	std::vector<double> m_calib_vlsb;
 	std::vector<bool> m_cyclic;
 	std::vector<double> m_samplerate;
+	std::vector<int> m_oversampling_ratio;
 
 	std::map<double, double> m_filter_compensation_table;
 	std::vector<libm2k::utils::DeviceOut*> m_dac_devices;
@@ -99,9 +136,45 @@ private:
 	bool m_dma_data_available;
 	std::vector<unsigned int> m_nb_kernel_buffers;
 
+	struct CachedWaveform {
+		std::vector<std::vector<short>> samples;
+		std::vector<double> calib_vlsb;
+		WAVEFORM_INFO info;
+	};
+	std::map<std::string, CachedWaveform> m_waveforms;
+	std::vector<std::string> m_active_waveform;
+	std::vector<unsigned long long> m_active_waveform_pushes;
+
+	std::thread m_stream_thread;
+	std::atomic<bool> m_stream_stop;
+	std::atomic<bool> m_stream_running;
+	std::mutex m_stream_mutex;
+	std::string m_stream_error;
+	libm2k::GENERATOR_STATISTICS m_stream_statistics;
+	std::function<bool(const libm2k::GENERATOR_BLOCK &)> m_stream_producer;
+	std::vector<unsigned int> m_stream_channels;
+
+	std::vector<std::unique_ptr<libm2k::utils::Synthesizer>> m_synthesizers;
+
 	DeviceOut* getDacDevice(unsigned int chnIdx);
 	void syncDevice();
 	double convRawToVolts(short raw, double vlsb, double filterCompensation);
+	double getRawScale(unsigned int chnIdx);
+	void pushConverted(unsigned int chnIdx, const double *data, std::ptrdiff_t step, unsigned int nb_samples);
+	void pushExtracted(unsigned int chnIdx, const short *data, std::ptrdiff_t step, unsigned int nb_samples);
+	void checkWaveformChannels(const std::string &id, std::vector<unsigned int> const &nb_samples);
+	void storeWaveform(const std::string &id, std::vector<std::vector<short>> &&samples,
+			   std::vector<double> const &calib_vlsb);
+	bool isWaveformActive(unsigned int chnIdx, const std::string &id);
+	void deactivateWaveform(int chn = -1);
+	void checkStreamingStopped(const std::string &operation);
+	void joinStreaming();
+	void streamingThread(unsigned int nb_samples, bool processed,
+			     std::vector<double> rates, std::vector<double> raw_scale);
+	bool readStreamingOccupancy(unsigned int nb_samples, std::vector<double> const &rates);
+	void pushBuffers(std::vector<unsigned int> const &channels, std::vector<unsigned int> const &nb_samples,
+			 std::function<void(unsigned int, short*)> fill);
+	libm2k::utils::Synthesizer *getConfiguredSynthesizer(unsigned int chnIdx);
 };
 }
 }
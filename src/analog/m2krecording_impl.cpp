@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "analog/m2krecording_impl.hpp"
+#include "utils/conversion.hpp"
+#include <libm2k/m2kexceptions.hpp>
+#include <cstring>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::utils;
+
+static const char RECORDING_MAGIC[8] = {'L', 'M', '2', 'K', 'R', 'A', 'W', '\0'};
+static const uint32_t RECORDING_VERSION = 2;
+
+static_assert(sizeof(RECORDING_FILE_HEADER) == 72, "Unexpected recording header layout");
+static_assert(sizeof(RECORDING_FILE_CHANNEL) == 64, "Unexpected recording channel layout");
+
+
+RecordingWriter::RecordingWriter(const std::string &path, const RECORDING_INFO &info) :
+	m_file(nullptr),
+	m_info(info)
+{
+	m_info.nb_samples = 0;
+	m_info.dropped_blocks = 0;
+	m_file = std::fopen(path.c_str(), "wb");
+	if (!m_file) {
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not create " + path);
+		return;
+	}
+	writeHeader();
+}
+
+RecordingWriter::~RecordingWriter()
+{
+	if (m_file) {
+		std::fclose(m_file);
+	}
+}
+
+void RecordingWriter::writeHeader()
+{
+	RECORDING_FILE_HEADER header = {};
+	memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+	header.version = RECORDING_VERSION;
+	header.nb_channels = m_info.nb_channels;
+	header.data_offset = sizeof(RECORDING_FILE_HEADER) + m_info.nb_channels * sizeof(RECORDING_FILE_CHANNEL);
+	header.nb_samples = m_info.nb_samples;
+	header.dropped_blocks = m_info.dropped_blocks;
+	header.sample_rate = m_info.sample_rate;
+	header.oversampling_ratio = m_info.oversampling_ratio;
+	header.trigger_source = m_info.trigger_source;
+	header.trigger_delay = m_info.trigger_delay;
+	header.decimation_mode = m_info.decimation_mode;
+	header.decimation_factor = m_info.decimation_factor;
+	header.decimation_order = m_info.decimation_order;
+
+	bool written = (std::fwrite(&header, sizeof(header), 1, m_file) == 1);
+	for (unsigned int i = 0; i < m_info.nb_channels && written; i++) {
+		RECORDING_FILE_CHANNEL channel = {};
+		channel.calib_gain = m_info.calib_gains.at(i);
+		channel.vertical_offset = m_info.vertical_offsets.at(i);
+		channel.scale = m_info.scales.at(i);
+		channel.offset = m_info.offsets.at(i);
+		channel.trigger_hysteresis = m_info.trigger_hysteresis.at(i);
+		channel.range = m_info.ranges.at(i);
+		channel.calib_offset = m_info.calib_offsets.at(i);
+		channel.trigger_mode = m_info.trigger_modes.at(i);
+		channel.trigger_condition = m_info.trigger_conditions.at(i);
+		channel.trigger_level = m_info.trigger_levels.at(i);
+		written = (std::fwrite(&channel, sizeof(channel), 1, m_file) == 1);
+	}
+	if (!written) {
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not write the header");
+	}
+}
+
+void RecordingWriter::write(const short *samples, unsigned int nb_samples)
+{
+	if (!m_file) {
+		throw_exception(EXC_INVALID_PARAMETER, "Recording: The file is closed");
+		return;
+	}
+	size_t count = (size_t)nb_samples * m_info.nb_channels;
+	if (std::fwrite(samples, sizeof(short), count, m_file) != count) {
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not write the samples");
+		return;
+	}
+	m_info.nb_samples += nb_samples;
+}
+
+void RecordingWriter::close(unsigned long long dropped_blocks)
+{
+	if (!m_file) {
+		return;
+	}
+	m_info.dropped_blocks = dropped_blocks;
+	std::FILE *file = m_file;
+	bool rewound = (std::fseek(file, 0, SEEK_SET) == 0);
+	__try {
+		if (rewound) {
+			writeHeader();
+		}
+	} __catch (exception_type &e) {
+		rewound = false;
+	}
+	bool closed = (std::fclose(file) == 0);
+	m_file = nullptr;
+	if (!rewound || !closed) {
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not complete the file");
+	}
+}
+
+unsigned long long RecordingWriter::getNbSamples() const
+{
+	return m_info.nb_samples;
+}
+
+
+/*
+ * The whole file is mapped read-only; samples are only touched when a view or a
+ * conversion asks for them. The number of samples is derived from the file size,
+ * so a recording that was not closed properly can still be read
+ */
+M2kRecordingImpl::M2kRecordingImpl(const std::string &path) :
+	m_map(nullptr),
+	m_map_size(0),
+	m_samples(nullptr)
+{
+#ifdef _WIN32
+	m_mapping = nullptr;
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			     FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		m_file = nullptr;
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not open " + path);
+		return;
+	}
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(m_file, &size)) {
+		m_map_size = size.QuadPart;
+	}
+	if (m_map_size >= sizeof(RECORDING_FILE_HEADER)) {
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping) {
+			m_map = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+	}
+#else
+	m_fd = open(path.c_str(), O_RDONLY);
+	if (m_fd < 0) {
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not open " + path);
+		return;
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) == 0) {
+		m_map_size = st.st_size;
+	}
+	if (m_map_size >= sizeof(RECORDING_FILE_HEADER)) {
+		void *map = mmap(nullptr, m_map_size, PROT_READ, MAP_SHARED, m_fd, 0);
+		if (map != MAP_FAILED) {
+			m_map = static_cast<const char*>(map);
+		}
+	}
+#endif
+	if (!m_map) {
+		unmap();
+		throw_exception(EXC_RUNTIME_ERROR, "Recording: Can not map " + path);
+		return;
+	}
+
+	RECORDING_FILE_HEADER header;
+	memcpy(&header, m_map, sizeof(header));
+	if (memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0 ||
+			header.version != RECORDING_VERSION || header.nb_channels == 0 ||
+			header.data_offset != sizeof(header) + header.nb_channels * sizeof(RECORDING_FILE_CHANNEL) ||
+			header.data_offset > m_map_size) {
+		unmap();
+		throw_exception(EXC_INVALID_PARAMETER, "Recording: " + path + " is not a raw recording");
+		return;
+	}
+
+	m_info.sample_rate = header.sample_rate;
+	m_info.oversampling_ratio = header.oversampling_ratio;
+	m_info.nb_channels = header.nb_channels;
+	m_info.nb_samples = (m_map_size - header.data_offset) / (header.nb_channels * sizeof(short));
+	m_info.dropped_blocks = header.dropped_blocks;
+	m_info.trigger_source = static_cast<M2K_TRIGGER_SOURCE_ANALOG>(header.trigger_source);
+	m_info.trigger_delay = header.trigger_delay;
+	m_info.decimation_mode = static_cast<M2K_DECIMATION_MODE>(header.decimation_mode);
+	m_info.decimation_factor = header.decimation_factor;
+	m_info.decimation_order = header.decimation_order;
+	for (unsigned int i = 0; i < header.nb_channels; i++) {
+		RECORDING_FILE_CHANNEL channel;
+		memcpy(&channel, m_map + sizeof(header) + i * sizeof(channel), sizeof(channel));
+		m_info.ranges.push_back(static_cast<M2K_RANGE>(channel.range));
+		m_info.calib_gains.push_back(channel.calib_gain);
+		m_info.calib_offsets.push_back(channel.calib_offset);
+		m_info.vertical_offsets.push_back(channel.vertical_offset);
+		m_info.scales.push_back(channel.scale);
+		m_info.offsets.push_back(channel.offset);
+		m_info.trigger_modes.push_back(static_cast<M2K_TRIGGER_MODE>(channel.trigger_mode));
+		m_info.trigger_conditions.push_back(static_cast<M2K_TRIGGER_CONDITION_ANALOG>(channel.trigger_condition));
+		m_info.trigger_levels.push_back(channel.trigger_level);
+		m_info.trigger_hysteresis.push_back(channel.trigger_hysteresis);
+	}
+	m_samples = reinterpret_cast<const short*>(m_map + header.data_offset);
+}
+
+M2kRecordingImpl::~M2kRecordingImpl()
+{
+	unmap();
+}
+
+void M2kRecordingImpl::unmap()
+{
+#ifdef _WIN32
+	if (m_map) {
+		UnmapViewOfFile(m_map);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file) {
+		CloseHandle(m_file);
+	}
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_map) {
+		munmap(const_cast<char*>(m_map), m_map_size);
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+	}
+	m_fd = -1;
+#endif
+	m_map = nullptr;
+	m_samples = nullptr;
+}
+
+RECORDING_INFO M2kRecordingImpl::getInfo()
+{
+	return m_info;
+}
+
+unsigned int M2kRecordingImpl::getNbChannels()
+{
+	return m_info.nb_channels;
+}
+
+unsigned long long M2kRecordingImpl::getNbSamples()
+{
+	return m_info.nb_samples;
+}
+
+libm2k::SAMPLE_VIEW<short> M2kRecordingImpl::getSamplesView(unsigned int channel, unsigned long long first,
+							    unsigned int nb_samples)
+{
+	if (channel >= m_info.nb_channels) {
+		throw_exception(EXC_OUT_OF_RANGE, "Recording: No such channel");
+	}
+	if (first > m_info.nb_samples || nb_samples > m_info.nb_samples - first) {
+		throw_exception(EXC_OUT_OF_RANGE, "Recording: The requested samples are outside the recording");
+	}
+	libm2k::SAMPLE_VIEW<short> view = {m_samples + first * m_info.nb_channels + channel,
+					   m_info.nb_channels, nb_samples};
+	return view;
+}
+
+std::vector<short> M2kRecordingImpl::getSamplesRaw(unsigned int channel, unsigned long long first,
+						   unsigned int nb_samples)
+{
+	auto view = getSamplesView(channel, first, nb_samples);
+	std::vector<short> data(nb_samples);
+	Conversion::extract(view.data, view.step, nb_samples, data.data());
+	return data;
+}
+
+std::vector<double> M2kRecordingImpl::getSamples(unsigned int channel, unsigned long long first,
+						 unsigned int nb_samples)
+{
+	auto view = getSamplesView(channel, first, nb_samples);
+	CHANNEL_COEFFICIENTS coefficients = {m_info.scales.at(channel), m_info.offsets.at(channel)};
+	std::vector<double> data(nb_samples);
+	Conversion::rawToScaled(view.data, view.step, nb_samples, coefficients, data.data());
+	return data;
+}
+
+
+M2kRecording *libm2k::analog::openRecording(const std::string &path)
+{
+	return new M2kRecordingImpl(path);
+}
+
+void libm2k::analog::closeRecording(M2kRecording *recording)
+{
+	delete recording;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef M2KRECORDING_IMPL_HPP
+#define M2KRECORDING_IMPL_HPP
+
+#include <libm2k/analog/m2krecording.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace libm2k {
+namespace analog {
+
+/*
+ * Layout of a raw recording, little-endian:
+ *   RECORDING_FILE_HEADER
+ *   RECORDING_FILE_CHANNEL, nb_channels times
+ *   int16 samples of all the channels, interleaved, from data_offset to the end of the file
+ */
+struct RECORDING_FILE_HEADER {
+	char magic[8];
+	uint32_t version;
+	uint32_t nb_channels;
+	uint64_t data_offset;
+	uint64_t nb_samples;
+	uint64_t dropped_blocks;
+	double sample_rate;
+	int32_t oversampling_ratio;
+	int32_t trigger_source;
+	int32_t trigger_delay;
+	int32_t decimation_mode;
+	uint32_t decimation_factor;
+	uint32_t decimation_order;
+};
+
+struct RECORDING_FILE_CHANNEL {
+	double calib_gain;
+	double vertical_offset;
+	double scale;
+	double offset;
+	double trigger_hysteresis;
+	int32_t range;
+	int32_t calib_offset;
+	int32_t trigger_mode;
+	int32_t trigger_condition;
+	int32_t trigger_level;
+	int32_t reserved;
+};
+
+/* Writes a recording; the header is completed when the writer is closed */
+class RecordingWriter
+{
+public:
+	RecordingWriter(const std::string &path, const RECORDING_INFO &info);
+	~RecordingWriter();
+
+	/* Interleaved raw samples of all the channels; nb_samples per channel */
+	void write(const short *samples, unsigned int nb_samples);
+	void close(unsigned long long dropped_blocks);
+	unsigned long long getNbSamples() const;
+
+private:
+	std::FILE *m_file;
+	RECORDING_INFO m_info;
+
+	void writeHeader();
+};
+
+class M2kRecordingImpl : public M2kRecording
+{
+public:
+	M2kRecordingImpl(const std::string &path);
+	~M2kRecordingImpl() override;
+
+	RECORDING_INFO getInfo() override;
+	unsigned int getNbChannels() override;
+	unsigned long long getNbSamples() override;
+
+	libm2k::SAMPLE_VIEW<short> getSamplesView(unsigned int channel, unsigned long long first,
+						  unsigned int nb_samples) override;
+	std::vector<short> getSamplesRaw(unsigned int channel, unsigned long long first,
+					 unsigned int nb_samples) override;
+	std::vector<double> getSamples(unsigned int channel, unsigned long long first,
+				       unsigned int nb_samples) override;
+
+private:
+	RECORDING_INFO m_info;
+	const char *m_map;
+	size_t m_map_size;
+	const short *m_samples;
+#ifdef _WIN32
+	void *m_file;
+	void *m_mapping;
+#else
+	int m_fd;
+#endif
+
+	void unmap();
+};
+}
+}
+
+#endif //M2KRECORDING_IMPL_HPP
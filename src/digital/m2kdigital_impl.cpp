@@ -131,13 +131,21 @@ void M2kDigitalImpl::setDirection(unsigned short mask)
 	DIO_DIRECTION direction;
 	bool dir = false;
 	unsigned int index = 0;
-	while (mask != 0 || index < m_dev_write->getNbChannels(true)) {
-		dir = mask & 1;
-		mask >>= 1;
-		direction = static_cast<DIO_DIRECTION>(dir);
-		setDirection(index, direction);
-		index++;
+
+	beginConfiguration();
+	__try {
+		while (mask != 0 || index < m_dev_write->getNbChannels(true)) {
+			dir = mask & 1;
+			mask >>= 1;
+			direction = static_cast<DIO_DIRECTION>(dir);
+			setDirection(index, direction);
+			index++;
+		}
+	} __catch (exception_type &e) {
+		cancelConfiguration();
+		throw_exception(EXC_OUT_OF_RANGE, e.what());
 	}
+	commitConfiguration();
 }
 
 void M2kDigitalImpl::setDirection(DIO_CHANNEL index, bool dir)
@@ -241,6 +249,19 @@ void M2kDigitalImpl::push(unsigned short *data, unsigned int nb_samples)
 	m_dev_write->push(data, 0, nb_samples, getCyclic(), true);
 }
 
+unsigned short *M2kDigitalImpl::acquireBuffer(unsigned int nb_samples)
+{
+	if (!anyChannelEnabled(DIO_OUTPUT)) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2kDigital: No TX channel enabled.");
+	}
+	return static_cast<unsigned short*>(m_dev_write->acquireBuffer(nb_samples, getCyclic()));
+}
+
+void M2kDigitalImpl::commitBuffer()
+{
+	m_dev_write->commitBuffer();
+}
+
 void M2kDigitalImpl::stopBufferOut()
 {
 	m_dev_write->stop();
@@ -296,6 +317,58 @@ const unsigned short* M2kDigitalImpl::getSamplesP(unsigned int nb_samples)
 	}
 }
 
+libm2k::SAMPLE_VIEW<unsigned short> M2kDigitalImpl::getSamplesView(unsigned int nb_samples)
+{
+	__try {
+		if (!anyChannelEnabled(DIO_INPUT)) {
+			throw_exception(EXC_INVALID_PARAMETER, "M2kDigital: No RX channel enabled.");
+		}
+
+		/* There is a restriction in the HDL that the buffer size must
+		 * be a multiple of 8 bytes (4x 16-bit samples). Round up to the
+		 * nearest multiple.*/
+		nb_samples = ((nb_samples + 3) / 4) * 4;
+		return m_dev_read->getSamplesViewShort(nb_samples);
+
+	} __catch (exception_type &e) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2K Digital: " + string(e.what()));
+		return libm2k::SAMPLE_VIEW<unsigned short>{nullptr, 0, 0};
+	}
+}
+
+void M2kDigitalImpl::startStreaming(unsigned int nb_samples, unsigned int queue_depth)
+{
+	__try {
+		if (!anyChannelEnabled(DIO_INPUT)) {
+			throw_exception(EXC_INVALID_PARAMETER, "M2kDigital: No RX channel enabled.");
+		}
+
+		/* There is a restriction in the HDL that the buffer size must
+		 * be a multiple of 8 bytes (4x 16-bit samples). Round up to the
+		 * nearest multiple.*/
+		nb_samples = ((nb_samples + 3) / 4) * 4;
+		m_dev_read->startStreaming(nb_samples, queue_depth);
+
+	} __catch (exception_type &e) {
+		throw_exception(EXC_INVALID_PARAMETER, "M2K Digital: " + string(e.what()));
+	}
+}
+
+void M2kDigitalImpl::stopStreaming()
+{
+	m_dev_read->stopStreaming();
+}
+
+const unsigned short *M2kDigitalImpl::popStreamingBlock(unsigned int timeout_ms)
+{
+	return reinterpret_cast<const unsigned short*>(m_dev_read->popStreamingBlock(timeout_ms));
+}
+
+libm2k::STREAMING_STATISTICS M2kDigitalImpl::getStreamingStatistics()
+{
+	return m_dev_read->getStreamingStatistics();
+}
+
 void M2kDigitalImpl::enableChannel(unsigned int index, bool enable)
 {
 	if (index < m_dev_write->getNbChannels(true)) {
@@ -410,6 +483,54 @@ void M2kDigitalImpl::setCyclic(bool cyclic)
 	m_dev_write->setCyclic(cyclic);
 }
 
+void M2kDigitalImpl::setAttributeCaching(bool enable)
+{
+	m_dev_read->setAttributeCaching(enable);
+	m_dev_write->setAttributeCaching(enable);
+	m_dev_generic->setAttributeCaching(enable);
+}
+
+void M2kDigitalImpl::invalidateAttributeCache()
+{
+	m_dev_read->invalidateAttributeCache();
+	m_dev_write->invalidateAttributeCache();
+	m_dev_generic->invalidateAttributeCache();
+}
+
+void M2kDigitalImpl::beginConfiguration()
+{
+	m_dev_read->beginTransaction();
+	m_dev_write->beginTransaction();
+	m_dev_generic->beginTransaction();
+}
+
+/* Every device is committed even if an earlier one fails, so none is left in a transaction */
+void M2kDigitalImpl::commitConfiguration()
+{
+	std::string error;
+	std::vector<DeviceGeneric*> devices = {m_dev_read.get(), m_dev_write.get(), m_dev_generic.get()};
+
+	for (auto dev : devices) {
+		__try {
+			dev->commitTransaction();
+		} __catch (exception_type &e) {
+			if (error.empty()) {
+				error = e.what();
+			}
+		}
+	}
+	if (!error.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, error);
+	}
+}
+
+void M2kDigitalImpl::cancelConfiguration()
+{
+	m_dev_read->cancelTransaction();
+	m_dev_write->cancelTransaction();
+	m_dev_generic->cancelTransaction();
+}
+
 struct IIO_OBJECTS M2kDigitalImpl::getIioObjects()
 {
 	auto tx_iio = m_dev_write->getIioObjects();
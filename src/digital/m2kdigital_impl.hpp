@@ -52,6 +52,8 @@ public:
 
 	void push(std::vector<unsigned short> const &data);
 	void push(unsigned short *data, unsigned int nb_samples);
+	unsigned short *acquireBuffer(unsigned int nb_samples);
+	void commitBuffer();
 
 	void setValueRaw(DIO_CHANNEL index, DIO_LEVEL level);
 	void setValueRaw(unsigned int index, DIO_LEVEL level);
@@ -65,6 +67,12 @@ public:
 
 	std::vector<unsigned short> getSamples(unsigned int nb_samples);
 	const unsigned short *getSamplesP(unsigned int nb_samples);
+	libm2k::SAMPLE_VIEW<unsigned short> getSamplesView(unsigned int nb_samples);
+
+	void startStreaming(unsigned int nb_samples, unsigned int queue_depth = 8);
+	void stopStreaming();
+	const unsigned short *popStreamingBlock(unsigned int timeout_ms = 1000);
+	libm2k::STREAMING_STATISTICS getStreamingStatistics();
 
 	void enableChannel(unsigned int index, bool enable);
 	void enableChannel(DIO_CHANNEL index, bool enable);
@@ -98,6 +106,13 @@ public:
 	unsigned int getNbChannelsOut();
 
 	void getSamples(std::vector<unsigned short> &data, unsigned int nb_samples);
+
+	void setAttributeCaching(bool enable);
+	void invalidateAttributeCache();
+
+	void beginConfiguration();
+	void commitConfiguration();
+	void cancelConfiguration();
 private:
 	bool m_cyclic;
 	std::shared_ptr<libm2k::utils::DeviceIn> m_dev_read;
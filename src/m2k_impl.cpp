@@ -113,6 +113,7 @@ M2kImpl::~M2kImpl()
 	// The correct fix would be adding a separate caliboffset register in the firmware
 	// which will clear up the confusion
 
+	getAnalogIn()->stopSession();
 	getAnalogIn()->setVerticalOffset(ANALOG_IN_CHANNEL_1,0);
 	getAnalogIn()->setVerticalOffset(ANALOG_IN_CHANNEL_2,0);
 
@@ -400,3 +401,29 @@ bool M2kImpl::getLed()
 	}
 	return on;
 }
+
+void M2kImpl::setAttributeCaching(bool enable)
+{
+	for (auto ain : m_instancesAnalogIn) {
+		ain->setAttributeCaching(enable);
+	}
+	for (auto aout : m_instancesAnalogOut) {
+		aout->setAttributeCaching(enable);
+	}
+	for (auto d : m_instancesDigital) {
+		d->setAttributeCaching(enable);
+	}
+}
+
+void M2kImpl::invalidateAttributeCache()
+{
+	for (auto ain : m_instancesAnalogIn) {
+		ain->invalidateAttributeCache();
+	}
+	for (auto aout : m_instancesAnalogOut) {
+		aout->invalidateAttributeCache();
+	}
+	for (auto d : m_instancesDigital) {
+		d->invalidateAttributeCache();
+	}
+}
@@ -70,6 +70,9 @@ public:
 	void setLed(bool on);
 	bool getLed();
 
+	void setAttributeCaching(bool enable);
+	void invalidateAttributeCache();
+
 private:
 	M2kCalibration* m_calibration;
 	libm2k::M2kHardwareTrigger *m_trigger;
@@ -340,14 +340,14 @@ void M2kCalibrationImpl::setAdcOffset(unsigned int chn, int offset)
 		throw_exception(EXC_OUT_OF_RANGE, "No such ADC channel");
 	}
 
+	/* The values are kept once the ADC accepted them; it refuses them during a session */
+	m_m2k_adc->setAdcCalibOffset(static_cast<ANALOG_IN_CHANNEL>(chn), offset, 0);
 	if (chn == 0) {
 		m_adc_ch0_offset = offset;
 		m_adc_ch0_vert_offset = 0;
-		m_m2k_adc->setAdcCalibOffset(static_cast<ANALOG_IN_CHANNEL>(0), m_adc_ch0_offset, m_adc_ch0_vert_offset);
 	} else {
 		m_adc_ch1_offset = offset;
 		m_adc_ch1_vert_offset = 0;
-		m_m2k_adc->setAdcCalibOffset(static_cast<ANALOG_IN_CHANNEL>(1), m_adc_ch1_offset, m_adc_ch1_vert_offset);
 	}
 }
 
@@ -358,12 +358,11 @@ void M2kCalibrationImpl::setAdcGain(unsigned int chn, double gain)
 		throw_exception(EXC_OUT_OF_RANGE, "No such ADC channel");
 	}
 
+	m_m2k_adc->setCalibscale(chn, gain);
 	if (chn == 0) {
 		m_adc_ch0_gain = gain;
-		m_m2k_adc->setCalibscale(ANALOG_IN_CHANNEL_1, m_adc_ch0_gain);
 	} else {
 		m_adc_ch1_gain = gain;
-		m_m2k_adc->setCalibscale(ANALOG_IN_CHANNEL_2, m_adc_ch1_gain);
 	}
 }
 
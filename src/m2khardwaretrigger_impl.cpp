@@ -558,14 +558,18 @@ void M2kHardwareTriggerImpl::setHwTriggerSettings(struct SETTINGS *settings)
 {
 	for (unsigned int i = 0; i < m_num_channels; i++) {
 		setAnalogCondition(i, settings->analog_condition[i]);
-		setDigitalExternalCondition(settings->digital_condition[i]);
 		setAnalogLevel(i, settings->level[i]);
 		setAnalogLevelRaw(i, settings->raw_level[i]);
 		setAnalogHysteresis(i, settings->hysteresis[i]);
 		setAnalogMode(i, settings->mode[i]);
-		setAnalogSource(settings->trigger_source);
-		setAnalogDelay(settings->delay);
 	}
+
+	/* Global settings; the per channel loop used to write them once per channel, the last write winning */
+	if (m_num_channels > 0) {
+		setDigitalExternalCondition(settings->digital_condition[m_num_channels - 1]);
+	}
+	setAnalogSource(settings->trigger_source);
+	setAnalogDelay(settings->delay);
 }
 
 void M2kHardwareTriggerImpl::setCalibParameters(unsigned int chnIdx, double scaling, double offset)
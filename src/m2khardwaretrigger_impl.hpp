@@ -90,7 +90,7 @@ public:
 
 	static std::vector<std::string> getAvailableDigitalConditions();
 
-	void setCalibParameters(unsigned int chnIdx, double scaling, double vert_offset);
+	void setCalibParameters(unsigned int chnIdx, double scaling, double offset);
 
 	M2K_TRIGGER_CONDITION_DIGITAL getAnalogExternalCondition(unsigned int chnIdx);
 	void setAnalogExternalCondition(unsigned int chnIdx, M2K_TRIGGER_CONDITION_DIGITAL cond);
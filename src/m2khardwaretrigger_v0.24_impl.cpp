@@ -232,12 +232,15 @@ void M2kHardwareTriggerV024Impl::setHwTriggerSettings(struct SETTINGS *settings)
 {
 	for (unsigned int i = 0; i < m_num_channels; i++) {
 		setAnalogCondition(i, settings->analog_condition[i]);
-		setDigitalExternalCondition(settings->digital_condition[i]);
 		setAnalogLevel(i, settings->level[i]);
 		setAnalogLevelRaw(i, settings->raw_level[i]);
 		setAnalogHysteresis(i, settings->hysteresis[i]);
 		setAnalogMode(i, settings->mode[i]);
-		setAnalogSource(settings->trigger_source);
-		setAnalogDelay(settings->delay);
 	}
+
+	if (m_num_channels > 0) {
+		setDigitalExternalCondition(settings->digital_condition[m_num_channels - 1]);
+	}
+	setAnalogSource(settings->trigger_source);
+	setAnalogDelay(settings->delay);
 }
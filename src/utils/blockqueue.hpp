@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BLOCKQUEUE_HPP
+#define BLOCKQUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+namespace libm2k {
+namespace utils {
+
+/**
+ * Bounded single-producer/single-consumer ring of fixed size blocks.
+ * All the blocks are allocated when the queue is created; the producer writes
+ * straight into a free slot and publishes it, the consumer reads the oldest
+ * published slot in place and releases it when it is done with it.
+ * Only one thread may produce and only one thread may consume at a time.
+ */
+template <typename T>
+class BlockQueue
+{
+public:
+	BlockQueue(unsigned int capacity, size_t block_size) :
+		m_slots(capacity + 1, std::vector<T>(block_size)),
+		m_block_size(block_size),
+		m_head(0),
+		m_tail(0)
+	{
+	}
+
+	/* Producer: free slot to write into, or nullptr if the queue is full */
+	T *beginWrite()
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (next(tail) == m_head.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return m_slots[tail].data();
+	}
+
+	/* Producer: publish the slot returned by beginWrite */
+	void endWrite()
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		m_tail.store(next(tail), std::memory_order_release);
+	}
+
+	/* Consumer: oldest published block, or nullptr if the queue is empty */
+	const T *front() const
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return m_slots[head].data();
+	}
+
+	/* Consumer: give the block returned by front back to the producer */
+	void pop()
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		m_head.store(next(head), std::memory_order_release);
+	}
+
+	bool empty() const
+	{
+		return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+	}
+
+	unsigned int size() const
+	{
+		unsigned int head = m_head.load(std::memory_order_acquire);
+		unsigned int tail = m_tail.load(std::memory_order_acquire);
+		return (tail + m_slots.size() - head) % m_slots.size();
+	}
+
+	unsigned int capacity() const
+	{
+		return m_slots.size() - 1;
+	}
+
+	size_t blockSize() const
+	{
+		return m_block_size;
+	}
+
+	/* Slot of the block returned by beginWrite / front; per-block metadata can be kept
+	 * in a parallel array of slots() entries */
+	unsigned int writeSlot() const
+	{
+		return m_tail.load(std::memory_order_relaxed);
+	}
+
+	unsigned int readSlot() const
+	{
+		return m_head.load(std::memory_order_relaxed);
+	}
+
+	unsigned int slots() const
+	{
+		return m_slots.size();
+	}
+
+private:
+	std::vector<std::vector<T>> m_slots;
+	size_t m_block_size;
+	std::atomic<unsigned int> m_head;
+	std::atomic<unsigned int> m_tail;
+
+	unsigned int next(unsigned int idx) const
+	{
+		return (idx + 1) % m_slots.size();
+	}
+};
+}
+}
+
+#endif //BLOCKQUEUE_HPP
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <memory>
 #include <algorithm>
+#include <chrono>
 
 using namespace std;
 using namespace libm2k::utils;
@@ -45,12 +46,16 @@ Buffer::Buffer(struct iio_device *dev) {
 	}
 	m_buffer = nullptr;
 	m_last_nb_samples = 0;
+	m_last_cyclic = false;
+	m_pushed = false;
+	m_acquired = false;
+	m_acquire_duration = 0;
+	m_statistics = {};
 }
 
 Buffer::~Buffer() {
 	stop();
 	destroy();
-	m_data.clear();
 	m_data_short.clear();
 }
 
@@ -60,12 +65,66 @@ void Buffer::initializeBuffer(unsigned int size, bool cyclic)
 		* data transferring; the buffer must be destroy when its size is changed
 		*
 		* In cyclic mode the very first buffer pushed will be repeated; in order to push any other buffer the
-		* old buffer must be destroyed and a new one must be created*/
-	if (size != m_last_nb_samples || cyclic) {
+		* old buffer must be destroyed and a new one must be created
+		*
+		* libiio allows a single buffer per device, so the existing buffer is kept whenever it can serve
+		* the request: same size and same mode, and, for cyclic buffers, not pushed yet */
+	if (size == 0) {
 		destroy();
-		m_last_nb_samples = size;
+		return;
+	}
+
+	bool reusable = m_buffer && (size == m_last_nb_samples) &&
+			(cyclic == m_last_cyclic) && !(cyclic && m_pushed);
+	if (reusable) {
+		m_statistics.buffers_reused++;
+		return;
+	}
+
+	destroy();
+	m_last_nb_samples = size;
+	m_last_cyclic = cyclic;
+	m_pushed = false;
+	{
+		std::lock_guard<std::mutex> lock(m_buffer_lock);
 		m_buffer = iio_device_create_buffer(m_dev, size, cyclic);
 	}
+	if (m_buffer) {
+		m_statistics.buffers_created++;
+	}
+}
+
+/*
+ * Push the TX buffer and account for the time spent since the start of the push request
+ */
+void Buffer::pushBuffer(double setup_duration)
+{
+	auto start = std::chrono::steady_clock::now();
+	ssize_t ret = iio_buffer_push(m_buffer);
+	if (ret < 0) {
+		destroy();
+		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
+		return;
+	}
+	m_pushed = true;
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	double latency = setup_duration + elapsed.count();
+	m_statistics.nb_pushes++;
+	m_statistics.last_push_latency = latency;
+	m_statistics.total_push_latency += latency;
+	m_statistics.max_push_latency = std::max(m_statistics.max_push_latency, latency);
+}
+
+libm2k::BUFFER_STATISTICS Buffer::getStatistics()
+{
+	return m_statistics;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
 }
 
 void Buffer::setChannels(std::vector<Channel*> channels)
@@ -80,6 +139,7 @@ void Buffer::setChannels(std::vector<Channel*> channels)
 void Buffer::push(unsigned short *data, unsigned int channel, unsigned int nb_samples,
 	  bool cyclic, bool multiplex)
 {
+	auto start = std::chrono::steady_clock::now();
 	if (Utils::getIioDeviceDirection(m_dev) != OUTPUT) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
 	}
@@ -110,11 +170,7 @@ void Buffer::push(unsigned short *data, unsigned int channel, unsigned int nb_sa
 			}
 
 		}
-		ssize_t ret = iio_buffer_push(m_buffer);
-		if (ret < 0) {
-			destroy();
-			throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
-		}
+		pushBuffer(secondsSince(start));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
 
@@ -125,6 +181,7 @@ void Buffer::push(unsigned short *data, unsigned int channel, unsigned int nb_sa
 void Buffer::push(std::vector<short> const &data, unsigned int channel,
 	  bool cyclic, bool multiplex)
 {
+	auto start = std::chrono::steady_clock::now();
 	size_t size = data.size();
 	if (Utils::getIioDeviceDirection(m_dev) != OUTPUT) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
@@ -156,11 +213,7 @@ void Buffer::push(std::vector<short> const &data, unsigned int channel,
 			}
 
 		}
-		ssize_t ret = iio_buffer_push(m_buffer);
-		if (ret < 0) {
-			destroy();
-			throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
-		}
+		pushBuffer(secondsSince(start));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
 
@@ -170,6 +223,7 @@ void Buffer::push(std::vector<short> const &data, unsigned int channel,
 void Buffer::push(std::vector<unsigned short> const &data, unsigned int channel,
 	  bool cyclic, bool multiplex)
 {
+	auto start = std::chrono::steady_clock::now();
 	size_t size = data.size();
 	if (Utils::getIioDeviceDirection(m_dev) != OUTPUT) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
@@ -201,11 +255,7 @@ void Buffer::push(std::vector<unsigned short> const &data, unsigned int channel,
 			}
 
 		}
-		ssize_t ret = iio_buffer_push(m_buffer);
-		if (ret < 0) {
-			destroy();
-			throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
-		}
+		pushBuffer(secondsSince(start));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
 
@@ -214,6 +264,7 @@ void Buffer::push(std::vector<unsigned short> const &data, unsigned int channel,
 
 void Buffer::push(std::vector<double> const &data, unsigned int channel, bool cyclic)
 {
+	auto start = std::chrono::steady_clock::now();
 	size_t size = data.size();
 	if (Utils::getIioDeviceDirection(m_dev) == INPUT) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
@@ -234,11 +285,7 @@ void Buffer::push(std::vector<double> const &data, unsigned int channel, bool cy
 
 	if (channel < m_channel_list.size() ) {
 		m_channel_list.at(channel)->write(m_buffer, data);
-		ssize_t ret = iio_buffer_push(m_buffer);
-		if (ret < 0) {
-			destroy();
-			throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
-		}
+		pushBuffer(secondsSince(start));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
 	}
@@ -259,6 +306,7 @@ void Buffer::push(std::vector<std::vector<short>> const &data)
 
 void Buffer::push(double *data, unsigned int channel, unsigned int nb_samples, bool cyclic)
 {
+	auto start = std::chrono::steady_clock::now();
 	if (Utils::getIioDeviceDirection(m_dev) == INPUT) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
 	}
@@ -279,11 +327,7 @@ void Buffer::push(double *data, unsigned int channel, unsigned int nb_samples, b
 
 	if (channel < m_channel_list.size() ) {
 		m_channel_list.at(channel)->write(m_buffer, data, nb_samples);
-		ssize_t ret = iio_buffer_push(m_buffer);
-		if (ret < 0) {
-			destroy();
-			throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
-		}
+		pushBuffer(secondsSince(start));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
 	}
@@ -291,6 +335,7 @@ void Buffer::push(double *data, unsigned int channel, unsigned int nb_samples, b
 
 void Buffer::push(short *data, unsigned int channel, unsigned int nb_samples, bool cyclic)
 {
+	auto start = std::chrono::steady_clock::now();
 	if (Utils::getIioDeviceDirection(m_dev) == INPUT) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
 	}
@@ -310,16 +355,58 @@ void Buffer::push(short *data, unsigned int channel, unsigned int nb_samples, bo
 
 	if (channel < m_channel_list.size() ) {
 		m_channel_list.at(channel)->write(m_buffer, data, nb_samples);
-		ssize_t ret = iio_buffer_push(m_buffer);
-		if (ret < 0) {
-			destroy();
-			throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot push TX buffer");
-		}
+		pushBuffer(secondsSince(start));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
 	}
 }
 
+/*
+ * Hand out the memory of the next TX buffer, so the samples can be generated in place
+ * instead of being copied from a user container. The samples of the enabled channels
+ * are interleaved, starting at the returned address. Nothing is sent until commitBuffer.
+ */
+void *Buffer::acquireBuffer(unsigned int nb_samples, bool cyclic)
+{
+	if (Utils::getIioDeviceDirection(m_dev) != OUTPUT) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device not output buffer capable, so no buffer was created");
+		return nullptr;
+	}
+
+	if (nb_samples == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Cannot acquire an empty TX buffer");
+		return nullptr;
+	}
+
+	if (m_channel_list.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Please setup channels before pushing data");
+		return nullptr;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	initializeBuffer(nb_samples, cyclic);
+
+	if (!m_buffer) {
+		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Can't create the TX buffer");
+		return nullptr;
+	}
+
+	m_acquired = true;
+	m_acquire_duration = secondsSince(start);
+	return iio_buffer_start(m_buffer);
+}
+
+void Buffer::commitBuffer()
+{
+	if (!m_acquired || !m_buffer) {
+		throw_exception(EXC_INVALID_PARAMETER, "Buffer: No TX buffer was acquired");
+		return;
+	}
+
+	m_acquired = false;
+	pushBuffer(m_acquire_duration);
+}
+
 void Buffer::getSamples(std::vector<unsigned short> &data, unsigned int nb_samples)
 {
 	if (Utils::getIioDeviceDirection(m_dev) == OUTPUT) {
@@ -383,39 +470,65 @@ const unsigned short* Buffer::getSamplesP(unsigned int nb_samples)
 }
 
 
-void Buffer::getSamples(std::vector<std::vector<double>> &data, unsigned int nb_samples,
-				const std::function<double(int16_t, unsigned int)> &process)
+static CHANNEL_COEFFICIENTS coefficientsOf(const std::vector<CHANNEL_COEFFICIENTS> &coefficients, unsigned int ch)
 {
-	short* data_p = (short *) getSamplesRawInterleaved(nb_samples);
+	return (ch < coefficients.size()) ? coefficients.at(ch) : Conversion::identity();
+}
 
-	std::vector<bool> channels_enabled;
-	data.clear();
+/* The conversion kernel of each output type */
+static void convertChannel(const short *src, ptrdiff_t step, unsigned int nb_samples,
+			   const CHANNEL_COEFFICIENTS &coefficients, double *dst)
+{
+	Conversion::rawToScaled(src, step, nb_samples, coefficients, dst);
+}
 
-	for (auto chn : m_channel_list) {
-		bool en  = chn->isEnabled();
-		channels_enabled.push_back(en);
-		std::vector<double> ch_data {};
-		data.push_back(ch_data);
-	}
+static void convertChannel(const short *src, ptrdiff_t step, unsigned int nb_samples,
+			   const CHANNEL_COEFFICIENTS &coefficients, float *dst)
+{
+	Conversion::rawToScaled(src, step, nb_samples, coefficients, dst);
+}
 
-	unsigned int i;
-	unsigned int nb_channels = m_channel_list.size();
+static void convertChannel(const short *src, ptrdiff_t step, unsigned int nb_samples,
+			   const CHANNEL_COEFFICIENTS &, short *dst)
+{
+	Conversion::extract(src, step, nb_samples, dst);
+}
 
-	for (i = 0; i < nb_samples; i++) {
-		for (unsigned int ch = 0; ch < nb_channels; ch++) {
-			if (channels_enabled.at(ch)) {
-				data.at(ch).push_back(process(data_p[i * nb_channels + ch], ch));
-			}
+template <typename T>
+void Buffer::getSamples(std::vector<std::vector<T>> &data, unsigned int nb_samples,
+				const std::vector<CHANNEL_COEFFICIENTS> &coefficients)
+{
+	getSamplesRawInterleavedVoid(nb_samples);
+
+	unsigned int nb_channels = m_channel_list.size();
+	ptrdiff_t step = iio_buffer_step(m_buffer) / sizeof(short);
+	data.resize(nb_channels);
+
+	for (unsigned int ch = 0; ch < nb_channels; ch++) {
+		Channel *chn = m_channel_list.at(ch);
+		if (!chn->isEnabled()) {
+			data.at(ch).clear();
+			continue;
 		}
+		data.at(ch).resize(nb_samples);
+		const short *src = static_cast<const short*>(chn->getFirstVoid(m_buffer));
+		convertChannel(src, step, nb_samples, coefficientsOf(coefficients, ch), data.at(ch).data());
 	}
 }
 
+template void Buffer::getSamples<double>(std::vector<std::vector<double>> &, unsigned int,
+					 const std::vector<CHANNEL_COEFFICIENTS> &);
+template void Buffer::getSamples<float>(std::vector<std::vector<float>> &, unsigned int,
+					const std::vector<CHANNEL_COEFFICIENTS> &);
+template void Buffer::getSamples<short>(std::vector<std::vector<short>> &, unsigned int,
+					const std::vector<CHANNEL_COEFFICIENTS> &);
+
 std::vector<std::vector<double>> Buffer::getSamples(unsigned int nb_samples,
-				const std::function<double(int16_t, unsigned int)> &process)
+				const std::vector<CHANNEL_COEFFICIENTS> &coefficients)
 {
-	m_data.clear();
-	getSamples(m_data, nb_samples, process);
-	return m_data;
+	std::vector<std::vector<double>> data;
+	getSamples(data, nb_samples, coefficients);
+	return data;
 }
 
 const short* Buffer::getSamplesRawInterleaved(unsigned int nb_samples)
@@ -458,33 +571,60 @@ void* Buffer::getSamplesRawInterleavedVoid(unsigned int nb_samples)
 	return m_channel_list.at(0)->getFirstVoid(m_buffer);
 }
 
-const double* Buffer::getSamplesInterleaved(unsigned int nb_samples,
-				    const std::function<double(int16_t, unsigned int)> &process)
+/*
+ * Refill the buffer and describe where each channel's samples live inside it, without
+ * copying them. Disabled channels get an empty view so the index of the view is the
+ * index of the channel. The views are invalidated by the next refill or by destroy().
+ */
+std::vector<libm2k::SAMPLE_VIEW<short>> Buffer::getSamplesView(unsigned int nb_samples)
 {
-	const short* data_p = getSamplesRawInterleaved(nb_samples);
+	getSamplesRawInterleavedVoid(nb_samples);
 
-	std::vector<bool> channels_enabled;
+	std::vector<libm2k::SAMPLE_VIEW<short>> views;
+	ptrdiff_t step = iio_buffer_step(m_buffer) / sizeof(short);
 
 	for (auto chn : m_channel_list) {
-		bool en  = chn->isEnabled();
-		channels_enabled.push_back(en);
+		libm2k::SAMPLE_VIEW<short> view = {nullptr, 0, 0};
+		if (chn->isEnabled()) {
+			view.data = static_cast<const short*>(chn->getFirstVoid(m_buffer));
+			view.step = step;
+			view.nb_samples = nb_samples;
+		}
+		views.push_back(view);
 	}
+	return views;
+}
 
-	unsigned int nb_channels = m_channel_list.size();
-	double *data_p_d = new double[nb_samples * channels_enabled.size()];
-	unsigned int i;
-	unsigned int i_d = 0;
-
-	for (i = 0; i < nb_samples; i++) {
-		for (unsigned int ch = 0; ch < nb_channels; ch++) {
-			if (channels_enabled.at(ch)) {
-				data_p_d[i_d] = process(data_p[i * nb_channels + ch], ch);
-				i_d++;
-			}
+libm2k::SAMPLE_VIEW<unsigned short> Buffer::getSamplesViewShort(unsigned int nb_samples)
+{
+	libm2k::SAMPLE_VIEW<unsigned short> view = {getSamplesP(nb_samples), 1, nb_samples};
+	return view;
+}
+
+/*
+ * Fill the caller's memory with the converted samples of the enabled
+ * channels, interleaved; data must hold nb_samples * enabled channels values
+ */
+void Buffer::getSamplesInterleaved(double *data, unsigned int nb_samples,
+				   const std::vector<CHANNEL_COEFFICIENTS> &coefficients)
+{
+	if (!data) {
+		throw_exception(EXC_INVALID_PARAMETER, "Buffer: Invalid destination for the RX samples");
+		return;
+	}
+
+	const short* data_p = getSamplesRawInterleaved(nb_samples);
+
+	m_enabled_coefficients.clear();
+	for (unsigned int ch = 0; ch < m_channel_list.size(); ch++) {
+		if (m_channel_list.at(ch)->isEnabled()) {
+			m_enabled_coefficients.push_back(coefficientsOf(coefficients, ch));
 		}
 	}
 
-	return (const double *)data_p_d;
+	/* Only the enabled channels are found in the buffer, interleaved */
+	Conversion::rawToScaledInterleaved(data_p, m_enabled_coefficients.size(), nb_samples,
+					   m_enabled_coefficients.data(), data);
 }
 
 void Buffer::stop()
@@ -493,23 +633,31 @@ void Buffer::stop()
 		return;
 	}
 
-	if (m_buffer) {
-		iio_buffer_cancel(m_buffer);
-	}
+	cancelBuffer();
 	destroy();
 }
 
+/*
+ * The streaming threads refill the buffer and destroy it when a refill fails, while
+ * cancelBuffer may be called from the other threads; the lock keeps a concurrent
+ * cancel from reaching a destroyed buffer
+ */
 void Buffer::destroy()
 {
+	std::lock_guard<std::mutex> lock(m_buffer_lock);
 	if (m_buffer) {
 		iio_buffer_destroy(m_buffer);
 		m_buffer = nullptr;
 		m_last_nb_samples = 0;
+		m_last_cyclic = false;
+		m_pushed = false;
+		m_acquired = false;
 	}
 }
 
 void Buffer::cancelBuffer()
 {
+	std::lock_guard<std::mutex> lock(m_buffer_lock);
 	if (m_buffer) {
 		iio_buffer_cancel(m_buffer);
 	}
@@ -27,7 +27,10 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <mutex>
 #include <libm2k/m2kglobal.hpp>
+#include <libm2k/enums.hpp>
+#include "conversion.hpp"
 
 namespace libm2k {
 namespace utils {
@@ -52,37 +55,54 @@ public:
 	void push(double *data, unsigned int channel, unsigned int nb_samples, bool cyclic = true);
 	void push(short *data, unsigned int channel, unsigned int nb_samples, bool cyclic = true);
 
+	void *acquireBuffer(unsigned int nb_samples, bool cyclic = true);
+	void commitBuffer();
+
 	void setChannels(std::vector<Channel*> channels);
 	std::vector<unsigned short> getSamples(unsigned int nb_samples);
 	const unsigned short* getSamplesP(unsigned int nb_samples);
 
 	std::vector<std::vector<double>> getSamples(unsigned int nb_samples,
-					const std::function<double(int16_t, unsigned int)> &process);
-	const double *getSamplesInterleaved(unsigned int nb_samples,
-					const std::function<double(int16_t, unsigned int)> &process);
+					const std::vector<CHANNEL_COEFFICIENTS> &coefficients);
+	void getSamplesInterleaved(double *data, unsigned int nb_samples,
+					const std::vector<CHANNEL_COEFFICIENTS> &coefficients);
 	const short *getSamplesRawInterleaved(unsigned int nb_samples);
 	void* getSamplesRawInterleavedVoid(unsigned int nb_samples);
 
-	void getSamples(std::vector<std::vector<double>> &data, unsigned int nb_samples,
-					const std::function<double(int16_t, unsigned int)> &process);
+	std::vector<libm2k::SAMPLE_VIEW<short>> getSamplesView(unsigned int nb_samples);
+	libm2k::SAMPLE_VIEW<unsigned short> getSamplesViewShort(unsigned int nb_samples);
+
+	/* T is double or float for scaled values; short returns the raw codes and ignores the coefficients */
+	template <typename T>
+	void getSamples(std::vector<std::vector<T>> &data, unsigned int nb_samples,
+					const std::vector<CHANNEL_COEFFICIENTS> &coefficients);
 	void getSamples(std::vector<unsigned short> &data, unsigned int nb_samples);
 
 	void stop();
 	void setCyclic(bool enable);
+	/* Can be called from any thread; the buffer itself is destroyed only by its owner thread */
 	void cancelBuffer();
 	void flushBuffer();
 
 	struct iio_buffer* getBuffer();
+	libm2k::BUFFER_STATISTICS getStatistics();
 private:
 	struct iio_device* m_dev;
 	struct iio_buffer* m_buffer;
+	std::mutex m_buffer_lock;
 	unsigned int m_last_nb_samples;
 	bool m_cyclic;
+	bool m_last_cyclic;
+	bool m_pushed;
+	bool m_acquired;
+	double m_acquire_duration;
+	libm2k::BUFFER_STATISTICS m_statistics;
 	std::vector<Channel*> m_channel_list;
-	std::vector<std::vector<double>> m_data;
 	std::vector<unsigned short> m_data_short;
+	std::vector<CHANNEL_COEFFICIENTS> m_enabled_coefficients;
 
 	void destroy();
+	void pushBuffer(double setup_duration);
 };
 }
 }
@@ -30,6 +30,7 @@ using namespace libm2k::utils;
 
 Channel::Channel(iio_device *device, unsigned int channel) {
 	m_device = device;
+	m_channel = nullptr;
 	if (m_device) {
 		m_channel = iio_device_get_channel(m_device, channel);
 	}
@@ -37,11 +38,13 @@ Channel::Channel(iio_device *device, unsigned int channel) {
 	if (!m_channel) {
 		m_channel = nullptr;
 	}
+	indexAttributes();
 }
 
 Channel::Channel(iio_device *device, std::string channel_name, bool output)
 {
 	m_device = device;
+	m_channel = nullptr;
 	if (m_device) {
 		m_channel = iio_device_find_channel(device, channel_name.c_str(), output);
 	}
@@ -50,12 +53,24 @@ Channel::Channel(iio_device *device, std::string channel_name, bool output)
 		m_channel = nullptr;
 
 	}
-
+	indexAttributes();
 }
 
 Channel::~Channel() {
 }
 
+/* The attribute list of a channel never changes, so it is only scanned once */
+void Channel::indexAttributes()
+{
+	if (!m_channel) {
+		return;
+	}
+	unsigned int nb_attr = iio_channel_get_attrs_count(m_channel);
+	for (unsigned int i = 0; i < nb_attr; i++) {
+		m_attributes.insert(iio_channel_get_attr(m_channel, i));
+	}
+}
+
 std::string Channel::getName()
 {
 	if (!m_channel) {
@@ -106,10 +121,7 @@ bool Channel::hasAttribute(std::string attr)
 	if (!m_channel) {
 		throw_exception(EXC_INVALID_PARAMETER, "Channel: Cannot find associated channel");
 	}
-	if (iio_channel_find_attr(m_channel, attr.c_str()) != NULL) {
-		return true;
-	}
-	return false;
+	return m_attributes.find(attr) != m_attributes.end();
 }
 
 void Channel::enableChannel(bool enable)
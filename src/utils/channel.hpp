@@ -26,6 +26,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_set>
 #include <libm2k/m2kglobal.hpp>
 
 namespace libm2k {
@@ -76,6 +77,9 @@ public:
 private:
 	struct iio_device *m_device;
 	struct iio_channel *m_channel;
+	std::unordered_set<std::string> m_attributes;
+
+	void indexAttributes();
 
 
 };
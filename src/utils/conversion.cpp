@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "conversion.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define CONVERSION_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define CONVERSION_SSE2 1
+#endif
+
+using namespace libm2k::utils;
+
+namespace {
+
+template <typename T>
+void rawToScaledScalar(const short *src, std::ptrdiff_t step, unsigned int first, unsigned int nb_samples,
+		       const CHANNEL_COEFFICIENTS &coefficients, T *dst)
+{
+	const T scale = static_cast<T>(coefficients.scale);
+	const T offset = static_cast<T>(coefficients.offset);
+	for (unsigned int i = first; i < nb_samples; i++) {
+		dst[i] = static_cast<T>(src[i * step]) * scale + offset;
+	}
+}
+
+#if defined(CONVERSION_AVX2)
+/* 8 samples of one channel, sign extended to 32 bits; step is 1 or 2 */
+inline __m256i loadChannel(const short *src, std::ptrdiff_t step, unsigned int i)
+{
+	if (step == 1) {
+		return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+	}
+	__m256i pairs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+	return _mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16);
+}
+
+const unsigned int VECTOR_SAMPLES = 8;
+#elif defined(CONVERSION_SSE2)
+/* 4 samples of one channel, sign extended to 32 bits; step is 1 or 2 */
+inline __m128i loadChannel(const short *src, std::ptrdiff_t step, unsigned int i)
+{
+	if (step == 1) {
+		__m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	}
+	__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+	return _mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16);
+}
+
+const unsigned int VECTOR_SAMPLES = 4;
+#endif
+
+#if defined(CONVERSION_AVX2) || defined(CONVERSION_SSE2)
+/*
+ * Number of samples that can be loaded as whole vectors. With step 2 a vector load
+ * reads one element past the last sample of the channel, so the last group is left
+ * to the scalar loop; this keeps every access inside the IIO buffer.
+ */
+inline unsigned int vectorSamples(std::ptrdiff_t step, unsigned int nb_samples,
+				  unsigned int width = VECTOR_SAMPLES)
+{
+	if (step != 1 && step != 2) {
+		return 0;
+	}
+	unsigned int limit = (step == 2 && nb_samples > 0) ? nb_samples - 1 : nb_samples;
+	return (limit / width) * width;
+}
+
+/* Values converted to raw codes per iteration of scaledToRaw */
+const unsigned int VECTOR_VALUES = 8;
+#endif
+}
+
+CHANNEL_COEFFICIENTS Conversion::identity()
+{
+	CHANNEL_COEFFICIENTS coefficients = {1.0, 0.0};
+	return coefficients;
+}
+
+void Conversion::rawToScaled(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+			     const CHANNEL_COEFFICIENTS &coefficients, double *dst)
+{
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2)
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	const __m256d scale = _mm256_set1_pd(coefficients.scale);
+	const __m256d offset = _mm256_set1_pd(coefficients.offset);
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m256i raw = loadChannel(src, step, i);
+		__m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(raw));
+		__m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(raw, 1));
+		_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_mul_pd(lo, scale), offset));
+		_mm256_storeu_pd(dst + i + 4, _mm256_add_pd(_mm256_mul_pd(hi, scale), offset));
+	}
+#elif defined(CONVERSION_SSE2)
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	const __m128d scale = _mm_set1_pd(coefficients.scale);
+	const __m128d offset = _mm_set1_pd(coefficients.offset);
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m128i raw = loadChannel(src, step, i);
+		__m128d lo = _mm_cvtepi32_pd(raw);
+		__m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(raw, _MM_SHUFFLE(1, 0, 3, 2)));
+		_mm_storeu_pd(dst + i, _mm_add_pd(_mm_mul_pd(lo, scale), offset));
+		_mm_storeu_pd(dst + i + 2, _mm_add_pd(_mm_mul_pd(hi, scale), offset));
+	}
+#endif
+	rawToScaledScalar(src, step, i, nb_samples, coefficients, dst);
+}
+
+void Conversion::rawToScaled(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+			     const CHANNEL_COEFFICIENTS &coefficients, float *dst)
+{
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2)
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	const __m256 scale = _mm256_set1_ps(static_cast<float>(coefficients.scale));
+	const __m256 offset = _mm256_set1_ps(static_cast<float>(coefficients.offset));
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m256 raw = _mm256_cvtepi32_ps(loadChannel(src, step, i));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(raw, scale), offset));
+	}
+#elif defined(CONVERSION_SSE2)
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	const __m128 scale = _mm_set1_ps(static_cast<float>(coefficients.scale));
+	const __m128 offset = _mm_set1_ps(static_cast<float>(coefficients.offset));
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m128 raw = _mm_cvtepi32_ps(loadChannel(src, step, i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(raw, scale), offset));
+	}
+#endif
+	rawToScaledScalar(src, step, i, nb_samples, coefficients, dst);
+}
+
+void Conversion::extract(const short *src, std::ptrdiff_t step, unsigned int nb_samples, short *dst)
+{
+	if (step == 1) {
+		std::copy(src, src + nb_samples, dst);
+		return;
+	}
+
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2)
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		/* the values fit in 16 bits, so packing does not saturate */
+		__m256i packed = _mm256_packs_epi32(loadChannel(src, step, i), _mm256_setzero_si256());
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(packed));
+	}
+#elif defined(CONVERSION_SSE2)
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m128i packed = _mm_packs_epi32(loadChannel(src, step, i), _mm_setzero_si128());
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), packed);
+	}
+#endif
+	for (; i < nb_samples; i++) {
+		dst[i] = src[i * step];
+	}
+}
+
+long long Conversion::sum(const short *src, std::ptrdiff_t step, unsigned int nb_samples)
+{
+	long long total = 0;
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2) || defined(CONVERSION_SSE2)
+	/* Each 32-bit lane gains at most 2^15 per vector, flush to 64 bits before it can overflow */
+	const unsigned int block = 65535 * VECTOR_SAMPLES;
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	while (i < vec_end) {
+		unsigned int end = std::min(vec_end, i + block);
+#if defined(CONVERSION_AVX2)
+		__m256i acc = _mm256_setzero_si256();
+		for (; i < end; i += VECTOR_SAMPLES) {
+			acc = _mm256_add_epi32(acc, loadChannel(src, step, i));
+		}
+		int lanes[VECTOR_SAMPLES];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+#else
+		__m128i acc = _mm_setzero_si128();
+		for (; i < end; i += VECTOR_SAMPLES) {
+			acc = _mm_add_epi32(acc, loadChannel(src, step, i));
+		}
+		int lanes[VECTOR_SAMPLES];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+#endif
+		for (unsigned int lane = 0; lane < VECTOR_SAMPLES; lane++) {
+			total += lanes[lane];
+		}
+	}
+#endif
+	for (; i < nb_samples; i++) {
+		total += src[i * step];
+	}
+	return total;
+}
+
+/*
+ * The sums use 32-bit lanes flushed to 64 bits like sum(). Each square is at most 2^30:
+ * madd of the low 16 bits of a lane (the sample itself) with itself, the high half
+ * being cleared, gives it exactly; the squares are then widened to 64-bit lanes.
+ */
+void Conversion::accumulate(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+			    SAMPLE_STATISTICS &statistics)
+{
+	long long total = 0;
+	unsigned long long squares = 0;
+	short lowest = statistics.min;
+	short highest = statistics.max;
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2) || defined(CONVERSION_SSE2)
+	const unsigned int block = 65535 * VECTOR_SAMPLES;
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+#if defined(CONVERSION_AVX2)
+	const __m256i low16 = _mm256_set1_epi32(0xffff);
+	const __m256i low32 = _mm256_set1_epi64x(0xffffffffLL);
+	__m256i vmin = _mm256_set1_epi32(lowest);
+	__m256i vmax = _mm256_set1_epi32(highest);
+	__m256i sq = _mm256_setzero_si256();
+#else
+	const __m128i low16 = _mm_set1_epi32(0xffff);
+	const __m128i low32 = _mm_set_epi32(0, -1, 0, -1);
+	__m128i vmin = _mm_set1_epi16(lowest);
+	__m128i vmax = _mm_set1_epi16(highest);
+	__m128i sq = _mm_setzero_si128();
+#endif
+	while (i < vec_end) {
+		unsigned int end = std::min(vec_end, i + block);
+		int lanes[VECTOR_SAMPLES];
+#if defined(CONVERSION_AVX2)
+		__m256i acc = _mm256_setzero_si256();
+		for (; i < end; i += VECTOR_SAMPLES) {
+			__m256i v = loadChannel(src, step, i);
+			acc = _mm256_add_epi32(acc, v);
+			vmin = _mm256_min_epi32(vmin, v);
+			vmax = _mm256_max_epi32(vmax, v);
+			__m256i m = _mm256_and_si256(v, low16);
+			__m256i s = _mm256_madd_epi16(m, m);
+			sq = _mm256_add_epi64(sq, _mm256_and_si256(s, low32));
+			sq = _mm256_add_epi64(sq, _mm256_srli_epi64(s, 32));
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+#else
+		__m128i acc = _mm_setzero_si128();
+		for (; i < end; i += VECTOR_SAMPLES) {
+			__m128i v = loadChannel(src, step, i);
+			acc = _mm_add_epi32(acc, v);
+			/* SSE2 only has 16-bit min/max; the lanes fit, so pack them back */
+			__m128i packed = _mm_packs_epi32(v, v);
+			vmin = _mm_min_epi16(vmin, packed);
+			vmax = _mm_max_epi16(vmax, packed);
+			__m128i m = _mm_and_si128(v, low16);
+			__m128i s = _mm_madd_epi16(m, m);
+			sq = _mm_add_epi64(sq, _mm_and_si128(s, low32));
+			sq = _mm_add_epi64(sq, _mm_srli_epi64(s, 32));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+#endif
+		for (unsigned int lane = 0; lane < VECTOR_SAMPLES; lane++) {
+			total += lanes[lane];
+		}
+	}
+#if defined(CONVERSION_AVX2)
+	int mins[8], maxs[8];
+	unsigned long long sqs[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(mins), vmin);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(maxs), vmax);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(sqs), sq);
+#else
+	short mins[8], maxs[8];
+	unsigned long long sqs[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mins), vmin);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), vmax);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(sqs), sq);
+#endif
+	for (unsigned int lane = 0; lane < 8; lane++) {
+		lowest = std::min<short>(lowest, mins[lane]);
+		highest = std::max<short>(highest, maxs[lane]);
+	}
+	for (unsigned int lane = 0; lane < sizeof(sqs) / sizeof(sqs[0]); lane++) {
+		squares += sqs[lane];
+	}
+#endif
+	for (; i < nb_samples; i++) {
+		short v = src[i * step];
+		total += v;
+		squares += (unsigned long long)((int)v * v);
+		lowest = std::min(lowest, v);
+		highest = std::max(highest, v);
+	}
+	statistics.nb_samples += nb_samples;
+	statistics.sum += total;
+	statistics.sum_squares += squares;
+	statistics.min = lowest;
+	statistics.max = highest;
+}
+
+unsigned int Conversion::find(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+			      int low, int high, bool inside)
+{
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2) || defined(CONVERSION_SSE2)
+	/* low <= v <= high is v > low - 1 and high + 1 > v, exact on the 32-bit lanes */
+	unsigned int vec_end = vectorSamples(step, nb_samples);
+	int invert = inside ? 0 : (1 << VECTOR_SAMPLES) - 1;
+#if defined(CONVERSION_AVX2)
+	const __m256i below = _mm256_set1_epi32(low - 1);
+	const __m256i above = _mm256_set1_epi32(high + 1);
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m256i v = loadChannel(src, step, i);
+		__m256i hit = _mm256_and_si256(_mm256_cmpgt_epi32(v, below), _mm256_cmpgt_epi32(above, v));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit)) ^ invert;
+#else
+	const __m128i below = _mm_set1_epi32(low - 1);
+	const __m128i above = _mm_set1_epi32(high + 1);
+	for (; i < vec_end; i += VECTOR_SAMPLES) {
+		__m128i v = loadChannel(src, step, i);
+		__m128i hit = _mm_and_si128(_mm_cmpgt_epi32(v, below), _mm_cmpgt_epi32(above, v));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(hit)) ^ invert;
+#endif
+		if (mask) {
+			unsigned int lane = 0;
+			while (!(mask & (1 << lane))) {
+				lane++;
+			}
+			return i + lane;
+		}
+	}
+#endif
+	for (; i < nb_samples; i++) {
+		int v = src[i * step];
+		if ((v >= low && v <= high) == inside) {
+			return i;
+		}
+	}
+	return nb_samples;
+}
+
+/*
+ * The clamp comes before the conversion to integers, which would turn the values out of
+ * range into 0x80000000. Both the vector and the scalar paths round in the current mode
+ * (to nearest, by default), and max(v, low) returns low for NaN in both.
+ */
+void Conversion::scaledToRaw(const double *src, std::ptrdiff_t step, unsigned int nb_samples,
+			     double scale, short *dst)
+{
+	const double lowest = -32768.0;
+	const double highest = 32767.0;
+	unsigned int i = 0;
+#if defined(CONVERSION_AVX2)
+	unsigned int vec_end = vectorSamples(step, nb_samples, VECTOR_VALUES);
+	const __m256d vscale = _mm256_set1_pd(scale);
+	const __m256d vlow = _mm256_set1_pd(lowest);
+	const __m256d vhigh = _mm256_set1_pd(highest);
+	for (; i < vec_end; i += VECTOR_VALUES) {
+		__m256d a, b;
+		if (step == 1) {
+			a = _mm256_loadu_pd(src + i);
+			b = _mm256_loadu_pd(src + i + 4);
+		} else {
+			/* Even elements of 16 interleaved values, back in order */
+			const double *s = src + 2 * i;
+			a = _mm256_unpacklo_pd(_mm256_loadu_pd(s), _mm256_loadu_pd(s + 4));
+			b = _mm256_unpacklo_pd(_mm256_loadu_pd(s + 8), _mm256_loadu_pd(s + 12));
+			a = _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 1, 2, 0));
+			b = _mm256_permute4x64_pd(b, _MM_SHUFFLE(3, 1, 2, 0));
+		}
+		a = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(a, vscale), vlow), vhigh);
+		b = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(b, vscale), vlow), vhigh);
+		__m128i packed = _mm_packs_epi32(_mm256_cvtpd_epi32(a), _mm256_cvtpd_epi32(b));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+	}
+#elif defined(CONVERSION_SSE2)
+	unsigned int vec_end = vectorSamples(step, nb_samples, VECTOR_VALUES);
+	const __m128d vscale = _mm_set1_pd(scale);
+	const __m128d vlow = _mm_set1_pd(lowest);
+	const __m128d vhigh = _mm_set1_pd(highest);
+	for (; i < vec_end; i += VECTOR_VALUES) {
+		__m128i quads[2];
+		for (unsigned int q = 0; q < 2; q++) {
+			__m128d a, b;
+			if (step == 1) {
+				a = _mm_loadu_pd(src + i + 4 * q);
+				b = _mm_loadu_pd(src + i + 4 * q + 2);
+			} else {
+				const double *s = src + 2 * (i + 4 * q);
+				a = _mm_unpacklo_pd(_mm_loadu_pd(s), _mm_loadu_pd(s + 2));
+				b = _mm_unpacklo_pd(_mm_loadu_pd(s + 4), _mm_loadu_pd(s + 6));
+			}
+			a = _mm_min_pd(_mm_max_pd(_mm_mul_pd(a, vscale), vlow), vhigh);
+			b = _mm_min_pd(_mm_max_pd(_mm_mul_pd(b, vscale), vlow), vhigh);
+			quads[q] = _mm_unpacklo_epi64(_mm_cvtpd_epi32(a), _mm_cvtpd_epi32(b));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(quads[0], quads[1]));
+	}
+#endif
+	for (; i < nb_samples; i++) {
+		double v = src[i * step] * scale;
+		v = (v > lowest) ? v : lowest;
+		v = (v < highest) ? v : highest;
+		dst[i] = static_cast<short>(std::lrint(v));
+	}
+}
+
+void Conversion::rawToScaledInterleaved(const short *src, unsigned int nb_channels, unsigned int nb_samples,
+					const CHANNEL_COEFFICIENTS *coefficients, double *dst)
+{
+	if (nb_channels == 1) {
+		rawToScaled(src, 1, nb_samples, coefficients[0], dst);
+		return;
+	}
+
+	unsigned int i = 0;
+	unsigned int total = nb_samples * nb_channels;
+	if (nb_channels == 2) {
+#if defined(CONVERSION_AVX2)
+		/* 4 pairs per iteration; every 4 doubles hold 2 pairs (ch0, ch1, ch0, ch1) */
+		const __m256d scale = _mm256_set_pd(coefficients[1].scale, coefficients[0].scale,
+						    coefficients[1].scale, coefficients[0].scale);
+		const __m256d offset = _mm256_set_pd(coefficients[1].offset, coefficients[0].offset,
+						     coefficients[1].offset, coefficients[0].offset);
+		for (; i + 8 <= total; i += 8) {
+			__m256i raw = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+			__m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(raw));
+			__m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(raw, 1));
+			_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_mul_pd(lo, scale), offset));
+			_mm256_storeu_pd(dst + i + 4, _mm256_add_pd(_mm256_mul_pd(hi, scale), offset));
+		}
+#elif defined(CONVERSION_SSE2)
+		/* 2 pairs per iteration; every 2 doubles hold one pair (ch0, ch1) */
+		const __m128d scale = _mm_set_pd(coefficients[1].scale, coefficients[0].scale);
+		const __m128d offset = _mm_set_pd(coefficients[1].offset, coefficients[0].offset);
+		for (; i + 4 <= total; i += 4) {
+			__m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+			raw = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+			__m128d lo = _mm_cvtepi32_pd(raw);
+			__m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(raw, _MM_SHUFFLE(1, 0, 3, 2)));
+			_mm_storeu_pd(dst + i, _mm_add_pd(_mm_mul_pd(lo, scale), offset));
+			_mm_storeu_pd(dst + i + 2, _mm_add_pd(_mm_mul_pd(hi, scale), offset));
+		}
+#endif
+	}
+
+	for (; i < total; i++) {
+		const CHANNEL_COEFFICIENTS &c = coefficients[i % nb_channels];
+		dst[i] = src[i] * c.scale + c.offset;
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CONVERSION_HPP
+#define CONVERSION_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace libm2k {
+namespace utils {
+
+/**
+ * Affine conversion of a raw sample: value = raw * scale + offset
+ */
+struct CHANNEL_COEFFICIENTS {
+	double scale;
+	double offset;
+};
+
+/**
+ * Running statistics of raw samples; an empty set has min = 32767 and max = -32768
+ */
+struct SAMPLE_STATISTICS {
+	unsigned long long nb_samples;
+	long long sum;
+	unsigned long long sum_squares;
+	short min;
+	short max;
+};
+
+/**
+ * Block conversion kernels from raw 16-bit samples, as found inside the IIO buffers, and
+ * back. The vectorized paths are selected at compile time (AVX2, SSE2) with a scalar fallback.
+ */
+class Conversion
+{
+public:
+	/* dst[i] = src[i * step] * coefficients.scale + coefficients.offset */
+	static void rawToScaled(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+				const CHANNEL_COEFFICIENTS &coefficients, double *dst);
+	static void rawToScaled(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+				const CHANNEL_COEFFICIENTS &coefficients, float *dst);
+
+	/* dst[i] = src[i * step]: the raw codes of one channel, without conversion */
+	static void extract(const short *src, std::ptrdiff_t step, unsigned int nb_samples, short *dst);
+
+	/* Sum of src[i * step], accumulated in integers */
+	static long long sum(const short *src, std::ptrdiff_t step, unsigned int nb_samples);
+
+	/* Adds the count, sum, sum of squares, minimum and maximum of src[i * step] to statistics, in one pass */
+	static void accumulate(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+			       SAMPLE_STATISTICS &statistics);
+
+	/* Index of the first src[i * step] inside [low, high] (or outside, if !inside); nb_samples if none */
+	static unsigned int find(const short *src, std::ptrdiff_t step, unsigned int nb_samples,
+				 int low, int high, bool inside = true);
+
+	/* dst[i] = src[i * step] * scale, rounded to the nearest code and saturated to 16 bits;
+	 * NaN gives -32768 */
+	static void scaledToRaw(const double *src, std::ptrdiff_t step, unsigned int nb_samples,
+				double scale, short *dst);
+
+	/* Interleaved input and output; channel ch is converted using coefficients[ch] */
+	static void rawToScaledInterleaved(const short *src, unsigned int nb_channels, unsigned int nb_samples,
+				const CHANNEL_COEFFICIENTS *coefficients, double *dst);
+
+	/* Coefficients that leave the raw value unchanged */
+	static CHANNEL_COEFFICIENTS identity();
+};
+}
+}
+
+#endif //CONVERSION_HPP
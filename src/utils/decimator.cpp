@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "decimator.hpp"
+#include "conversion.hpp"
+#include <libm2k/m2kexceptions.hpp>
+#include <algorithm>
+#include <limits>
+
+using namespace libm2k::utils;
+using namespace libm2k::analog;
+
+/* A CIC output before normalization is at most 2^15 * gain; keep it inside 64 bits */
+static const long long MAX_CIC_GAIN = 1LL << 47;
+static const unsigned int MAX_CIC_ORDER = 6;
+
+/* num / den rounded to the nearest integer, halves away from zero, saturated to 16 bits */
+static inline short roundedQuotient(long long num, long long den)
+{
+	long long q = (num >= 0) ? (num + den / 2) / den : -((-num + den / 2) / den);
+	q = std::min<long long>(std::max<long long>(q, std::numeric_limits<short>::min()),
+				std::numeric_limits<short>::max());
+	return static_cast<short>(q);
+}
+
+Decimator::Decimator(M2K_DECIMATION_MODE mode, unsigned int factor, unsigned int nb_channels, unsigned int order) :
+	m_mode(mode),
+	m_factor(factor),
+	m_nb_channels(nb_channels),
+	m_order(order),
+	m_gain(1),
+	m_count(0)
+{
+	if (factor == 0 || nb_channels == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "Decimator: Invalid decimation factor or number of channels");
+	}
+
+	if (mode == DECIMATION_CIC) {
+		if (order == 0 || order > MAX_CIC_ORDER) {
+			throw_exception(EXC_INVALID_PARAMETER, "Decimator: The CIC order must be between 1 and " +
+					std::to_string(MAX_CIC_ORDER));
+		}
+		for (unsigned int k = 0; k < order; k++) {
+			if (m_gain > MAX_CIC_GAIN / factor) {
+				throw_exception(EXC_INVALID_PARAMETER, "Decimator: The CIC gain (factor ^ order) is too large");
+			}
+			m_gain *= factor;
+		}
+	} else if (mode != DECIMATION_BOXCAR && mode != DECIMATION_MIN_MAX) {
+		throw_exception(EXC_INVALID_PARAMETER, "Decimator: Unknown decimation mode");
+	}
+	reset();
+}
+
+void Decimator::reset()
+{
+	m_count = 0;
+	m_sums.assign(m_nb_channels, 0);
+	m_min.assign(m_nb_channels, std::numeric_limits<short>::max());
+	m_max.assign(m_nb_channels, std::numeric_limits<short>::min());
+	if (m_mode == DECIMATION_CIC) {
+		m_integrators.assign(m_nb_channels * m_order, 0);
+		m_combs.assign(m_nb_channels * m_order, 0);
+	}
+}
+
+unsigned int Decimator::getMaxOutputSamples(unsigned int nb_samples) const
+{
+	unsigned int windows = (nb_samples + m_factor - 1) / m_factor;
+	return (m_mode == DECIMATION_MIN_MAX) ? 2 * windows : windows;
+}
+
+unsigned int Decimator::process(const short *src, unsigned int nb_samples, short *dst)
+{
+	switch (m_mode) {
+	case DECIMATION_BOXCAR:
+		return processBoxcar(src, nb_samples, dst);
+	case DECIMATION_MIN_MAX:
+		return processMinMax(src, nb_samples, dst);
+	case DECIMATION_CIC:
+		return processCic(src, nb_samples, dst);
+	}
+	return 0;
+}
+
+unsigned int Decimator::processBoxcar(const short *src, unsigned int nb_samples, short *dst)
+{
+	unsigned int out = 0;
+	unsigned int i = 0;
+	while (i < nb_samples) {
+		unsigned int take = std::min(m_factor - m_count, nb_samples - i);
+		for (unsigned int ch = 0; ch < m_nb_channels; ch++) {
+			m_sums[ch] += Conversion::sum(src + (size_t)i * m_nb_channels + ch, m_nb_channels, take);
+		}
+		m_count += take;
+		i += take;
+
+		if (m_count == m_factor) {
+			for (unsigned int ch = 0; ch < m_nb_channels; ch++) {
+				dst[(size_t)out * m_nb_channels + ch] = roundedQuotient(m_sums[ch], m_factor);
+				m_sums[ch] = 0;
+			}
+			m_count = 0;
+			out++;
+		}
+	}
+	return out;
+}
+
+unsigned int Decimator::processMinMax(const short *src, unsigned int nb_samples, short *dst)
+{
+	unsigned int out = 0;
+	unsigned int i = 0;
+	while (i < nb_samples) {
+		unsigned int take = std::min(m_factor - m_count, nb_samples - i);
+		for (unsigned int ch = 0; ch < m_nb_channels; ch++) {
+			const short *s = src + (size_t)i * m_nb_channels + ch;
+			short lo = m_min[ch];
+			short hi = m_max[ch];
+			for (unsigned int j = 0; j < take; j++) {
+				short v = s[(size_t)j * m_nb_channels];
+				lo = std::min(lo, v);
+				hi = std::max(hi, v);
+			}
+			m_min[ch] = lo;
+			m_max[ch] = hi;
+		}
+		m_count += take;
+		i += take;
+
+		if (m_count == m_factor) {
+			for (unsigned int ch = 0; ch < m_nb_channels; ch++) {
+				dst[(size_t)out * m_nb_channels + ch] = m_min[ch];
+				dst[(size_t)(out + 1) * m_nb_channels + ch] = m_max[ch];
+				m_min[ch] = std::numeric_limits<short>::max();
+				m_max[ch] = std::numeric_limits<short>::min();
+			}
+			m_count = 0;
+			out += 2;
+		}
+	}
+	return out;
+}
+
+/*
+ * Integrators at the input rate, combs (differential delay 1) at the output rate.
+ * The two's complement wrap-around of the integrators cancels in the combs as long
+ * as the output fits in 64 bits, which the gain limit guarantees
+ */
+unsigned int Decimator::processCic(const short *src, unsigned int nb_samples, short *dst)
+{
+	unsigned int out = 0;
+	for (unsigned int i = 0; i < nb_samples; i++) {
+		const short *frame = src + (size_t)i * m_nb_channels;
+		for (unsigned int ch = 0; ch < m_nb_channels; ch++) {
+			uint64_t *integrators = &m_integrators[ch * m_order];
+			uint64_t v = static_cast<uint64_t>(static_cast<long long>(frame[ch]));
+			for (unsigned int k = 0; k < m_order; k++) {
+				integrators[k] += v;
+				v = integrators[k];
+			}
+		}
+
+		if (++m_count < m_factor) {
+			continue;
+		}
+		m_count = 0;
+		for (unsigned int ch = 0; ch < m_nb_channels; ch++) {
+			uint64_t v = m_integrators[ch * m_order + m_order - 1];
+			uint64_t *combs = &m_combs[ch * m_order];
+			for (unsigned int k = 0; k < m_order; k++) {
+				uint64_t previous = combs[k];
+				combs[k] = v;
+				v -= previous;
+			}
+			dst[(size_t)out * m_nb_channels + ch] = roundedQuotient(static_cast<long long>(v), m_gain);
+		}
+		out++;
+	}
+	return out;
+}
+
+M2K_DECIMATION_MODE Decimator::getMode() const
+{
+	return m_mode;
+}
+
+unsigned int Decimator::getFactor() const
+{
+	return m_factor;
+}
+
+unsigned int Decimator::getOrder() const
+{
+	return m_order;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DECIMATOR_HPP
+#define DECIMATOR_HPP
+
+#include <libm2k/analog/enums.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace libm2k {
+namespace utils {
+
+/**
+ * Decimation of raw 16-bit samples by an integer factor, using integer accumulators.
+ * The input and the output are interleaved frames of nb_channels samples. The state is
+ * kept between calls, so consecutive blocks of a stream are decimated as one signal;
+ * a window may span several blocks.
+ *
+ * DECIMATION_BOXCAR and DECIMATION_CIC produce one rounded raw code per window, with
+ * unity gain; DECIMATION_MIN_MAX produces two frames per window: the minimum and then
+ * the maximum of every channel.
+ */
+class Decimator
+{
+public:
+	Decimator(libm2k::analog::M2K_DECIMATION_MODE mode, unsigned int factor,
+		  unsigned int nb_channels, unsigned int order = 3);
+
+	/* Largest number of frames produced by process for nb_samples input frames */
+	unsigned int getMaxOutputSamples(unsigned int nb_samples) const;
+
+	/* Returns the number of frames written to dst */
+	unsigned int process(const short *src, unsigned int nb_samples, short *dst);
+
+	/* Drop the partial window and the filter history, e.g. after a gap in the input */
+	void reset();
+
+	libm2k::analog::M2K_DECIMATION_MODE getMode() const;
+	unsigned int getFactor() const;
+	unsigned int getOrder() const;
+
+private:
+	libm2k::analog::M2K_DECIMATION_MODE m_mode;
+	unsigned int m_factor;
+	unsigned int m_nb_channels;
+	unsigned int m_order;
+	long long m_gain;
+
+	/* Input frames already accumulated in the current window */
+	unsigned int m_count;
+	std::vector<long long> m_sums;
+	std::vector<short> m_min;
+	std::vector<short> m_max;
+	/* CIC stages of every channel; unsigned so that the integrators wrap around */
+	std::vector<uint64_t> m_integrators;
+	std::vector<uint64_t> m_combs;
+
+	unsigned int processBoxcar(const short *src, unsigned int nb_samples, short *dst);
+	unsigned int processMinMax(const short *src, unsigned int nb_samples, short *dst);
+	unsigned int processCic(const short *src, unsigned int nb_samples, short *dst);
+};
+}
+}
+
+#endif //DECIMATOR_HPP
@@ -29,11 +29,113 @@
 #include <cstring>
 #include <sstream>
 #include <iterator>
+#include <cstdlib>
+#include <locale>
+#include <iomanip>
+#include <map>
+#include <mutex>
 
 using namespace std;
 using namespace libm2k::utils;
 using namespace libm2k::context;
 
+/* Attributes written only by the library; their value can be served from the cache. The
+ * index in this table is the id of the attribute in the cache */
+static const char * const cacheable_attributes[] = {
+	"sampling_frequency",
+	"oversampling_ratio",
+	"gain",
+	"calibbias",
+	"calibscale",
+};
+static const unsigned int nb_cacheable_attributes = sizeof(cacheable_attributes) / sizeof(cacheable_attributes[0]);
+
+static int cacheableAttributeId(const std::string &attr)
+{
+	for (unsigned int i = 0; i < nb_cacheable_attributes; i++) {
+		if (attr == cacheable_attributes[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* Same conversions as the libiio attribute readers */
+static double toDouble(const std::string &value)
+{
+	double number = 0;
+	std::istringstream iss(value);
+	iss.imbue(std::locale::classic());
+	iss >> number;
+	return number;
+}
+
+static long long toLongLong(const std::string &value)
+{
+	return std::strtoll(value.c_str(), nullptr, 0);
+}
+
+/* Same formatting as the libiio attribute writers */
+static std::string fromDouble(double value)
+{
+	std::ostringstream oss;
+	oss.imbue(std::locale::classic());
+	oss << std::fixed << std::setprecision(6) << value;
+	return oss.str();
+}
+
+static std::string fromLongLong(long long value)
+{
+	return std::to_string(value);
+}
+
+/* Numbers compare by value: the device reads back "1000000" for a staged "1000000.000000" */
+static bool sameValue(const std::string &lvalue, const std::string &rvalue)
+{
+	if (lvalue == rvalue) {
+		return true;
+	}
+	double lnumber = 0, rnumber = 0;
+	std::istringstream liss(lvalue), riss(rvalue);
+	liss.imbue(std::locale::classic());
+	riss.imbue(std::locale::classic());
+	liss >> lnumber;
+	riss >> rnumber;
+	return !liss.fail() && !riss.fail() && (liss >> std::ws).eof() &&
+		(riss >> std::ws).eof() && (lnumber == rnumber);
+}
+
+typedef std::unordered_map<std::string, std::string> KNOWN_VALUES;
+
+/*
+ * The values known to be on an iio_device are shared by all its wrappers (m2k-fabric is
+ * wrapped by every instrument); the table lives as long as one of the wrappers does
+ */
+static std::shared_ptr<KNOWN_VALUES> getKnownValues(struct iio_device *dev)
+{
+	static std::mutex lock;
+	static std::map<struct iio_device*, std::weak_ptr<KNOWN_VALUES>> devices;
+
+	if (!dev) {
+		return std::make_shared<KNOWN_VALUES>();
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (auto it = devices.begin(); it != devices.end();) {
+		if (it->second.expired()) {
+			it = devices.erase(it);
+		} else {
+			it++;
+		}
+	}
+	auto known = devices[dev].lock();
+	if (!known) {
+		known = std::make_shared<KNOWN_VALUES>();
+		devices[dev] = known;
+	}
+	return known;
+}
+
 
 /** Represents an iio_device **/
 DeviceGeneric::DeviceGeneric(struct iio_context* context, std::string dev_name)
@@ -41,6 +143,9 @@ DeviceGeneric::DeviceGeneric(struct iio_context* context, std::string dev_name)
 	m_context = context;
 	m_dev = nullptr;
 	m_buffer = nullptr;
+	m_attribute_caching = false;
+	m_transaction_depth = 0;
+	m_transaction_cancelled = false;
 
 	if (dev_name != "") {
 		m_dev = iio_context_find_device(context, dev_name.c_str());
@@ -48,6 +153,15 @@ DeviceGeneric::DeviceGeneric(struct iio_context* context, std::string dev_name)
 			throw_exception(EXC_INVALID_PARAMETER, "Device: No such device");
 		}
 
+		unsigned int nb_attr = iio_device_get_attrs_count(m_dev);
+		for (unsigned int i = 0; i < nb_attr; i++) {
+			m_dev_attributes.insert(iio_device_get_attr(m_dev, i));
+		}
+		nb_attr = iio_device_get_buffer_attrs_count(m_dev);
+		for (unsigned int i = 0; i < nb_attr; i++) {
+			m_buffer_attributes.insert(iio_device_get_buffer_attr(m_dev, i));
+		}
+
 		__try {
 			m_buffer = new Buffer(m_dev);
 		} __catch (exception_type &e) {
@@ -80,6 +194,9 @@ DeviceGeneric::DeviceGeneric(struct iio_context* context, std::string dev_name)
 			return Utils::compareNatural(lchn->getId(), rchn->getId());
 		});
 	}
+	m_known_values = getKnownValues(m_dev);
+	m_attribute_cache.assign(nb_cacheable_attributes * (1 + m_channel_list_in.size() + m_channel_list_out.size()),
+				 CACHED_VALUE());
 }
 
 DeviceGeneric::~DeviceGeneric()
@@ -160,10 +277,18 @@ string DeviceGeneric::getName()
 
 double DeviceGeneric::getDoubleValue(std::string attr)
 {
+	const CACHED_VALUE *cached = getCachedValue(attr, -1, false);
+	if (cached) {
+		return cached->number;
+	}
+	if (isCacheable(attr) || isStaged(attr, -1, false)) {
+		return toDouble(getStringValue(attr));
+	}
+
 	double value = 0;
 	std::string dev_name = getName();
 
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
 		iio_device_attr_read_double(m_dev, attr.c_str(),
 					    &value);
 	} else {
@@ -175,6 +300,14 @@ double DeviceGeneric::getDoubleValue(std::string attr)
 
 double DeviceGeneric::getDoubleValue(unsigned int chn_idx, std::string attr, bool output)
 {
+	const CACHED_VALUE *cached = getCachedValue(attr, chn_idx, output);
+	if (cached) {
+		return cached->number;
+	}
+	if (isCacheable(attr) || isStaged(attr, chn_idx, output)) {
+		return toDouble(getStringValue(chn_idx, attr, output));
+	}
+
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 
@@ -193,8 +326,13 @@ double DeviceGeneric::getDoubleValue(unsigned int chn_idx, std::string attr, boo
 
 double DeviceGeneric::setDoubleValue(double value, std::string attr)
 {
+	eraseCachedValue(attr, -1, false);
 	std::string dev_name = iio_device_get_name(m_dev);
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
+		if (stageValue(attr, false, 0, attr, false, fromDouble(value))) {
+			return value;
+		}
+		forgetKnownValue(attr);
 		iio_device_attr_write_double(m_dev, attr.c_str(),
 					     value);
 	} else {
@@ -206,6 +344,7 @@ double DeviceGeneric::setDoubleValue(double value, std::string attr)
 
 double DeviceGeneric::setDoubleValue(unsigned int chn_idx, double value, std::string attr, bool output)
 {
+	eraseCachedValue(attr, chn_idx, output);
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 	if (chn_idx >= nb_channels) {
@@ -220,16 +359,29 @@ double DeviceGeneric::setDoubleValue(unsigned int chn_idx, double value, std::st
 				" attribute for the selected channel");
 	}
 
+	std::string key = channelKey(chn_idx, attr, output);
+	if (stageValue(key, true, chn_idx, attr, output, fromDouble(value))) {
+		return value;
+	}
+	forgetKnownValue(key);
 	chn->setDoubleValue(attr, value);
 	return chn->getDoubleValue(attr);
 }
 
 int DeviceGeneric::getLongValue(std::string attr)
 {
+	const CACHED_VALUE *cached = getCachedValue(attr, -1, false);
+	if (cached) {
+		return cached->integer;
+	}
+	if (isCacheable(attr) || isStaged(attr, -1, false)) {
+		return toLongLong(getStringValue(attr));
+	}
+
 	long long value = 0;
 	std::string dev_name = getName();
 
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
 		iio_device_attr_read_longlong(m_dev, attr.c_str(),
 					      &value);
 	} else {
@@ -241,6 +393,14 @@ int DeviceGeneric::getLongValue(std::string attr)
 
 int DeviceGeneric::getLongValue(unsigned int chn_idx, std::string attr, bool output)
 {
+	const CACHED_VALUE *cached = getCachedValue(attr, chn_idx, output);
+	if (cached) {
+		return cached->integer;
+	}
+	if (isCacheable(attr) || isStaged(attr, chn_idx, output)) {
+		return toLongLong(getStringValue(chn_idx, attr, output));
+	}
+
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 
@@ -262,7 +422,7 @@ int DeviceGeneric::getBufferLongValue(std::string attr)
 	long long value = 0;
 	std::string dev_name = getName();
 
-	if (ContextImpl::iioDevBufferHasAttribute(m_dev, attr)) {
+	if (hasBufferAttribute(attr)) {
 		iio_device_buffer_attr_read_longlong(m_dev, attr.c_str(),
 						     &value);
 	} else {
@@ -274,8 +434,13 @@ int DeviceGeneric::getBufferLongValue(std::string attr)
 
 int DeviceGeneric::setLongValue(int value, std::string attr)
 {
+	eraseCachedValue(attr, -1, false);
 	std::string dev_name = iio_device_get_name(m_dev);
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
+		if (stageValue(attr, false, 0, attr, false, fromLongLong(value))) {
+			return value;
+		}
+		forgetKnownValue(attr);
 		iio_device_attr_write_longlong(m_dev, attr.c_str(),
 					       value);
 	} else {
@@ -287,6 +452,7 @@ int DeviceGeneric::setLongValue(int value, std::string attr)
 
 int DeviceGeneric::setLongValue(unsigned int chn_idx, int value, std::string attr, bool output)
 {
+	eraseCachedValue(attr, chn_idx, output);
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 	if (chn_idx >= nb_channels) {
@@ -301,6 +467,11 @@ int DeviceGeneric::setLongValue(unsigned int chn_idx, int value, std::string att
 				" attribute for the selected channel");
 	}
 
+	std::string key = channelKey(chn_idx, attr, output);
+	if (stageValue(key, true, chn_idx, attr, output, fromLongLong(value))) {
+		return value;
+	}
+	forgetKnownValue(key);
 	chn->setLongValue(attr, value);
 	return chn->getLongValue(attr);
 }
@@ -308,7 +479,7 @@ int DeviceGeneric::setLongValue(unsigned int chn_idx, int value, std::string att
 int DeviceGeneric::setBufferLongValue(int value, std::string attr)
 {
 	std::string dev_name = iio_device_get_name(m_dev);
-	if (ContextImpl::iioDevBufferHasAttribute(m_dev, attr)) {
+	if (hasBufferAttribute(attr)) {
 		iio_device_buffer_attr_write_longlong(m_dev, attr.c_str(),
 						      value);
 	} else {
@@ -320,10 +491,18 @@ int DeviceGeneric::setBufferLongValue(int value, std::string attr)
 
 bool DeviceGeneric::getBoolValue(string attr)
 {
+	const CACHED_VALUE *cached = getCachedValue(attr, -1, false);
+	if (cached) {
+		return (cached->integer != 0);
+	}
+	if (isCacheable(attr) || isStaged(attr, -1, false)) {
+		return (toLongLong(getStringValue(attr)) != 0);
+	}
+
 	bool value = 0;
 	std::string dev_name = getName();
 
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
 		iio_device_attr_read_bool(m_dev, attr.c_str(),
 					  &value);
 	} else {
@@ -335,6 +514,14 @@ bool DeviceGeneric::getBoolValue(string attr)
 
 bool DeviceGeneric::getBoolValue(unsigned int chn_idx, string attr, bool output)
 {
+	const CACHED_VALUE *cached = getCachedValue(attr, chn_idx, output);
+	if (cached) {
+		return (cached->integer != 0);
+	}
+	if (isCacheable(attr) || isStaged(attr, chn_idx, output)) {
+		return (toLongLong(getStringValue(chn_idx, attr, output)) != 0);
+	}
+
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 
@@ -355,8 +542,13 @@ bool DeviceGeneric::getBoolValue(unsigned int chn_idx, string attr, bool output)
 
 bool DeviceGeneric::setBoolValue(bool value, string attr)
 {
+	eraseCachedValue(attr, -1, false);
 	std::string dev_name = iio_device_get_name(m_dev);
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
+		if (stageValue(attr, false, 0, attr, false, fromLongLong(value))) {
+			return value;
+		}
+		forgetKnownValue(attr);
 		iio_device_attr_write_bool(m_dev, attr.c_str(), value);
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, dev_name +
@@ -368,6 +560,7 @@ bool DeviceGeneric::setBoolValue(bool value, string attr)
 
 bool DeviceGeneric::setBoolValue(unsigned int chn_idx, bool value, string attr, bool output)
 {
+	eraseCachedValue(attr, chn_idx, output);
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 	if (chn_idx >= nb_channels) {
@@ -382,14 +575,24 @@ bool DeviceGeneric::setBoolValue(unsigned int chn_idx, bool value, string attr,
 				" attribute for the selected channel");
 	}
 
+	std::string key = channelKey(chn_idx, attr, output);
+	if (stageValue(key, true, chn_idx, attr, output, fromLongLong(value))) {
+		return value;
+	}
+	forgetKnownValue(key);
 	chn->setBoolValue(attr, value);
 	return chn->getBoolValue(attr);
 }
 
 string DeviceGeneric::setStringValue(string attr, string value)
 {
+	eraseCachedValue(attr, -1, false);
 	std::string dev_name = iio_device_get_name(m_dev);
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
+		if (stageValue(attr, false, 0, attr, false, value)) {
+			return value;
+		}
+		forgetKnownValue(attr);
 		iio_device_attr_write(m_dev, attr.c_str(), value.c_str());
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, dev_name +
@@ -400,6 +603,7 @@ string DeviceGeneric::setStringValue(string attr, string value)
 
 string DeviceGeneric::setStringValue(unsigned int chn_idx, string attr, string value, bool output)
 {
+	eraseCachedValue(attr, chn_idx, output);
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 	if (chn_idx >= nb_channels) {
@@ -414,6 +618,11 @@ string DeviceGeneric::setStringValue(unsigned int chn_idx, string attr, string v
 				" attribute for the selected channel");
 	}
 
+	std::string key = channelKey(chn_idx, attr, output);
+	if (stageValue(key, true, chn_idx, attr, output, value)) {
+		return value;
+	}
+	forgetKnownValue(key);
 	chn->setStringValue(attr, value);
 	return chn->getStringValue(attr);
 }
@@ -421,20 +630,39 @@ string DeviceGeneric::setStringValue(unsigned int chn_idx, string attr, string v
 string DeviceGeneric::getStringValue(string attr)
 {
 	char value[100];
+	std::string staged;
+	if (getStagedValue(attr, -1, false, staged)) {
+		return staged;
+	}
+	const CACHED_VALUE *cached = getCachedValue(attr, -1, false);
+	if (cached) {
+		return cached->text;
+	}
+
 	std::string dev_name = getName();
 
-	if (ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (hasGlobalAttribute(attr)) {
 		iio_device_attr_read(m_dev, attr.c_str(),
 				     value, sizeof(value));
 	} else {
 		throw_exception(EXC_INVALID_PARAMETER, dev_name +
 				" has no " + attr + " attribute");
 	}
+	setCachedValue(attr, -1, false, value);
 	return std::string(value);
 }
 
 string DeviceGeneric::getStringValue(unsigned int chn_idx, string attr, bool output)
 {
+	std::string value;
+	if (getStagedValue(attr, chn_idx, output, value)) {
+		return value;
+	}
+	const CACHED_VALUE *cached = getCachedValue(attr, chn_idx, output);
+	if (cached) {
+		return cached->text;
+	}
+
 	unsigned int nb_channels = iio_device_get_channels_count(m_dev);
 	std::string dev_name = getName();
 
@@ -450,7 +678,9 @@ string DeviceGeneric::getStringValue(unsigned int chn_idx, string attr, bool out
 				" attribute for the selected channel");
 	}
 
-	return chn->getStringValue(attr);
+	value = chn->getStringValue(attr);
+	setCachedValue(attr, chn_idx, output, value);
+	return value;
 }
 
 std::vector<std::string> DeviceGeneric::getAvailableAttributeValues(const string &attr)
@@ -460,7 +690,7 @@ std::vector<std::string> DeviceGeneric::getAvailableAttributeValues(const string
 	std::vector<std::string> values;
 
 	dev_name = getName();
-	if (!ContextImpl::iioDevHasAttribute(m_dev, attr)) {
+	if (!hasGlobalAttribute(attr)) {
 		throw_exception(EXC_INVALID_PARAMETER, dev_name + " has no " + attr + " attribute");
 		return std::vector<std::string>();
 	}
@@ -606,10 +836,256 @@ void DeviceGeneric::setCyclic(bool enable)
 
 bool DeviceGeneric::hasGlobalAttribute(string attr)
 {
-	return ContextImpl::iioDevHasAttribute(m_dev, attr);
+	return m_dev_attributes.find(attr) != m_dev_attributes.end();
 }
 
 bool DeviceGeneric::hasBufferAttribute(string attr)
 {
-	return ContextImpl::iioDevBufferHasAttribute(m_dev, attr);
+	return m_buffer_attributes.find(attr) != m_buffer_attributes.end();
+}
+
+void DeviceGeneric::setAttributeCaching(bool enable)
+{
+	m_attribute_caching = enable;
+	invalidateAttributeCache();
+}
+
+bool DeviceGeneric::getAttributeCaching()
+{
+	return m_attribute_caching;
+}
+
+void DeviceGeneric::invalidateAttributeCache()
+{
+	for (auto &cached : m_attribute_cache) {
+		cached.valid = false;
+	}
+	m_known_values->clear();
+}
+
+/*
+ * The cache holds one slot per cacheable attribute for the device and for every channel;
+ * the slot of an attribute is found from its id and the index of the channel (-1 for the
+ * device), without building a key
+ */
+int DeviceGeneric::getCacheIndex(const std::string &attr, int chn_idx, bool output)
+{
+	if (!m_attribute_caching) {
+		return -1;
+	}
+	int id = cacheableAttributeId(attr);
+	if (id < 0) {
+		return -1;
+	}
+
+	unsigned int nb_in = m_channel_list_in.size();
+	unsigned int nb_out = m_channel_list_out.size();
+	unsigned int slot = 0;
+	if (chn_idx >= 0) {
+		if ((unsigned int)chn_idx >= (output ? nb_out : nb_in)) {
+			return -1;
+		}
+		slot = 1 + (output ? nb_in : 0) + chn_idx;
+	}
+	return id * (1 + nb_in + nb_out) + slot;
+}
+
+bool DeviceGeneric::isCacheable(const std::string &attr)
+{
+	return m_attribute_caching && (cacheableAttributeId(attr) >= 0);
+}
+
+std::string DeviceGeneric::channelKey(unsigned int chn_idx, const std::string &attr, bool output)
+{
+	return (output ? "out" : "in") + std::to_string(chn_idx) + "/" + attr;
+}
+
+/* The cached value, unless it is missing or a newer value is staged */
+const DeviceGeneric::CACHED_VALUE *DeviceGeneric::getCachedValue(const std::string &attr, int chn_idx, bool output)
+{
+	int index = getCacheIndex(attr, chn_idx, output);
+	if (index < 0 || !m_attribute_cache[index].valid || isStaged(attr, chn_idx, output)) {
+		return nullptr;
+	}
+	return &m_attribute_cache[index];
+}
+
+/* The value is parsed once, here, for the typed getters */
+void DeviceGeneric::setCachedValue(const std::string &attr, int chn_idx, bool output, const std::string &value)
+{
+	int index = getCacheIndex(attr, chn_idx, output);
+	if (index < 0) {
+		return;
+	}
+	CACHED_VALUE &cached = m_attribute_cache[index];
+	cached.text = value;
+	cached.number = toDouble(value);
+	cached.integer = toLongLong(value);
+	cached.valid = true;
+}
+
+void DeviceGeneric::eraseCachedValue(const std::string &attr, int chn_idx, bool output)
+{
+	int index = getCacheIndex(attr, chn_idx, output);
+	if (index >= 0) {
+		m_attribute_cache[index].valid = false;
+	}
+}
+
+void DeviceGeneric::beginTransaction()
+{
+	m_transaction_depth++;
+}
+
+/*
+ * Write the staged values, in the order they were first staged, skipping the ones
+ * equal to the value known to be on the device. A failed write does not stop the
+ * commit: the remaining values are still written and the failures are reported at
+ * the end.
+ */
+void DeviceGeneric::commitTransaction()
+{
+	if (m_transaction_depth == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: No transaction in progress");
+		return;
+	}
+	m_transaction_depth--;
+	if (m_transaction_depth > 0) {
+		return;
+	}
+
+	std::vector<STAGED_VALUE> staged;
+	staged.swap(m_staged_values);
+	m_staged_index.clear();
+
+	if (m_transaction_cancelled) {
+		m_transaction_cancelled = false;
+		throw_exception(EXC_INVALID_PARAMETER, "Device: The transaction was cancelled by a nested call");
+		return;
+	}
+
+	std::string failed;
+	for (auto &entry : staged) {
+		if (isKnownValue(entry.key, entry.value)) {
+			continue;
+		}
+		if (!writeStagedValue(entry)) {
+			failed += (failed.empty() ? "" : ", ") + entry.key;
+		}
+	}
+	if (!failed.empty()) {
+		throw_exception(EXC_INVALID_PARAMETER, getName() + ": Cannot write " + failed);
+	}
+}
+
+/*
+ * A nested cancel cannot undo only its own values, since they may overwrite the ones
+ * staged by the outer levels; the transaction is marked as failed instead
+ */
+void DeviceGeneric::cancelTransaction()
+{
+	if (m_transaction_depth == 0) {
+		return;
+	}
+	m_transaction_depth--;
+	if (m_transaction_depth > 0) {
+		m_transaction_cancelled = true;
+		return;
+	}
+	m_transaction_cancelled = false;
+	m_staged_values.clear();
+	m_staged_index.clear();
+}
+
+bool DeviceGeneric::isTransactionOpen()
+{
+	return m_transaction_depth > 0;
+}
+
+bool DeviceGeneric::isTransactionCancelled()
+{
+	return m_transaction_cancelled;
+}
+
+bool DeviceGeneric::isKnownValue(const std::string &key, const std::string &value)
+{
+	auto known = m_known_values->find(key);
+	return (known != m_known_values->end()) && sameValue(known->second, value);
+}
+
+void DeviceGeneric::forgetKnownValue(const std::string &key)
+{
+	m_known_values->erase(key);
+}
+
+/* Write a staged value and remember the value the device settled on */
+bool DeviceGeneric::writeStagedValue(const STAGED_VALUE &entry)
+{
+	char value[100];
+	ssize_t ret;
+	struct iio_channel *chn = nullptr;
+
+	eraseCachedValue(entry.attr, entry.channel ? (int)entry.chn_idx : -1, entry.output);
+	forgetKnownValue(entry.key);
+	if (entry.channel) {
+		chn = getChannel(entry.chn_idx, entry.output)->getChannel();
+		ret = iio_channel_attr_write(chn, entry.attr.c_str(), entry.value.c_str());
+	} else {
+		ret = iio_device_attr_write(m_dev, entry.attr.c_str(), entry.value.c_str());
+	}
+	if (ret < 0) {
+		return false;
+	}
+
+	if (chn) {
+		ret = iio_channel_attr_read(chn, entry.attr.c_str(), value, sizeof(value));
+	} else {
+		ret = iio_device_attr_read(m_dev, entry.attr.c_str(), value, sizeof(value));
+	}
+	if (ret < 0) {
+		return true;
+	}
+	(*m_known_values)[entry.key] = value;
+	return true;
+}
+
+/* Nothing is staged outside of a transaction; the key is built only when some values are */
+bool DeviceGeneric::isStaged(const std::string &attr, int chn_idx, bool output)
+{
+	if (m_staged_values.empty()) {
+		return false;
+	}
+	std::string key = (chn_idx < 0) ? attr : channelKey(chn_idx, attr, output);
+	return m_staged_index.find(key) != m_staged_index.end();
+}
+
+bool DeviceGeneric::stageValue(const std::string &key, bool channel, unsigned int chn_idx,
+			       const std::string &attr, bool output, const std::string &value)
+{
+	if (m_transaction_depth == 0) {
+		return false;
+	}
+
+	auto it = m_staged_index.find(key);
+	if (it != m_staged_index.end()) {
+		m_staged_values.at(it->second).value = value;
+	} else {
+		m_staged_index[key] = m_staged_values.size();
+		m_staged_values.push_back({key, channel, chn_idx, output, attr, value});
+	}
+	return true;
+}
+
+bool DeviceGeneric::getStagedValue(const std::string &attr, int chn_idx, bool output, std::string &value)
+{
+	if (m_staged_values.empty()) {
+		return false;
+	}
+	std::string key = (chn_idx < 0) ? attr : channelKey(chn_idx, attr, output);
+	auto it = m_staged_index.find(key);
+	if (it == m_staged_index.end()) {
+		return false;
+	}
+	value = m_staged_values.at(it->second).value;
+	return true;
 }
@@ -27,6 +27,8 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <unordered_set>
+#include <unordered_map>
 #include <libm2k/m2kglobal.hpp>
 
 namespace libm2k {
@@ -102,12 +104,70 @@ public:
 	virtual bool hasGlobalAttribute(std::string attr);
 	virtual bool hasBufferAttribute(std::string attr);
 
+	/* Serve the attributes changed only by the library (sampling_frequency, oversampling_ratio,
+	 * gain, calibbias, calibscale) from a write-through cache instead of reading them back */
+	virtual void setAttributeCaching(bool enable);
+	virtual bool getAttributeCaching();
+	virtual void invalidateAttributeCache();
+
+	/* Stage the attribute writes until the outermost commitTransaction; the committed
+	 * values are diffed against the values read back after the last writes, shared by all
+	 * the wrappers of the iio_device, and only the changed ones are sent. A nested
+	 * cancelTransaction fails the whole transaction: the outermost commitTransaction
+	 * drops the staged values and throws. */
+	virtual void beginTransaction();
+	virtual void commitTransaction();
+	virtual void cancelTransaction();
+	virtual bool isTransactionOpen();
+	virtual bool isTransactionCancelled();
+
 protected:
 	struct iio_context *m_context;
 	struct iio_device *m_dev;
 	std::vector<Channel*> m_channel_list_in;
 	std::vector<Channel*> m_channel_list_out;
 	Buffer* m_buffer;
+
+private:
+	struct CACHED_VALUE {
+		bool valid = false;
+		double number = 0;
+		long long integer = 0;
+		std::string text;
+	};
+
+	struct STAGED_VALUE {
+		std::string key;
+		bool channel;
+		unsigned int chn_idx;
+		bool output;
+		std::string attr;
+		std::string value;
+	};
+
+	std::unordered_set<std::string> m_dev_attributes;
+	std::unordered_set<std::string> m_buffer_attributes;
+	std::vector<CACHED_VALUE> m_attribute_cache;
+	bool m_attribute_caching;
+	unsigned int m_transaction_depth;
+	bool m_transaction_cancelled;
+	std::vector<STAGED_VALUE> m_staged_values;
+	std::unordered_map<std::string, size_t> m_staged_index;
+	std::shared_ptr<std::unordered_map<std::string, std::string>> m_known_values;
+
+	int getCacheIndex(const std::string &attr, int chn_idx, bool output);
+	bool isCacheable(const std::string &attr);
+	std::string channelKey(unsigned int chn_idx, const std::string &attr, bool output);
+	const CACHED_VALUE *getCachedValue(const std::string &attr, int chn_idx, bool output);
+	void setCachedValue(const std::string &attr, int chn_idx, bool output, const std::string &value);
+	void eraseCachedValue(const std::string &attr, int chn_idx, bool output);
+	bool isStaged(const std::string &attr, int chn_idx, bool output);
+	bool stageValue(const std::string &key, bool channel, unsigned int chn_idx,
+			const std::string &attr, bool output, const std::string &value);
+	bool getStagedValue(const std::string &attr, int chn_idx, bool output, std::string &value);
+	bool isKnownValue(const std::string &key, const std::string &value);
+	void forgetKnownValue(const std::string &key);
+	bool writeStagedValue(const STAGED_VALUE &entry);
 };
 }
 }
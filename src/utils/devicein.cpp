@@ -27,6 +27,8 @@
 #include <libm2k/context.hpp>
 #include <algorithm>
 #include <string>
+#include <cstring>
+#include <chrono>
 
 using namespace std;
 using namespace libm2k::utils;
@@ -35,14 +37,25 @@ using namespace libm2k::context;
 
 /** Represents an iio_device **/
 DeviceIn::DeviceIn(struct iio_context* context, std::string dev_name) :
-	DeviceGeneric(context, dev_name)
+	DeviceGeneric(context, dev_name),
+	m_stream_stop(false),
+	m_stream_running(false),
+	m_stream_block_in_use(false),
+	m_stream_blocks_acquired(0),
+	m_stream_blocks_delivered(0),
+	m_stream_overruns(0)
 {
 	m_channel_list = m_channel_list_in;
 }
 
 void DeviceIn::initializeBuffer(unsigned int nb_samples)
 {
+	checkStreamingStopped();
 	m_buffer->initializeBuffer(nb_samples, false);
+	if (!m_buffer->getBuffer()) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not create the RX buffer for streaming");
+		return;
+	}
 }
 
 void DeviceIn::cancelBuffer()
@@ -56,6 +69,7 @@ void DeviceIn::cancelBuffer()
 
 DeviceIn::~DeviceIn()
 {
+	stopStreaming();
 	m_channel_list.clear();
 }
 
@@ -65,6 +79,7 @@ std::vector<unsigned short> DeviceIn::getSamplesShort(unsigned int nb_samples)
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Cannot refill; device not buffer capable");
 		return std::vector<unsigned short>();
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
 	return m_buffer->getSamples(nb_samples);
 
@@ -76,20 +91,22 @@ const unsigned short* DeviceIn::getSamplesP(unsigned int nb_samples)
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
 		return nullptr;
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
 	return m_buffer->getSamplesP(nb_samples);
 
 }
 
 std::vector<std::vector<double> > DeviceIn::getSamples(unsigned int nb_samples,
-						       const std::function<double(int16_t, unsigned int)> &process)
+						       const std::vector<CHANNEL_COEFFICIENTS> &coefficients)
 {
 	if (!m_buffer) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Cannot refill; device not buffer capable");
 		std::vector<std::vector<double>>();
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
-	return m_buffer->getSamples(nb_samples, process);
+	return m_buffer->getSamples(nb_samples, coefficients);
 }
 
 void* DeviceIn::getSamplesRawInterleavedVoid(unsigned int nb_samples)
@@ -98,36 +115,48 @@ void* DeviceIn::getSamplesRawInterleavedVoid(unsigned int nb_samples)
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
 		return nullptr;
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
 	return m_buffer->getSamplesRawInterleavedVoid(nb_samples);
 }
 
-const double *DeviceIn::getSamplesInterleaved(unsigned int nb_samples,
-					      const std::function<double(int16_t, unsigned int)> &process)
+void DeviceIn::getSamplesInterleaved(double *data, unsigned int nb_samples,
+				     const std::vector<CHANNEL_COEFFICIENTS> &coefficients)
 {
 	if (!m_buffer) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
-		return nullptr;
+		return;
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
-	return m_buffer->getSamplesInterleaved(nb_samples, process);
+	m_buffer->getSamplesInterleaved(data, nb_samples, coefficients);
 }
 
-void DeviceIn::getSamples(std::vector<std::vector<double> > &data, unsigned int nb_samples,
-			  const std::function<double(int16_t, unsigned int)> &process)
+template <typename T>
+void DeviceIn::getSamples(std::vector<std::vector<T> > &data, unsigned int nb_samples,
+			  const std::vector<CHANNEL_COEFFICIENTS> &coefficients)
 {
 	if (!m_buffer) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Cannot refill; device not buffer capable");
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
-	m_buffer->getSamples(data, nb_samples, process);
+	m_buffer->getSamples(data, nb_samples, coefficients);
 }
 
+template void DeviceIn::getSamples<double>(std::vector<std::vector<double>> &, unsigned int,
+					   const std::vector<CHANNEL_COEFFICIENTS> &);
+template void DeviceIn::getSamples<float>(std::vector<std::vector<float>> &, unsigned int,
+					  const std::vector<CHANNEL_COEFFICIENTS> &);
+template void DeviceIn::getSamples<short>(std::vector<std::vector<short>> &, unsigned int,
+					  const std::vector<CHANNEL_COEFFICIENTS> &);
+
 void DeviceIn::getSamples(std::vector<unsigned short> &data, unsigned int nb_samples)
 {
 	if (!m_buffer) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Cannot refill; device not buffer capable");
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
 	m_buffer->getSamples(data, nb_samples);
 }
@@ -138,18 +167,50 @@ const short *DeviceIn::getSamplesRawInterleaved(unsigned int nb_samples)
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
 		return nullptr;
 	}
+	checkStreamingStopped();
 	m_buffer->setChannels(m_channel_list);
 	return m_buffer->getSamplesRawInterleaved(nb_samples);
 }
 
+std::vector<libm2k::SAMPLE_VIEW<short>> DeviceIn::getSamplesView(unsigned int nb_samples)
+{
+	if (!m_buffer) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
+		return std::vector<libm2k::SAMPLE_VIEW<short>>();
+	}
+	checkStreamingStopped();
+	m_buffer->setChannels(m_channel_list);
+	return m_buffer->getSamplesView(nb_samples);
+}
+
+libm2k::SAMPLE_VIEW<unsigned short> DeviceIn::getSamplesViewShort(unsigned int nb_samples)
+{
+	if (!m_buffer) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
+		return libm2k::SAMPLE_VIEW<unsigned short>{nullptr, 0, 0};
+	}
+	checkStreamingStopped();
+	m_buffer->setChannels(m_channel_list);
+	return m_buffer->getSamplesViewShort(nb_samples);
+}
+
 void DeviceIn::flushBuffer()
 {
 	if (!m_buffer) {
 		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not refill; device not buffer capable");
 	}
+	checkStreamingStopped();
 	m_buffer->flushBuffer();
 }
 
+/* The refill thread uses the buffer without a lock until stopStreaming joins it */
+void DeviceIn::checkStreamingStopped()
+{
+	if (m_stream_thread.joinable()) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not use the RX buffer; streaming in progress");
+	}
+}
+
 struct libm2k::IIO_OBJECTS DeviceIn::getIioObjects()
 {
 	IIO_OBJECTS iio_object = {};
@@ -162,3 +223,258 @@ struct libm2k::IIO_OBJECTS DeviceIn::getIioObjects()
 	iio_object.context = m_context;
 	return iio_object;
 }
+
+void DeviceIn::startStreaming(unsigned int nb_samples, unsigned int queue_depth,
+			      std::function<void(const libm2k::STREAMING_BLOCK &)> callback,
+			      std::function<void(const short *, unsigned long long)> hook)
+{
+	if (!m_buffer) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Can not stream; device not buffer capable");
+		return;
+	}
+	if (m_stream_thread.joinable()) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Streaming already started");
+		return;
+	}
+	if (nb_samples == 0 || queue_depth == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Invalid streaming block size or queue depth");
+		return;
+	}
+
+	ssize_t sample_size = iio_device_get_sample_size(m_dev);
+	if (sample_size <= 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: No channel enabled for streaming");
+		return;
+	}
+
+	/* The IIO buffer is created here, before the threads start; they only refill it and
+	 * stopStreaming can cancel it from this thread without racing with its creation */
+	m_buffer->setChannels(m_channel_list);
+	m_buffer->initializeBuffer(nb_samples, false);
+	size_t block_size = (nb_samples * sample_size) / sizeof(short);
+	m_stream_queue = std::unique_ptr<BlockQueue<short>>(new BlockQueue<short>(queue_depth, block_size));
+	m_stream_slots.assign(m_stream_queue->slots(), STREAM_SLOT());
+	m_stream_block_in_use = false;
+	m_stream_error.clear();
+	m_stream_timing = STREAMING_STATISTICS();
+	m_stream_blocks_acquired = 0;
+	m_stream_blocks_delivered = 0;
+	m_stream_overruns = 0;
+	m_stream_callback = callback;
+	m_stream_hook = hook;
+	m_stream_stop = false;
+	m_stream_running = true;
+	m_stream_thread = std::thread(&DeviceIn::streamingThread, this, nb_samples);
+	if (m_stream_callback) {
+		m_stream_callback_thread = std::thread(&DeviceIn::callbackThread, this, nb_samples);
+	}
+}
+
+void DeviceIn::stopStreaming()
+{
+	if (!m_stream_thread.joinable()) {
+		return;
+	}
+	m_stream_stop = true;
+	m_buffer->cancelBuffer();
+	m_stream_thread.join();
+	if (m_stream_callback_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+		}
+		m_stream_cond.notify_all();
+		m_stream_callback_thread.join();
+	}
+
+	/* A cancelled buffer can not be refilled again */
+	m_buffer->flushBuffer();
+	m_stream_queue.reset();
+	m_stream_callback = nullptr;
+	m_stream_hook = nullptr;
+	m_stream_block_in_use = false;
+}
+
+/* The streaming lasts until stopStreaming, also when the threads ended on an error:
+ * the buffer and the threads are only released there */
+bool DeviceIn::isStreaming()
+{
+	return m_stream_thread.joinable();
+}
+
+void DeviceIn::streamingThread(unsigned int nb_samples)
+{
+	size_t block_bytes = m_stream_queue->blockSize() * sizeof(short);
+
+	while (!m_stream_stop) {
+		void *data = nullptr;
+		auto start = std::chrono::steady_clock::now();
+		__try {
+			data = m_buffer->getSamplesRawInterleavedVoid(nb_samples);
+		} __catch (exception_type &e) {
+			if (!m_stream_stop) {
+				std::lock_guard<std::mutex> lock(m_stream_mutex);
+				m_stream_error = e.what();
+			}
+			break;
+		}
+		if (!data) {
+			break;
+		}
+		auto acquired = std::chrono::steady_clock::now();
+		double latency = std::chrono::duration<double>(acquired - start).count();
+		unsigned long long index = m_stream_blocks_acquired++;
+
+		short *block = m_stream_queue->beginWrite();
+		if (block) {
+			memcpy(block, iio_buffer_start(m_buffer->getBuffer()), block_bytes);
+			STREAM_SLOT &slot = m_stream_slots[m_stream_queue->writeSlot()];
+			slot.acquired = acquired;
+			slot.index = index;
+			m_stream_queue->endWrite();
+		} else {
+			m_stream_overruns++;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			m_stream_timing.last_refill_latency = latency;
+			m_stream_timing.max_refill_latency = std::max(m_stream_timing.max_refill_latency, latency);
+			m_stream_timing.total_refill_latency += latency;
+		}
+		if (block) {
+			m_stream_cond.notify_all();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_stream_mutex);
+		m_stream_running = false;
+	}
+	m_stream_cond.notify_all();
+}
+
+void DeviceIn::callbackThread(unsigned int nb_samples)
+{
+	unsigned int nb_channels = m_stream_queue->blockSize() / nb_samples;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_stream_mutex);
+			m_stream_cond.wait(lock, [this] {
+				return !m_stream_queue->empty() || !m_stream_running || m_stream_stop;
+			});
+		}
+		const short *raw = m_stream_queue->front();
+		if (m_stream_stop || !raw) {
+			break;
+		}
+
+		const STREAM_SLOT &slot = m_stream_slots[m_stream_queue->readSlot()];
+		libm2k::STREAMING_BLOCK block = {raw, nullptr, nb_samples, nb_channels, slot.index,
+						 slot.index * nb_samples};
+		if (!deliverStreamingBlock(block, slot)) {
+			break;
+		}
+		m_stream_queue->pop();
+		m_stream_blocks_delivered++;
+	}
+}
+
+/* Returns false when the hook or the callback failed; the acquisition is then stopped */
+bool DeviceIn::deliverStreamingBlock(const libm2k::STREAMING_BLOCK &block, const STREAM_SLOT &slot)
+{
+	double delay = std::chrono::duration<double>(std::chrono::steady_clock::now() - slot.acquired).count();
+	{
+		std::lock_guard<std::mutex> lock(m_stream_mutex);
+		m_stream_timing.last_callback_delay = delay;
+		m_stream_timing.max_callback_delay = std::max(m_stream_timing.max_callback_delay, delay);
+	}
+
+	__try {
+		if (m_stream_hook) {
+			m_stream_hook(block.raw, block.index);
+		}
+		m_stream_callback(block);
+	} __catch (exception_type &e) {
+		/* A failing consumer stops the acquisition; the error is kept for the caller */
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			m_stream_error = std::string("callback: ") + e.what();
+		}
+		m_stream_stop = true;
+		m_buffer->cancelBuffer();
+		return false;
+	}
+	return true;
+}
+
+const short *DeviceIn::popStreamingBlock(unsigned int timeout_ms)
+{
+	if (!m_stream_queue) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Streaming not started");
+		return nullptr;
+	}
+	if (m_stream_callback) {
+		throw_exception(EXC_INVALID_PARAMETER, "Device: Streaming blocks are delivered to the callback");
+		return nullptr;
+	}
+
+	/* The block handed out previously is released only now, so the
+	 * caller can use it until the next pop without copying it */
+	if (m_stream_block_in_use) {
+		m_stream_queue->pop();
+		m_stream_block_in_use = false;
+	}
+
+	std::unique_lock<std::mutex> lock(m_stream_mutex);
+	m_stream_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {
+		return !m_stream_queue->empty() || !m_stream_running;
+	});
+	std::string error = m_stream_error;
+	lock.unlock();
+
+	const short *block = m_stream_queue->front();
+	if (!block) {
+		if (!error.empty()) {
+			throw_exception(EXC_RUNTIME_ERROR, "Device: Streaming stopped; " + error);
+		}
+		return nullptr;
+	}
+	if (m_stream_hook) {
+		m_stream_hook(block, m_stream_slots[m_stream_queue->readSlot()].index);
+	}
+	m_stream_block_in_use = true;
+	m_stream_blocks_delivered++;
+	return block;
+}
+
+size_t DeviceIn::getStreamingBlockSize()
+{
+	return m_stream_queue ? m_stream_queue->blockSize() : 0;
+}
+
+struct libm2k::STREAMING_STATISTICS DeviceIn::getStreamingStatistics()
+{
+	STREAMING_STATISTICS stats = {};
+	stats.blocks_acquired = m_stream_blocks_acquired;
+	stats.blocks_delivered = m_stream_blocks_delivered;
+	stats.overruns = m_stream_overruns;
+	if (m_stream_queue) {
+		stats.queue_depth = m_stream_queue->size();
+		stats.queue_capacity = m_stream_queue->capacity();
+	}
+
+	std::lock_guard<std::mutex> lock(m_stream_mutex);
+	stats.last_refill_latency = m_stream_timing.last_refill_latency;
+	stats.max_refill_latency = m_stream_timing.max_refill_latency;
+	stats.total_refill_latency = m_stream_timing.total_refill_latency;
+	stats.last_callback_delay = m_stream_timing.last_callback_delay;
+	stats.max_callback_delay = m_stream_timing.max_callback_delay;
+	return stats;
+}
+
+std::string DeviceIn::getStreamingError()
+{
+	std::lock_guard<std::mutex> lock(m_stream_mutex);
+	return m_stream_error;
+}
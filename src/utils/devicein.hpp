@@ -28,8 +28,15 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <libm2k/m2kglobal.hpp>
 #include "devicegeneric.hpp"
+#include "blockqueue.hpp"
+#include "conversion.hpp"
 #include <libm2k/enums.hpp>
 
 using namespace std;
@@ -48,22 +55,70 @@ public:
 	std::vector<unsigned short> getSamplesShort(unsigned int nb_samples);
 	const unsigned short* getSamplesP(unsigned int nb_samples);
 	std::vector<std::vector<double> > getSamples(unsigned int nb_samples,
-					const std::function<double (int16_t, unsigned int)> &process);
-	const double *getSamplesInterleaved(unsigned int nb_samples,
-					const std::function<double (int16_t, unsigned int)> &process);
+					const std::vector<CHANNEL_COEFFICIENTS> &coefficients);
+	void getSamplesInterleaved(double *data, unsigned int nb_samples,
+					const std::vector<CHANNEL_COEFFICIENTS> &coefficients);
 	const short *getSamplesRawInterleaved(unsigned int nb_samples);
 	void* getSamplesRawInterleavedVoid(unsigned int nb_samples);
 
-	void getSamples(std::vector<std::vector<double>> &data, unsigned int nb_samples,
-			const std::function<double (int16_t, unsigned int)> &process);
+	std::vector<libm2k::SAMPLE_VIEW<short>> getSamplesView(unsigned int nb_samples);
+	libm2k::SAMPLE_VIEW<unsigned short> getSamplesViewShort(unsigned int nb_samples);
+
+	/* T is double, float or short (raw codes), see Buffer::getSamples */
+	template <typename T>
+	void getSamples(std::vector<std::vector<T>> &data, unsigned int nb_samples,
+			const std::vector<CHANNEL_COEFFICIENTS> &coefficients);
 	void getSamples(std::vector<unsigned short> &data, unsigned int nb_samples);
 
 	void initializeBuffer(unsigned int nb_samples);
 	void cancelBuffer();
 	void flushBuffer();
 	struct IIO_OBJECTS getIioObjects();
+
+	/* Continuous acquisition: a dedicated thread keeps refilling the buffer and
+	 * queues the raw interleaved blocks; a single consumer pops them in order.
+	 * With a callback, a second thread hands every queued block to it in place.
+	 * The hook, when set, sees every block before the consumer, on the consumer
+	 * thread, with the index of the block; the instruments run their analyses there */
+	void startStreaming(unsigned int nb_samples, unsigned int queue_depth,
+			    std::function<void(const libm2k::STREAMING_BLOCK &)> callback = nullptr,
+			    std::function<void(const short *, unsigned long long)> hook = nullptr);
+	void stopStreaming();
+	bool isStreaming();
+	const short *popStreamingBlock(unsigned int timeout_ms);
+	size_t getStreamingBlockSize();
+	struct libm2k::STREAMING_STATISTICS getStreamingStatistics();
+	std::string getStreamingError();
 private:
+	struct STREAM_SLOT {
+		std::chrono::steady_clock::time_point acquired;
+		unsigned long long index;
+	};
+
 	std::vector<Channel*> m_channel_list;
+
+	std::unique_ptr<BlockQueue<short>> m_stream_queue;
+	std::thread m_stream_thread;
+	std::atomic<bool> m_stream_stop;
+	std::atomic<bool> m_stream_running;
+	bool m_stream_block_in_use;
+	std::string m_stream_error;
+	std::mutex m_stream_mutex;
+	std::condition_variable m_stream_cond;
+	std::atomic<unsigned long long> m_stream_blocks_acquired;
+	std::atomic<unsigned long long> m_stream_blocks_delivered;
+	std::atomic<unsigned long long> m_stream_overruns;
+	/* Refill and callback timings, guarded by m_stream_mutex */
+	struct libm2k::STREAMING_STATISTICS m_stream_timing;
+	std::vector<STREAM_SLOT> m_stream_slots;
+	std::thread m_stream_callback_thread;
+	std::function<void(const libm2k::STREAMING_BLOCK &)> m_stream_callback;
+	std::function<void(const short *, unsigned long long)> m_stream_hook;
+
+	void checkStreamingStopped();
+	void streamingThread(unsigned int nb_samples);
+	void callbackThread(unsigned int nb_samples);
+	bool deliverStreamingBlock(const libm2k::STREAMING_BLOCK &block, const STREAM_SLOT &slot);
 };
 }
 }
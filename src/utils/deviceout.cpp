@@ -122,6 +122,25 @@ void DeviceOut::push(short *data, unsigned int channel, unsigned int nb_samples,
 	m_buffer->push(data, channel, nb_samples, cyclic);
 }
 
+void *DeviceOut::acquireBuffer(unsigned int nb_samples, bool cyclic)
+{
+	if (!m_buffer) {
+		throw_exception(EXC_RUNTIME_ERROR, "Device: Can not push; device not buffer capable");
+		return nullptr;
+	}
+	m_buffer->setChannels(m_channel_list);
+	return m_buffer->acquireBuffer(nb_samples, cyclic);
+}
+
+void DeviceOut::commitBuffer()
+{
+	if (!m_buffer) {
+		throw_exception(EXC_RUNTIME_ERROR, "Device: Can not push; device not buffer capable");
+		return;
+	}
+	m_buffer->commitBuffer();
+}
+
 void DeviceOut::stop()
 {
 	if (m_buffer) {
@@ -150,3 +169,12 @@ struct libm2k::IIO_OBJECTS DeviceOut::getIioObjects()
 	iio_object.context = m_context;
 	return iio_object;
 }
+
+struct libm2k::BUFFER_STATISTICS DeviceOut::getBufferStatistics()
+{
+	if (!m_buffer) {
+		throw_exception(EXC_RUNTIME_ERROR, "Device: not buffer capable");
+		return BUFFER_STATISTICS{};
+	}
+	return m_buffer->getStatistics();
+}
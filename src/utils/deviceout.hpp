@@ -54,10 +54,14 @@ public:
 	void push(std::vector<double> const &data, unsigned int channel, bool cyclic = true);
 	void push(double *data, unsigned int channel, unsigned int nb_samples, bool cyclic = true);
 	void push(short *data, unsigned int channel, unsigned int nb_samples, bool cyclic = true);
+
+	void *acquireBuffer(unsigned int nb_samples, bool cyclic = true);
+	void commitBuffer();
 	void stop();
 	void cancelBuffer();
 	void setKernelBuffersCount(unsigned int count);
 	struct IIO_OBJECTS getIioObjects();
+	struct libm2k::BUFFER_STATISTICS getBufferStatistics();
 
 private:
 	std::vector<Channel*> m_channel_list;
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "measurement.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace libm2k::utils;
+using namespace libm2k::analog;
+
+MeasurementAccumulator::MeasurementAccumulator()
+{
+	reset();
+}
+
+void MeasurementAccumulator::reset()
+{
+	m_statistics = SAMPLE_STATISTICS{0, 0, 0, std::numeric_limits<short>::max(),
+					 std::numeric_limits<short>::min()};
+	restartPeriods();
+}
+
+void MeasurementAccumulator::restart()
+{
+	m_level_known = false;
+	m_high = false;
+	m_rising_seen = false;
+	m_position = 0;
+	m_last_rising = 0;
+	m_high_since_rising = 0;
+}
+
+void MeasurementAccumulator::restartPeriods()
+{
+	m_periods = 0;
+	m_period_samples = 0;
+	m_period_high_samples = 0;
+	m_reference_middle = 0;
+	m_reference_half_band = 0;
+	restart();
+}
+
+void MeasurementAccumulator::update(const short *src, std::ptrdiff_t step, unsigned int nb_samples)
+{
+	if (nb_samples == 0) {
+		return;
+	}
+	/* The statistics come first, so the crossing levels already include this block */
+	Conversion::accumulate(src, step, nb_samples, m_statistics);
+	scanCrossings(src, step, nb_samples);
+}
+
+/*
+ * Two levels around the middle of the range seen so far, 10% of the peak-to-peak
+ * amplitude apart, keep the noise around the middle from producing extra edges.
+ * Until the range has been seen whole (the first period, or the first block of a
+ * slow signal) the levels still move: when they leave the band the periods were
+ * counted in, the edges found so far are no longer trusted and the count starts over
+ */
+void MeasurementAccumulator::scanCrossings(const short *src, std::ptrdiff_t step, unsigned int nb_samples)
+{
+	int min = m_statistics.min;
+	int max = m_statistics.max;
+	int half_band = std::max((max - min) / 20, 1);
+	int middle = min + (max - min) / 2;
+	if (m_reference_half_band == 0 || std::abs(middle - m_reference_middle) > m_reference_half_band / 2 ||
+			2 * half_band > 3 * m_reference_half_band) {
+		restartPeriods();
+		m_reference_middle = middle;
+		m_reference_half_band = half_band;
+	}
+	int upper = middle + half_band;
+	int lower = middle - half_band;
+
+	unsigned long long position = m_position;
+	unsigned int i = 0;
+	/* The first samples of a run only settle the level; starting above it is not an edge */
+	if (!m_level_known) {
+		for (; i < nb_samples && !m_level_known; i++) {
+			int v = src[i * step];
+			if (v >= upper || v <= lower) {
+				m_level_known = true;
+				m_high = (v >= upper);
+			}
+		}
+	}
+
+	/* Jump from one crossing to the next; the samples in between keep the level */
+	bool high = m_high;
+	unsigned long long high_since_rising = m_high_since_rising;
+	while (i < nb_samples) {
+		if (high) {
+			unsigned int next = i + Conversion::find(src + i * step, step, nb_samples - i,
+								   std::numeric_limits<short>::min(), lower);
+			high_since_rising += next - i;
+			high = (next == nb_samples);
+			i = next + 1;
+			continue;
+		}
+		unsigned int next = i + Conversion::find(src + i * step, step, nb_samples - i,
+							   upper, std::numeric_limits<short>::max());
+		if (next == nb_samples) {
+			break;
+		}
+		if (m_rising_seen) {
+			m_periods++;
+			m_period_samples += position + next - m_last_rising;
+			m_period_high_samples += high_since_rising;
+		}
+		m_rising_seen = true;
+		m_last_rising = position + next;
+		high_since_rising = 0;
+		high = true;
+		i = next;
+	}
+	m_high = high;
+	m_high_since_rising = high_since_rising;
+	m_position = position + nb_samples;
+}
+
+const SAMPLE_STATISTICS &MeasurementAccumulator::getStatistics() const
+{
+	return m_statistics;
+}
+
+MEASUREMENT_RESULTS MeasurementAccumulator::getResults(const CHANNEL_COEFFICIENTS &coefficients,
+						       double sample_rate) const
+{
+	MEASUREMENT_RESULTS results = {};
+	unsigned long long n = m_statistics.nb_samples;
+	if (n == 0) {
+		return results;
+	}
+
+	double scale = coefficients.scale;
+	double offset = coefficients.offset;
+	double mean = (double)m_statistics.sum / n;
+	double mean_square = (double)m_statistics.sum_squares / n;
+	double variance = std::max(mean_square - mean * mean, 0.0);
+	double low = m_statistics.min * scale + offset;
+	double high = m_statistics.max * scale + offset;
+
+	results.nb_samples = n;
+	results.mean = mean * scale + offset;
+	results.rms = std::sqrt(std::max(scale * scale * mean_square + 2 * scale * offset * mean + offset * offset, 0.0));
+	results.ac_rms = std::fabs(scale) * std::sqrt(variance);
+	results.min = std::min(low, high);
+	results.max = std::max(low, high);
+	results.peak_to_peak = results.max - results.min;
+	if (m_periods > 0 && m_period_samples > 0 && sample_rate > 0) {
+		double duty = (double)m_period_high_samples / m_period_samples;
+		results.period = (double)m_period_samples / m_periods / sample_rate;
+		results.frequency = 1.0 / results.period;
+		/* A negative scale inverts the waveform */
+		results.duty_cycle = (scale < 0) ? 1.0 - duty : duty;
+	}
+	return results;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEASUREMENT_HPP
+#define MEASUREMENT_HPP
+
+#include <libm2k/analog/enums.hpp>
+#include "conversion.hpp"
+
+namespace libm2k {
+namespace utils {
+
+/**
+ * Waveform measurements of one channel, accumulated over consecutive blocks of raw
+ * samples. Every block goes through a single vectorized pass for the count, sum, sum
+ * of squares, minimum and maximum, then through a scan for the crossings of the
+ * middle level; the conversion to Volts is only done when the results are requested.
+ */
+class MeasurementAccumulator
+{
+public:
+	MeasurementAccumulator();
+
+	/* src[i * step] continues the samples of the previous update */
+	void update(const short *src, std::ptrdiff_t step, unsigned int nb_samples);
+
+	/* The next samples do not follow the previous ones (e.g. dropped block); the statistics are kept */
+	void restart();
+
+	void reset();
+
+	const SAMPLE_STATISTICS &getStatistics() const;
+	libm2k::analog::MEASUREMENT_RESULTS getResults(const CHANNEL_COEFFICIENTS &coefficients,
+						       double sample_rate) const;
+
+private:
+	SAMPLE_STATISTICS m_statistics;
+
+	/* Levels the periods below were counted against; a half band of 0 when none yet */
+	int m_reference_middle;
+	int m_reference_half_band;
+
+	/* Crossing state of the current run of contiguous samples */
+	bool m_level_known;
+	bool m_high;
+	bool m_rising_seen;
+	unsigned long long m_position;
+	unsigned long long m_last_rising;
+	unsigned long long m_high_since_rising;
+
+	/* Complete periods, from one rising edge to the next */
+	unsigned long long m_periods;
+	unsigned long long m_period_samples;
+	unsigned long long m_period_high_samples;
+
+	void restartPeriods();
+	void scanCrossings(const short *src, std::ptrdiff_t step, unsigned int nb_samples);
+};
+}
+}
+
+#endif //MEASUREMENT_HPP
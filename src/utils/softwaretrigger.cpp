@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "softwaretrigger.hpp"
+#include "conversion.hpp"
+#include <libm2k/m2kexceptions.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace libm2k::utils;
+using namespace libm2k::analog;
+
+static const int RAW_MIN = std::numeric_limits<short>::min();
+static const int RAW_MAX = std::numeric_limits<short>::max();
+
+SoftwareTrigger::SoftwareTrigger(const SOFTWARE_TRIGGER_SETTINGS &settings, unsigned int nb_channels,
+				 unsigned int block_samples) :
+	m_settings(settings),
+	m_nb_channels(nb_channels),
+	m_block_samples(block_samples),
+	m_needs_arming(true),
+	m_arm_inside(true),
+	m_fire_inside(true),
+	m_next_index(0),
+	m_pending_head(0),
+	m_triggered(0),
+	m_missed(0)
+{
+	if (nb_channels == 0 || block_samples == 0 || settings.channel >= nb_channels) {
+		throw_exception(EXC_INVALID_PARAMETER, "SoftwareTrigger: Invalid trigger channel");
+	}
+	if (settings.post_samples == 0) {
+		throw_exception(EXC_INVALID_PARAMETER, "SoftwareTrigger: The frame needs at least one sample after the trigger");
+	}
+
+	/* Every condition arms on one range of raw codes and fires on another, disjoint one */
+	int level = settings.level;
+	int high = settings.level_high;
+	int hysteresis = std::max(settings.hysteresis, 0);
+	switch (settings.condition) {
+	case STREAMING_TRIGGER_RISING_EDGE:
+		m_arm_low = RAW_MIN;
+		m_arm_high = level - std::max(hysteresis, 1);
+		m_fire_low = level;
+		m_fire_high = RAW_MAX;
+		break;
+	case STREAMING_TRIGGER_FALLING_EDGE:
+		m_arm_low = level + std::max(hysteresis, 1);
+		m_arm_high = RAW_MAX;
+		m_fire_low = RAW_MIN;
+		m_fire_high = level;
+		break;
+	case STREAMING_TRIGGER_HIGH_LEVEL:
+		m_needs_arming = false;
+		m_fire_low = level;
+		m_fire_high = RAW_MAX;
+		break;
+	case STREAMING_TRIGGER_LOW_LEVEL:
+		m_needs_arming = false;
+		m_fire_low = RAW_MIN;
+		m_fire_high = level;
+		break;
+	case STREAMING_TRIGGER_WINDOW_ENTER:
+	case STREAMING_TRIGGER_WINDOW_EXIT:
+		if (high < level) {
+			throw_exception(EXC_INVALID_PARAMETER, "SoftwareTrigger: The window is empty");
+		}
+		m_fire_low = level;
+		m_fire_high = high;
+		if (settings.condition == STREAMING_TRIGGER_WINDOW_ENTER) {
+			m_arm_low = level - hysteresis;
+			m_arm_high = high + hysteresis;
+			m_arm_inside = false;
+		} else {
+			m_arm_low = level + hysteresis;
+			m_arm_high = high - hysteresis;
+			m_fire_inside = false;
+		}
+		break;
+	default:
+		throw_exception(EXC_INVALID_PARAMETER, "SoftwareTrigger: Unknown trigger condition");
+	}
+
+	/* A pending frame starts at most pre + post samples before the end of the newest block */
+	m_capacity = (unsigned long long)settings.pre_samples + settings.post_samples + block_samples;
+	m_ring.resize(m_capacity * nb_channels);
+	m_frame.resize(((size_t)settings.pre_samples + settings.post_samples) * nb_channels);
+	restart(0);
+}
+
+void SoftwareTrigger::restart(unsigned long long position)
+{
+	m_missed += m_pending.size() - m_pending_head;
+	m_pending.clear();
+	m_pending_head = 0;
+	m_valid_start = position;
+	m_end = position;
+	m_search_from = position;
+	m_armed = !m_needs_arming;
+}
+
+void SoftwareTrigger::push(const short *block, unsigned long long index)
+{
+	unsigned long long start = index * m_block_samples;
+	if (index != m_next_index) {
+		restart(start);
+	}
+	m_next_index = index + 1;
+
+	size_t offset = start % m_capacity;
+	size_t first = std::min<size_t>(m_block_samples, m_capacity - offset);
+	memcpy(&m_ring[offset * m_nb_channels], block, first * m_nb_channels * sizeof(short));
+	memcpy(&m_ring[0], block + first * m_nb_channels, (m_block_samples - first) * m_nb_channels * sizeof(short));
+	m_end = start + m_block_samples;
+
+	search(block, start);
+}
+
+void SoftwareTrigger::search(const short *block, unsigned long long start)
+{
+	unsigned long long end = start + m_block_samples;
+	unsigned long long position = std::max(m_search_from, start);
+	const short *channel = block + m_settings.channel;
+
+	while (position < end) {
+		unsigned int nb_samples = end - position;
+		const short *src = channel + (position - start) * m_nb_channels;
+		if (!m_armed) {
+			unsigned int k = Conversion::find(src, m_nb_channels, nb_samples, m_arm_low, m_arm_high, m_arm_inside);
+			if (k == nb_samples) {
+				break;
+			}
+			position += k;
+			m_armed = true;
+			continue;
+		}
+
+		unsigned int k = Conversion::find(src, m_nb_channels, nb_samples, m_fire_low, m_fire_high, m_fire_inside);
+		if (k == nb_samples) {
+			break;
+		}
+		unsigned long long trigger = position + k;
+		/* Right after a (re)start there may not be enough samples before the trigger */
+		if (trigger < m_valid_start + m_settings.pre_samples) {
+			m_missed++;
+		} else {
+			m_pending.push_back(trigger);
+		}
+		m_armed = !m_needs_arming;
+		m_search_from = trigger + m_settings.post_samples;
+		position = m_search_from;
+	}
+}
+
+const short *SoftwareTrigger::nextFrame(unsigned long long &first_sample)
+{
+	if (m_pending_head == m_pending.size()) {
+		m_pending.clear();
+		m_pending_head = 0;
+		return nullptr;
+	}
+	unsigned long long trigger = m_pending[m_pending_head];
+	if (trigger + m_settings.post_samples > m_end) {
+		return nullptr;
+	}
+	m_pending_head++;
+	m_triggered++;
+
+	first_sample = trigger - m_settings.pre_samples;
+	size_t frame_samples = getFrameSamples();
+	size_t offset = first_sample % m_capacity;
+	if (offset + frame_samples <= m_capacity) {
+		return &m_ring[offset * m_nb_channels];
+	}
+
+	/* The frame wraps around the end of the ring */
+	size_t first = m_capacity - offset;
+	memcpy(&m_frame[0], &m_ring[offset * m_nb_channels], first * m_nb_channels * sizeof(short));
+	memcpy(&m_frame[first * m_nb_channels], &m_ring[0], (frame_samples - first) * m_nb_channels * sizeof(short));
+	return m_frame.data();
+}
+
+unsigned int SoftwareTrigger::getFrameSamples() const
+{
+	return m_settings.pre_samples + m_settings.post_samples;
+}
+
+unsigned long long SoftwareTrigger::getTriggeredFrames() const
+{
+	return m_triggered;
+}
+
+unsigned long long SoftwareTrigger::getMissedTriggers() const
+{
+	return m_missed;
+}
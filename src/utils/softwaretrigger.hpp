@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SOFTWARETRIGGER_HPP
+#define SOFTWARETRIGGER_HPP
+
+#include <libm2k/analog/enums.hpp>
+#include <vector>
+
+namespace libm2k {
+namespace utils {
+
+/* STREAMING_TRIGGER with the levels converted to raw codes */
+struct SOFTWARE_TRIGGER_SETTINGS {
+	bool enabled;
+	unsigned int channel;
+	libm2k::analog::M2K_STREAMING_TRIGGER_CONDITION condition;
+	int level;
+	int level_high;
+	int hysteresis;
+	unsigned int pre_samples;
+	unsigned int post_samples;
+};
+
+/**
+ * Trigger search over consecutive blocks of raw interleaved samples. The condition is
+ * reduced to finding the first sample inside (or outside) a range of raw codes, first
+ * to arm the trigger and then to fire it, and both searches are vectorized.
+ * The blocks are kept in a ring long enough for a frame to reach back pre_samples
+ * before the trigger and post_samples after it, across block boundaries.
+ */
+class SoftwareTrigger
+{
+public:
+	SoftwareTrigger(const SOFTWARE_TRIGGER_SETTINGS &settings, unsigned int nb_channels, unsigned int block_samples);
+
+	/* Append the next block; index is its sequence number, a gap restarts the search */
+	void push(const short *block, unsigned long long index);
+
+	/* The next complete frame (interleaved) or nullptr; valid until the next call of push or nextFrame.
+	 * first_sample is the position in the stream of its first sample */
+	const short *nextFrame(unsigned long long &first_sample);
+
+	unsigned int getFrameSamples() const;
+	unsigned long long getTriggeredFrames() const;
+	unsigned long long getMissedTriggers() const;
+
+private:
+	SOFTWARE_TRIGGER_SETTINGS m_settings;
+	unsigned int m_nb_channels;
+	unsigned int m_block_samples;
+
+	/* The ranges of raw codes that arm and that fire the trigger */
+	bool m_needs_arming;
+	int m_arm_low;
+	int m_arm_high;
+	bool m_arm_inside;
+	int m_fire_low;
+	int m_fire_high;
+	bool m_fire_inside;
+
+	/* Ring of the latest samples; position p of the stream is frame p % m_capacity */
+	std::vector<short> m_ring;
+	std::vector<short> m_frame;
+	unsigned long long m_capacity;
+	unsigned long long m_next_index;
+	unsigned long long m_valid_start;
+	unsigned long long m_end;
+
+	bool m_armed;
+	unsigned long long m_search_from;
+	std::vector<unsigned long long> m_pending;
+	size_t m_pending_head;
+
+	unsigned long long m_triggered;
+	unsigned long long m_missed;
+
+	void restart(unsigned long long position);
+	void search(const short *block, unsigned long long start);
+};
+}
+}
+
+#endif //SOFTWARETRIGGER_HPP
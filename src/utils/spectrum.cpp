@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "spectrum.hpp"
+#include <libm2k/m2kexceptions.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+using namespace libm2k::utils;
+using namespace libm2k::analog;
+
+static const unsigned int MIN_FFT_SIZE = 8;
+static const unsigned int MAX_FFT_SIZE = 1u << 20;
+/* Amplitude of a full-scale sine, in raw codes of the 12-bit ADC */
+static const double FULL_SCALE_RAW = 1u << 11;
+/* Value of the empty bins, instead of -inf */
+static const double DB_FLOOR = -300;
+static const double PI = 3.14159265358979323846;
+
+/* The transforms and the windows are cached while they are in use */
+template <typename T, typename Key, typename Create>
+static std::shared_ptr<const T> getCached(std::map<Key, std::weak_ptr<const T>> &cache, std::mutex &mutex,
+					  const Key &key, Create create)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto cached = cache[key].lock();
+	if (!cached) {
+		cached = create();
+		cache[key] = cached;
+	}
+	return cached;
+}
+
+/* Forward DFT of R values, in place */
+template <unsigned int R>
+static inline void butterfly(double *re, double *im);
+
+template <>
+inline void butterfly<2>(double *re, double *im)
+{
+	double r1 = re[1], i1 = im[1];
+	re[1] = re[0] - r1; im[1] = im[0] - i1;
+	re[0] = re[0] + r1; im[0] = im[0] + i1;
+}
+
+template <>
+inline void butterfly<4>(double *re, double *im)
+{
+	double t0r = re[0] + re[2], t0i = im[0] + im[2];
+	double t1r = re[0] - re[2], t1i = im[0] - im[2];
+	double t2r = re[1] + re[3], t2i = im[1] + im[3];
+	/* -i * (x1 - x3) */
+	double t3r = im[1] - im[3], t3i = re[3] - re[1];
+	re[0] = t0r + t2r; im[0] = t0i + t2i;
+	re[1] = t1r + t3r; im[1] = t1i + t3i;
+	re[2] = t0r - t2r; im[2] = t0i - t2i;
+	re[3] = t1r - t3r; im[3] = t1i - t3i;
+}
+
+template <>
+inline void butterfly<3>(double *re, double *im)
+{
+	const double s = 0.86602540378443864676;
+	double t1r = re[1] + re[2], t1i = im[1] + im[2];
+	double t2r = re[1] - re[2], t2i = im[1] - im[2];
+	double mr = re[0] - 0.5 * t1r, mi = im[0] - 0.5 * t1i;
+	/* -i * s * (x1 - x2) */
+	double nr = s * t2i, ni = -s * t2r;
+	re[0] = re[0] + t1r; im[0] = im[0] + t1i;
+	re[1] = mr + nr; im[1] = mi + ni;
+	re[2] = mr - nr; im[2] = mi - ni;
+}
+
+template <>
+inline void butterfly<5>(double *re, double *im)
+{
+	const double c1 = 0.30901699437494742410, c2 = -0.80901699437494742410;
+	const double s1 = 0.95105651629515357212, s2 = 0.58778525229247312917;
+	double t1r = re[1] + re[4], t1i = im[1] + im[4];
+	double t2r = re[2] + re[3], t2i = im[2] + im[3];
+	double t3r = re[1] - re[4], t3i = im[1] - im[4];
+	double t4r = re[2] - re[3], t4i = im[2] - im[3];
+	double m1r = re[0] + c1 * t1r + c2 * t2r, m1i = im[0] + c1 * t1i + c2 * t2i;
+	double m2r = re[0] + c2 * t1r + c1 * t2r, m2i = im[0] + c2 * t1i + c1 * t2i;
+	/* -i * (s1 * t3 + s2 * t4) and -i * (s2 * t3 - s1 * t4) */
+	double n1r = s1 * t3i + s2 * t4i, n1i = -(s1 * t3r + s2 * t4r);
+	double n2r = s2 * t3i - s1 * t4i, n2i = -(s2 * t3r - s1 * t4r);
+	re[0] = re[0] + t1r + t2r; im[0] = im[0] + t1i + t2i;
+	re[1] = m1r + n1r; im[1] = m1i + n1i;
+	re[4] = m1r - n1r; im[4] = m1i - n1i;
+	re[2] = m2r + n2r; im[2] = m2i + n2i;
+	re[3] = m2r - n2r; im[3] = m2i - n2i;
+}
+
+/*
+ * One radix-R pass of the Stockham FFT over n complex values: R transforms of span values
+ * each, read with a stride of n / R, are combined into transforms of R * span values
+ */
+template <unsigned int R>
+static void fftPass(const double *in, double *out, unsigned int n, unsigned int span, const double *twiddles)
+{
+	const unsigned int stride = n / R;
+	const unsigned int blocks = stride / span;
+	for (unsigned int b = 0; b < blocks; b++) {
+		for (unsigned int k = 0; k < span; k++) {
+			unsigned int j = b * span + k;
+			const double *w = twiddles + 2 * (k * (R - 1));
+			double re[R], im[R];
+			re[0] = in[2 * j];
+			im[0] = in[2 * j + 1];
+			for (unsigned int r = 1; r < R; r++) {
+				double xr = in[2 * (j + r * stride)];
+				double xi = in[2 * (j + r * stride) + 1];
+				double wr = w[2 * (r - 1)];
+				double wi = w[2 * (r - 1) + 1];
+				re[r] = xr * wr - xi * wi;
+				im[r] = xr * wi + xi * wr;
+			}
+			butterfly<R>(re, im);
+
+			unsigned int d = b * span * R + k;
+			for (unsigned int r = 0; r < R; r++) {
+				out[2 * (d + r * span)] = re[r];
+				out[2 * (d + r * span) + 1] = im[r];
+			}
+		}
+	}
+}
+
+RealFft::RealFft(unsigned int size) :
+	m_size(size),
+	m_half(size / 2)
+{
+	if (!isSupportedSize(size)) {
+		throw_exception(EXC_INVALID_PARAMETER, "Spectrum: Unsupported FFT size " + std::to_string(size));
+	}
+
+	unsigned int remaining = m_half;
+	unsigned int span = 1;
+	while (remaining > 1) {
+		unsigned int radix = (remaining % 4 == 0) ? 4 : (remaining % 2 == 0) ? 2 :
+				     (remaining % 3 == 0) ? 3 : 5;
+		m_stages.push_back(STAGE{radix, span, m_twiddles.size()});
+		for (unsigned int k = 0; k < span; k++) {
+			for (unsigned int r = 1; r < radix; r++) {
+				double angle = -2 * PI * r * k / (span * radix);
+				m_twiddles.push_back(std::cos(angle));
+				m_twiddles.push_back(std::sin(angle));
+			}
+		}
+		remaining /= radix;
+		span *= radix;
+	}
+
+	for (unsigned int k = 0; k <= m_half; k++) {
+		double angle = -2 * PI * k / m_size;
+		m_split.push_back(std::cos(angle));
+		m_split.push_back(std::sin(angle));
+	}
+}
+
+bool RealFft::isSupportedSize(unsigned int size)
+{
+	if (size < MIN_FFT_SIZE || size > MAX_FFT_SIZE || size % 2 != 0) {
+		return false;
+	}
+	unsigned int half = size / 2;
+	const unsigned int factors[] = {2, 3, 5};
+	for (unsigned int f : factors) {
+		while (half % f == 0) {
+			half /= f;
+		}
+	}
+	return half == 1;
+}
+
+unsigned int RealFft::getSize() const
+{
+	return m_size;
+}
+
+std::shared_ptr<const RealFft> RealFft::get(unsigned int size)
+{
+	static std::map<unsigned int, std::weak_ptr<const RealFft>> cache;
+	static std::mutex mutex;
+	return getCached(cache, mutex, size, [size]() {
+		return std::make_shared<const RealFft>(size);
+	});
+}
+
+/*
+ * The even samples are the real parts and the odd samples the imaginary parts of the
+ * complex input z, so data already holds it. With Z = FFT(z) of n = size / 2 values:
+ *   X[k] = (Z[k] + conj(Z[n - k])) / 2 - i e^(-2 pi i k / size) (Z[k] - conj(Z[n - k])) / 2
+ */
+void RealFft::accumulatePower(double *data, double *scratch, double *power) const
+{
+	double *in = data;
+	double *out = scratch;
+	for (const STAGE &stage : m_stages) {
+		const double *twiddles = m_twiddles.data() + stage.twiddles;
+		switch (stage.radix) {
+		case 2:
+			fftPass<2>(in, out, m_half, stage.span, twiddles);
+			break;
+		case 3:
+			fftPass<3>(in, out, m_half, stage.span, twiddles);
+			break;
+		case 4:
+			fftPass<4>(in, out, m_half, stage.span, twiddles);
+			break;
+		default:
+			fftPass<5>(in, out, m_half, stage.span, twiddles);
+			break;
+		}
+		std::swap(in, out);
+	}
+
+	const double *z = in;
+	for (unsigned int k = 0; k <= m_half; k++) {
+		unsigned int a = (k == m_half) ? 0 : k;
+		unsigned int b = (k == 0) ? 0 : m_half - k;
+		double zr = z[2 * a], zi = z[2 * a + 1];
+		double cr = z[2 * b], ci = -z[2 * b + 1];
+		double er = 0.5 * (zr + cr), ei = 0.5 * (zi + ci);
+		double or_ = 0.5 * (zi - ci), oi = -0.5 * (zr - cr);
+		double wr = m_split[2 * k], wi = m_split[2 * k + 1];
+		double xr = er + or_ * wr - oi * wi;
+		double xi = ei + or_ * wi + oi * wr;
+		power[k] += xr * xr + xi * xi;
+	}
+}
+
+/* Periodic (DFT-even) cosine-sum windows */
+std::shared_ptr<const WINDOW_TABLE> SpectrumAnalyzer::getWindowTable(M2K_SPECTRUM_WINDOW window, unsigned int size)
+{
+	std::vector<double> terms;
+	switch (window) {
+	case SPECTRUM_WINDOW_RECTANGULAR:
+		terms = {1.0};
+		break;
+	case SPECTRUM_WINDOW_HANN:
+		terms = {0.5, 0.5};
+		break;
+	case SPECTRUM_WINDOW_HAMMING:
+		terms = {0.54, 0.46};
+		break;
+	case SPECTRUM_WINDOW_BLACKMAN_HARRIS:
+		terms = {0.35875, 0.48829, 0.14128, 0.01168};
+		break;
+	case SPECTRUM_WINDOW_FLAT_TOP:
+		terms = {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368};
+		break;
+	default:
+		throw_exception(EXC_INVALID_PARAMETER, "Spectrum: Unknown window");
+	}
+
+	static std::map<std::pair<int, unsigned int>, std::weak_ptr<const WINDOW_TABLE>> cache;
+	static std::mutex mutex;
+	return getCached(cache, mutex, std::make_pair((int)window, size), [&terms, size]() {
+		auto table = std::make_shared<WINDOW_TABLE>();
+		table->coefficients.resize(size);
+		table->sum = 0;
+		table->sum_squares = 0;
+		for (unsigned int n = 0; n < size; n++) {
+			double w = 0;
+			for (unsigned int j = 0; j < terms.size(); j++) {
+				double term = terms[j] * std::cos(2 * PI * j * n / size);
+				w += (j % 2) ? -term : term;
+			}
+			table->coefficients[n] = w;
+			table->sum += w;
+			table->sum_squares += w * w;
+		}
+		return std::shared_ptr<const WINDOW_TABLE>(table);
+	});
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer(const SPECTRUM_SETTINGS &settings, double raw_offset) :
+	m_fft_size(settings.fft_size),
+	m_raw_offset(raw_offset),
+	m_fill(0),
+	m_averages(0)
+{
+	if (!RealFft::isSupportedSize(settings.fft_size)) {
+		throw_exception(EXC_INVALID_PARAMETER, "Spectrum: Unsupported FFT size " +
+				std::to_string(settings.fft_size));
+	}
+	if (!(settings.overlap >= 0 && settings.overlap < 1)) {
+		throw_exception(EXC_INVALID_PARAMETER, "Spectrum: The overlap must be in [0, 1)");
+	}
+	m_window = getWindowTable(settings.window, m_fft_size);
+	m_fft = RealFft::get(m_fft_size);
+
+	unsigned int overlap = (unsigned int)std::round(settings.overlap * m_fft_size);
+	m_hop = std::max(m_fft_size - std::min(overlap, m_fft_size), 1u);
+	m_segment.resize(m_fft_size);
+	m_windowed.resize(m_fft_size);
+	m_scratch.resize(m_fft_size);
+	m_power.assign(m_fft_size / 2 + 1, 0);
+}
+
+void SpectrumAnalyzer::update(const short *src, std::ptrdiff_t step, unsigned int nb_samples)
+{
+	unsigned int i = 0;
+	while (i < nb_samples) {
+		unsigned int take = std::min(m_fft_size - m_fill, nb_samples - i);
+		const short *s = src + (std::ptrdiff_t)i * step;
+		double *d = m_segment.data() + m_fill;
+		for (unsigned int j = 0; j < take; j++) {
+			d[j] = s[(std::ptrdiff_t)j * step] + m_raw_offset;
+		}
+		m_fill += take;
+		i += take;
+
+		if (m_fill == m_fft_size) {
+			processSegment();
+			/* The overlapping tail starts the next segment */
+			unsigned int keep = m_fft_size - m_hop;
+			std::memmove(m_segment.data(), m_segment.data() + m_hop, keep * sizeof(double));
+			m_fill = keep;
+		}
+	}
+}
+
+void SpectrumAnalyzer::processSegment()
+{
+	const double *w = m_window->coefficients.data();
+	for (unsigned int j = 0; j < m_fft_size; j++) {
+		m_windowed[j] = m_segment[j] * w[j];
+	}
+	m_fft->accumulatePower(m_windowed.data(), m_scratch.data(), m_power.data());
+	m_averages++;
+}
+
+void SpectrumAnalyzer::restart()
+{
+	m_fill = 0;
+}
+
+void SpectrumAnalyzer::reset()
+{
+	restart();
+	std::fill(m_power.begin(), m_power.end(), 0);
+	m_averages = 0;
+}
+
+unsigned long long SpectrumAnalyzer::getNbAverages() const
+{
+	return m_averages;
+}
+
+/*
+ * The amplitudes are corrected by the coherent gain of the window (its sum), so a tone
+ * centered on a bin reads its RMS amplitude; the density by its noise bandwidth (the sum
+ * of its squares). Every bin but DC and Nyquist also holds the power of its negative frequency
+ */
+SPECTRUM SpectrumAnalyzer::getResults(double scale, double sample_rate, M2K_SPECTRUM_UNIT unit) const
+{
+	SPECTRUM spectrum = {};
+	spectrum.bin_width = sample_rate / m_fft_size;
+	spectrum.nb_averages = m_averages;
+	if (m_averages == 0) {
+		return spectrum;
+	}
+
+	const double s1 = m_window->sum;
+	const double s2 = m_window->sum_squares;
+	const double full_scale_power = FULL_SCALE_RAW * FULL_SCALE_RAW / 2;
+	const unsigned int nb_bins = m_power.size();
+	spectrum.values.resize(nb_bins);
+	for (unsigned int k = 0; k < nb_bins; k++) {
+		double power = m_power[k] / m_averages;
+		if (k != 0 && k != nb_bins - 1) {
+			power *= 2;
+		}
+		double tone_power = power / (s1 * s1);
+		double value = 0;
+		switch (unit) {
+		case SPECTRUM_VOLTS_RMS:
+			value = std::sqrt(tone_power) * std::fabs(scale);
+			break;
+		case SPECTRUM_DBV:
+			value = std::max(10 * std::log10(tone_power * scale * scale), DB_FLOOR);
+			break;
+		case SPECTRUM_VOLTS_PER_SQRT_HZ:
+			value = std::sqrt(power / (sample_rate * s2)) * std::fabs(scale);
+			break;
+		case SPECTRUM_DBFS:
+		default:
+			value = std::max(10 * std::log10(tone_power / full_scale_power), DB_FLOOR);
+			break;
+		}
+		spectrum.values[k] = value;
+	}
+	return spectrum;
+}
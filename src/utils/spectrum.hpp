@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SPECTRUM_HPP
+#define SPECTRUM_HPP
+
+#include <libm2k/analog/enums.hpp>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace libm2k {
+namespace utils {
+
+/* Coefficients of a window, with the sums the spectrum scaling needs */
+struct WINDOW_TABLE {
+	std::vector<double> coefficients;
+	double sum;
+	double sum_squares;
+};
+
+/**
+ * FFT of real samples, through a complex FFT of half the size (Stockham autosort, radix
+ * 4, 2, 3 and 5 passes) and a final pass that separates the even and odd samples.
+ * The twiddle factors are computed once, when the object is created; the transforms
+ * only read them, so one object can be shared by several threads.
+ */
+class RealFft
+{
+public:
+	RealFft(unsigned int size);
+
+	/* Even sizes whose half is a product of powers of 2, 3 and 5 */
+	static bool isSupportedSize(unsigned int size);
+
+	unsigned int getSize() const;
+
+	/* |X[k]|^2 of the size samples of data, added to power[k], for k = 0 .. size / 2.
+	 * data and scratch (size values each) are overwritten */
+	void accumulatePower(double *data, double *scratch, double *power) const;
+
+	/* The shared transform of a size */
+	static std::shared_ptr<const RealFft> get(unsigned int size);
+
+private:
+	struct STAGE {
+		unsigned int radix;
+		unsigned int span;
+		size_t twiddles;
+	};
+
+	unsigned int m_size;
+	unsigned int m_half;
+	std::vector<STAGE> m_stages;
+	std::vector<double> m_twiddles;
+	/* e^(-2 pi i k / size), for the separation of the even and odd samples */
+	std::vector<double> m_split;
+};
+
+/**
+ * Averaged spectrum of one channel (Welch's method), accumulated over consecutive blocks
+ * of raw samples. The samples are collected in segments of fft_size, overlapping by the
+ * configured fraction, and a segment may span several blocks; the power of the windowed
+ * segments is summed in raw codes and only converted when the results are requested.
+ */
+class SpectrumAnalyzer
+{
+public:
+	/* raw_offset is added to every raw sample, so that the DC bin includes the offset of the channel */
+	SpectrumAnalyzer(const libm2k::analog::SPECTRUM_SETTINGS &settings, double raw_offset = 0);
+
+	/* src[i * step] continues the samples of the previous update */
+	void update(const short *src, std::ptrdiff_t step, unsigned int nb_samples);
+
+	/* The next samples do not follow the previous ones; the partial segment is dropped */
+	void restart();
+
+	void reset();
+
+	unsigned long long getNbAverages() const;
+
+	/* scale is the Volts per raw code of the channel; sample_rate sets the bin width */
+	libm2k::analog::SPECTRUM getResults(double scale, double sample_rate,
+					    libm2k::analog::M2K_SPECTRUM_UNIT unit) const;
+
+	/* The shared, precomputed coefficients of a window */
+	static std::shared_ptr<const WINDOW_TABLE> getWindowTable(libm2k::analog::M2K_SPECTRUM_WINDOW window,
+								  unsigned int size);
+
+private:
+	unsigned int m_fft_size;
+	unsigned int m_hop;
+	double m_raw_offset;
+	std::shared_ptr<const WINDOW_TABLE> m_window;
+	std::shared_ptr<const RealFft> m_fft;
+
+	/* Samples of the current segment; the first m_fill are valid */
+	std::vector<double> m_segment;
+	unsigned int m_fill;
+	std::vector<double> m_windowed;
+	std::vector<double> m_scratch;
+	std::vector<double> m_power;
+	unsigned long long m_averages;
+
+	void processSegment();
+};
+}
+}
+
+#endif //SPECTRUM_HPP
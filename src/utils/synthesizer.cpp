@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "synthesizer.hpp"
+#include "conversion.hpp"
+#include <libm2k/m2kexceptions.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace libm2k::utils;
+using namespace libm2k::analog;
+
+/* Samples converted to raw codes at once */
+static const unsigned int BLOCK_SAMPLES = 1024;
+/* The sine table has 2^SINE_BITS intervals; with linear interpolation its error stays
+ * around 1e-6 of the amplitude, well below one code of the 12-bit DAC */
+static const unsigned int SINE_BITS = 10;
+/* Loops shorter than this are made of several repetitions of the shortest loop */
+static const unsigned int MIN_CYCLE_SAMPLES = 1024;
+/* Length of the loop of a constant waveform */
+static const unsigned int DC_CYCLE_SAMPLES = 1024;
+/* One turn of the phase accumulators */
+static const double PHASE_TURN = 18446744073709551616.0;
+static const double PI = 3.14159265358979323846;
+
+static const double *sineTable()
+{
+	static const std::vector<double> table = [] {
+		std::vector<double> values((1u << SINE_BITS) + 1);
+		for (unsigned int i = 0; i < values.size(); i++) {
+			values[i] = std::sin(2 * PI * i / (1u << SINE_BITS));
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+/* The shapes, for a phase given as a fraction of the period */
+static inline double sineValue(uint64_t phase, const double *table)
+{
+	unsigned int index = static_cast<unsigned int>(phase >> (64 - SINE_BITS));
+	double fraction = static_cast<double>((phase << SINE_BITS) >> 11) * (1.0 / (1ull << 53));
+	return table[index] + fraction * (table[index + 1] - table[index]);
+}
+
+static inline double squareValue(double x, double duty_cycle)
+{
+	return (x < duty_cycle) ? 1.0 : -1.0;
+}
+
+static inline double triangleValue(double x)
+{
+	if (x < 0.25) {
+		return 4 * x;
+	}
+	return (x < 0.75) ? (2 - 4 * x) : (4 * x - 4);
+}
+
+static inline double sawtoothValue(double x)
+{
+	return (x < 0.5) ? (2 * x) : (2 * x - 2);
+}
+
+template <M2K_SYNTH_WAVEFORM W>
+static inline double shapeValue(uint64_t phase, double duty_cycle, const double *table)
+{
+	if (W == SYNTH_SINE) {
+		return sineValue(phase, table);
+	}
+	double x = static_cast<double>(phase) * (1.0 / PHASE_TURN);
+	switch (W) {
+	case SYNTH_SQUARE:
+		return squareValue(x, duty_cycle);
+	case SYNTH_TRIANGLE:
+		return triangleValue(x);
+	default:
+		return sawtoothValue(x);
+	}
+}
+
+/* Adds n samples of a tone to block; the fixed frequencies keep an integer step */
+template <M2K_SYNTH_WAVEFORM W, typename Tone>
+static void addTone(Tone &tone, double *block, unsigned int n)
+{
+	const double *table = sineTable();
+	double amplitude = tone.raw_amplitude;
+	double duty_cycle = tone.duty_cycle;
+	uint64_t phase = tone.phase;
+
+	if (tone.sweep_samples == 0) {
+		uint64_t step = tone.step;
+		for (unsigned int i = 0; i < n; i++) {
+			block[i] += amplitude * shapeValue<W>(phase, duty_cycle, table);
+			phase += step;
+		}
+	} else {
+		double step = tone.sweep_step;
+		for (unsigned int i = 0; i < n; i++) {
+			block[i] += amplitude * shapeValue<W>(phase, duty_cycle, table);
+			phase += static_cast<uint64_t>(step);
+			step += tone.sweep_delta;
+			if (++tone.sweep_position == tone.sweep_samples) {
+				tone.sweep_position = 0;
+				step = tone.start_step;
+			}
+		}
+		tone.sweep_step = step;
+	}
+	tone.phase = phase;
+}
+
+/* Phase units per sample, for a frequency of at most half the sample rate */
+static double phaseStep(double frequency, double sample_rate)
+{
+	return frequency / sample_rate * PHASE_TURN;
+}
+
+Synthesizer::Synthesizer(const SYNTH_SETTINGS &settings) :
+	m_settings(settings),
+	m_sample_rate(0),
+	m_raw_scale(0),
+	m_raw_offset(0)
+{
+	for (const SYNTH_TONE &settings_tone : m_settings.tones) {
+		TONE_STATE tone = {};
+		tone.waveform = settings_tone.waveform;
+		tone.duty_cycle = settings_tone.duty_cycle;
+		double turns = std::fmod(settings_tone.phase / 360, 1.0);
+		if (turns < 0) {
+			turns += 1;
+		}
+		tone.start_phase = (turns < 1) ? static_cast<uint64_t>(turns * PHASE_TURN) : 0;
+		m_tones.push_back(tone);
+	}
+	restart();
+}
+
+void Synthesizer::validate(const SYNTH_SETTINGS &settings, double sample_rate)
+{
+	if (!(sample_rate > 0)) {
+		throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: Invalid sample rate");
+	}
+	if (!std::isfinite(settings.offset)) {
+		throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: Invalid offset");
+	}
+	for (const SYNTH_TONE &tone : settings.tones) {
+		if (tone.waveform < SYNTH_SINE || tone.waveform > SYNTH_SAWTOOTH) {
+			throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: Invalid waveform");
+		}
+		if (!std::isfinite(tone.amplitude) || !std::isfinite(tone.phase)) {
+			throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: Invalid amplitude or phase");
+		}
+		if (!(tone.duty_cycle >= 0 && tone.duty_cycle <= 1)) {
+			throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: The duty cycle must be between 0 and 1");
+		}
+		if (!(tone.sweep_duration >= 0) || !std::isfinite(tone.sweep_duration)) {
+			throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: Invalid sweep duration");
+		}
+		bool sweep = (tone.sweep_duration > 0);
+		if (!(tone.frequency >= 0 && tone.frequency <= sample_rate / 2) ||
+				(sweep && !(tone.stop_frequency >= 0 && tone.stop_frequency <= sample_rate / 2))) {
+			throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: The frequencies must be between 0 and half the sample rate");
+		}
+	}
+}
+
+const SYNTH_SETTINGS &Synthesizer::getSettings() const
+{
+	return m_settings;
+}
+
+void Synthesizer::configure(double sample_rate, double raw_scale)
+{
+	if (sample_rate == m_sample_rate && raw_scale == m_raw_scale) {
+		return;
+	}
+	validate(m_settings, sample_rate);
+
+	m_raw_scale = raw_scale;
+	m_raw_offset = m_settings.offset * raw_scale;
+	for (unsigned int i = 0; i < m_tones.size(); i++) {
+		const SYNTH_TONE &settings_tone = m_settings.tones.at(i);
+		TONE_STATE &tone = m_tones.at(i);
+		tone.raw_amplitude = settings_tone.amplitude * raw_scale;
+		tone.step = static_cast<uint64_t>(phaseStep(settings_tone.frequency, sample_rate));
+		tone.start_step = phaseStep(settings_tone.frequency, sample_rate);
+		tone.sweep_samples = 0;
+		if (settings_tone.sweep_duration > 0) {
+			tone.sweep_samples = std::max(1.0, std::round(settings_tone.sweep_duration * sample_rate));
+			tone.sweep_delta = (phaseStep(settings_tone.stop_frequency, sample_rate) - tone.start_step) /
+					tone.sweep_samples;
+			/* The sweep goes on from the same frequency */
+			tone.sweep_position = std::min(tone.sweep_position, tone.sweep_samples - 1);
+			tone.sweep_step = tone.start_step + tone.sweep_position * tone.sweep_delta;
+		}
+	}
+	m_sample_rate = sample_rate;
+}
+
+void Synthesizer::restart()
+{
+	for (TONE_STATE &tone : m_tones) {
+		tone.phase = tone.start_phase;
+		tone.sweep_position = 0;
+		tone.sweep_step = tone.start_step;
+	}
+}
+
+void Synthesizer::synthesize(short *dst, unsigned int nb_samples)
+{
+	m_block.resize(BLOCK_SAMPLES);
+	double *block = m_block.data();
+	while (nb_samples > 0) {
+		unsigned int n = std::min(nb_samples, BLOCK_SAMPLES);
+		std::fill(block, block + n, m_raw_offset);
+		for (TONE_STATE &tone : m_tones) {
+			switch (tone.waveform) {
+			case SYNTH_SINE:
+				addTone<SYNTH_SINE>(tone, block, n);
+				break;
+			case SYNTH_SQUARE:
+				addTone<SYNTH_SQUARE>(tone, block, n);
+				break;
+			case SYNTH_TRIANGLE:
+				addTone<SYNTH_TRIANGLE>(tone, block, n);
+				break;
+			default:
+				addTone<SYNTH_SAWTOOTH>(tone, block, n);
+				break;
+			}
+		}
+		Conversion::scaledToRaw(block, 1, n, 1.0, dst);
+		dst += n;
+		nb_samples -= n;
+	}
+}
+
+unsigned int Synthesizer::tuneToCycle(unsigned int max_samples)
+{
+	max_samples = std::max(max_samples, 1u);
+	unsigned long long nb_samples = 0;
+	double min_frequency = std::numeric_limits<double>::infinity();
+	for (unsigned int i = 0; i < m_tones.size(); i++) {
+		if (m_tones.at(i).sweep_samples > 0) {
+			/* A loop cut inside a sweep would restart it mid-way */
+			if (nb_samples > 0 && nb_samples != m_tones.at(i).sweep_samples) {
+				throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: The sweeps of a looped waveform "
+						"must have the same duration");
+				return 0;
+			}
+			nb_samples = m_tones.at(i).sweep_samples;
+		} else if (m_settings.tones.at(i).frequency > 0) {
+			min_frequency = std::min(min_frequency, m_settings.tones.at(i).frequency);
+		}
+	}
+
+	/* Worst frequency error, in Hz, when every fixed tone is rounded to whole periods over n samples */
+	auto roundingError = [this](unsigned long long n) {
+		double error = 0;
+		for (unsigned int i = 0; i < m_tones.size(); i++) {
+			double frequency = m_settings.tones.at(i).frequency;
+			if (m_tones.at(i).sweep_samples > 0 || frequency == 0) {
+				continue;
+			}
+			double periods = std::max(1.0, std::round(frequency * n / m_sample_rate));
+			error = std::max(error, std::fabs(periods * m_sample_rate / n - frequency));
+		}
+		return error;
+	};
+
+	if (nb_samples > max_samples) {
+		throw_exception(EXC_INVALID_PARAMETER, "Synthesizer: The sweep is longer than the " +
+				std::to_string(max_samples) + " samples of a looped waveform");
+		return 0;
+	}
+
+	if (nb_samples == 0 && std::isinf(min_frequency)) {
+		nb_samples = DC_CYCLE_SAMPLES;
+	} else if (nb_samples == 0) {
+		/* Whole periods of the lowest tone, until the other tones fit as well */
+		double period = m_sample_rate / min_frequency;
+		double best_error = std::numeric_limits<double>::infinity();
+		double tolerance = m_sample_rate * 1e-12;
+		for (unsigned long long k = 1; std::floor(k * period) <= max_samples && best_error > tolerance; k++) {
+			unsigned long long candidates[] = {(unsigned long long)std::floor(k * period),
+							   (unsigned long long)std::ceil(k * period)};
+			for (unsigned long long n : candidates) {
+				if (n == 0 || n > max_samples) {
+					continue;
+				}
+				double error = roundingError(n);
+				if (error < best_error) {
+					best_error = error;
+					nb_samples = n;
+				}
+			}
+		}
+		if (nb_samples == 0) {
+			nb_samples = max_samples;
+		}
+		if (nb_samples < MIN_CYCLE_SAMPLES) {
+			unsigned long long repeats = (MIN_CYCLE_SAMPLES + nb_samples - 1) / nb_samples;
+			nb_samples *= std::max(1ull, std::min(repeats, max_samples / nb_samples));
+		}
+	}
+	nb_samples = std::min(nb_samples, (unsigned long long)max_samples);
+
+	for (unsigned int i = 0; i < m_tones.size(); i++) {
+		double frequency = m_settings.tones.at(i).frequency;
+		TONE_STATE &tone = m_tones.at(i);
+		if (tone.sweep_samples > 0 || frequency == 0) {
+			continue;
+		}
+		double periods = std::max(1.0, std::round(frequency * nb_samples / m_sample_rate));
+		tone.step = static_cast<uint64_t>(periods / nb_samples * PHASE_TURN);
+	}
+	restart();
+	return nb_samples;
+}
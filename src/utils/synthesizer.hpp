@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SYNTHESIZER_HPP
+#define SYNTHESIZER_HPP
+
+#include <libm2k/analog/enums.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace libm2k {
+namespace utils {
+
+/**
+ * Direct digital synthesis of the sum of the tones of SYNTH_SETTINGS, as raw DAC codes.
+ * Every tone has a 64-bit phase accumulator, read through a lookup table for the sine;
+ * the phases carry over from one call to the next, so consecutive blocks form one
+ * continuous waveform. The amplitudes and the offset are scaled to raw codes once.
+ */
+class Synthesizer
+{
+public:
+	Synthesizer(const libm2k::analog::SYNTH_SETTINGS &settings);
+
+	/* Throws for settings that can not be generated at sample_rate */
+	static void validate(const libm2k::analog::SYNTH_SETTINGS &settings, double sample_rate);
+
+	const libm2k::analog::SYNTH_SETTINGS &getSettings() const;
+
+	/* Output sample rate and Volts to raw factor; the phases are kept when they change */
+	void configure(double sample_rate, double raw_scale);
+
+	/* Back to the phases of the settings and to the start of the sweeps */
+	void restart();
+
+	/* The next nb_samples samples; configure must have been called */
+	void synthesize(short *dst, unsigned int nb_samples);
+
+	/* Length of a seamless loop of the waveform, at most max_samples: the duration of the
+	 * sweeps, or a number of samples holding whole periods of every tone. The frequencies are
+	 * rounded to whole periods over that length when they do not fit exactly; the tones are
+	 * restarted. Throws when the sweeps differ in length or one is longer than max_samples */
+	unsigned int tuneToCycle(unsigned int max_samples);
+
+private:
+	struct TONE_STATE {
+		libm2k::analog::M2K_SYNTH_WAVEFORM waveform;
+		double raw_amplitude;
+		double duty_cycle;
+		uint64_t start_phase;
+		uint64_t phase;
+		uint64_t step;
+		/* Sweeps: the step, in phase units per sample, changes by sweep_delta every sample */
+		double start_step;
+		double sweep_step;
+		double sweep_delta;
+		unsigned long long sweep_samples;
+		unsigned long long sweep_position;
+	};
+
+	libm2k::analog::SYNTH_SETTINGS m_settings;
+	double m_sample_rate;
+	double m_raw_scale;
+	double m_raw_offset;
+	std::vector<TONE_STATE> m_tones;
+	std::vector<double> m_block;
+};
+}
+}
+
+#endif //SYNTHESIZER_HPP
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SIM_TEST_HPP
+#define SIM_TEST_HPP
+
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+
+/*
+ * Checks shared by the tests run against the simulated iio backend. A failed check is
+ * reported with its location and the test goes on; main returns sim_test::result().
+ */
+namespace sim_test {
+
+inline unsigned int &failures()
+{
+	static unsigned int count = 0;
+	return count;
+}
+
+inline void fail(const char *file, int line, const std::string &message)
+{
+	std::cerr << file << ":" << line << ": check failed: " << message << std::endl;
+	failures()++;
+}
+
+/* Runs one case; an exception escaping it is a failure */
+inline void run(const std::string &name, const std::function<void()> &test)
+{
+	unsigned int before = failures();
+	try {
+		test();
+	} catch (std::exception &e) {
+		std::cerr << name << ": unexpected exception: " << e.what() << std::endl;
+		failures()++;
+	}
+	std::cout << (failures() == before ? "PASS " : "FAIL ") << name << std::endl;
+}
+
+inline int result()
+{
+	return failures() ? 1 : 0;
+}
+}
+
+#define SIM_CHECK(condition) do { \
+		if (!(condition)) { \
+			sim_test::fail(__FILE__, __LINE__, #condition); \
+		} \
+	} while (0)
+
+#define SIM_CHECK_CLOSE(value, expected, tolerance) do { \
+		double _value = (value); \
+		double _expected = (expected); \
+		if (!(std::fabs(_value - _expected) <= (tolerance))) { \
+			sim_test::fail(__FILE__, __LINE__, std::string(#value " == " #expected ": ") + \
+				       std::to_string(_value) + " != " + std::to_string(_expected)); \
+		} \
+	} while (0)
+
+#define SIM_CHECK_THROWS(statement) do { \
+		bool _thrown = false; \
+		try { \
+			statement; \
+		} catch (std::exception &) { \
+			_thrown = true; \
+		} \
+		if (!_thrown) { \
+			sim_test::fail(__FILE__, __LINE__, #statement " did not throw"); \
+		} \
+	} while (0)
+
+#endif //SIM_TEST_HPP
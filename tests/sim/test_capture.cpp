@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The capture calls of M2kAnalogIn against getSamplesRaw, on constant waveforms that give
+// known raw codes on both channels
+
+#include "sim_test.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <libm2k/m2khardwaretrigger.hpp>
+#include <iio.h>
+#include "iio_sim.hpp"
+#include <iostream>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+
+static ContextBuilder builder;
+
+static const short RAW[] = {-121, 300};
+
+static void testViews(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	std::vector<SAMPLE_VIEW<short>> views = ain->getSamplesView(1000);
+	SIM_CHECK(views.size() == 2);
+
+	/* The views point inside the RX buffer, one sample of each channel per step */
+	iio_buffer *buffer = ain->getIioObjects().buffers_rx.at(0);
+	const short *start = static_cast<const short *>(iio_buffer_start(buffer));
+	const short *end = static_cast<const short *>(iio_buffer_end(buffer));
+	for (unsigned int ch = 0; ch < 2; ch++) {
+		SIM_CHECK(views[ch].data >= start && views[ch].data < end);
+		SIM_CHECK(views[ch].step == 2);
+		SIM_CHECK(views[ch].nb_samples == 1000);
+		SIM_CHECK(views[ch][0] == RAW[ch] && views[ch][999] == RAW[ch]);
+	}
+	std::vector<std::vector<double>> raw = ain->getSamplesRaw(1000);
+	for (unsigned int ch = 0; ch < 2; ch++) {
+		SIM_CHECK(raw[ch].size() == 1000 && raw[ch][500] == RAW[ch]);
+	}
+
+	/* Both channels are refilled, but a disabled one has an empty view */
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, false);
+	views = ain->getSamplesView(1000);
+	SIM_CHECK(views[1].data == nullptr && views[1].nb_samples == 0);
+	SIM_CHECK(views[0].step == 2 && views[0].nb_samples == 1000);
+	SIM_CHECK(views[0][0] == RAW[0] && views[0][999] == RAW[0]);
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+	ain->stopAcquisition();
+}
+
+static void testInterleaved(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	const double volts[] = {ain->convertRawToVolts(0, RAW[0]), ain->convertRawToVolts(1, RAW[1])};
+
+	/* The caller's memory is filled with the two channels interleaved, and nothing past it */
+	std::vector<double> arena(2 * 1000 + 1, 42);
+	ain->getSamplesInterleaved(arena.data(), 1000);
+	for (unsigned int i = 0; i < 2 * 1000; i++) {
+		SIM_CHECK_CLOSE(arena[i], volts[i % 2], 1e-9);
+	}
+	SIM_CHECK(arena[2 * 1000] == 42);
+
+	const double *owned = ain->getSamplesInterleaved(1000);
+	SIM_CHECK(owned != arena.data());
+	SIM_CHECK_CLOSE(owned[0], volts[0], 1e-9);
+	SIM_CHECK_CLOSE(owned[1999], volts[1], 1e-9);
+
+	const short *raw = ain->getSamplesRawInterleaved(1000);
+	SIM_CHECK(raw[0] == RAW[0] && raw[1] == RAW[1] && raw[1998] == RAW[0] && raw[1999] == RAW[1]);
+	ain->stopAcquisition();
+}
+
+static void testTypedCaptures(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	std::vector<std::vector<double>> volts = ain->getSamples(1000);
+	std::vector<std::vector<float>> volts_float = ain->getSamplesFloat(1000);
+	std::vector<std::vector<short>> raw = ain->getSamplesRawShort(1000);
+	SIM_CHECK(volts_float.size() == 2 && raw.size() == 2);
+	for (unsigned int ch = 0; ch < 2; ch++) {
+		SIM_CHECK(volts_float[ch].size() == 1000 && raw[ch].size() == 1000);
+		SIM_CHECK_CLOSE(volts[ch][0], ain->convertRawToVolts(ch, RAW[ch]), 1e-9);
+		SIM_CHECK_CLOSE(volts_float[ch][0], volts[ch][0], 1e-5);
+		SIM_CHECK_CLOSE(volts_float[ch][999], volts[ch][999], 1e-5);
+		SIM_CHECK(raw[ch][0] == RAW[ch] && raw[ch][999] == RAW[ch]);
+	}
+
+	/* The containers of the client are cleared, then filled */
+	std::vector<std::vector<float>> float_data(5, std::vector<float>(3, 42));
+	std::vector<std::vector<short>> short_data(5, std::vector<short>(3, 42));
+	ain->getSamples(float_data, 500);
+	ain->getSamplesRaw(short_data, 500);
+	SIM_CHECK(float_data.size() == 2 && short_data.size() == 2);
+	for (unsigned int ch = 0; ch < 2; ch++) {
+		SIM_CHECK(float_data[ch].size() == 500 && short_data[ch].size() == 500);
+		SIM_CHECK_CLOSE(float_data[ch][499], volts[ch][0], 1e-5);
+		SIM_CHECK(short_data[ch][499] == RAW[ch]);
+	}
+	ain->stopAcquisition();
+}
+
+static void testVoltage(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	M2kHardwareTrigger *trigger = ain->getTrigger();
+	const double volts[] = {ain->convertRawToVolts(0, RAW[0]), ain->convertRawToVolts(1, RAW[1])};
+	trigger->setAnalogMode(0, ANALOG);
+
+	/* A single reading acquires with the trigger disabled, then restores it */
+	SIM_CHECK(ain->getVoltageRaw(0) == RAW[0]);
+	SIM_CHECK_CLOSE(ain->getVoltage(1), volts[1], 1e-9);
+	std::vector<double> both = ain->getVoltage();
+	SIM_CHECK(both.size() == 2);
+	SIM_CHECK_CLOSE(both[0], volts[0], 1e-9);
+	SIM_CHECK_CLOSE(both[1], volts[1], 1e-9);
+	SIM_CHECK(trigger->getAnalogMode(0) == ANALOG);
+
+	/* The voltmeter keeps the trigger disabled and the channels enabled between readings */
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, false);
+	ain->startVoltmeter(100);
+	SIM_CHECK(trigger->getAnalogMode(0) == ALWAYS);
+	for (unsigned int i = 0; i < 3; i++) {
+		const short *raw = ain->getVoltageRawP();
+		SIM_CHECK(raw[0] == RAW[0] && raw[1] == RAW[1]);
+		const double *mean = ain->getVoltageP();
+		SIM_CHECK_CLOSE(mean[0], volts[0], 1e-9);
+		SIM_CHECK_CLOSE(mean[1], volts[1], 1e-9);
+	}
+	ain->stopVoltmeter();
+	SIM_CHECK(trigger->getAnalogMode(0) == ANALOG);
+	SIM_CHECK(!ain->isChannelEnabled(ANALOG_IN_CHANNEL_2));
+
+	trigger->setAnalogMode(0, ALWAYS);
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+}
+
+int main()
+{
+	iio_context *ctx = iio_create_context_from_uri("sim:?timing=0");
+	if (!ctx) {
+		std::cerr << "Can not create the simulated context" << std::endl;
+		return 1;
+	}
+	for (unsigned int ch = 0; ch < 2; ch++) {
+		iio_sim::setWaveform(ctx, "m2k-adc", "voltage" + std::to_string(ch),
+				     {iio_sim::SIM_CONSTANT, 0, 0, (double)RAW[ch], 0, 0});
+	}
+	M2k *m2k = builder.m2kOpen(ctx, "sim:?timing=0");
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->setSampleRate(1e6);
+	ain->enableChannel(ANALOG_IN_CHANNEL_1, true);
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+	sim_test::run("zero-copy views", [m2k] { testViews(m2k); });
+	sim_test::run("interleaved", [m2k] { testInterleaved(m2k); });
+	sim_test::run("float and raw captures", [m2k] { testTypedCaptures(m2k); });
+	sim_test::run("voltage", [m2k] { testVoltage(m2k); });
+	builder.contextClose(m2k);
+	return sim_test::result();
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Nesting and failure semantics of beginConfiguration, commitConfiguration and
+// cancelConfiguration, and the attribute cache, on the simulated M2K
+
+#include "sim_test.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <libm2k/analog/m2kanalogout.hpp>
+#include <iio.h>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+
+static ContextBuilder builder;
+
+static void testCommit(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->setSampleRate(1e6);
+
+	/* The staged value is read back inside the transaction and applied by the outermost commit */
+	ain->beginConfiguration();
+	ain->beginConfiguration();
+	ain->setSampleRate(1e5);
+	ain->commitConfiguration();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+	ain->commitConfiguration();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+
+	/* Without a transaction there is nothing to commit; a cancel does nothing */
+	SIM_CHECK_THROWS(ain->commitConfiguration());
+	ain->cancelConfiguration();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+}
+
+static void testCancel(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->setSampleRate(1e6);
+	double scale = ain->getScalingFactor(ANALOG_IN_CHANNEL_1);
+
+	/* The outermost cancel drops everything */
+	ain->beginConfiguration();
+	ain->setSampleRate(1e3);
+	ain->cancelConfiguration();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e6, 1e-6);
+	SIM_CHECK_CLOSE(ain->getScalingFactor(ANALOG_IN_CHANNEL_1), scale, 1e-12);
+
+	/* A nested cancel makes the outermost commit fail, and nothing is written */
+	ain->beginConfiguration();
+	ain->setSampleRate(1e5);
+	ain->beginConfiguration();
+	ain->setSampleRate(1e3);
+	ain->cancelConfiguration();
+	SIM_CHECK_THROWS(ain->commitConfiguration());
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e6, 1e-6);
+	SIM_CHECK_CLOSE(ain->getScalingFactor(ANALOG_IN_CHANNEL_1), scale, 1e-12);
+
+	/* The failed transaction is over; the next one starts clean */
+	ain->beginConfiguration();
+	ain->setSampleRate(1e5);
+	ain->commitConfiguration();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+
+	/* A nested cancel followed by an outermost cancel ends the transaction as well */
+	ain->beginConfiguration();
+	ain->beginConfiguration();
+	ain->setSampleRate(1e3);
+	ain->cancelConfiguration();
+	ain->cancelConfiguration();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+	SIM_CHECK_THROWS(ain->commitConfiguration());
+}
+
+static void testAnalogOut(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	aout->setSampleRate(0, 75e6);
+	aout->setSampleRate(1, 75e6);
+
+	aout->beginConfiguration();
+	aout->setSampleRate(0, 750000);
+	aout->beginConfiguration();
+	aout->setSampleRate(1, 7500000);
+	aout->commitConfiguration();
+	aout->commitConfiguration();
+	SIM_CHECK_CLOSE(aout->getSampleRate(0), 750000, 1e-6);
+	SIM_CHECK_CLOSE(aout->getSampleRate(1), 7500000, 1e-6);
+
+	aout->beginConfiguration();
+	aout->setSampleRate(0, 75e6);
+	aout->beginConfiguration();
+	aout->setSampleRate(1, 75e6);
+	aout->cancelConfiguration();
+	SIM_CHECK_THROWS(aout->commitConfiguration());
+	SIM_CHECK_CLOSE(aout->getSampleRate(0), 750000, 1e-6);
+	SIM_CHECK_CLOSE(aout->getSampleRate(1), 7500000, 1e-6);
+}
+
+static void testChannelSampleRate(M2k *m2k)
+{
+	/* The rate is shared: setting it through one channel sets it for both */
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	SIM_CHECK_CLOSE(ain->setSampleRate(1, 1e5), 1e5, 1e-6);
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+	SIM_CHECK_THROWS(ain->setSampleRate(2, 1e6));
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+}
+
+static void testAttributeCache(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	iio_device *adc = ain->getIioObjects().devices.at(0);
+
+	/* A write is read back once, then served from memory */
+	ain->setAttributeCaching(true);
+	ain->setSampleRate(1e5);
+	SIM_CHECK(iio_device_attr_write(adc, "sampling_frequency", "1000000") > 0);
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+	ain->invalidateAttributeCache();
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e6, 1e-6);
+
+	/* Every write through the library refreshes the cached value */
+	ain->setSampleRate(1e5);
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e5, 1e-6);
+
+	/* Without the cache, every access reaches the device */
+	ain->setAttributeCaching(false);
+	SIM_CHECK(iio_device_attr_write(adc, "sampling_frequency", "1000000") > 0);
+	SIM_CHECK_CLOSE(ain->getSampleRate(), 1e6, 1e-6);
+}
+
+int main()
+{
+	M2k *m2k = builder.m2kOpen("sim:?timing=0");
+	if (!m2k) {
+		std::cerr << "Can not open the simulated M2K" << std::endl;
+		return 1;
+	}
+	sim_test::run("nested commit", [m2k] { testCommit(m2k); });
+	sim_test::run("nested cancel", [m2k] { testCancel(m2k); });
+	sim_test::run("analog output transactions", [m2k] { testAnalogOut(m2k); });
+	sim_test::run("sample rate of a channel", [m2k] { testChannelSampleRate(m2k); });
+	sim_test::run("attribute cache", [m2k] { testAttributeCache(m2k); });
+	builder.contextClose(m2k);
+	return sim_test::result();
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The conversion kernels against plain scalar loops, for every length around the vector
+// widths and for the steps of one channel, of two interleaved channels and of three
+
+#include "sim_test.hpp"
+#include "utils/conversion.hpp"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace libm2k::utils;
+
+static const unsigned int LENGTHS[] = {0, 1, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100, 1001};
+static const unsigned int STEPS[] = {1, 2, 3};
+
+static std::vector<short> randomRaw(std::mt19937 &rng, size_t count)
+{
+	std::uniform_int_distribution<int> codes(-32768, 32767);
+	std::vector<short> raw(count);
+	for (short &value : raw) {
+		value = static_cast<short>(codes(rng));
+	}
+	return raw;
+}
+
+static void testRawToScaled()
+{
+	std::mt19937 rng(1);
+	const CHANNEL_COEFFICIENTS coefficients = {0.0012345, -0.25};
+	for (unsigned int step : STEPS) {
+		for (unsigned int n : LENGTHS) {
+			std::vector<short> raw = randomRaw(rng, (size_t)n * step + 1);
+			std::vector<double> volts(n + 1, 42);
+			std::vector<float> volts_float(n + 1, 42);
+			Conversion::rawToScaled(raw.data(), step, n, coefficients, volts.data());
+			Conversion::rawToScaled(raw.data(), step, n, coefficients, volts_float.data());
+			for (unsigned int i = 0; i < n; i++) {
+				double expected = raw[i * step] * coefficients.scale + coefficients.offset;
+				SIM_CHECK_CLOSE(volts[i], expected, 1e-12);
+				SIM_CHECK_CLOSE(volts_float[i], expected, 1e-5);
+			}
+			/* Nothing is written past the last sample */
+			SIM_CHECK(volts[n] == 42);
+			SIM_CHECK(volts_float[n] == 42);
+		}
+	}
+}
+
+static void testExtractAndSum()
+{
+	std::mt19937 rng(2);
+	for (unsigned int step : STEPS) {
+		for (unsigned int n : LENGTHS) {
+			std::vector<short> raw = randomRaw(rng, (size_t)n * step + 1);
+			std::vector<short> extracted(n);
+			Conversion::extract(raw.data(), step, n, extracted.data());
+			long long sum = 0;
+			SAMPLE_STATISTICS expected = {0, 0, 0, std::numeric_limits<short>::max(),
+						      std::numeric_limits<short>::min()};
+			for (unsigned int i = 0; i < n; i++) {
+				short value = raw[i * step];
+				SIM_CHECK(extracted[i] == value);
+				sum += value;
+				expected.nb_samples++;
+				expected.sum += value;
+				expected.sum_squares += (unsigned long long)((long long)value * value);
+				expected.min = std::min(expected.min, value);
+				expected.max = std::max(expected.max, value);
+			}
+			SIM_CHECK(Conversion::sum(raw.data(), step, n) == sum);
+
+			/* The statistics add up over consecutive calls */
+			SAMPLE_STATISTICS statistics = {0, 0, 0, std::numeric_limits<short>::max(),
+							std::numeric_limits<short>::min()};
+			unsigned int half = n / 2;
+			Conversion::accumulate(raw.data(), step, half, statistics);
+			Conversion::accumulate(raw.data() + half * step, step, n - half, statistics);
+			SIM_CHECK(statistics.nb_samples == expected.nb_samples);
+			SIM_CHECK(statistics.sum == expected.sum);
+			SIM_CHECK(statistics.sum_squares == expected.sum_squares);
+			SIM_CHECK(statistics.min == expected.min);
+			SIM_CHECK(statistics.max == expected.max);
+		}
+	}
+}
+
+static void testFind()
+{
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<int> codes(-100, 100);
+	for (unsigned int step : STEPS) {
+		for (unsigned int n : LENGTHS) {
+			for (unsigned int position = 0; position <= n; position += std::max(1u, n / 5)) {
+				/* Every sample in [-100, 100], but one outlier at position */
+				std::vector<short> raw((size_t)n * step + 1);
+				for (short &value : raw) {
+					value = static_cast<short>(codes(rng));
+				}
+				if (position < n) {
+					raw[position * step] = (position % 2) ? -32768 : 32767;
+				}
+				unsigned int expected = n;
+				for (unsigned int i = 0; i < n; i++) {
+					if (raw[i * step] < -100 || raw[i * step] > 100) {
+						expected = i;
+						break;
+					}
+				}
+				SIM_CHECK(Conversion::find(raw.data(), step, n, -100, 100, false) == expected);
+				SIM_CHECK(Conversion::find(raw.data(), step, n, 101, 32767, true) ==
+					  ((position < n && raw[position * step] > 0) ? position : n));
+
+				/* The bounds of the range are inclusive */
+				if (n > 0) {
+					short first = raw[0];
+					SIM_CHECK(Conversion::find(raw.data(), step, n, first, first, true) == 0);
+				}
+			}
+		}
+	}
+}
+
+static void testScaledToRaw()
+{
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<double> volts(-12, 12);
+	const double scale = 3000;
+	for (unsigned int step : STEPS) {
+		for (unsigned int n : LENGTHS) {
+			std::vector<double> src((size_t)n * step + 1);
+			for (double &value : src) {
+				value = volts(rng);
+			}
+			/* Saturation on both sides, and NaN */
+			if (n > 2) {
+				src[0] = 1e9;
+				src[step] = -1e9;
+				src[2 * step] = std::numeric_limits<double>::quiet_NaN();
+			}
+			std::vector<short> raw(n + 1, 42);
+			Conversion::scaledToRaw(src.data(), step, n, scale, raw.data());
+			for (unsigned int i = 0; i < n; i++) {
+				double value = src[i * step] * scale;
+				short expected;
+				if (std::isnan(value)) {
+					expected = -32768;
+				} else {
+					value = std::min(std::max(value, -32768.0), 32767.0);
+					expected = static_cast<short>(std::lrint(value));
+				}
+				SIM_CHECK(raw[i] == expected);
+			}
+			SIM_CHECK(raw[n] == 42);
+		}
+	}
+}
+
+static void testInterleaved()
+{
+	std::mt19937 rng(5);
+	const CHANNEL_COEFFICIENTS coefficients[] = {{0.001, 0.5}, {-0.002, -1}, {0.5, 0}};
+	for (unsigned int nb_channels = 1; nb_channels <= 3; nb_channels++) {
+		for (unsigned int n : LENGTHS) {
+			std::vector<short> raw = randomRaw(rng, (size_t)n * nb_channels);
+			std::vector<double> volts((size_t)n * nb_channels);
+			Conversion::rawToScaledInterleaved(raw.data(), nb_channels, n, coefficients, volts.data());
+			for (size_t i = 0; i < volts.size(); i++) {
+				const CHANNEL_COEFFICIENTS &c = coefficients[i % nb_channels];
+				SIM_CHECK_CLOSE(volts[i], raw[i] * c.scale + c.offset, 1e-12);
+			}
+		}
+	}
+}
+
+int main()
+{
+	sim_test::run("raw to scaled", testRawToScaled);
+	sim_test::run("extract, sum and statistics", testExtractAndSum);
+	sim_test::run("find", testFind);
+	sim_test::run("scaled to raw", testScaledToRaw);
+	sim_test::run("interleaved raw to scaled", testInterleaved);
+	return sim_test::result();
+}
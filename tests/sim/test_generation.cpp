@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The push paths of M2kAnalogOut, checked on the samples left in the TX buffers of the
+// simulated DACs
+
+#include "sim_test.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogout.hpp>
+#include <iio.h>
+#include "iio_sim.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+
+static ContextBuilder builder;
+static iio_context *ctx;
+
+static const std::string DACS[] = {"m2k-dac-a", "m2k-dac-b"};
+
+/* The samples of the last buffer created on the given channel */
+static const short *txData(M2kAnalogOut *aout, unsigned int chn)
+{
+	return static_cast<const short *>(iio_buffer_start(aout->getIioObjects().buffers_tx.at(chn)));
+}
+
+static void testAcquireCommit(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	aout->setCyclic(false);
+	unsigned long long pushes = iio_sim::getStatistics(ctx, DACS[0]).pushes;
+
+	/* The samples are written in place, and only sent by the commit */
+	short *raw = aout->acquireBuffer(0, 1000);
+	SIM_CHECK(raw == txData(aout, 0));
+	for (unsigned int i = 0; i < 1000; i++) {
+		raw[i] = static_cast<short>(i * 16);
+	}
+	SIM_CHECK(iio_sim::getStatistics(ctx, DACS[0]).pushes == pushes);
+	aout->commitBuffer(0);
+	SIM_CHECK(iio_sim::getStatistics(ctx, DACS[0]).pushes == pushes + 1);
+	SIM_CHECK(txData(aout, 0)[999] == 999 * 16);
+
+	/* A commit needs its own acquire */
+	SIM_CHECK_THROWS(aout->commitBuffer(0));
+	SIM_CHECK_THROWS(aout->acquireBuffer(0, 0));
+	SIM_CHECK_THROWS(aout->acquireBuffer(2, 1000));
+	SIM_CHECK_THROWS(aout->commitBuffer(2));
+	aout->stop();
+	aout->setCyclic(true);
+}
+
+static void testBufferReuse(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	aout->setCyclic(false);
+	BUFFER_STATISTICS before = aout->getBufferStatistics(0);
+
+	/* Streamed buffers of the same size share one IIO buffer */
+	for (unsigned int i = 0; i < 3; i++) {
+		aout->pushRaw(0, std::vector<short>(1024, 16));
+	}
+	BUFFER_STATISTICS stats = aout->getBufferStatistics(0);
+	SIM_CHECK(stats.nb_pushes == before.nb_pushes + 3);
+	SIM_CHECK(stats.buffers_created == before.buffers_created + 1);
+	SIM_CHECK(stats.buffers_reused == before.buffers_reused + 2);
+	SIM_CHECK(stats.last_push_latency >= 0 && stats.max_push_latency >= stats.last_push_latency);
+
+	/* A new size, a new mode and a cyclic buffer already pushed all need a new one */
+	aout->pushRaw(0, std::vector<short>(2048, 16));
+	aout->setCyclic(true);
+	aout->pushRaw(0, std::vector<short>(2048, 16));
+	aout->pushRaw(0, std::vector<short>(2048, 32));
+	stats = aout->getBufferStatistics(0);
+	SIM_CHECK(stats.nb_pushes == before.nb_pushes + 6);
+	SIM_CHECK(stats.buffers_created == before.buffers_created + 4);
+	SIM_CHECK(stats.buffers_reused == before.buffers_reused + 2);
+	SIM_CHECK(txData(aout, 0)[2047] == 32);
+	aout->stop();
+}
+
+static void testPushVolts(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	std::vector<std::vector<double>> volts(2);
+	for (unsigned int i = 0; i < 1000; i++) {
+		volts[0].push_back(-4.5 + i * 0.009);
+		volts[1].push_back(std::sin(i * 0.01) * 3);
+	}
+	auto checkRaw = [&](unsigned int chn) {
+		const short *raw = txData(aout, chn);
+		for (unsigned int i = 0; i < volts[chn].size(); i++) {
+			if (raw[i] != aout->convertVoltsToRaw(chn, volts[chn][i])) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	/* Every push path converts the Volts as convertVoltsToRaw does */
+	aout->push(0, volts[0]);
+	SIM_CHECK(checkRaw(0));
+	aout->push(volts);
+	SIM_CHECK(checkRaw(0) && checkRaw(1));
+	aout->pushBytes(1, volts[1].data(), volts[1].size());
+	SIM_CHECK(checkRaw(1));
+
+	std::vector<double> interleaved;
+	for (unsigned int i = 0; i < 1000; i++) {
+		interleaved.push_back(volts[0][i]);
+		interleaved.push_back(volts[1][i]);
+	}
+	aout->pushInterleaved(interleaved.data(), 2, interleaved.size());
+	SIM_CHECK(checkRaw(0) && checkRaw(1));
+
+	/* Out of range Volts saturate */
+	aout->push(0, std::vector<double>(16, 1e6));
+	SIM_CHECK(txData(aout, 0)[15] == aout->convertVoltsToRaw(0, 1e6));
+	aout->stop();
+}
+
+static void testWaveformCache(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	aout->setCyclic(true);
+	aout->setSampleRate(0, 750000);
+	aout->setSampleRate(1, 7500000);
+
+	std::vector<short> ramp;
+	for (unsigned int i = 0; i < 1024; i++) {
+		ramp.push_back(static_cast<short>(i * 16));
+	}
+	std::vector<std::vector<double>> volts = {std::vector<double>(512, 1.5), std::vector<double>(256, -2)};
+	aout->registerWaveformRaw("ramp", {ramp, {}});
+	aout->registerWaveform("steps", volts);
+	const short raw_volts[] = {aout->convertVoltsToRaw(0, 1.5), aout->convertVoltsToRaw(1, -2)};
+	SIM_CHECK((aout->getWaveforms() == std::vector<std::string>{"ramp", "steps"}));
+
+	WAVEFORM_INFO info = aout->getWaveformInfo("ramp");
+	SIM_CHECK(info.id == "ramp");
+	SIM_CHECK(info.nb_samples.size() == 2 && info.nb_samples[0] == 1024 && info.nb_samples[1] == 0);
+	SIM_CHECK_CLOSE(info.sample_rate[0], 750000, 1e-6);
+	SIM_CHECK(info.nb_activations == 0);
+
+	/* The activation restores the sample rate the waveform was registered with */
+	aout->setSampleRate(0, 7500000);
+	unsigned long long pushes[] = {iio_sim::getStatistics(ctx, DACS[0]).pushes,
+				       iio_sim::getStatistics(ctx, DACS[1]).pushes};
+	SIM_CHECK(aout->activateWaveform("ramp") >= 0);
+	SIM_CHECK_CLOSE(aout->getSampleRate(0), 750000, 1e-6);
+	SIM_CHECK(iio_sim::getStatistics(ctx, DACS[0]).pushes == pushes[0] + 1);
+	SIM_CHECK(iio_sim::getStatistics(ctx, DACS[1]).pushes == pushes[1]);
+	SIM_CHECK(txData(aout, 0)[1023] == ramp[1023]);
+
+	/* A waveform still being generated is not sent again */
+	aout->activateWaveform("ramp");
+	SIM_CHECK(iio_sim::getStatistics(ctx, DACS[0]).pushes == pushes[0] + 1);
+	SIM_CHECK(aout->getWaveformInfo("ramp").nb_activations == 2);
+
+	aout->activateWaveform("steps");
+	SIM_CHECK(txData(aout, 0)[511] == raw_volts[0] && txData(aout, 1)[255] == raw_volts[1]);
+	aout->activateWaveform("ramp");
+	SIM_CHECK(iio_sim::getStatistics(ctx, DACS[0]).pushes == pushes[0] + 3);
+	SIM_CHECK(txData(aout, 0)[0] == ramp[0] && txData(aout, 0)[1023] == ramp[1023]);
+
+	/* Unknown ids, empty waveforms and extra channels are rejected */
+	aout->unregisterWaveform("ramp");
+	SIM_CHECK((aout->getWaveforms() == std::vector<std::string>{"steps"}));
+	SIM_CHECK_THROWS(aout->activateWaveform("ramp"));
+	SIM_CHECK_THROWS(aout->getWaveformInfo("ramp"));
+	SIM_CHECK_THROWS(aout->unregisterWaveform("ramp"));
+	SIM_CHECK_THROWS(aout->registerWaveformRaw("empty", {{}, {}}));
+	SIM_CHECK_THROWS(aout->registerWaveformRaw("extra", {ramp, ramp, ramp}));
+	aout->unregisterWaveform("steps");
+	aout->stop();
+}
+
+static void testPushRawInterleaved(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	std::vector<short> interleaved;
+	for (unsigned int i = 0; i < 1000; i++) {
+		interleaved.push_back(static_cast<short>(i * 16));
+		interleaved.push_back(static_cast<short>(-16 * (int)i));
+	}
+
+	/* nb_samples counts the samples of all the channels */
+	aout->pushRawInterleaved(interleaved.data(), 2, interleaved.size());
+	bool deinterleaved = true;
+	for (unsigned int i = 0; i < 1000; i++) {
+		deinterleaved = deinterleaved && txData(aout, 0)[i] == interleaved[2 * i] &&
+				txData(aout, 1)[i] == interleaved[2 * i + 1];
+	}
+	SIM_CHECK(deinterleaved);
+
+	/* A single channel is taken as it is */
+	aout->pushRawInterleaved(interleaved.data(), 1, 500);
+	SIM_CHECK(txData(aout, 0)[0] == interleaved[0] && txData(aout, 0)[499] == interleaved[499]);
+
+	SIM_CHECK_THROWS(aout->pushRawInterleaved(interleaved.data(), 2, 999));
+	SIM_CHECK_THROWS(aout->pushRawInterleaved(interleaved.data(), 0, 1000));
+	SIM_CHECK_THROWS(aout->pushRawInterleaved(interleaved.data(), 3, 999));
+	std::vector<double> volts(1000, 0);
+	SIM_CHECK_THROWS(aout->pushInterleaved(volts.data(), 0, 1000));
+	aout->stop();
+}
+
+/* Waits for the condition, at most one second */
+template <typename Condition>
+static bool waitFor(Condition condition)
+{
+	for (unsigned int i = 0; i < 1000 && !condition(); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return condition();
+}
+
+static void testGenerator(M2k *m2k)
+{
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	std::atomic<unsigned int> calls(0);
+	std::atomic<bool> last(false);
+	bool consistent = true;
+
+	/* The producer writes raw samples straight into the TX buffers, until it ends the stream */
+	SIM_CHECK_THROWS(aout->startStreaming(0, [](const GENERATOR_BLOCK &) { return true; }));
+	aout->startStreaming(1000, [&](const GENERATOR_BLOCK &block) {
+		consistent = consistent && block.nb_channels == 2 && block.nb_samples == 1000 &&
+			     block.volts == nullptr && block.channels[0] == 0 && block.channels[1] == 1 &&
+			     block.first_sample == block.index * 1000;
+		for (unsigned int ch = 0; ch < block.nb_channels; ch++) {
+			for (unsigned int i = 0; i < block.nb_samples; i++) {
+				block.raw[ch][i] = static_cast<short>((ch + 1) * 16);
+			}
+		}
+		calls++;
+		return !last;
+	});
+	SIM_CHECK(waitFor([&] { return calls >= 5; }));
+	SIM_CHECK(aout->isStreaming());
+
+	/* The stream owns the channels and their settings */
+	SIM_CHECK_THROWS(aout->startStreaming(1000, [](const GENERATOR_BLOCK &) { return true; }));
+	SIM_CHECK_THROWS(aout->pushRaw(0, std::vector<short>(1000, 0)));
+	SIM_CHECK_THROWS(aout->setSampleRate(0, 750000));
+	SIM_CHECK_THROWS(aout->setCyclic(true));
+
+	last = true;
+	SIM_CHECK(waitFor([&] { return !aout->isStreaming(); }));
+	GENERATOR_STATISTICS stats = aout->getStreamingStatistics();
+	SIM_CHECK(txData(aout, 0)[999] == 16 && txData(aout, 1)[999] == 32);
+	aout->stopStreaming();
+	SIM_CHECK(consistent);
+	SIM_CHECK(stats.blocks_generated >= 4 && stats.blocks_generated <= calls);
+	SIM_CHECK(stats.max_producer_duration >= stats.last_producer_duration);
+
+	/* Blocks filled in Volts are converted as the pushes do */
+	calls = 0;
+	aout->startStreaming(500, [&](const GENERATOR_BLOCK &block) {
+		consistent = consistent && block.raw == nullptr && block.volts != nullptr;
+		for (unsigned int ch = 0; ch < block.nb_channels && block.volts; ch++) {
+			for (unsigned int i = 0; i < block.nb_samples; i++) {
+				block.volts[ch][i] = ch ? -1.25 : 2.5;
+			}
+		}
+		calls++;
+		return calls < 3;
+	}, true);
+	SIM_CHECK(waitFor([&] { return !aout->isStreaming(); }));
+	SIM_CHECK(txData(aout, 0)[499] == aout->convertVoltsToRaw(0, 2.5));
+	SIM_CHECK(txData(aout, 1)[499] == aout->convertVoltsToRaw(1, -1.25));
+	aout->stopStreaming();
+	SIM_CHECK(consistent);
+
+	/* A failing producer ends the stream, and its error comes out of stopStreaming */
+	aout->startStreaming(500, [](const GENERATOR_BLOCK &) -> bool {
+		throw std::runtime_error("producer failure");
+	});
+	SIM_CHECK(waitFor([&] { return !aout->isStreaming(); }));
+	bool reported = false;
+	try {
+		aout->stopStreaming();
+	} catch (std::exception &e) {
+		reported = (std::string(e.what()).find("producer failure") != std::string::npos);
+	}
+	SIM_CHECK(reported);
+	aout->pushRaw(0, std::vector<short>(1000, 0));
+	aout->stop();
+}
+
+int main()
+{
+	ctx = iio_create_context_from_uri("sim:?timing=0");
+	if (!ctx) {
+		std::cerr << "Can not create the simulated context" << std::endl;
+		return 1;
+	}
+	M2k *m2k = builder.m2kOpen(ctx, "sim:?timing=0");
+	M2kAnalogOut *aout = m2k->getAnalogOut();
+	aout->enableChannel(0, true);
+	aout->enableChannel(1, true);
+	sim_test::run("acquire and commit", [m2k] { testAcquireCommit(m2k); });
+	sim_test::run("buffer reuse", [m2k] { testBufferReuse(m2k); });
+	sim_test::run("push Volts", [m2k] { testPushVolts(m2k); });
+	sim_test::run("waveform cache", [m2k] { testWaveformCache(m2k); });
+	sim_test::run("push raw interleaved", [m2k] { testPushRawInterleaved(m2k); });
+	sim_test::run("streaming generator", [m2k] { testGenerator(m2k); });
+	builder.contextClose(m2k);
+	return sim_test::result();
+}
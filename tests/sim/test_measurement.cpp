@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The waveform measurements of raw blocks: the statistics and the crossing detection must
+// give the same results whatever the split of the signal into blocks
+
+#include "sim_test.hpp"
+#include "utils/measurement.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <iio.h>
+#include "iio_sim.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+using namespace libm2k::utils;
+
+static const unsigned int BLOCK_SIZES[] = {1, 7, 33, 100, 257, 4096};
+static const CHANNEL_COEFFICIENTS COEFFICIENTS = {0.001, 0.5};
+
+/* A square wave starting high, with noise smaller than the hysteresis */
+static std::vector<short> squareWave(unsigned int period, unsigned int high, unsigned int nb_periods)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> noise(-30, 30);
+	std::vector<short> signal;
+	for (unsigned int p = 0; p < nb_periods; p++) {
+		for (unsigned int i = 0; i < period; i++) {
+			signal.push_back(static_cast<short>((i < high ? 1000 : -1000) + noise(rng)));
+		}
+	}
+	return signal;
+}
+
+static MEASUREMENT_RESULTS measure(const std::vector<short> &signal, unsigned int block_size,
+				   const CHANNEL_COEFFICIENTS &coefficients)
+{
+	MeasurementAccumulator measurement;
+	for (size_t i = 0; i < signal.size(); i += block_size) {
+		unsigned int count = std::min<size_t>(block_size, signal.size() - i);
+		measurement.update(signal.data() + i, 1, count);
+	}
+	return measurement.getResults(coefficients, 1e6);
+}
+
+static void testSquare()
+{
+	std::vector<short> signal = squareWave(100, 30, 20);
+	for (unsigned int block_size : BLOCK_SIZES) {
+		MEASUREMENT_RESULTS results = measure(signal, block_size, COEFFICIENTS);
+		SIM_CHECK(results.nb_samples == signal.size());
+		SIM_CHECK_CLOSE(results.frequency, 1e6 / 100, 1e-6);
+		SIM_CHECK_CLOSE(results.period, 100 / 1e6, 1e-12);
+		SIM_CHECK_CLOSE(results.duty_cycle, 0.3, 1e-9);
+		SIM_CHECK(results.max <= 1.03 + 0.5 + 1e-9 && results.max >= 0.97 + 0.5);
+		SIM_CHECK(results.min >= -1.03 + 0.5 - 1e-9 && results.min <= -0.97 + 0.5);
+		SIM_CHECK_CLOSE(results.peak_to_peak, results.max - results.min, 1e-12);
+		SIM_CHECK_CLOSE(results.mean, 0.5 + (0.3 - 0.7), 0.01);
+		SIM_CHECK_CLOSE(results.ac_rms, std::sqrt(1 - 0.4 * 0.4), 0.01);
+	}
+
+	/* A negative scale turns the high samples into the low ones */
+	MEASUREMENT_RESULTS inverted = measure(signal, 100, {-0.001, 0});
+	SIM_CHECK_CLOSE(inverted.duty_cycle, 0.7, 1e-9);
+	SIM_CHECK_CLOSE(inverted.frequency, 1e6 / 100, 1e-6);
+}
+
+static void testSine()
+{
+	std::vector<short> signal(10000);
+	for (size_t i = 0; i < signal.size(); i++) {
+		signal[i] = static_cast<short>(std::lrint(2000 * std::sin(2 * M_PI * i / 250.0)));
+	}
+	for (unsigned int block_size : BLOCK_SIZES) {
+		MEASUREMENT_RESULTS results = measure(signal, block_size, COEFFICIENTS);
+		SIM_CHECK_CLOSE(results.frequency, 1e6 / 250, 1);
+		SIM_CHECK_CLOSE(results.duty_cycle, 0.5, 0.01);
+		SIM_CHECK_CLOSE(results.ac_rms, 2 / std::sqrt(2.0), 0.01);
+	}
+}
+
+static void testIncompletePeriod()
+{
+	/* A single rising edge is no period; a constant signal has no edge at all */
+	std::vector<short> signal = squareWave(100, 50, 1);
+	signal.insert(signal.begin(), 50, -1000);
+	SIM_CHECK(measure(signal, 16, COEFFICIENTS).frequency == 0);
+	SIM_CHECK(measure(std::vector<short>(1000, 42), 16, COEFFICIENTS).frequency == 0);
+	SIM_CHECK(measure(std::vector<short>(), 16, COEFFICIENTS).nb_samples == 0);
+}
+
+static void testRestart()
+{
+	/* The samples after a restart do not follow the previous ones: no period spans the gap */
+	std::vector<short> signal = squareWave(100, 30, 5);
+	MeasurementAccumulator measurement;
+	measurement.update(signal.data(), 1, 250);
+	measurement.restart();
+	measurement.update(signal.data() + 40, 1, 250);
+	MEASUREMENT_RESULTS results = measurement.getResults(COEFFICIENTS, 1e6);
+	SIM_CHECK(results.nb_samples == 500);
+	SIM_CHECK_CLOSE(results.frequency, 1e6 / 100, 1e-6);
+	SIM_CHECK_CLOSE(results.duty_cycle, 0.3, 1e-9);
+}
+
+static void testAnalogIn()
+{
+	ContextBuilder builder;
+	iio_context *ctx = iio_create_context_from_uri("sim:?timing=0");
+	SIM_CHECK(iio_sim::setWaveform(ctx, "m2k-adc", "voltage0", {iio_sim::SIM_SQUARE, 1000, 1500, 0, 0, 0}) == 0);
+	SIM_CHECK(iio_sim::setWaveform(ctx, "m2k-adc", "voltage1", {iio_sim::SIM_CONSTANT, 0, 0, -121, 0, 0}) == 0);
+	M2k *m2k = builder.m2kOpen(ctx, "sim:?timing=0");
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->setSampleRate(1e6);
+	ain->enableChannel(ANALOG_IN_CHANNEL_1, true);
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+
+	std::vector<MEASUREMENT_RESULTS> results = ain->getMeasurements(20000);
+	SIM_CHECK(results.size() == 2);
+	SIM_CHECK_CLOSE(results[0].frequency, 1000, 1);
+	SIM_CHECK_CLOSE(results[0].duty_cycle, 0.5, 0.01);
+	SIM_CHECK_CLOSE(results[0].peak_to_peak, std::fabs(ain->convertRawToVolts(0, 1500) -
+							   ain->convertRawToVolts(0, -1500)), 1e-6);
+	SIM_CHECK(results[1].frequency == 0);
+	SIM_CHECK_CLOSE(results[1].mean, ain->convertRawToVolts(1, -121), 1e-9);
+	ain->stopAcquisition();
+	builder.contextClose(m2k);
+}
+
+int main()
+{
+	sim_test::run("square wave", testSquare);
+	sim_test::run("sine wave", testSine);
+	sim_test::run("incomplete period", testIncompletePeriod);
+	sim_test::run("restart", testRestart);
+	sim_test::run("analog input measurements", testAnalogIn);
+	return sim_test::result();
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Raw recordings written, then read back through the memory-mapped reader
+
+#include "sim_test.hpp"
+#include "analog/m2krecording_impl.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <libm2k/analog/m2krecording.hpp>
+#include <iio.h>
+#include "iio_sim.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+
+static const char *WRITER_PATH = "libm2k_test_writer.bin";
+static const char *ANALOG_IN_PATH = "libm2k_test_analogin.bin";
+
+static RECORDING_INFO recordingInfo()
+{
+	RECORDING_INFO info = {};
+	info.sample_rate = 1e6;
+	info.oversampling_ratio = 4;
+	info.nb_channels = 2;
+	info.ranges = {PLUS_MINUS_25V, PLUS_MINUS_2_5V};
+	info.calib_gains = {1.01, 0.99};
+	info.calib_offsets = {2050, 2040};
+	info.vertical_offsets = {0.25, -0.5};
+	info.scales = {0.01, -0.002};
+	info.offsets = {0.1, -0.3};
+	info.trigger_modes = {ANALOG, ALWAYS};
+	info.trigger_conditions = {RISING_EDGE_ANALOG, FALLING_EDGE_ANALOG};
+	info.trigger_levels = {100, -200};
+	info.trigger_hysteresis = {0.05, 0.1};
+	info.trigger_source = CHANNEL_2;
+	info.trigger_delay = -500;
+	info.decimation_mode = DECIMATION_CIC;
+	info.decimation_factor = 5;
+	info.decimation_order = 3;
+	return info;
+}
+
+static void testWriterRoundTrip()
+{
+	RECORDING_INFO info = recordingInfo();
+	const unsigned int block_samples = 1000;
+	const unsigned int nb_blocks = 7;
+	{
+		RecordingWriter writer(WRITER_PATH, info);
+		std::vector<short> block(2 * block_samples);
+		for (unsigned int b = 0; b < nb_blocks; b++) {
+			for (unsigned int i = 0; i < block_samples; i++) {
+				int position = b * block_samples + i;
+				block[2 * i] = static_cast<short>(position - 3000);
+				block[2 * i + 1] = static_cast<short>(-position);
+			}
+			writer.write(block.data(), block_samples);
+		}
+		SIM_CHECK(writer.getNbSamples() == (unsigned long long)nb_blocks * block_samples);
+		writer.close(3);
+	}
+
+	M2kRecording *recording = openRecording(WRITER_PATH);
+	RECORDING_INFO read = recording->getInfo();
+	SIM_CHECK(recording->getNbChannels() == 2);
+	SIM_CHECK(recording->getNbSamples() == (unsigned long long)nb_blocks * block_samples);
+	SIM_CHECK(read.nb_samples == (unsigned long long)nb_blocks * block_samples);
+	SIM_CHECK(read.dropped_blocks == 3);
+	SIM_CHECK(read.sample_rate == info.sample_rate);
+	SIM_CHECK(read.oversampling_ratio == info.oversampling_ratio);
+	SIM_CHECK(read.ranges == info.ranges);
+	SIM_CHECK(read.calib_gains == info.calib_gains);
+	SIM_CHECK(read.calib_offsets == info.calib_offsets);
+	SIM_CHECK(read.vertical_offsets == info.vertical_offsets);
+	SIM_CHECK(read.scales == info.scales);
+	SIM_CHECK(read.offsets == info.offsets);
+	SIM_CHECK(read.trigger_modes == info.trigger_modes);
+	SIM_CHECK(read.trigger_conditions == info.trigger_conditions);
+	SIM_CHECK(read.trigger_levels == info.trigger_levels);
+	SIM_CHECK(read.trigger_hysteresis == info.trigger_hysteresis);
+	SIM_CHECK(read.trigger_source == info.trigger_source);
+	SIM_CHECK(read.trigger_delay == info.trigger_delay);
+	SIM_CHECK(read.decimation_mode == info.decimation_mode);
+	SIM_CHECK(read.decimation_factor == info.decimation_factor);
+	SIM_CHECK(read.decimation_order == info.decimation_order);
+
+	/* Ranges that span the blocks of the writer */
+	std::vector<short> first = recording->getSamplesRaw(0, 990, 20);
+	std::vector<short> second = recording->getSamplesRaw(1, 990, 20);
+	SAMPLE_VIEW<short> view = recording->getSamplesView(1, 990, 20);
+	std::vector<double> volts = recording->getSamples(0, 990, 20);
+	bool matches = (first.size() == 20 && second.size() == 20 && volts.size() == 20 && view.nb_samples == 20);
+	for (unsigned int i = 0; i < 20 && matches; i++) {
+		int position = 990 + i;
+		matches = (first[i] == position - 3000) && (second[i] == -position) &&
+				(view.data[i * view.step] == -position);
+		SIM_CHECK_CLOSE(volts[i], (position - 3000) * info.scales[0] + info.offsets[0], 1e-9);
+	}
+	SIM_CHECK(matches);
+	SIM_CHECK_THROWS(recording->getSamplesRaw(0, nb_blocks * block_samples - 5, 10));
+	SIM_CHECK_THROWS(recording->getSamplesRaw(2, 0, 1));
+	closeRecording(recording);
+	std::remove(WRITER_PATH);
+
+	SIM_CHECK_THROWS(openRecording(WRITER_PATH));
+}
+
+static void testAnalogInRecording()
+{
+	ContextBuilder builder;
+	iio_context *ctx = iio_create_context_from_uri("sim:?timing=0");
+	iio_sim::WAVEFORM_SETTINGS first = {iio_sim::SIM_CONSTANT, 0, 0, 321, 0, 0};
+	iio_sim::WAVEFORM_SETTINGS second = {iio_sim::SIM_CONSTANT, 0, 0, -121, 0, 0};
+	SIM_CHECK(iio_sim::setWaveform(ctx, "m2k-adc", "voltage0", first) == 0);
+	SIM_CHECK(iio_sim::setWaveform(ctx, "m2k-adc", "voltage1", second) == 0);
+	M2k *m2k = builder.m2kOpen(ctx, "sim:?timing=0");
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->setSampleRate(1e6);
+	ain->setStreamingDecimation(DECIMATION_BOXCAR, 1);
+
+	ain->startRecording(ANALOG_IN_PATH, 1000);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	unsigned long long nb_samples = ain->stopRecording();
+	SIM_CHECK(nb_samples > 0 && nb_samples % 1000 == 0);
+
+	M2kRecording *recording = openRecording(ANALOG_IN_PATH);
+	RECORDING_INFO info = recording->getInfo();
+	SIM_CHECK(recording->getNbSamples() == nb_samples);
+	SIM_CHECK(info.nb_channels == 2);
+	SIM_CHECK_CLOSE(info.sample_rate, ain->getSampleRate(), 1e-6);
+	SIM_CHECK(info.decimation_factor == 1);
+	SIM_CHECK_CLOSE(info.scales.at(0), ain->getScalingFactor(ANALOG_IN_CHANNEL_1), 1e-12);
+
+	std::vector<short> raw0 = recording->getSamplesRaw(0, 0, nb_samples);
+	std::vector<short> raw1 = recording->getSamplesRaw(1, 0, nb_samples);
+	bool constant = true;
+	for (unsigned int i = 0; i < nb_samples; i++) {
+		constant = constant && (raw0[i] == 321) && (raw1[i] == -121);
+	}
+	SIM_CHECK(constant);
+	/* The conversion stored in the file is the one of the acquisition */
+	SIM_CHECK_CLOSE(recording->getSamples(1, 0, 1).at(0), ain->convertRawToVolts(1, -121), 1e-9);
+	closeRecording(recording);
+	std::remove(ANALOG_IN_PATH);
+	builder.contextClose(m2k);
+}
+
+int main()
+{
+	sim_test::run("writer round trip", testWriterRoundTrip);
+	sim_test::run("analog input recording", testAnalogInRecording);
+	return sim_test::result();
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The acquisition sessions of M2kAnalogIn and the voltmeter built on them
+
+#include "sim_test.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+
+static ContextBuilder builder;
+
+static void testSessionCaptures(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->enableChannel(ANALOG_IN_CHANNEL_1, true);
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, false);
+	SIM_CHECK_THROWS(ain->startSession(0));
+	ain->startSession(1000);
+	SIM_CHECK(ain->isSessionRunning());
+
+	/* Every capture of the session refills the same RX buffer */
+	SIM_CHECK(ain->getSamples(1000).at(0).size() == 1000);
+	iio_buffer *buffer = ain->getIioObjects().buffers_rx.at(0);
+	for (unsigned int i = 0; i < 3; i++) {
+		SIM_CHECK(ain->getSamplesRawShort(1000).at(0).size() == 1000);
+		SIM_CHECK(ain->getIioObjects().buffers_rx.at(0) == buffer);
+	}
+
+	/* The size and the configuration are pinned */
+	SIM_CHECK_THROWS(ain->getSamples(500));
+	SIM_CHECK_THROWS(ain->enableChannel(ANALOG_IN_CHANNEL_2, true));
+	SIM_CHECK_THROWS(ain->setRange(ANALOG_IN_CHANNEL_1, PLUS_MINUS_2_5V));
+	SIM_CHECK_THROWS(ain->startSession(1000));
+	SIM_CHECK_THROWS(ain->startVoltmeter(1000));
+
+	/* The channels of the user are back once the session stops */
+	ain->stopSession();
+	SIM_CHECK(!ain->isSessionRunning());
+	SIM_CHECK(ain->isChannelEnabled(ANALOG_IN_CHANNEL_1));
+	SIM_CHECK(!ain->isChannelEnabled(ANALOG_IN_CHANNEL_2));
+	SIM_CHECK(ain->getSamples(500).at(0).size() == 500);
+	ain->stopAcquisition();
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+}
+
+static void testPinnedCalibration(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	double gain = m2k->getAdcCalibrationGain(0);
+	int offset = m2k->getAdcCalibrationOffset(0);
+	double scale = ain->getScalingFactor(ANALOG_IN_CHANNEL_1);
+
+	/* The session pins the conversion coefficients, calibration included */
+	ain->startSession(1000);
+	SIM_CHECK_THROWS(m2k->setAdcCalibrationGain(0, gain * 1.01));
+	SIM_CHECK_THROWS(m2k->setAdcCalibrationOffset(0, offset + 10));
+	SIM_CHECK_THROWS(ain->setSampleRate(1e5));
+	SIM_CHECK_CLOSE(m2k->getAdcCalibrationGain(0), gain, 1e-12);
+	SIM_CHECK(m2k->getAdcCalibrationOffset(0) == offset);
+	SIM_CHECK_CLOSE(ain->getScalingFactor(ANALOG_IN_CHANNEL_1), scale, 1e-12);
+	ain->stopSession();
+
+	m2k->setAdcCalibrationOffset(0, offset);
+	m2k->setAdcCalibrationGain(0, gain);
+}
+
+static void testVoltmeterResize(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->startVoltmeter(100);
+	SIM_CHECK(ain->isVoltmeterRunning());
+	ain->getVoltage();
+
+	/* Another size reopens the session, the voltmeter keeps running */
+	ain->startVoltmeter(200);
+	SIM_CHECK(ain->isVoltmeterRunning());
+	SIM_CHECK(ain->isSessionRunning());
+	SIM_CHECK(ain->getVoltage().size() == 2);
+	SIM_CHECK_THROWS(ain->startSession(100));
+	ain->stopVoltmeter();
+	SIM_CHECK(!ain->isVoltmeterRunning());
+	SIM_CHECK(!ain->isSessionRunning());
+}
+
+int main()
+{
+	M2k *m2k = builder.m2kOpen("sim:?timing=0");
+	if (!m2k) {
+		std::cerr << "Can not open the simulated M2K" << std::endl;
+		return 1;
+	}
+	sim_test::run("captures in a session", [m2k] { testSessionCaptures(m2k); });
+	sim_test::run("calibration pinned by a session", [m2k] { testPinnedCalibration(m2k); });
+	sim_test::run("voltmeter resize", [m2k] { testVoltmeterResize(m2k); });
+	builder.contextClose(m2k);
+	return sim_test::result();
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The FFT and the Welch averaging of the spectrum stage against a naive DFT
+
+#include "sim_test.hpp"
+#include "utils/spectrum.hpp"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace libm2k::analog;
+using namespace libm2k::utils;
+
+static const double PI = 3.14159265358979323846;
+
+/* |X[k]|^2 for k = 0 .. size / 2, summed directly */
+static std::vector<double> naivePower(const std::vector<double> &data)
+{
+	size_t size = data.size();
+	std::vector<double> power(size / 2 + 1);
+	for (size_t k = 0; k < power.size(); k++) {
+		double re = 0;
+		double im = 0;
+		for (size_t j = 0; j < size; j++) {
+			double angle = -2 * PI * (double)((k * j) % size) / size;
+			re += data[j] * std::cos(angle);
+			im += data[j] * std::sin(angle);
+		}
+		power[k] = re * re + im * im;
+	}
+	return power;
+}
+
+static void testRealFft()
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> values(-2048, 2048);
+	const unsigned int sizes[] = {8, 10, 12, 18, 30, 64, 96, 250, 486, 1000, 1024};
+	for (unsigned int size : sizes) {
+		SIM_CHECK(RealFft::isSupportedSize(size));
+		std::vector<double> data(size);
+		for (double &value : data) {
+			value = values(rng);
+		}
+		std::vector<double> expected = naivePower(data);
+
+		RealFft fft(size);
+		std::vector<double> scratch(size);
+		/* The power is added to what is already there */
+		std::vector<double> power(size / 2 + 1, 1.0);
+		std::vector<double> work = data;
+		fft.accumulatePower(work.data(), scratch.data(), power.data());
+
+		double largest = *std::max_element(expected.begin(), expected.end());
+		for (size_t k = 0; k < expected.size(); k++) {
+			SIM_CHECK_CLOSE(power[k] - 1.0, expected[k], largest * 1e-10);
+		}
+	}
+	SIM_CHECK(!RealFft::isSupportedSize(14));
+	SIM_CHECK(!RealFft::isSupportedSize(1001));
+	SIM_CHECK(!RealFft::isSupportedSize(4));
+}
+
+static void testWelch()
+{
+	const unsigned int fft_size = 64;
+	const SPECTRUM_SETTINGS settings = {fft_size, SPECTRUM_WINDOW_HANN, 0.5, SPECTRUM_VOLTS_RMS};
+	const unsigned int hop = fft_size / 2;
+	const unsigned int total = 1000;
+	const double raw_offset = 10;
+
+	std::mt19937 rng(2);
+	std::uniform_int_distribution<int> noise(-300, 300);
+	std::vector<short> raw(total);
+	for (unsigned int i = 0; i < total; i++) {
+		raw[i] = static_cast<short>(std::lround(1000 * std::sin(2 * PI * 5.25 * i / fft_size)) + noise(rng));
+	}
+
+	/* Periodic Hann window, and the average of the power of the overlapping segments */
+	std::vector<double> window(fft_size);
+	double s1 = 0;
+	for (unsigned int j = 0; j < fft_size; j++) {
+		window[j] = 0.5 - 0.5 * std::cos(2 * PI * j / fft_size);
+		s1 += window[j];
+	}
+	std::vector<double> average(fft_size / 2 + 1, 0);
+	unsigned int nb_segments = 0;
+	for (unsigned int start = 0; start + fft_size <= total; start += hop) {
+		std::vector<double> segment(fft_size);
+		for (unsigned int j = 0; j < fft_size; j++) {
+			segment[j] = (raw[start + j] + raw_offset) * window[j];
+		}
+		std::vector<double> power = naivePower(segment);
+		for (size_t k = 0; k < power.size(); k++) {
+			average[k] += power[k];
+		}
+		nb_segments++;
+	}
+
+	/* Blocks of odd sizes, so that the segments span the block boundaries */
+	SpectrumAnalyzer analyzer(settings, raw_offset);
+	unsigned int position = 0;
+	unsigned int block = 1;
+	while (position < total) {
+		unsigned int n = std::min(block, total - position);
+		analyzer.update(raw.data() + position, 1, n);
+		position += n;
+		block = block * 3 % 97 + 1;
+	}
+	SIM_CHECK(analyzer.getNbAverages() == nb_segments);
+
+	const double scale = 0.005;
+	const double sample_rate = 1e5;
+	SPECTRUM spectrum = analyzer.getResults(scale, sample_rate, SPECTRUM_VOLTS_RMS);
+	SIM_CHECK(spectrum.nb_averages == nb_segments);
+	SIM_CHECK_CLOSE(spectrum.bin_width, sample_rate / fft_size, 1e-9);
+	SIM_CHECK(spectrum.values.size() == average.size());
+	for (size_t k = 0; k < average.size() && k < spectrum.values.size(); k++) {
+		double power = average[k] / nb_segments;
+		if (k != 0 && k != average.size() - 1) {
+			power *= 2;
+		}
+		double expected = std::sqrt(power) / s1 * scale;
+		SIM_CHECK_CLOSE(spectrum.values[k], expected, 1e-9 + expected * 1e-9);
+	}
+
+	/* A restart drops the partial segment; a reset drops the averages as well */
+	analyzer.restart();
+	analyzer.update(raw.data(), 1, fft_size - 1);
+	SIM_CHECK(analyzer.getNbAverages() == nb_segments);
+	analyzer.reset();
+	SIM_CHECK(analyzer.getNbAverages() == 0);
+	SIM_CHECK(analyzer.getResults(scale, sample_rate, SPECTRUM_VOLTS_RMS).values.empty());
+}
+
+static void testToneAmplitude()
+{
+	/* A tone centered on a bin reads its RMS amplitude, whatever the window */
+	const unsigned int fft_size = 1000;
+	const M2K_SPECTRUM_WINDOW windows[] = {SPECTRUM_WINDOW_RECTANGULAR, SPECTRUM_WINDOW_HANN,
+						SPECTRUM_WINDOW_BLACKMAN_HARRIS, SPECTRUM_WINDOW_FLAT_TOP};
+	std::vector<short> raw(4 * fft_size);
+	for (size_t i = 0; i < raw.size(); i++) {
+		raw[i] = static_cast<short>(std::lround(1024 * std::sin(2 * PI * 50 * i / fft_size)));
+	}
+	for (M2K_SPECTRUM_WINDOW window : windows) {
+		SPECTRUM_SETTINGS settings = {fft_size, window, 0, SPECTRUM_VOLTS_RMS};
+		SpectrumAnalyzer analyzer(settings);
+		analyzer.update(raw.data(), 1, raw.size());
+		SPECTRUM spectrum = analyzer.getResults(1.0, fft_size, SPECTRUM_VOLTS_RMS);
+		SIM_CHECK(spectrum.nb_averages == 4);
+		SIM_CHECK_CLOSE(spectrum.values.at(50), 1024 / std::sqrt(2.0), 1.0);
+	}
+	SPECTRUM_SETTINGS unsupported = {1001, SPECTRUM_WINDOW_HANN, 0, SPECTRUM_VOLTS_RMS};
+	SIM_CHECK_THROWS(SpectrumAnalyzer analyzer(unsupported));
+}
+
+int main()
+{
+	sim_test::run("real FFT", testRealFft);
+	sim_test::run("Welch averaging", testWelch);
+	sim_test::run("tone amplitude", testToneAmplitude);
+	return sim_test::result();
+}
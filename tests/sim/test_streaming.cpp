@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The continuous acquisition of M2kAnalogIn: its life cycle, its error reporting and
+// how it shares the RX buffer with the other acquisition paths
+
+#include "sim_test.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+
+static ContextBuilder builder;
+
+/* Waits for the condition, at most one second */
+template <typename Condition>
+static bool waitFor(Condition condition)
+{
+	for (unsigned int i = 0; i < 1000 && !condition(); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return condition();
+}
+
+static void testPopBlocks(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->startStreaming(1000, 4);
+	SIM_CHECK_THROWS(ain->startStreaming(1000, 4));
+
+	/* Nothing is consumed: the queue fills up and the next blocks are dropped */
+	SIM_CHECK(waitFor([&] { return ain->getStreamingStatistics().overruns > 0; }));
+	STREAMING_STATISTICS stats = ain->getStreamingStatistics();
+	SIM_CHECK(stats.queue_capacity == 4);
+	SIM_CHECK(stats.queue_depth == 4);
+	SIM_CHECK(stats.blocks_delivered == 0);
+	SIM_CHECK(stats.blocks_acquired >= stats.overruns + stats.queue_depth);
+
+	SIM_CHECK(ain->popStreamingBlock() != nullptr);
+	SIM_CHECK(ain->popStreamingBlock() != nullptr);
+	SIM_CHECK(ain->getStreamingStatistics().blocks_delivered == 2);
+	ain->stopStreaming();
+	SIM_CHECK_THROWS(ain->popStreamingBlock());
+
+	/* A new stream starts with fresh counters */
+	ain->startStreaming(1000, 2);
+	SIM_CHECK(ain->getStreamingStatistics().blocks_delivered == 0);
+	SIM_CHECK(ain->getStreamingStatistics().queue_capacity == 2);
+	SIM_CHECK(ain->popStreamingBlock() != nullptr);
+	ain->stopStreaming();
+}
+
+static void testCallbackBlocks(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	std::vector<unsigned long long> indexes;
+	std::atomic<unsigned int> calls(0);
+	bool consistent = true;
+
+	/* A slow consumer with a short queue: blocks get dropped, and show as gaps */
+	ain->startStreaming(1000, [&](const STREAMING_BLOCK &block) {
+		consistent = consistent && block.nb_samples == 1000 && block.nb_channels == 2 &&
+			     block.volts != nullptr && block.first_sample == block.index * 1000;
+		for (unsigned int ch = 0; ch < 2 && block.volts; ch++) {
+			double expected = ain->convertRawToVolts(ch, block.raw[ch]);
+			consistent = consistent && std::abs(block.volts[ch] - expected) < 1e-9;
+		}
+		indexes.push_back(block.index);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		calls++;
+	}, true, 2);
+	SIM_CHECK(waitFor([&] { return calls >= 10; }));
+	STREAMING_STATISTICS stats = ain->getStreamingStatistics();
+	ain->stopStreaming();
+
+	SIM_CHECK(consistent);
+	SIM_CHECK(stats.queue_capacity == 2);
+	SIM_CHECK(stats.overruns > 0);
+	SIM_CHECK(stats.blocks_delivered >= 10);
+	SIM_CHECK(stats.max_callback_delay >= stats.last_callback_delay);
+	unsigned long long gaps = indexes.front();
+	for (size_t i = 1; i < indexes.size(); i++) {
+		SIM_CHECK(indexes[i] > indexes[i - 1]);
+		gaps += indexes[i] - indexes[i - 1] - 1;
+	}
+	SIM_CHECK(gaps > 0 && gaps <= stats.overruns);
+}
+
+static void testFailedCallback(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->enableChannel(ANALOG_IN_CHANNEL_1, true);
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, false);
+
+	std::atomic<unsigned int> calls(0);
+	ain->startStreaming(1000, [&](const STREAMING_BLOCK &) {
+		calls++;
+		throw std::runtime_error("callback failure");
+	});
+	SIM_CHECK(waitFor([&] { return calls > 0; }));
+
+	/* The stream ended on the error, but it is only released by stopStreaming */
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	SIM_CHECK_THROWS(ain->startStreaming(1000, [](const STREAMING_BLOCK &) {}));
+	bool reported = false;
+	try {
+		ain->stopStreaming();
+	} catch (std::exception &e) {
+		reported = (std::string(e.what()).find("callback failure") != std::string::npos);
+	}
+	SIM_CHECK(reported);
+	SIM_CHECK(calls == 1);
+
+	/* The channels of the user are back, and a new stream starts cleanly */
+	SIM_CHECK(ain->isChannelEnabled(ANALOG_IN_CHANNEL_1));
+	SIM_CHECK(!ain->isChannelEnabled(ANALOG_IN_CHANNEL_2));
+	std::atomic<unsigned int> blocks(0);
+	ain->startStreaming(1000, [&](const STREAMING_BLOCK &) { blocks++; });
+	SIM_CHECK(waitFor([&] { return blocks > 2; }));
+	ain->stopStreaming();
+	SIM_CHECK(!ain->isChannelEnabled(ANALOG_IN_CHANNEL_2));
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+}
+
+static void testCaptureWhileStreaming(M2k *m2k)
+{
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, false);
+	std::atomic<unsigned int> blocks(0);
+	ain->startStreaming(4096, [&](const STREAMING_BLOCK &) { blocks++; });
+	SIM_CHECK(waitFor([&] { return blocks > 0; }));
+
+	/* The refill thread owns the RX buffer: every other use of it is rejected */
+	SIM_CHECK_THROWS(ain->getSamples(1000));
+	SIM_CHECK_THROWS(ain->getSamplesRawShort(4096));
+	SIM_CHECK_THROWS(ain->getSamplesView(1000));
+	SIM_CHECK_THROWS(ain->getVoltage(0));
+	SIM_CHECK_THROWS(ain->startAcquisition(1000));
+	SIM_CHECK_THROWS(ain->stopAcquisition());
+	SIM_CHECK_THROWS(ain->startSession(1000));
+	SIM_CHECK(!ain->isSessionRunning());
+
+	/* The stream goes on, with all the channels it needs */
+	unsigned int before = blocks;
+	SIM_CHECK(waitFor([&] { return blocks > before + 2; }));
+	SIM_CHECK(ain->isChannelEnabled(ANALOG_IN_CHANNEL_2));
+	ain->stopStreaming();
+	SIM_CHECK(!ain->isChannelEnabled(ANALOG_IN_CHANNEL_2));
+
+	/* Once stopped, the captures work again */
+	ain->enableChannel(ANALOG_IN_CHANNEL_2, true);
+	SIM_CHECK(ain->getSamples(1000).size() == 2);
+	ain->stopAcquisition();
+}
+
+int main()
+{
+	M2k *m2k = builder.m2kOpen("sim:?timing=0");
+	if (!m2k) {
+		std::cerr << "Can not open the simulated M2K" << std::endl;
+		return 1;
+	}
+	m2k->getAnalogIn()->setSampleRate(1e6);
+	sim_test::run("pop blocks", [m2k] { testPopBlocks(m2k); });
+	sim_test::run("callback blocks", [m2k] { testCallbackBlocks(m2k); });
+	sim_test::run("restart after a failed callback", [m2k] { testFailedCallback(m2k); });
+	sim_test::run("capture while streaming", [m2k] { testCaptureWhileStreaming(m2k); });
+	builder.contextClose(m2k);
+	return sim_test::result();
+}
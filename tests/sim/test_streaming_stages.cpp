@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// The decimation and the software trigger of the analog streams, fed in blocks of
+// varying sizes: the windows and the frames that span the block boundaries must come
+// out as if the signal had been processed at once
+
+#include "sim_test.hpp"
+#include "utils/decimator.hpp"
+#include "utils/softwaretrigger.hpp"
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <iio.h>
+#include "iio_sim.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace libm2k;
+using namespace libm2k::analog;
+using namespace libm2k::context;
+using namespace libm2k::utils;
+
+/* Division rounded to the nearest integer, halves away from zero, saturated to 16 bits */
+static short roundedQuotient(long long numerator, long long denominator)
+{
+	long long quotient = (numerator >= 0) ? (numerator + denominator / 2) / denominator :
+						-((-numerator + denominator / 2) / denominator);
+	return static_cast<short>(std::max(-32768LL, std::min(32767LL, quotient)));
+}
+
+/* The decimation of a whole interleaved signal, one window after the other */
+static std::vector<short> referenceDecimation(M2K_DECIMATION_MODE mode, unsigned int factor,
+					      unsigned int nb_channels, unsigned int order,
+					      const std::vector<short> &signal)
+{
+	unsigned int nb_frames = signal.size() / nb_channels;
+	std::vector<short> output;
+	if (mode == DECIMATION_CIC) {
+		std::vector<std::vector<long long>> integrators(nb_channels, std::vector<long long>(order, 0));
+		std::vector<std::vector<long long>> combs(nb_channels, std::vector<long long>(order, 0));
+		long long gain = 1;
+		for (unsigned int k = 0; k < order; k++) {
+			gain *= factor;
+		}
+		for (unsigned int f = 0; f < nb_frames; f++) {
+			for (unsigned int c = 0; c < nb_channels; c++) {
+				long long value = signal[f * nb_channels + c];
+				for (unsigned int k = 0; k < order; k++) {
+					integrators[c][k] += value;
+					value = integrators[c][k];
+				}
+			}
+			if ((f + 1) % factor != 0) {
+				continue;
+			}
+			for (unsigned int c = 0; c < nb_channels; c++) {
+				long long value = integrators[c][order - 1];
+				for (unsigned int k = 0; k < order; k++) {
+					long long previous = combs[c][k];
+					combs[c][k] = value;
+					value -= previous;
+				}
+				output.push_back(roundedQuotient(value, gain));
+			}
+		}
+		return output;
+	}
+
+	for (unsigned int window = 0; window + factor <= nb_frames; window += factor) {
+		std::vector<short> minimum(nb_channels);
+		std::vector<short> maximum(nb_channels);
+		for (unsigned int c = 0; c < nb_channels; c++) {
+			long long sum = 0;
+			short low = 32767;
+			short high = -32768;
+			for (unsigned int j = 0; j < factor; j++) {
+				short value = signal[(window + j) * nb_channels + c];
+				sum += value;
+				low = std::min(low, value);
+				high = std::max(high, value);
+			}
+			if (mode == DECIMATION_BOXCAR) {
+				output.push_back(roundedQuotient(sum, factor));
+			}
+			minimum[c] = low;
+			maximum[c] = high;
+		}
+		if (mode == DECIMATION_MIN_MAX) {
+			output.insert(output.end(), minimum.begin(), minimum.end());
+			output.insert(output.end(), maximum.begin(), maximum.end());
+		}
+	}
+	return output;
+}
+
+static void testDecimatorBlocks()
+{
+	std::mt19937 rng(1);
+	const M2K_DECIMATION_MODE modes[] = {DECIMATION_BOXCAR, DECIMATION_CIC, DECIMATION_MIN_MAX};
+	for (unsigned int t = 0; t < 150; t++) {
+		M2K_DECIMATION_MODE mode = modes[t % 3];
+		unsigned int factor = 1 + rng() % ((mode == DECIMATION_CIC) ? 20 : 50);
+		unsigned int nb_channels = 1 + rng() % 2;
+		unsigned int order = 1 + rng() % 4;
+		unsigned int nb_frames = 1 + rng() % 3000;
+		std::vector<short> signal((size_t)nb_frames * nb_channels);
+		for (short &value : signal) {
+			value = static_cast<short>((int)(rng() % 65536) - 32768);
+		}
+
+		Decimator decimator(mode, factor, nb_channels, order);
+		std::vector<short> output;
+		unsigned int position = 0;
+		while (position < nb_frames) {
+			unsigned int n = std::min(nb_frames - position, 1 + (unsigned int)(rng() % 300));
+			unsigned int max_output = decimator.getMaxOutputSamples(n);
+			std::vector<short> block((size_t)(max_output + 1) * nb_channels, 12345);
+			unsigned int produced = decimator.process(&signal[(size_t)position * nb_channels], n, block.data());
+			SIM_CHECK(produced <= max_output);
+			/* Nothing is written past the produced frames */
+			SIM_CHECK(block[(size_t)produced * nb_channels] == 12345);
+			output.insert(output.end(), block.begin(), block.begin() + (size_t)produced * nb_channels);
+			position += n;
+		}
+		SIM_CHECK(output == referenceDecimation(mode, factor, nb_channels, order, signal));
+	}
+
+	/* A reset drops the partial window */
+	Decimator decimator(DECIMATION_BOXCAR, 4, 1);
+	std::vector<short> first = {100, 100, 100};
+	std::vector<short> second = {8, 8, 8, 8};
+	std::vector<short> output(2);
+	SIM_CHECK(decimator.process(first.data(), first.size(), output.data()) == 0);
+	decimator.reset();
+	SIM_CHECK(decimator.process(second.data(), second.size(), output.data()) == 1);
+	SIM_CHECK(output[0] == 8);
+
+	SIM_CHECK_THROWS(Decimator invalid(DECIMATION_CIC, 0, 1));
+}
+
+/*
+ * Channel 0 is a sawtooth of 40 samples from -2000 to 1900, crossing 0 upwards at every
+ * position p with p % 40 == 20; channel 1 holds the position, to check where the frames start.
+ */
+static short sawtooth(unsigned long long position)
+{
+	return static_cast<short>((position % 40) * 100 - 2000);
+}
+
+static std::vector<short> triggerBlock(unsigned long long index, unsigned int block_samples)
+{
+	std::vector<short> block(2 * block_samples);
+	for (unsigned int i = 0; i < block_samples; i++) {
+		unsigned long long position = index * block_samples + i;
+		block[2 * i] = sawtooth(position);
+		block[2 * i + 1] = static_cast<short>(position % 32768);
+	}
+	return block;
+}
+
+static void testTriggerFrames()
+{
+	const unsigned int block_samples = 16;
+	SOFTWARE_TRIGGER_SETTINGS settings = {true, 0, STREAMING_TRIGGER_RISING_EDGE, 0, 0, 50, 25, 30};
+	SoftwareTrigger trigger(settings, 2, block_samples);
+	SIM_CHECK(trigger.getFrameSamples() == 55);
+
+	std::vector<unsigned long long> starts;
+	for (unsigned long long index = 0; index < 100; index++) {
+		std::vector<short> block = triggerBlock(index, block_samples);
+		trigger.push(block.data(), index);
+		unsigned long long first_sample = 0;
+		const short *frame;
+		while ((frame = trigger.nextFrame(first_sample))) {
+			starts.push_back(first_sample);
+			/* The frames span several blocks and wrap around the ring */
+			bool intact = true;
+			for (unsigned int i = 0; i < trigger.getFrameSamples(); i++) {
+				intact = intact && (frame[2 * i] == sawtooth(first_sample + i)) &&
+						(frame[2 * i + 1] == (short)((first_sample + i) % 32768));
+			}
+			SIM_CHECK(intact);
+			SIM_CHECK(frame[2 * settings.pre_samples] >= 0);
+			SIM_CHECK(frame[2 * (settings.pre_samples - 1)] < 0);
+		}
+	}
+
+	/* The crossing at 20 comes too early for the pre-trigger samples; the others make a
+	 * frame each, as the sawtooth re-arms before the next crossing. The last frames are
+	 * still waiting for their post-trigger samples */
+	SIM_CHECK(trigger.getMissedTriggers() == 1);
+	unsigned long long end = 100ULL * block_samples;
+	unsigned long long expected = 0;
+	for (unsigned long long crossing = 60; crossing + settings.post_samples <= end; crossing += 40) {
+		SIM_CHECK(expected < starts.size() && starts[expected] == crossing - settings.pre_samples);
+		expected++;
+	}
+	SIM_CHECK(starts.size() == expected);
+	SIM_CHECK(trigger.getTriggeredFrames() == expected);
+}
+
+static void testTriggerGap()
+{
+	const unsigned int block_samples = 16;
+	SOFTWARE_TRIGGER_SETTINGS settings = {true, 0, STREAMING_TRIGGER_RISING_EDGE, 0, 0, 50, 25, 30};
+	SoftwareTrigger trigger(settings, 2, block_samples);
+	unsigned long long first_sample = 0;
+	for (unsigned long long index = 0; index < 5; index++) {
+		std::vector<short> block = triggerBlock(index, block_samples);
+		trigger.push(block.data(), index);
+		while (trigger.nextFrame(first_sample)) {}
+	}
+	unsigned long long missed = trigger.getMissedTriggers();
+
+	/* After a dropped block the frames can not reach back before it */
+	std::vector<unsigned long long> starts;
+	for (unsigned long long index = 6; index < 20; index++) {
+		std::vector<short> block = triggerBlock(index, block_samples);
+		trigger.push(block.data(), index);
+		while (trigger.nextFrame(first_sample)) {
+			starts.push_back(first_sample);
+		}
+	}
+	SIM_CHECK(!starts.empty());
+	for (unsigned long long start : starts) {
+		SIM_CHECK(start >= 6 * block_samples);
+	}
+	SIM_CHECK(trigger.getMissedTriggers() > missed);
+}
+
+static void testAnalogInChain()
+{
+	/* The stages run in the callback chain of M2kAnalogIn, on a constant simulated signal */
+	ContextBuilder builder;
+	iio_context *ctx = iio_create_context_from_uri("sim:?timing=0");
+	iio_sim::WAVEFORM_SETTINGS ramp = {iio_sim::SIM_SAWTOOTH, 1000, 1500, 0, 0, 0};
+	iio_sim::WAVEFORM_SETTINGS constant = {iio_sim::SIM_CONSTANT, 0, 0, -121, 0, 0};
+	SIM_CHECK(iio_sim::setWaveform(ctx, "m2k-adc", "voltage0", ramp) == 0);
+	SIM_CHECK(iio_sim::setWaveform(ctx, "m2k-adc", "voltage1", constant) == 0);
+	M2k *m2k = builder.m2kOpen(ctx, "sim:?timing=0");
+	M2kAnalogIn *ain = m2k->getAnalogIn();
+	ain->setSampleRate(1e6);
+
+	std::mutex lock;
+	std::vector<unsigned int> sizes;
+	std::vector<short> constant_values;
+	ain->setStreamingDecimation(DECIMATION_BOXCAR, 10);
+	ain->startStreaming(1000, [&](const STREAMING_BLOCK &block) {
+		std::lock_guard<std::mutex> guard(lock);
+		sizes.push_back(block.nb_samples);
+		constant_values.push_back(block.raw[1]);
+	}, false);
+	SIM_CHECK_THROWS(ain->setStreamingDecimation(DECIMATION_CIC, 4));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ain->stopStreaming();
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		SIM_CHECK(!sizes.empty());
+		for (unsigned int size : sizes) {
+			SIM_CHECK(size == 100);
+		}
+		for (short value : constant_values) {
+			SIM_CHECK(value == -121);
+		}
+	}
+
+	/* The trigger and the decimation do not go together */
+	STREAMING_TRIGGER streaming_trigger = {};
+	streaming_trigger.enabled = true;
+	streaming_trigger.channel = 0;
+	streaming_trigger.condition = STREAMING_TRIGGER_RISING_EDGE;
+	streaming_trigger.level = 0;
+	streaming_trigger.pre_samples = 10;
+	streaming_trigger.post_samples = 100;
+	ain->setStreamingTrigger(streaming_trigger);
+	SIM_CHECK_THROWS(ain->startStreaming(1000, [](const STREAMING_BLOCK &) {}, true));
+
+	ain->setStreamingDecimation(DECIMATION_BOXCAR, 1);
+	std::atomic<unsigned int> frames(0);
+	std::atomic<bool> aligned(true);
+	ain->startStreaming(1000, [&](const STREAMING_BLOCK &block) {
+		frames++;
+		if (block.nb_samples != 110 || block.raw[2 * 9] >= block.raw[2 * 10]) {
+			aligned = false;
+		}
+	}, true);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ain->stopStreaming();
+	STREAMING_STATISTICS statistics = ain->getStreamingStatistics();
+	SIM_CHECK(frames > 0);
+	SIM_CHECK(aligned);
+	SIM_CHECK(statistics.triggered_frames == frames);
+
+	builder.contextClose(m2k);
+}
+
+int main()
+{
+	sim_test::run("decimation across blocks", testDecimatorBlocks);
+	sim_test::run("trigger frames across blocks", testTriggerFrames);
+	sim_test::run("trigger after a dropped block", testTriggerGap);
+	sim_test::run("analog input callback chain", testAnalogInChain);
+	return sim_test::result();
+}
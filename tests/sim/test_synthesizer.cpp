@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Continuity of the synthesized waveforms, from one block to the next and around the
+// seam of a looped (cyclic) buffer
+
+#include "sim_test.hpp"
+#include "utils/synthesizer.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace libm2k::analog;
+using namespace libm2k::utils;
+
+static const double SAMPLE_RATE = 750000;
+static const double RAW_SCALE = 1000;
+static const unsigned int MAX_LOOP = 1048576;
+
+static SYNTH_TONE tone(M2K_SYNTH_WAVEFORM waveform, double frequency, double amplitude,
+		       double stop_frequency = 0, double sweep_duration = 0)
+{
+	SYNTH_TONE settings = {waveform, frequency, amplitude, 0, 0.5, stop_frequency, sweep_duration};
+	return settings;
+}
+
+static void testBlocks()
+{
+	SYNTH_SETTINGS settings;
+	settings.offset = 0.5;
+	settings.tones = {tone(SYNTH_SINE, 1234.5, 2), tone(SYNTH_TRIANGLE, 777, 1),
+			  tone(SYNTH_SINE, 100, 1, 20000, 0.005)};
+	const unsigned int total = 10000;
+
+	Synthesizer whole(settings);
+	whole.configure(SAMPLE_RATE, RAW_SCALE);
+	std::vector<short> expected(total);
+	whole.synthesize(expected.data(), total);
+
+	/* The phases and the sweeps carry over between the calls */
+	Synthesizer blocks(settings);
+	blocks.configure(SAMPLE_RATE, RAW_SCALE);
+	std::vector<short> samples(total);
+	unsigned int position = 0;
+	unsigned int size = 1;
+	while (position < total) {
+		unsigned int n = std::min(size, total - position);
+		blocks.synthesize(samples.data() + position, n);
+		position += n;
+		size = size * 7 % 2053 + 1;
+	}
+	SIM_CHECK(samples == expected);
+}
+
+static void testLoop()
+{
+	SYNTH_SETTINGS settings;
+	settings.offset = 0;
+	settings.tones = {tone(SYNTH_SINE, 1234.5, 4), tone(SYNTH_SINE, 3001, 2), tone(SYNTH_TRIANGLE, 997, 1)};
+	Synthesizer synthesizer(settings);
+	synthesizer.configure(SAMPLE_RATE, RAW_SCALE);
+	unsigned int nb_samples = synthesizer.tuneToCycle(MAX_LOOP);
+	SIM_CHECK(nb_samples > 0 && nb_samples <= MAX_LOOP);
+
+	/* The second repetition of the loop matches the first one, so the DAC can cycle over it */
+	std::vector<short> samples(2 * (size_t)nb_samples);
+	synthesizer.synthesize(samples.data(), samples.size());
+	int largest_step = 0;
+	int largest_difference = 0;
+	for (unsigned int i = 0; i < nb_samples; i++) {
+		largest_difference = std::max(largest_difference, std::abs(samples[nb_samples + i] - samples[i]));
+		if (i > 0) {
+			largest_step = std::max(largest_step, std::abs(samples[i] - samples[i - 1]));
+		}
+	}
+	SIM_CHECK(largest_difference <= 1);
+
+	/* No jump at the seam, where the last sample is followed by the first one */
+	SIM_CHECK(std::abs(samples[0] - samples[nb_samples - 1]) <= largest_step + 1);
+}
+
+static void testSweepLoop()
+{
+	SYNTH_SETTINGS settings;
+	settings.offset = 0;
+	settings.tones = {tone(SYNTH_SINE, 1000, 1, 5000, 0.01), tone(SYNTH_SINE, 2000, 1, 3000, 0.01),
+			  tone(SYNTH_SINE, 1234, 1)};
+	Synthesizer synthesizer(settings);
+	synthesizer.configure(SAMPLE_RATE, RAW_SCALE);
+	/* The loop holds exactly one sweep */
+	SIM_CHECK(synthesizer.tuneToCycle(MAX_LOOP) == 7500);
+
+	settings.tones = {tone(SYNTH_SINE, 1000, 1, 5000, 0.01), tone(SYNTH_SINE, 2000, 1, 3000, 0.02)};
+	Synthesizer different(settings);
+	different.configure(SAMPLE_RATE, RAW_SCALE);
+	SIM_CHECK_THROWS(different.tuneToCycle(MAX_LOOP));
+
+	settings.tones = {tone(SYNTH_SINE, 1000, 1, 5000, 2)};
+	Synthesizer longer(settings);
+	longer.configure(SAMPLE_RATE, RAW_SCALE);
+	SIM_CHECK_THROWS(longer.tuneToCycle(MAX_LOOP));
+}
+
+static void testValidate()
+{
+	SYNTH_SETTINGS settings;
+	settings.offset = 0;
+	settings.tones = {tone(SYNTH_SINE, SAMPLE_RATE, 1)};
+	SIM_CHECK_THROWS(Synthesizer::validate(settings, SAMPLE_RATE));
+	settings.tones = {tone(SYNTH_SINE, 1000, 1)};
+	SIM_CHECK_THROWS(Synthesizer::validate(settings, 0));
+	Synthesizer::validate(settings, SAMPLE_RATE);
+}
+
+int main()
+{
+	sim_test::run("continuity across blocks", testBlocks);
+	sim_test::run("seamless loop", testLoop);
+	sim_test::run("loop of a sweep", testSweepLoop);
+	sim_test::run("settings validation", testValidate);
+	return sim_test::result();
+}
@@ -0,0 +1,590 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Microbenchmarks of the libm2k data paths, run against the simulated iio
+// backend (sim: URIs) with the buffer pacing disabled, so only the host side
+// cost is measured. For each benchmark the throughput and the number of heap
+// allocations per iteration are reported.
+//
+// Usage: libm2k_bench [-f <filter>] [-t <seconds>] [-n <samples>]
+//	-f	only run the benchmarks whose name contains <filter>
+//	-t	minimum measuring time of each benchmark (default 0.5)
+//	-n	number of samples per channel for the buffer benchmarks (default 65536)
+
+#include <libm2k/contextbuilder.hpp>
+#include <libm2k/m2k.hpp>
+#include <libm2k/lidar.hpp>
+#include <libm2k/analog/m2kanalogin.hpp>
+#include <libm2k/analog/m2kanalogout.hpp>
+#include <libm2k/digital/m2kdigital.hpp>
+#ifdef COMMUNICATION
+#include <libm2k/tools/spi.hpp>
+#include <libm2k/tools/spi_extra.hpp>
+#include <libm2k/tools/i2c.hpp>
+#include <libm2k/tools/i2c_extra.hpp>
+#include <libm2k/tools/uart.hpp>
+#include <libm2k/tools/uart_extra.hpp>
+#endif
+#include "utils/devicegeneric.hpp"
+#include "utils/devicein.hpp"
+#include "utils/decimator.hpp"
+#include "utils/measurement.hpp"
+#include "utils/softwaretrigger.hpp"
+#include "utils/spectrum.hpp"
+#include "iio_sim.hpp"
+#include <iio.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace libm2k::context;
+using namespace libm2k::analog;
+using namespace libm2k::digital;
+using namespace libm2k::utils;
+
+#define BENCH_URI_M2K "sim:?timing=0"
+#define BENCH_URI_LIDAR "sim:lidar?timing=0"
+
+/* Every heap allocation of the process goes through these, including the ones made inside libm2k */
+static std::atomic<unsigned long long> allocations(0);
+
+void *operator new(std::size_t size)
+{
+	allocations++;
+	void *ptr = std::malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+struct BENCHMARK {
+	std::string name;
+	std::string unit;		///< what is counted by items: samples, ops, bytes
+	unsigned long long items;	///< per iteration
+	unsigned long long bytes;	///< per iteration, raw sample data moved
+	std::function<void()> run;
+};
+
+struct BENCH_SETTINGS {
+	std::string filter;
+	double min_time;
+	unsigned int nb_samples;
+};
+
+static ContextBuilder builder;
+
+static std::string formatRate(double value, const std::string &unit)
+{
+	const char *prefixes[] = {"", "k", "M", "G", "T"};
+	unsigned int idx = 0;
+	while (value >= 1000.0 && idx < 4) {
+		value /= 1000.0;
+		idx++;
+	}
+	char text[64];
+	snprintf(text, sizeof(text), "%8.2f %s%s/s", value, prefixes[idx], unit.c_str());
+	return text;
+}
+
+static void runBenchmark(const BENCHMARK &bench, const BENCH_SETTINGS &settings)
+{
+	typedef std::chrono::steady_clock clock;
+
+	try {
+		/* warm up: buffers are created and attributes cached on the first call */
+		bench.run();
+
+		unsigned long long iterations = 0;
+		unsigned long long allocs_before = allocations.load();
+		auto start = clock::now();
+		double elapsed = 0;
+		do {
+			bench.run();
+			iterations++;
+			elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		} while (elapsed < settings.min_time || iterations < 3);
+		unsigned long long allocs = allocations.load() - allocs_before;
+
+		double ns_per_iter = elapsed * 1e9 / iterations;
+		double items_rate = bench.items * iterations / elapsed;
+		printf("%-36s %10llu %14.0f %20s %16s %12.1f\n", bench.name.c_str(), iterations,
+		       ns_per_iter, formatRate(items_rate, bench.unit).c_str(),
+		       bench.bytes ? formatRate(bench.bytes * iterations / elapsed, "B").c_str() : "-",
+		       (double)allocs / iterations);
+	} catch (std::exception &e) {
+		printf("%-36s failed: %s\n", bench.name.c_str(), e.what());
+	}
+	fflush(stdout);
+}
+
+/* Serve constant inputs, so the waveform synthesis of the simulator weighs little in the refill cost */
+static void setConstantInputs(struct iio_context *ctx, const std::string &device, unsigned int nb_channels)
+{
+	iio_sim::WAVEFORM_SETTINGS constant = {iio_sim::SIM_CONSTANT, 0, 0, 100, 0, 0};
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		iio_sim::setWaveform(ctx, device, "voltage" + std::to_string(i), constant);
+	}
+}
+
+/* Buffer::getSamples and friends, through a bare DeviceIn on the ADC */
+static std::vector<BENCHMARK> bufferBenchmarks(DeviceIn *adc, unsigned int nb_samples)
+{
+	std::vector<BENCHMARK> benches;
+	unsigned int nb_channels = adc->getNbChannels(false);
+	unsigned long long items = (unsigned long long)nb_samples * nb_channels;
+	unsigned long long bytes = items * sizeof(short);
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		adc->enableChannel(i, true, false);
+	}
+	auto coefficients = std::make_shared<std::vector<CHANNEL_COEFFICIENTS>>(nb_channels,
+							CHANNEL_COEFFICIENTS{0.0125, -0.5});
+	auto interleaved = std::make_shared<std::vector<double>>(items);
+	auto data = std::make_shared<std::vector<std::vector<double>>>();
+
+	benches.push_back({"buffer.getSamples", "S", items, bytes, [=]() {
+		auto samples = adc->getSamples(nb_samples, *coefficients);
+	}});
+	benches.push_back({"buffer.getSamples(out)", "S", items, bytes, [=]() {
+		adc->getSamples(*data, nb_samples, *coefficients);
+	}});
+	auto data_float = std::make_shared<std::vector<std::vector<float>>>();
+	auto data_raw = std::make_shared<std::vector<std::vector<short>>>();
+	benches.push_back({"buffer.getSamples(float)", "S", items, bytes, [=]() {
+		adc->getSamples(*data_float, nb_samples, *coefficients);
+	}});
+	benches.push_back({"buffer.getSamples(short)", "S", items, bytes, [=]() {
+		adc->getSamples(*data_raw, nb_samples, *coefficients);
+	}});
+	benches.push_back({"buffer.getSamplesInterleaved", "S", items, bytes, [=]() {
+		adc->getSamplesInterleaved(interleaved->data(), nb_samples, *coefficients);
+	}});
+	benches.push_back({"buffer.getSamplesRawInterleaved", "S", items, bytes, [=]() {
+		adc->getSamplesRawInterleaved(nb_samples);
+	}});
+
+	/* The streaming measurement and decimation stages alone, on one raw block */
+	auto raw = std::make_shared<std::vector<short>>(items);
+	for (unsigned long long i = 0; i < items; i++) {
+		(*raw)[i] = (short)(2000 * sin(2 * M_PI * i / 1000.0));
+	}
+	benches.push_back({"measurement.update", "S", items, bytes, [=]() {
+		MeasurementAccumulator measurement;
+		for (unsigned int ch = 0; ch < nb_channels; ch++) {
+			measurement.update(raw->data() + ch, nb_channels, nb_samples);
+		}
+	}});
+	const M2K_DECIMATION_MODE modes[] = {DECIMATION_BOXCAR, DECIMATION_CIC, DECIMATION_MIN_MAX};
+	const char *names[] = {"decimator.boxcar", "decimator.cic", "decimator.minmax"};
+	for (unsigned int m = 0; m < 3; m++) {
+		auto decimator = std::make_shared<Decimator>(modes[m], 16, nb_channels);
+		auto decimated = std::make_shared<std::vector<short>>(
+					decimator->getMaxOutputSamples(nb_samples) * nb_channels);
+		benches.push_back({names[m], "S", items, bytes, [=]() {
+			decimator->process(raw->data(), nb_samples, decimated->data());
+		}});
+	}
+	auto analyzer = std::make_shared<SpectrumAnalyzer>(SPECTRUM_SETTINGS{4096, SPECTRUM_WINDOW_BLACKMAN_HARRIS,
+										 0.5, SPECTRUM_DBFS});
+	benches.push_back({"spectrum.update", "S", items, bytes, [=]() {
+		for (unsigned int ch = 0; ch < nb_channels; ch++) {
+			analyzer->update(raw->data() + ch, nb_channels, nb_samples);
+		}
+	}});
+	SOFTWARE_TRIGGER_SETTINGS settings = {true, 0, STREAMING_TRIGGER_RISING_EDGE, 0, 0, 100, 100, 400};
+	auto trigger = std::make_shared<SoftwareTrigger>(settings, nb_channels, nb_samples);
+	auto trigger_index = std::make_shared<unsigned long long>(0);
+	benches.push_back({"trigger.push", "S", items, bytes, [=]() {
+		unsigned long long first_sample;
+		trigger->push(raw->data(), (*trigger_index)++);
+		while (trigger->nextFrame(first_sample)) {
+		}
+	}});
+	return benches;
+}
+
+/* The same paths through the public API, including the per-call attribute traffic */
+static std::vector<BENCHMARK> analogInBenchmarks(M2kAnalogIn *ain, unsigned int nb_samples)
+{
+	std::vector<BENCHMARK> benches;
+	unsigned int nb_channels = ain->getNbChannels();
+	unsigned long long items = (unsigned long long)nb_samples * nb_channels;
+	unsigned long long bytes = items * sizeof(short);
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		ain->enableChannel(i, true);
+	}
+	auto interleaved = std::make_shared<std::vector<double>>(items);
+
+	benches.push_back({"analogin.getSamples", "S", items, bytes, [=]() {
+		auto samples = ain->getSamples(nb_samples);
+	}});
+	benches.push_back({"analogin.getSamplesRaw", "S", items, bytes, [=]() {
+		auto samples = ain->getSamplesRaw(nb_samples);
+	}});
+	benches.push_back({"analogin.getSamplesFloat", "S", items, bytes, [=]() {
+		auto samples = ain->getSamplesFloat(nb_samples);
+	}});
+	benches.push_back({"analogin.getSamplesRawShort", "S", items, bytes, [=]() {
+		auto samples = ain->getSamplesRawShort(nb_samples);
+	}});
+	benches.push_back({"analogin.getSamplesInterleaved", "S", items, bytes, [=]() {
+		ain->getSamplesInterleaved(interleaved->data(), nb_samples);
+	}});
+	benches.push_back({"analogin.getSamplesRawInterleaved", "S", items, bytes, [=]() {
+		ain->getSamplesRawInterleaved(nb_samples);
+	}});
+	benches.push_back({"analogin.getMeasurements", "S", items, bytes, [=]() {
+		auto results = ain->getMeasurements(nb_samples);
+	}});
+	if (nb_samples >= ain->getSpectrumSettings().fft_size) {
+		benches.push_back({"analogin.getSpectrum", "S", items, bytes, [=]() {
+			auto spectra = ain->getSpectrum(nb_samples);
+		}});
+	}
+
+	/* The same captures inside a session: no configuration I/O per call */
+	auto session = [=]() {
+		if (!ain->isSessionRunning() || ain->isVoltmeterRunning()) {
+			ain->stopSession();
+			ain->startSession(nb_samples);
+		}
+	};
+	benches.push_back({"analogin.session.getSamples", "S", items, bytes, [=]() {
+		session();
+		auto samples = ain->getSamples(nb_samples);
+	}});
+	benches.push_back({"analogin.session.getSamplesRawInterleaved", "S", items, bytes, [=]() {
+		session();
+		ain->getSamplesRawInterleaved(nb_samples);
+	}});
+
+	/* DC readings: 100 samples per channel, first configured per call, then kept configured */
+	const unsigned int dc_samples = 100;
+	benches.push_back({"analogin.getVoltage", "S", dc_samples * nb_channels, dc_samples * nb_channels * sizeof(short), [=]() {
+		if (ain->isSessionRunning()) {
+			ain->stopSession();
+		}
+		ain->getVoltage();
+	}});
+	benches.push_back({"analogin.voltmeter", "S", dc_samples * nb_channels, dc_samples * nb_channels * sizeof(short), [=]() {
+		if (!ain->isVoltmeterRunning()) {
+			ain->startVoltmeter(dc_samples);
+		}
+		ain->getVoltage();
+	}});
+	return benches;
+}
+
+/* Volts to raw conversion and buffer handling of the DAC pushes */
+static std::vector<BENCHMARK> analogOutBenchmarks(M2kAnalogOut *aout, unsigned int nb_samples)
+{
+	std::vector<BENCHMARK> benches;
+	const unsigned int nb_channels = 2;
+	unsigned long long items = (unsigned long long)nb_samples * nb_channels;
+	unsigned long long bytes = items * sizeof(short);
+
+	aout->setCyclic(true);
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		aout->enableChannel(i, true);
+	}
+
+	auto data = std::make_shared<std::vector<std::vector<double>>>(nb_channels,
+							std::vector<double>(nb_samples));
+	auto interleaved = std::make_shared<std::vector<double>>(items);
+	auto raw_interleaved = std::make_shared<std::vector<short>>(items);
+	for (unsigned int i = 0; i < nb_samples; i++) {
+		double value = 4.0 * sin(2 * M_PI * i / nb_samples);
+		for (unsigned int ch = 0; ch < nb_channels; ch++) {
+			(*data)[ch][i] = value;
+			(*interleaved)[i * nb_channels + ch] = value;
+			(*raw_interleaved)[i * nb_channels + ch] = (short)(value * 400);
+		}
+	}
+
+	benches.push_back({"analogout.push", "S", items, bytes, [=]() {
+		aout->push(*data);
+	}});
+	benches.push_back({"analogout.push(channel)", "S", nb_samples, nb_samples * sizeof(short), [=]() {
+		aout->push(0, (*data)[0]);
+	}});
+	benches.push_back({"analogout.pushInterleaved", "S", items, bytes, [=]() {
+		aout->pushInterleaved(interleaved->data(), nb_channels, items);
+	}});
+	benches.push_back({"analogout.pushRawInterleaved", "S", items, bytes, [=]() {
+		aout->pushRawInterleaved(raw_interleaved->data(), nb_channels, items);
+	}});
+
+	// alternate between two cached waveforms, so that every activation switches the output
+	aout->registerWaveform("bench.sine", *data);
+	aout->registerWaveform("bench.inverted", std::vector<std::vector<double>>(nb_channels,
+						std::vector<double>((*data)[0].rbegin(), (*data)[0].rend())));
+	auto switches = std::make_shared<unsigned long long>(0);
+	benches.push_back({"analogout.activateWaveform", "S", items, bytes, [=]() {
+		aout->activateWaveform(((*switches)++ % 2) ? "bench.inverted" : "bench.sine");
+	}});
+
+	// a sine and a square on each channel, synthesized straight to raw samples
+	SYNTH_SETTINGS synth = {{{SYNTH_SINE, 1000, 4, 0, 0.5, 0, 0}, {SYNTH_SQUARE, 3000, 0.5, 0, 0.5, 0, 0}}, 0};
+	for (unsigned int ch = 0; ch < nb_channels; ch++) {
+		aout->setSynthesizer(ch, synth);
+	}
+	auto synthesized = std::make_shared<std::vector<short>>(nb_samples);
+	benches.push_back({"analogout.synthesizeRaw", "S", items, bytes, [=]() {
+		for (unsigned int ch = 0; ch < nb_channels; ch++) {
+			aout->synthesizeRaw(ch, synthesized->data(), nb_samples);
+		}
+	}});
+	unsigned long long loop_items = 0;
+	for (unsigned int loop_samples : aout->pushSynthesized()) {
+		loop_items += loop_samples;
+	}
+	benches.push_back({"analogout.pushSynthesized", "S", loop_items, loop_items * sizeof(short), [=]() {
+		aout->pushSynthesized();
+	}});
+	return benches;
+}
+
+/* Attribute reads and writes, with and without the attribute cache */
+static std::vector<BENCHMARK> attributeBenchmarks(DeviceGeneric *dev, DeviceGeneric *cached)
+{
+	std::vector<BENCHMARK> benches;
+	cached->setAttributeCaching(true);
+
+	benches.push_back({"attr.getDoubleValue", "op", 1, 0, [=]() {
+		dev->getDoubleValue("sampling_frequency");
+	}});
+	benches.push_back({"attr.getDoubleValue(channel)", "op", 1, 0, [=]() {
+		dev->getDoubleValue(0, "calibscale");
+	}});
+	benches.push_back({"attr.setDoubleValue", "op", 1, 0, [=]() {
+		dev->setDoubleValue(1000000, "sampling_frequency");
+	}});
+	benches.push_back({"attr.getStringValue", "op", 1, 0, [=]() {
+		dev->getStringValue("sampling_frequency_available");
+	}});
+	benches.push_back({"attr.getAvailableAttributeValues", "op", 1, 0, [=]() {
+		dev->getAvailableAttributeValues("sampling_frequency");
+	}});
+	benches.push_back({"attr.cached.getDoubleValue", "op", 1, 0, [=]() {
+		cached->getDoubleValue("sampling_frequency");
+	}});
+	benches.push_back({"attr.cached.setDoubleValue", "op", 1, 0, [=]() {
+		cached->setDoubleValue(1000000, "sampling_frequency");
+	}});
+	benches.push_back({"attr.transaction", "op", 4, 0, [=]() {
+		cached->beginTransaction();
+		cached->setDoubleValue(1000000, "sampling_frequency");
+		cached->setDoubleValue(1, "oversampling_ratio");
+		cached->setDoubleValue(0, 1.0, "calibscale");
+		cached->setDoubleValue(1, 1.0, "calibscale");
+		cached->commitTransaction();
+	}});
+	return benches;
+}
+
+#ifdef COMMUNICATION
+/*
+ * Encoders build the logic buffer and push it; the decoder captures and parses
+ * the logic input. Without a loopback there is no slave answering, so the SPI and
+ * I2C transfers are measured write-only; UART reads decode the simulated pattern.
+ */
+static std::vector<BENCHMARK> communicationBenchmarks(M2k *m2k)
+{
+	std::vector<BENCHMARK> benches;
+	const unsigned int nb_bytes = 64;
+	auto payload = std::make_shared<std::vector<uint8_t>>(nb_bytes);
+	for (unsigned int i = 0; i < nb_bytes; i++) {
+		(*payload)[i] = (uint8_t)(i * 37);
+	}
+
+	m2k_spi_init m2k_spi_init_param = {1, 2, 7, MSB, m2k};
+	spi_init_param spi_param = {1000000, 0, SPI_MODE_3, &m2k_spi_init_param};
+	spi_desc *spi = nullptr;
+	if (spi_init_write_only(&spi, &spi_param) == 0) {
+		benches.push_back({"spi.write", "B", nb_bytes, 0, [=]() {
+			if (spi_write_only(spi, payload->data(), nb_bytes) != 0) {
+				throw std::runtime_error("spi_write_only failed");
+			}
+		}});
+	}
+
+	m2k_i2c_init m2k_i2c_init_param = {0, 1, m2k};
+	i2c_init_param i2c_param = {100000, 0x48, &m2k_i2c_init_param};
+	i2c_desc *i2c = nullptr;
+	if (i2c_init_write_only(&i2c, &i2c_param) == 0) {
+		benches.push_back({"i2c.write", "B", nb_bytes, 0, [=]() {
+			if (i2c_write_only(i2c, payload->data(), nb_bytes, i2c_general_call) != 0) {
+				throw std::runtime_error("i2c_write_only failed");
+			}
+		}});
+	}
+
+	m2k_uart_init m2k_uart_init_param = {NO_PARITY, 8, ONE, m2k};
+	uart_init_param uart_param = {0, 115200, &m2k_uart_init_param};
+	uart_desc *uart = nullptr;
+	if (uart_init(&uart, &uart_param) == 0) {
+		auto received = std::make_shared<std::vector<uint8_t>>(nb_bytes);
+		benches.push_back({"uart.write", "B", nb_bytes, 0, [=]() {
+			if (uart_write(uart, payload->data(), nb_bytes) != 0) {
+				throw std::runtime_error("uart_write failed");
+			}
+		}});
+		benches.push_back({"uart.read", "B", nb_bytes, 0, [=]() {
+			if (uart_read(uart, received->data(), nb_bytes) != 0) {
+				throw std::runtime_error("uart_read failed");
+			}
+		}});
+	}
+	return benches;
+}
+#endif
+
+static std::vector<BENCHMARK> lidarBenchmarks(Lidar *lidar, unsigned int nb_samples)
+{
+	std::vector<BENCHMARK> benches;
+	const unsigned int nb_channels = 5;
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		lidar->channelEnableDisable("voltage" + std::to_string(i), true);
+	}
+	unsigned long long items = (unsigned long long)nb_samples * nb_channels;
+
+	benches.push_back({"lidar.readChannels", "S", items, items * sizeof(int8_t), [=]() {
+		auto samples = lidar->readChannels(nb_samples);
+	}});
+	return benches;
+}
+
+static bool parseArguments(int argc, char **argv, BENCH_SETTINGS &settings)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		if (arg == "-f") {
+			settings.filter = argv[++i];
+		} else if (arg == "-t") {
+			settings.min_time = atof(argv[++i]);
+		} else if (arg == "-n") {
+			settings.nb_samples = (unsigned int)atoi(argv[++i]);
+		} else {
+			return false;
+		}
+	}
+	return settings.nb_samples > 0;
+}
+
+/* The devices are released before their contexts, when this returns */
+static void runAll(M2k *m2k, Lidar *lidar, struct iio_context *adc_ctx,
+		   struct iio_context *attr_ctx, const BENCH_SETTINGS &settings)
+{
+	std::vector<BENCHMARK> benches;
+	auto append = [&benches](const std::vector<BENCHMARK> &group) {
+		benches.insert(benches.end(), group.begin(), group.end());
+	};
+
+	setConstantInputs(adc_ctx, "m2k-adc", 2);
+
+	DeviceIn adc(adc_ctx, "m2k-adc");
+	DeviceGeneric dev(attr_ctx, "m2k-adc");
+	DeviceGeneric cached(attr_ctx, "m2k-adc");
+
+	append(bufferBenchmarks(&adc, settings.nb_samples));
+	append(analogInBenchmarks(m2k->getAnalogIn(), settings.nb_samples));
+	append(analogOutBenchmarks(m2k->getAnalogOut(), settings.nb_samples));
+	append(attributeBenchmarks(&dev, &cached));
+#ifdef COMMUNICATION
+	append(communicationBenchmarks(m2k));
+#endif
+	append(lidarBenchmarks(lidar, settings.nb_samples));
+
+	printf("%-36s %10s %14s %20s %16s %12s\n", "benchmark", "iterations", "ns/iter",
+	       "throughput", "bytes/s", "allocs/iter");
+	for (auto &bench : benches) {
+		if (bench.name.find(settings.filter) == std::string::npos) {
+			continue;
+		}
+		runBenchmark(bench, settings);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	BENCH_SETTINGS settings = {"", 0.5, 65536};
+	if (!parseArguments(argc, argv, settings)) {
+		std::cout << "Usage: " << argv[0] << " [-f <filter>] [-t <seconds>] [-n <samples>]\n";
+		return 1;
+	}
+
+	struct iio_context *adc_ctx = iio_create_context_from_uri(BENCH_URI_M2K);
+	struct iio_context *attr_ctx = iio_create_context_from_uri(BENCH_URI_M2K);
+	struct iio_context *m2k_ctx = iio_create_context_from_uri(BENCH_URI_M2K);
+	struct iio_context *lidar_iio_ctx = iio_create_context_from_uri(BENCH_URI_LIDAR);
+	if (!adc_ctx || !attr_ctx || !m2k_ctx || !lidar_iio_ctx) {
+		std::cout << "Can't create the simulated contexts; is libm2k built with ENABLE_IIO_SIM?\n";
+		return 1;
+	}
+	setConstantInputs(adc_ctx, "m2k-adc", 2);
+	setConstantInputs(m2k_ctx, "m2k-adc", 2);
+	setConstantInputs(lidar_iio_ctx, "axi-ad9094-hpc", 5);
+
+	/* the contexts are destroyed by contextClose */
+	M2k *m2k = builder.m2kOpen(m2k_ctx, BENCH_URI_M2K);
+	Context *lidar_ctx = builder.contextOpen(lidar_iio_ctx, BENCH_URI_LIDAR);
+	if (!m2k || !lidar_ctx || !lidar_ctx->toLidar()) {
+		std::cout << "Can't open the simulated M2k and lidar contexts\n";
+		return 1;
+	}
+
+	runAll(m2k, lidar_ctx->toLidar(), adc_ctx, attr_ctx, settings);
+
+	builder.contextClose(lidar_ctx);
+	builder.contextClose(m2k);
+	iio_context_destroy(attr_ctx);
+	iio_context_destroy(adc_ctx);
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IIO_SIM_HPP
+#define IIO_SIM_HPP
+
+#include <string>
+
+struct iio_context;
+
+/**
+ * Control interface of the simulated iio backend.
+ *
+ * The simulator implements the subset of the libiio C API used by libm2k and
+ * is linked instead of libiio when building with ENABLE_IIO_SIM. Contexts are
+ * created with the usual iio_create_context_from_uri() call:
+ *	"sim:" or "sim:m2k"	- an ADALM2000 (firmware v0.26)
+ *	"sim:lidar"		- the lidar board
+ * Options can be appended after '?', separated by '&':
+ *	timing=0		- do not pace buffers at the sample rate
+ *	seed=<n>		- seed of the noise generator
+ *
+ * Input devices serve the waveform configured for each channel, expressed in
+ * raw ADC codes. Attributes are kept in memory; writes are snapped to the
+ * values listed in the matching "<attr>_available" attribute, if any.
+ */
+namespace iio_sim {
+
+enum WAVEFORM {
+	SIM_SINE = 0,
+	SIM_SQUARE = 1,
+	SIM_TRIANGLE = 2,
+	SIM_SAWTOOTH = 3,
+	SIM_NOISE = 4,
+	SIM_CONSTANT = 5,
+};
+
+struct WAVEFORM_SETTINGS {
+	WAVEFORM type;
+	double frequency;	///< Hz
+	double amplitude;	///< peak, raw codes
+	double offset;		///< raw codes
+	double phase;		///< radians
+	double noise;		///< standard deviation of the added noise, raw codes
+};
+
+struct SIM_STATISTICS {
+	unsigned long long refills;
+	unsigned long long overflows;	///< RX samples dropped because refill was late
+	unsigned long long pushes;
+	unsigned long long underruns;	///< TX queue ran empty while streaming
+};
+
+/**
+ * @brief Check if the given context was created by the simulator
+ */
+bool isSimulated(const struct iio_context *ctx);
+
+/**
+ * @brief Set the waveform served by an input channel
+ * @return 0 on success, a negative errno code otherwise
+ */
+int setWaveform(struct iio_context *ctx, const std::string &device,
+		const std::string &channel, const WAVEFORM_SETTINGS &settings);
+
+/**
+ * @brief Pace buffer operations at the configured sample rate (default: on)
+ */
+void setRealtime(struct iio_context *ctx, bool realtime);
+
+/**
+ * @brief Counters of the buffer activity on the given device
+ */
+SIM_STATISTICS getStatistics(struct iio_context *ctx, const std::string &device);
+
+}
+
+#endif //IIO_SIM_HPP
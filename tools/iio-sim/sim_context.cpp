@@ -0,0 +1,1244 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sim_context.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+
+using namespace iio_sim;
+
+namespace {
+
+typedef std::lock_guard<std::mutex> sim_lock;
+
+const char *SIM_URI_PREFIX = "sim:";
+const char *SIM_SCAN_DESCRIPTION = "0456:b672 (Analog Devices Inc. M2k), serial=sim0001";
+const unsigned int SIM_DEFAULT_TIMEOUT_MS = 5000;
+const size_t SIM_ATTR_MAX = 1024;
+
+bool parseDouble(const std::string &str, double &value)
+{
+	std::istringstream stream(str);
+	stream.imbue(std::locale::classic());
+	stream >> value;
+	if (stream.fail()) {
+		return false;
+	}
+	stream >> std::ws;
+	return stream.eof();
+}
+
+std::string formatDouble(double value)
+{
+	std::ostringstream stream;
+	stream.imbue(std::locale::classic());
+	stream.setf(std::ios::fixed);
+	stream.precision(6);
+	stream << value;
+	return stream.str();
+}
+
+std::string trim(const std::string &str)
+{
+	size_t first = str.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos) {
+		return "";
+	}
+	size_t last = str.find_last_not_of(" \t\r\n");
+	return str.substr(first, last - first + 1);
+}
+
+std::vector<std::string> split(const std::string &str)
+{
+	std::vector<std::string> tokens;
+	std::istringstream stream(str);
+	std::string token;
+	while (stream >> token) {
+		tokens.push_back(token);
+	}
+	return tokens;
+}
+
+ssize_t copyValue(const std::string &value, char *dst, size_t len)
+{
+	if (!dst || len == 0) {
+		return -EINVAL;
+	}
+	size_t count = std::min(value.size(), len - 1);
+	memcpy(dst, value.data(), count);
+	dst[count] = '\0';
+	return static_cast<ssize_t>(value.size() + 1);
+}
+
+int parseLongLong(const char *buf, long long *val)
+{
+	char *end;
+	long long value = strtoll(buf, &end, 0);
+	if (end == buf) {
+		return -EINVAL;
+	}
+	*val = value;
+	return 0;
+}
+
+int parseDouble(const char *buf, double *val)
+{
+	double value;
+	if (!parseDouble(trim(buf), value)) {
+		return -EINVAL;
+	}
+	*val = value;
+	return 0;
+}
+
+bool isOutputDevice(const struct iio_device *dev)
+{
+	for (auto &chn : dev->channels) {
+		if (chn->scan_element) {
+			return chn->output;
+		}
+	}
+	return false;
+}
+
+/* Same layout rules as libiio: channels sharing an index share the storage */
+size_t computeLayout(const struct iio_device *dev, std::vector<ptrdiff_t> *offsets)
+{
+	size_t size = 0;
+	ptrdiff_t prev_offset = 0;
+	const struct iio_channel *prev = nullptr;
+
+	if (offsets) {
+		offsets->assign(dev->channels.size(), -1);
+	}
+	for (size_t i = 0; i < dev->channels.size(); i++) {
+		const struct iio_channel *chn = dev->channels.at(i).get();
+		if (!chn->scan_element || !chn->enabled) {
+			continue;
+		}
+
+		size_t length = chn->format.length / 8 * chn->format.repeat;
+		ptrdiff_t offset;
+		if (prev && prev->index == chn->index) {
+			offset = prev_offset;
+		} else {
+			if (length && (size % length)) {
+				size += length - (size % length);
+			}
+			offset = static_cast<ptrdiff_t>(size);
+			size += length;
+		}
+		if (offsets) {
+			offsets->at(i) = offset;
+		}
+		prev = chn;
+		prev_offset = offset;
+	}
+	return size;
+}
+
+sim_clock::duration toDuration(double seconds)
+{
+	return std::chrono::duration_cast<sim_clock::duration>(
+				std::chrono::duration<double>(seconds));
+}
+
+double secondsBetween(sim_clock::time_point from, sim_clock::time_point to)
+{
+	return std::chrono::duration<double>(to - from).count();
+}
+
+/* Returns true if the buffer was cancelled while waiting */
+bool waitUntil(struct iio_buffer *buf, sim_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(buf->wait_lock);
+	return buf->wake.wait_until(lock, deadline, [buf]() {
+		return buf->cancelled.load();
+	});
+}
+
+/* Play out the queued TX samples; called with the context lock held */
+void drain(struct iio_buffer *buf, sim_clock::time_point now)
+{
+	double played = secondsBetween(buf->drained_at, now) * buf->rate;
+	buf->drained_at = now;
+	if (played < buf->queued) {
+		buf->queued -= played;
+	} else {
+		if (buf->queued > 0 && !buf->cyclic) {
+			buf->dev->statistics.underruns++;
+		}
+		buf->queued = 0;
+	}
+}
+
+double txCapacity(const struct iio_buffer *buf)
+{
+	unsigned int nb_buffers = std::max(buf->dev->kernel_buffers, 2u) - 1;
+	return static_cast<double>(nb_buffers) * buf->samples_count;
+}
+
+/* Free space (TX) or pending data (RX) in bytes; called with the context lock held */
+long long dataAvailable(struct iio_device *dev)
+{
+	struct iio_buffer *buf = dev->buffer;
+	if (!buf) {
+		return 0;
+	}
+
+	double samples;
+	if (isOutputDevice(dev)) {
+		if (dev->ctx->realtime && buf->rate > 0) {
+			drain(buf, sim_clock::now());
+		} else {
+			buf->queued = 0;
+		}
+		samples = txCapacity(buf) - buf->queued;
+	} else {
+		double capacity = static_cast<double>(dev->kernel_buffers) * buf->samples_count;
+		if (dev->ctx->realtime && buf->rate > 0) {
+			samples = secondsBetween(buf->start, sim_clock::now()) * buf->rate - buf->position;
+			samples = std::min(std::max(samples, 0.0), capacity);
+		} else {
+			samples = capacity;
+		}
+	}
+	return static_cast<long long>(samples) * static_cast<long long>(buf->sample_size);
+}
+
+/* Keep the stream position consistent when the sample rate changes */
+void updateRate(struct iio_buffer *buf, double rate, sim_clock::time_point now)
+{
+	if (rate == buf->rate) {
+		return;
+	}
+	if (rate > 0) {
+		buf->start = now - toDuration(buf->position / rate);
+	}
+	buf->rate = rate;
+}
+
+ssize_t pushSamples(struct iio_buffer *buf, size_t samples_count)
+{
+	if (!buf) {
+		return -EINVAL;
+	}
+	struct iio_device *dev = buf->dev;
+	struct iio_context *ctx = dev->ctx;
+	samples_count = std::min(samples_count, buf->samples_count);
+	ssize_t bytes = static_cast<ssize_t>(samples_count * buf->sample_size);
+
+	if (!isOutputDevice(dev) || buf->cancelled) {
+		return -EBADF;
+	}
+
+	std::unique_lock<std::mutex> lock(ctx->lock);
+	if (buf->cyclic) {
+		if (buf->pushed) {
+			return -EBUSY;
+		}
+		buf->pushed = true;
+		dev->statistics.pushes++;
+		return bytes;
+	}
+
+	sim_clock::time_point now = sim_clock::now();
+	updateRate(buf, getSampleRate(dev), now);
+	if (!ctx->realtime || buf->rate <= 0) {
+		buf->pushed = true;
+		dev->statistics.pushes++;
+		return bytes;
+	}
+
+	drain(buf, now);
+	double missing = buf->queued + samples_count - txCapacity(buf);
+	if (missing > 0) {
+		/* Wait for the DAC to free up enough kernel buffer space */
+		sim_clock::time_point deadline = now + toDuration(missing / buf->rate);
+		bool timed_out = false;
+		if (ctx->timeout_ms && deadline - now > std::chrono::milliseconds(ctx->timeout_ms)) {
+			deadline = now + std::chrono::milliseconds(ctx->timeout_ms);
+			timed_out = true;
+		}
+		lock.unlock();
+		if (waitUntil(buf, deadline)) {
+			return -EBADF;
+		}
+		if (timed_out) {
+			return -ETIMEDOUT;
+		}
+		lock.lock();
+		drain(buf, sim_clock::now());
+	}
+
+	buf->queued += samples_count;
+	buf->pushed = true;
+	dev->statistics.pushes++;
+	return bytes;
+}
+
+struct iio_context *createContext(const std::string &uri)
+{
+	std::string spec = uri.substr(strlen(SIM_URI_PREFIX));
+	std::string options;
+	size_t separator = spec.find('?');
+	if (separator != std::string::npos) {
+		options = spec.substr(separator + 1);
+		spec = spec.substr(0, separator);
+	}
+
+	struct iio_context *ctx = new iio_context;
+	ctx->name = "sim";
+	ctx->board = spec.empty() ? "m2k" : spec;
+	ctx->timeout_ms = SIM_DEFAULT_TIMEOUT_MS;
+	ctx->realtime = true;
+	ctx->rng.seed(0);
+
+	std::istringstream stream(options);
+	std::string option;
+	while (std::getline(stream, option, '&')) {
+		size_t eq = option.find('=');
+		std::string key = option.substr(0, eq);
+		std::string value = (eq == std::string::npos) ? "" : option.substr(eq + 1);
+		if (key == "timing") {
+			ctx->realtime = (value != "0" && value != "off");
+		} else if (key == "seed") {
+			ctx->rng.seed(static_cast<unsigned int>(strtoul(value.c_str(), nullptr, 0)));
+		} else if (!key.empty()) {
+			delete ctx;
+			errno = EINVAL;
+			return nullptr;
+		}
+	}
+
+	if (!buildContext(ctx, ctx->board)) {
+		delete ctx;
+		errno = ENODEV;
+		return nullptr;
+	}
+	ctx->attrs.push_back(std::make_pair("uri", uri));
+	return ctx;
+}
+
+}
+
+std::string *iio_sim::findAttribute(ATTRIBUTES &attrs, const std::string &name)
+{
+	for (auto &attr : attrs) {
+		if (attr.first == name) {
+			return &attr.second;
+		}
+	}
+	return nullptr;
+}
+
+const std::string *iio_sim::findAttribute(const ATTRIBUTES &attrs, const std::string &name)
+{
+	for (auto &attr : attrs) {
+		if (attr.first == name) {
+			return &attr.second;
+		}
+	}
+	return nullptr;
+}
+
+int iio_sim::writeAttribute(ATTRIBUTES &attrs, const std::string &name, const std::string &value)
+{
+	std::string *stored = findAttribute(attrs, name);
+	if (!stored) {
+		return -ENOENT;
+	}
+
+	std::string requested = trim(value);
+	const std::string *available = findAttribute(attrs, name + "_available");
+	if (!available) {
+		*stored = requested;
+		return static_cast<int>(value.size() + 1);
+	}
+
+	/* Exact match, otherwise the numerically closest option */
+	std::vector<std::string> options = split(*available);
+	double requested_value = 0;
+	bool numeric = parseDouble(requested, requested_value);
+	double best_distance = std::numeric_limits<double>::infinity();
+	int best = -1;
+	for (unsigned int i = 0; i < options.size(); i++) {
+		double candidate;
+		if (options.at(i) == requested) {
+			best = i;
+			break;
+		}
+		if (numeric && parseDouble(options.at(i), candidate)) {
+			double distance = std::fabs(candidate - requested_value);
+			if (distance < best_distance) {
+				best_distance = distance;
+				best = i;
+			}
+		}
+	}
+	if (best < 0) {
+		return -EINVAL;
+	}
+	*stored = options.at(best);
+	return static_cast<int>(value.size() + 1);
+}
+
+bool iio_sim::isSimulated(const struct iio_context *ctx)
+{
+	return ctx && ctx->name == "sim";
+}
+
+int iio_sim::setWaveform(struct iio_context *ctx, const std::string &device,
+			 const std::string &channel, const WAVEFORM_SETTINGS &settings)
+{
+	struct iio_device *dev = iio_context_find_device(ctx, device.c_str());
+	if (!dev) {
+		return -ENODEV;
+	}
+	struct iio_channel *chn = iio_device_find_channel(dev, channel.c_str(), false);
+	if (!chn) {
+		return -ENOENT;
+	}
+	sim_lock lock(ctx->lock);
+	chn->waveform = settings;
+	return 0;
+}
+
+void iio_sim::setRealtime(struct iio_context *ctx, bool realtime)
+{
+	sim_lock lock(ctx->lock);
+	ctx->realtime = realtime;
+}
+
+SIM_STATISTICS iio_sim::getStatistics(struct iio_context *ctx, const std::string &device)
+{
+	SIM_STATISTICS statistics = {};
+	struct iio_device *dev = iio_context_find_device(ctx, device.c_str());
+	if (dev) {
+		sim_lock lock(ctx->lock);
+		statistics = dev->statistics;
+	}
+	return statistics;
+}
+
+extern "C" {
+
+/* Library and scan */
+
+void iio_library_get_version(unsigned int *major, unsigned int *minor, char git_tag[8])
+{
+	if (major) {
+		*major = 0;
+	}
+	if (minor) {
+		*minor = 21;
+	}
+	if (git_tag) {
+		strncpy(git_tag, "sim", 8);
+	}
+}
+
+struct iio_scan_context *iio_create_scan_context(const char *backend, unsigned int)
+{
+	struct iio_scan_context *ctx = new iio_scan_context;
+	std::string filter = backend ? backend : "";
+	if (filter.empty() || filter.find("usb") != std::string::npos ||
+			filter.find("sim") != std::string::npos) {
+		struct iio_context_info info;
+		info.description = SIM_SCAN_DESCRIPTION;
+		info.uri = SIM_URI_PREFIX;
+		ctx->infos.push_back(info);
+	}
+	return ctx;
+}
+
+void iio_scan_context_destroy(struct iio_scan_context *ctx)
+{
+	delete ctx;
+}
+
+ssize_t iio_scan_context_get_info_list(struct iio_scan_context *ctx,
+				       struct iio_context_info ***info)
+{
+	if (!ctx || !info) {
+		return -EINVAL;
+	}
+	size_t count = ctx->infos.size();
+	*info = new struct iio_context_info *[count + 1];
+	for (size_t i = 0; i < count; i++) {
+		(*info)[i] = new iio_context_info(ctx->infos.at(i));
+	}
+	(*info)[count] = nullptr;
+	return static_cast<ssize_t>(count);
+}
+
+void iio_context_info_list_free(struct iio_context_info **info)
+{
+	if (!info) {
+		return;
+	}
+	for (struct iio_context_info **it = info; *it; it++) {
+		delete *it;
+	}
+	delete[] info;
+}
+
+const char *iio_context_info_get_description(const struct iio_context_info *info)
+{
+	return info->description.c_str();
+}
+
+const char *iio_context_info_get_uri(const struct iio_context_info *info)
+{
+	return info->uri.c_str();
+}
+
+/* Context */
+
+struct iio_context *iio_create_context_from_uri(const char *uri)
+{
+	if (!uri || strncmp(uri, SIM_URI_PREFIX, strlen(SIM_URI_PREFIX)) != 0) {
+		errno = ENOSYS;
+		return nullptr;
+	}
+	return createContext(uri);
+}
+
+void iio_context_destroy(struct iio_context *ctx)
+{
+	if (!ctx) {
+		return;
+	}
+	for (auto &dev : ctx->devices) {
+		delete dev->buffer;
+		dev->buffer = nullptr;
+	}
+	delete ctx;
+}
+
+int iio_context_get_version(const struct iio_context *, unsigned int *major,
+			    unsigned int *minor, char git_tag[8])
+{
+	iio_library_get_version(major, minor, git_tag);
+	return 0;
+}
+
+const char *iio_context_get_name(const struct iio_context *ctx)
+{
+	return ctx->name.c_str();
+}
+
+const char *iio_context_get_description(const struct iio_context *ctx)
+{
+	return ctx->description.c_str();
+}
+
+unsigned int iio_context_get_attrs_count(const struct iio_context *ctx)
+{
+	return static_cast<unsigned int>(ctx->attrs.size());
+}
+
+int iio_context_get_attr(const struct iio_context *ctx, unsigned int index,
+			 const char **name, const char **value)
+{
+	if (index >= ctx->attrs.size()) {
+		return -EINVAL;
+	}
+	if (name) {
+		*name = ctx->attrs.at(index).first.c_str();
+	}
+	if (value) {
+		*value = ctx->attrs.at(index).second.c_str();
+	}
+	return 0;
+}
+
+const char *iio_context_get_attr_value(const struct iio_context *ctx, const char *name)
+{
+	const std::string *value = findAttribute(ctx->attrs, name);
+	return value ? value->c_str() : nullptr;
+}
+
+unsigned int iio_context_get_devices_count(const struct iio_context *ctx)
+{
+	return static_cast<unsigned int>(ctx->devices.size());
+}
+
+struct iio_device *iio_context_get_device(const struct iio_context *ctx, unsigned int index)
+{
+	if (index >= ctx->devices.size()) {
+		return nullptr;
+	}
+	return ctx->devices.at(index).get();
+}
+
+struct iio_device *iio_context_find_device(const struct iio_context *ctx, const char *name)
+{
+	if (!ctx || !name) {
+		return nullptr;
+	}
+	for (auto &dev : ctx->devices) {
+		if (dev->id == name || dev->name == name) {
+			return dev.get();
+		}
+	}
+	return nullptr;
+}
+
+int iio_context_set_timeout(struct iio_context *ctx, unsigned int timeout_ms)
+{
+	sim_lock lock(ctx->lock);
+	ctx->timeout_ms = timeout_ms;
+	return 0;
+}
+
+/* Device */
+
+const struct iio_context *iio_device_get_context(const struct iio_device *dev)
+{
+	return dev->ctx;
+}
+
+const char *iio_device_get_id(const struct iio_device *dev)
+{
+	return dev->id.c_str();
+}
+
+const char *iio_device_get_name(const struct iio_device *dev)
+{
+	return dev->name.empty() ? nullptr : dev->name.c_str();
+}
+
+unsigned int iio_device_get_channels_count(const struct iio_device *dev)
+{
+	return static_cast<unsigned int>(dev->channels.size());
+}
+
+unsigned int iio_device_get_attrs_count(const struct iio_device *dev)
+{
+	return static_cast<unsigned int>(dev->attrs.size());
+}
+
+unsigned int iio_device_get_buffer_attrs_count(const struct iio_device *dev)
+{
+	return static_cast<unsigned int>(dev->buffer_attrs.size());
+}
+
+struct iio_channel *iio_device_get_channel(const struct iio_device *dev, unsigned int index)
+{
+	if (index >= dev->channels.size()) {
+		return nullptr;
+	}
+	return dev->channels.at(index).get();
+}
+
+const char *iio_device_get_attr(const struct iio_device *dev, unsigned int index)
+{
+	if (index >= dev->attrs.size()) {
+		return nullptr;
+	}
+	return dev->attrs.at(index).first.c_str();
+}
+
+const char *iio_device_get_buffer_attr(const struct iio_device *dev, unsigned int index)
+{
+	if (index >= dev->buffer_attrs.size()) {
+		return nullptr;
+	}
+	return dev->buffer_attrs.at(index).first.c_str();
+}
+
+struct iio_channel *iio_device_find_channel(const struct iio_device *dev,
+					    const char *name, bool output)
+{
+	if (!dev || !name) {
+		return nullptr;
+	}
+	for (auto &chn : dev->channels) {
+		if (chn->output == output && (chn->id == name || chn->name == name)) {
+			return chn.get();
+		}
+	}
+	return nullptr;
+}
+
+const char *iio_device_find_attr(const struct iio_device *dev, const char *name)
+{
+	for (auto &attr : dev->attrs) {
+		if (attr.first == name) {
+			return attr.first.c_str();
+		}
+	}
+	return nullptr;
+}
+
+const char *iio_device_find_buffer_attr(const struct iio_device *dev, const char *name)
+{
+	for (auto &attr : dev->buffer_attrs) {
+		if (attr.first == name) {
+			return attr.first.c_str();
+		}
+	}
+	return nullptr;
+}
+
+ssize_t iio_device_attr_read(const struct iio_device *dev, const char *attr,
+			     char *dst, size_t len)
+{
+	if (!dev || !attr) {
+		return -EINVAL;
+	}
+	sim_lock lock(dev->ctx->lock);
+	const std::string *value = findAttribute(dev->attrs, attr);
+	if (!value) {
+		return -ENOENT;
+	}
+	return copyValue(*value, dst, len);
+}
+
+ssize_t iio_device_attr_write(const struct iio_device *dev, const char *attr, const char *src)
+{
+	if (!dev || !attr || !src) {
+		return -EINVAL;
+	}
+	struct iio_device *mutable_dev = const_cast<struct iio_device *>(dev);
+	sim_lock lock(dev->ctx->lock);
+	return writeAttribute(mutable_dev->attrs, attr, src);
+}
+
+int iio_device_attr_read_longlong(const struct iio_device *dev, const char *attr, long long *val)
+{
+	char buf[SIM_ATTR_MAX];
+	ssize_t ret = iio_device_attr_read(dev, attr, buf, sizeof(buf));
+	if (ret < 0) {
+		return static_cast<int>(ret);
+	}
+	return parseLongLong(buf, val);
+}
+
+int iio_device_attr_read_bool(const struct iio_device *dev, const char *attr, bool *val)
+{
+	long long value;
+	int ret = iio_device_attr_read_longlong(dev, attr, &value);
+	if (ret == 0) {
+		*val = !!value;
+	}
+	return ret;
+}
+
+int iio_device_attr_read_double(const struct iio_device *dev, const char *attr, double *val)
+{
+	char buf[SIM_ATTR_MAX];
+	ssize_t ret = iio_device_attr_read(dev, attr, buf, sizeof(buf));
+	if (ret < 0) {
+		return static_cast<int>(ret);
+	}
+	return parseDouble(buf, val);
+}
+
+int iio_device_attr_write_longlong(const struct iio_device *dev, const char *attr, long long val)
+{
+	ssize_t ret = iio_device_attr_write(dev, attr, std::to_string(val).c_str());
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+int iio_device_attr_write_bool(const struct iio_device *dev, const char *attr, bool val)
+{
+	ssize_t ret = iio_device_attr_write(dev, attr, val ? "1" : "0");
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+int iio_device_attr_write_double(const struct iio_device *dev, const char *attr, double val)
+{
+	ssize_t ret = iio_device_attr_write(dev, attr, formatDouble(val).c_str());
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+ssize_t iio_device_buffer_attr_read(const struct iio_device *dev, const char *attr,
+				    char *dst, size_t len)
+{
+	if (!dev || !attr) {
+		return -EINVAL;
+	}
+	struct iio_device *mutable_dev = const_cast<struct iio_device *>(dev);
+	sim_lock lock(dev->ctx->lock);
+	std::string *value = findAttribute(mutable_dev->buffer_attrs, attr);
+	if (!value) {
+		return -ENOENT;
+	}
+	if (strcmp(attr, "data_available") == 0) {
+		*value = std::to_string(dataAvailable(mutable_dev));
+	}
+	return copyValue(*value, dst, len);
+}
+
+ssize_t iio_device_buffer_attr_write(const struct iio_device *dev, const char *attr,
+				     const char *src)
+{
+	if (!dev || !attr || !src) {
+		return -EINVAL;
+	}
+	struct iio_device *mutable_dev = const_cast<struct iio_device *>(dev);
+	sim_lock lock(dev->ctx->lock);
+	return writeAttribute(mutable_dev->buffer_attrs, attr, src);
+}
+
+int iio_device_buffer_attr_read_longlong(const struct iio_device *dev, const char *attr,
+					 long long *val)
+{
+	char buf[SIM_ATTR_MAX];
+	ssize_t ret = iio_device_buffer_attr_read(dev, attr, buf, sizeof(buf));
+	if (ret < 0) {
+		return static_cast<int>(ret);
+	}
+	return parseLongLong(buf, val);
+}
+
+int iio_device_buffer_attr_write_longlong(const struct iio_device *dev, const char *attr,
+					  long long val)
+{
+	ssize_t ret = iio_device_buffer_attr_write(dev, attr, std::to_string(val).c_str());
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+int iio_device_set_kernel_buffers_count(const struct iio_device *dev, unsigned int nb_buffers)
+{
+	if (!dev || nb_buffers == 0) {
+		return -EINVAL;
+	}
+	sim_lock lock(dev->ctx->lock);
+	const_cast<struct iio_device *>(dev)->kernel_buffers = nb_buffers;
+	return 0;
+}
+
+int iio_device_reg_write(struct iio_device *dev, uint32_t address, uint32_t value)
+{
+	sim_lock lock(dev->ctx->lock);
+	dev->registers[address] = value;
+	return 0;
+}
+
+int iio_device_reg_read(struct iio_device *dev, uint32_t address, uint32_t *value)
+{
+	sim_lock lock(dev->ctx->lock);
+	auto it = dev->registers.find(address);
+	*value = (it == dev->registers.end()) ? 0 : it->second;
+	return 0;
+}
+
+ssize_t iio_device_get_sample_size(const struct iio_device *dev)
+{
+	sim_lock lock(dev->ctx->lock);
+	size_t size = computeLayout(dev, nullptr);
+	return size ? static_cast<ssize_t>(size) : -EINVAL;
+}
+
+/* Channel */
+
+const struct iio_device *iio_channel_get_device(const struct iio_channel *chn)
+{
+	return chn->dev;
+}
+
+const char *iio_channel_get_id(const struct iio_channel *chn)
+{
+	return chn->id.c_str();
+}
+
+const char *iio_channel_get_name(const struct iio_channel *chn)
+{
+	return chn->name.empty() ? nullptr : chn->name.c_str();
+}
+
+bool iio_channel_is_output(const struct iio_channel *chn)
+{
+	return chn->output;
+}
+
+bool iio_channel_is_scan_element(const struct iio_channel *chn)
+{
+	return chn->scan_element;
+}
+
+unsigned int iio_channel_get_attrs_count(const struct iio_channel *chn)
+{
+	return static_cast<unsigned int>(chn->attrs.size());
+}
+
+const char *iio_channel_get_attr(const struct iio_channel *chn, unsigned int index)
+{
+	if (index >= chn->attrs.size()) {
+		return nullptr;
+	}
+	return chn->attrs.at(index).first.c_str();
+}
+
+const char *iio_channel_find_attr(const struct iio_channel *chn, const char *name)
+{
+	for (auto &attr : chn->attrs) {
+		if (attr.first == name) {
+			return attr.first.c_str();
+		}
+	}
+	return nullptr;
+}
+
+ssize_t iio_channel_attr_read(const struct iio_channel *chn, const char *attr,
+			      char *dst, size_t len)
+{
+	if (!chn || !attr) {
+		return -EINVAL;
+	}
+	sim_lock lock(chn->dev->ctx->lock);
+	const std::string *value = findAttribute(chn->attrs, attr);
+	if (!value) {
+		return -ENOENT;
+	}
+	std::string linked;
+	if (readLinkedAttribute(chn, attr, linked)) {
+		return copyValue(linked, dst, len);
+	}
+	return copyValue(*value, dst, len);
+}
+
+ssize_t iio_channel_attr_write(const struct iio_channel *chn, const char *attr, const char *src)
+{
+	if (!chn || !attr || !src) {
+		return -EINVAL;
+	}
+	struct iio_channel *mutable_chn = const_cast<struct iio_channel *>(chn);
+	sim_lock lock(chn->dev->ctx->lock);
+	return writeAttribute(mutable_chn->attrs, attr, src);
+}
+
+int iio_channel_attr_read_longlong(const struct iio_channel *chn, const char *attr, long long *val)
+{
+	char buf[SIM_ATTR_MAX];
+	ssize_t ret = iio_channel_attr_read(chn, attr, buf, sizeof(buf));
+	if (ret < 0) {
+		return static_cast<int>(ret);
+	}
+	return parseLongLong(buf, val);
+}
+
+int iio_channel_attr_read_bool(const struct iio_channel *chn, const char *attr, bool *val)
+{
+	long long value;
+	int ret = iio_channel_attr_read_longlong(chn, attr, &value);
+	if (ret == 0) {
+		*val = !!value;
+	}
+	return ret;
+}
+
+int iio_channel_attr_read_double(const struct iio_channel *chn, const char *attr, double *val)
+{
+	char buf[SIM_ATTR_MAX];
+	ssize_t ret = iio_channel_attr_read(chn, attr, buf, sizeof(buf));
+	if (ret < 0) {
+		return static_cast<int>(ret);
+	}
+	return parseDouble(buf, val);
+}
+
+int iio_channel_attr_write_longlong(const struct iio_channel *chn, const char *attr, long long val)
+{
+	ssize_t ret = iio_channel_attr_write(chn, attr, std::to_string(val).c_str());
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+int iio_channel_attr_write_bool(const struct iio_channel *chn, const char *attr, bool val)
+{
+	ssize_t ret = iio_channel_attr_write(chn, attr, val ? "1" : "0");
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+int iio_channel_attr_write_double(const struct iio_channel *chn, const char *attr, double val)
+{
+	ssize_t ret = iio_channel_attr_write(chn, attr, formatDouble(val).c_str());
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+void iio_channel_enable(struct iio_channel *chn)
+{
+	if (chn->scan_element) {
+		sim_lock lock(chn->dev->ctx->lock);
+		chn->enabled = true;
+	}
+}
+
+void iio_channel_disable(struct iio_channel *chn)
+{
+	if (chn->scan_element) {
+		sim_lock lock(chn->dev->ctx->lock);
+		chn->enabled = false;
+	}
+}
+
+bool iio_channel_is_enabled(const struct iio_channel *chn)
+{
+	return chn->scan_element && chn->enabled;
+}
+
+long iio_channel_get_index(const struct iio_channel *chn)
+{
+	return chn->index;
+}
+
+const struct iio_data_format *iio_channel_get_data_format(const struct iio_channel *chn)
+{
+	return &chn->format;
+}
+
+void iio_channel_convert(const struct iio_channel *chn, void *dst, const void *src)
+{
+	const struct iio_data_format &format = chn->format;
+	unsigned int length = std::min(format.length / 8, 8u);
+	uint64_t raw = 0;
+
+	memcpy(&raw, src, length);
+	raw >>= format.shift;
+	if (format.bits < 64) {
+		uint64_t mask = (1ull << format.bits) - 1;
+		raw &= mask;
+		if (format.is_signed && format.bits && ((raw >> (format.bits - 1)) & 1)) {
+			raw |= ~mask;
+		}
+	}
+	memcpy(dst, &raw, length);
+}
+
+void iio_channel_convert_inverse(const struct iio_channel *chn, void *dst, const void *src)
+{
+	const struct iio_data_format &format = chn->format;
+	unsigned int length = std::min(format.length / 8, 8u);
+	uint64_t raw = 0;
+
+	memcpy(&raw, src, length);
+	if (format.bits < 64) {
+		raw &= (1ull << format.bits) - 1;
+	}
+	raw <<= format.shift;
+	memcpy(dst, &raw, length);
+}
+
+size_t iio_channel_read(const struct iio_channel *chn, struct iio_buffer *buf,
+			void *dst, size_t len)
+{
+	size_t length = chn->format.length / 8;
+	if (!length) {
+		return 0;
+	}
+
+	uintptr_t ptr = reinterpret_cast<uintptr_t>(iio_buffer_first(buf, chn));
+	uintptr_t end = reinterpret_cast<uintptr_t>(iio_buffer_end(buf));
+	ptrdiff_t step = iio_buffer_step(buf);
+	size_t count = 0;
+	for (; ptr < end && count + length <= len; ptr += step, count += length) {
+		iio_channel_convert(chn, static_cast<char *>(dst) + count,
+				    reinterpret_cast<const void *>(ptr));
+	}
+	return count;
+}
+
+size_t iio_channel_write(const struct iio_channel *chn, struct iio_buffer *buf,
+			 const void *src, size_t len)
+{
+	size_t length = chn->format.length / 8;
+	if (!length) {
+		return 0;
+	}
+
+	uintptr_t ptr = reinterpret_cast<uintptr_t>(iio_buffer_first(buf, chn));
+	uintptr_t end = reinterpret_cast<uintptr_t>(iio_buffer_end(buf));
+	ptrdiff_t step = iio_buffer_step(buf);
+	size_t count = 0;
+	for (; ptr < end && count + length <= len; ptr += step, count += length) {
+		iio_channel_convert_inverse(chn, reinterpret_cast<void *>(ptr),
+					    static_cast<const char *>(src) + count);
+	}
+	return count;
+}
+
+/* Buffer */
+
+const struct iio_device *iio_buffer_get_device(const struct iio_buffer *buf)
+{
+	return buf->dev;
+}
+
+struct iio_buffer *iio_device_create_buffer(const struct iio_device *dev,
+					    size_t samples_count, bool cyclic)
+{
+	if (!dev || samples_count == 0) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	struct iio_device *mutable_dev = const_cast<struct iio_device *>(dev);
+	sim_lock lock(dev->ctx->lock);
+	if (dev->buffer) {
+		errno = EBUSY;
+		return nullptr;
+	}
+
+	struct iio_buffer *buf = new iio_buffer;
+	buf->dev = mutable_dev;
+	buf->sample_size = computeLayout(dev, &buf->offsets);
+	if (buf->sample_size == 0) {
+		delete buf;
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	size_t bytes = samples_count * buf->sample_size;
+	buf->storage.assign((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+	buf->data = reinterpret_cast<char *>(buf->storage.data());
+	buf->samples_count = samples_count;
+	buf->cyclic = cyclic;
+	buf->pushed = false;
+	buf->position = 0;
+	buf->queued = 0;
+	buf->rate = getSampleRate(dev);
+	buf->start = sim_clock::now();
+	buf->drained_at = buf->start;
+	buf->cancelled = false;
+	mutable_dev->buffer = buf;
+	return buf;
+}
+
+void iio_buffer_destroy(struct iio_buffer *buf)
+{
+	if (!buf) {
+		return;
+	}
+	{
+		sim_lock lock(buf->dev->ctx->lock);
+		buf->dev->buffer = nullptr;
+	}
+	delete buf;
+}
+
+ssize_t iio_buffer_refill(struct iio_buffer *buf)
+{
+	if (!buf) {
+		return -EINVAL;
+	}
+	struct iio_device *dev = buf->dev;
+	struct iio_context *ctx = dev->ctx;
+	if (isOutputDevice(dev) || buf->cancelled) {
+		return -EBADF;
+	}
+
+	std::unique_lock<std::mutex> lock(ctx->lock);
+	sim_clock::time_point now = sim_clock::now();
+	updateRate(buf, getSampleRate(dev), now);
+
+	if (ctx->realtime && buf->rate > 0) {
+		/* The hardware keeps sampling; drop what did not fit in the kernel buffers */
+		double produced = secondsBetween(buf->start, now) * buf->rate;
+		double capacity = static_cast<double>(dev->kernel_buffers) * buf->samples_count;
+		if (produced - buf->position > capacity) {
+			buf->position = static_cast<unsigned long long>(produced - capacity);
+			dev->statistics.overflows++;
+		}
+
+		sim_clock::time_point ready = buf->start +
+				toDuration((buf->position + buf->samples_count) / buf->rate);
+		if (ready > now) {
+			sim_clock::time_point deadline = ready;
+			bool timed_out = false;
+			if (ctx->timeout_ms && ready - now > std::chrono::milliseconds(ctx->timeout_ms)) {
+				deadline = now + std::chrono::milliseconds(ctx->timeout_ms);
+				timed_out = true;
+			}
+			lock.unlock();
+			if (waitUntil(buf, deadline)) {
+				return -EBADF;
+			}
+			if (timed_out) {
+				return -ETIMEDOUT;
+			}
+			lock.lock();
+		}
+	}
+
+	generateSamples(buf, buf->position);
+	buf->position += buf->samples_count;
+	dev->statistics.refills++;
+	return static_cast<ssize_t>(buf->samples_count * buf->sample_size);
+}
+
+ssize_t iio_buffer_push(struct iio_buffer *buf)
+{
+	return pushSamples(buf, buf ? buf->samples_count : 0);
+}
+
+ssize_t iio_buffer_push_partial(struct iio_buffer *buf, size_t samples_count)
+{
+	return pushSamples(buf, samples_count);
+}
+
+void iio_buffer_cancel(struct iio_buffer *buf)
+{
+	if (!buf) {
+		return;
+	}
+	buf->cancelled = true;
+	std::lock_guard<std::mutex> lock(buf->wait_lock);
+	buf->wake.notify_all();
+}
+
+void *iio_buffer_start(const struct iio_buffer *buf)
+{
+	return buf->data;
+}
+
+void *iio_buffer_first(const struct iio_buffer *buf, const struct iio_channel *chn)
+{
+	for (size_t i = 0; i < buf->dev->channels.size(); i++) {
+		if (buf->dev->channels.at(i).get() == chn) {
+			if (buf->offsets.at(i) < 0) {
+				break;
+			}
+			return buf->data + buf->offsets.at(i);
+		}
+	}
+	return iio_buffer_end(buf);
+}
+
+ptrdiff_t iio_buffer_step(const struct iio_buffer *buf)
+{
+	return static_cast<ptrdiff_t>(buf->sample_size);
+}
+
+void *iio_buffer_end(const struct iio_buffer *buf)
+{
+	return buf->data + buf->samples_count * buf->sample_size;
+}
+
+}
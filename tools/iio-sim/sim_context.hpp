@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SIM_CONTEXT_HPP
+#define SIM_CONTEXT_HPP
+
+#include "iio_sim.hpp"
+#include <iio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace iio_sim {
+
+typedef std::chrono::steady_clock sim_clock;
+
+/* Ordered name/value pairs: libiio exposes attributes by index */
+typedef std::vector<std::pair<std::string, std::string>> ATTRIBUTES;
+
+std::string *findAttribute(ATTRIBUTES &attrs, const std::string &name);
+const std::string *findAttribute(const ATTRIBUTES &attrs, const std::string &name);
+
+/* Store a value, validating it against "<name>_available" when present */
+int writeAttribute(ATTRIBUTES &attrs, const std::string &name, const std::string &value);
+
+/* sim_devices.cpp */
+bool buildContext(struct iio_context *ctx, const std::string &board);
+double getSampleRate(const struct iio_device *dev);
+bool readLinkedAttribute(const struct iio_channel *chn, const std::string &attr,
+			 std::string &value);
+void generateSamples(struct iio_buffer *buf, unsigned long long first_sample);
+
+}
+
+struct iio_channel {
+	struct iio_device *dev;
+	std::string id;
+	std::string name;
+	bool output;
+	bool scan_element;
+	long index;
+	struct iio_data_format format;
+	bool enabled;
+	iio_sim::ATTRIBUTES attrs;
+	iio_sim::WAVEFORM_SETTINGS waveform;
+};
+
+struct iio_device {
+	struct iio_context *ctx;
+	std::string id;
+	std::string name;
+	std::vector<std::unique_ptr<struct iio_channel>> channels;
+	iio_sim::ATTRIBUTES attrs;
+	iio_sim::ATTRIBUTES buffer_attrs;
+	std::map<uint32_t, uint32_t> registers;
+	unsigned int kernel_buffers;
+	struct iio_buffer *buffer;
+	iio_sim::SIM_STATISTICS statistics;
+};
+
+struct iio_buffer {
+	struct iio_device *dev;
+	std::vector<uint64_t> storage;
+	char *data;
+	size_t samples_count;
+	size_t sample_size;
+	/* Byte offset of each device channel inside a sample, -1 when disabled */
+	std::vector<ptrdiff_t> offsets;
+	bool cyclic;
+	bool pushed;
+
+	/* RX: samples handed out so far; TX: samples waiting to be "played" */
+	unsigned long long position;
+	double queued;
+	double rate;
+	iio_sim::sim_clock::time_point start;
+	iio_sim::sim_clock::time_point drained_at;
+
+	std::atomic<bool> cancelled;
+	std::mutex wait_lock;
+	std::condition_variable wake;
+};
+
+struct iio_context {
+	std::string name;
+	std::string description;
+	std::string board;
+	iio_sim::ATTRIBUTES attrs;
+	std::vector<std::unique_ptr<struct iio_device>> devices;
+	unsigned int timeout_ms;
+	bool realtime;
+	std::mt19937 rng;
+	std::mutex lock;
+};
+
+struct iio_context_info {
+	std::string description;
+	std::string uri;
+};
+
+struct iio_scan_context {
+	std::vector<struct iio_context_info> infos;
+};
+
+#endif //SIM_CONTEXT_HPP
@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of libm2k
+ * (see http://www.github.com/analogdevicesinc/libm2k).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sim_context.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace iio_sim;
+
+namespace {
+
+const double SIM_TWO_PI = 6.283185307179586;
+
+/* Absorbs rounding errors for edges that fall exactly on a sample */
+const double SIM_EDGE_EPSILON = 1e-9;
+
+/* ADC codes seen by the M2K while the inputs are switched to a reference */
+const double M2K_ADC_REF1_CODE = 1576;
+const double M2K_ADC_REF2_CODE = -1576;
+
+/* ADC codes per offset DAC code, independent of the input range */
+const double M2K_ADC_CODES_PER_OFFSET_CODE = 2.693 * 1.2 / (2 * 0.78);
+
+/* Power supply DAC (ad5627) and monitor ADC (ad9963) full scale voltages */
+const double M2K_SUPPLY_POS_FULL_SCALE = 5.02 * 1.2;
+const double M2K_SUPPLY_NEG_FULL_SCALE = -5.1 * 1.2;
+const double M2K_SUPPLY_READ_FULL_SCALE = 6.4;
+
+const WAVEFORM_SETTINGS SIM_FLAT = {SIM_CONSTANT, 0, 0, 0, 0, 0};
+
+struct iio_data_format makeFormat(unsigned int bits, unsigned int length,
+				  unsigned int shift, bool is_signed)
+{
+	struct iio_data_format format;
+	memset(&format, 0, sizeof(format));
+	format.length = length;
+	format.bits = bits;
+	format.shift = shift;
+	format.is_signed = is_signed;
+	format.is_fully_defined = (bits == length);
+	format.is_be = false;
+	format.with_scale = false;
+	format.scale = 1.0;
+	format.repeat = 1;
+	return format;
+}
+
+struct iio_device *addDevice(struct iio_context *ctx, const std::string &name,
+			     const ATTRIBUTES &attrs = ATTRIBUTES(),
+			     const ATTRIBUTES &buffer_attrs = ATTRIBUTES())
+{
+	std::unique_ptr<struct iio_device> dev(new iio_device);
+	dev->ctx = ctx;
+	dev->id = "iio:device" + std::to_string(ctx->devices.size());
+	dev->name = name;
+	dev->attrs = attrs;
+	dev->buffer_attrs = buffer_attrs;
+	dev->kernel_buffers = 4;
+	dev->buffer = nullptr;
+	dev->statistics = SIM_STATISTICS();
+	ctx->devices.push_back(std::move(dev));
+	return ctx->devices.back().get();
+}
+
+struct iio_channel *addChannel(struct iio_device *dev, const std::string &id, bool output,
+			       const ATTRIBUTES &attrs = ATTRIBUTES())
+{
+	std::unique_ptr<struct iio_channel> chn(new iio_channel);
+	chn->dev = dev;
+	chn->id = id;
+	chn->output = output;
+	chn->scan_element = false;
+	chn->index = -1;
+	chn->format = makeFormat(0, 0, 0, false);
+	chn->enabled = false;
+	chn->attrs = attrs;
+	chn->waveform = SIM_FLAT;
+	dev->channels.push_back(std::move(chn));
+	return dev->channels.back().get();
+}
+
+struct iio_channel *addScanChannel(struct iio_device *dev, const std::string &id, bool output,
+				   long index, const struct iio_data_format &format,
+				   const ATTRIBUTES &attrs = ATTRIBUTES())
+{
+	struct iio_channel *chn = addChannel(dev, id, output, attrs);
+	chn->scan_element = true;
+	chn->index = index;
+	chn->format = format;
+	return chn;
+}
+
+ATTRIBUTES streamBufferAttributes()
+{
+	return {{"data_available", "0"}, {"length", "0"}, {"watermark", "1"}};
+}
+
+std::string channelName(unsigned int index)
+{
+	return "voltage" + std::to_string(index);
+}
+
+double attributeAsDouble(const ATTRIBUTES &attrs, const std::string &name, double fallback)
+{
+	const std::string *value = findAttribute(attrs, name);
+	if (!value || value->empty()) {
+		return fallback;
+	}
+	return strtod(value->c_str(), nullptr);
+}
+
+void buildM2k(struct iio_context *ctx)
+{
+	ctx->description = "Simulated ADALM2000 (libm2k iio-sim)";
+	ctx->attrs = {
+		{"hw_model", "Analog Devices M2k Rev.D (Z7010-AD9963)"},
+		{"hw_model_variant", "0"},
+		{"hw_serial", "104473sim0001"},
+		{"fw_version", "v0.26"},
+		{"cal,offset_pos_dac", "0.000000"},
+		{"cal,gain_pos_dac", "1.000000"},
+		{"cal,offset_neg_dac", "0.000000"},
+		{"cal,gain_neg_dac", "1.000000"},
+		{"cal,offset_pos_adc", "0.000000"},
+		{"cal,gain_pos_adc", "1.000000"},
+		{"cal,offset_neg_adc", "0.000000"},
+		{"cal,gain_neg_adc", "1.000000"},
+		{"ip,ip-addr", "192.168.2.1"},
+	};
+
+	struct iio_device *dev = addDevice(ctx, "ad9963");
+	for (unsigned int i = 0; i < 3; i++) {
+		addChannel(dev, channelName(i), false, {{"raw", "0"}, {"scale", "0.439453125"}});
+	}
+
+	dev = addDevice(ctx, "m2k-fabric", {
+		{"calibration_mode", "none"},
+		{"calibration_mode_available", "adc_gnd adc_ref1 adc_ref2 dac none"},
+		{"clk_powerdown", "0"},
+	});
+	for (unsigned int i = 0; i < 2; i++) {
+		addChannel(dev, channelName(i), false, {
+			{"gain", "low"}, {"gain_available", "low high"}, {"powerdown", "0"}});
+	}
+	for (unsigned int i = 0; i < 2; i++) {
+		addChannel(dev, channelName(i), true, {{"powerdown", "1"}});
+	}
+	addChannel(dev, channelName(2), true, {{"user_supply_powerdown", "1"}});
+	addChannel(dev, channelName(3), true, {{"user_supply_powerdown", "1"}});
+	addChannel(dev, channelName(4), true, {{"done_led_overwrite_powerdown", "0"}});
+
+	dev = addDevice(ctx, "ad5625");
+	for (unsigned int i = 0; i < 4; i++) {
+		addChannel(dev, channelName(i), true, {
+			{"raw", "2048"}, {"powerdown", "0"}, {"scale", "0.610351562"}});
+	}
+
+	ATTRIBUTES dac_attrs = {
+		{"sampling_frequency", "75000000"},
+		{"sampling_frequency_available", "750 7500 75000 750000 7500000 75000000"},
+		{"oversampling_ratio", "1"},
+		{"calibscale", "1.000000"},
+		{"dma_sync", "0"},
+		{"dma_sync_start", "0"},
+	};
+	const std::string dac_names[] = {"m2k-dac-a", "m2k-dac-b"};
+	for (const std::string &name : dac_names) {
+		dev = addDevice(ctx, name, dac_attrs, streamBufferAttributes());
+		addScanChannel(dev, channelName(0), true, 0, makeFormat(16, 16, 0, true), {{"raw", "0"}});
+	}
+
+	dev = addDevice(ctx, "m2k-adc", {
+		{"sampling_frequency", "100000000"},
+		{"sampling_frequency_available", "1000 10000 100000 1000000 10000000 100000000"},
+		{"oversampling_ratio", "1"},
+	}, streamBufferAttributes());
+	for (unsigned int i = 0; i < 2; i++) {
+		struct iio_channel *chn = addScanChannel(dev, channelName(i), false, i,
+							 makeFormat(12, 16, 0, true),
+							 {{"calibbias", "2048"}, {"calibscale", "1.000000"}});
+		chn->waveform = {i ? SIM_SQUARE : SIM_SINE, 1000, 1000, 0, 0, 2};
+	}
+
+	dev = addDevice(ctx, "m2k-adc-trigger", {{"streaming", "0"}});
+	for (unsigned int i = 0; i < 2; i++) {
+		addChannel(dev, channelName(i), false, {
+			{"trigger", "edge-rising"}, {"trigger_hysteresis", "0"}, {"trigger_level", "0"}});
+	}
+	for (unsigned int i = 2; i < 4; i++) {
+		addChannel(dev, channelName(i), false, {{"trigger", "none"}});
+	}
+	addChannel(dev, channelName(4), false, {{"mode", "always"}});
+	addChannel(dev, channelName(5), false, {
+		{"mode", "always"}, {"out_direction", "in"}, {"out_select", "sw-trigger"}});
+	addChannel(dev, channelName(6), false, {
+		{"delay", "0"}, {"logic_mode", "a"}})->name = "trigger";
+
+	dev = addDevice(ctx, "m2k-logic-analyzer");
+	for (unsigned int i = 0; i < 16; i++) {
+		addChannel(dev, channelName(i), false, {
+			{"direction", "in"}, {"direction_available", "in out"}, {"raw", "0"},
+			{"outputmode", "push-pull"}, {"outputmode_available", "open-drain push-pull"}});
+	}
+
+	dev = addDevice(ctx, "m2k-logic-analyzer-rx", {
+		{"sampling_frequency", "100000000"}, {"streaming", "0"}}, streamBufferAttributes());
+	for (unsigned int i = 0; i < 16; i++) {
+		ATTRIBUTES attrs = {{"trigger", "none"}};
+		if (i == 0) {
+			attrs.push_back(std::make_pair("trigger_logic_mode", "or"));
+			attrs.push_back(std::make_pair("trigger_delay", "0"));
+		}
+		struct iio_channel *chn = addScanChannel(dev, channelName(i), false, 0,
+							 makeFormat(1, 16, i, false), attrs);
+		/* Bit i toggles every 2^i samples at the default rate: a binary counter */
+		chn->waveform = {SIM_SQUARE, 50e6 / (1u << i), 1, 0, SIM_TWO_PI / 2, 0};
+	}
+	addChannel(dev, channelName(16), false, {{"trigger", "none"}, {"trigger_mux_out", "trigger-logic"}});
+
+	dev = addDevice(ctx, "m2k-logic-analyzer-tx", {{"sampling_frequency", "100000000"}},
+			streamBufferAttributes());
+	for (unsigned int i = 0; i < 16; i++) {
+		addScanChannel(dev, channelName(i), true, 0, makeFormat(1, 16, i, false));
+	}
+
+	dev = addDevice(ctx, "ad5627");
+	for (unsigned int i = 0; i < 2; i++) {
+		addChannel(dev, channelName(i), true, {
+			{"raw", "0"}, {"powerdown", "0"}, {"scale", "1.220703125"}});
+	}
+}
+
+void buildLidar(struct iio_context *ctx)
+{
+	ctx->description = "Simulated lidar (libm2k iio-sim)";
+	ctx->attrs = {
+		{"hw_model", "Analog Devices Lidar"},
+		{"fw_version", "v0.1"},
+	};
+
+	struct iio_device *dev = addDevice(ctx, "ad7091");
+	addChannel(dev, channelName(0), false, {{"raw", "0"}, {"scale", "0.610351562"}});
+	dev = addDevice(ctx, "ltc2471");
+	addChannel(dev, channelName(0), false, {{"raw", "0"}, {"scale", "0.038147"}});
+	dev = addDevice(ctx, "xadc");
+	addChannel(dev, "temp0", false, {{"raw", "2600"}, {"offset", "-2219"}, {"scale", "123.040771484"}});
+	dev = addDevice(ctx, "ad9528");
+	addChannel(dev, "altvoltage0", true, {{"frequency", "1000000000"}});
+
+	dev = addDevice(ctx, "ad5627");
+	for (unsigned int i = 0; i < 2; i++) {
+		addChannel(dev, channelName(i), true, {
+			{"raw", "0"}, {"powerdown", "0"}, {"scale", "1.220703125"}});
+	}
+
+	dev = addDevice(ctx, "7c700000.axi-pulse-capture", {
+		{"sequencer_en", "0"},
+		{"sequencer_mode", "auto"},
+		{"sequencer_mode_available", "auto manual"},
+		{"sequencer_auto_cfg", "0 1 2 3"},
+		{"sequencer_manual_chsel", "0"},
+		{"sequencer_pulse_delay_ns", "0"},
+	});
+	addChannel(dev, channelName(0), true, {
+		{"en", "0"}, {"pulse_width_ns", "20"}, {"frequency", "50000"}});
+
+	dev = addDevice(ctx, "axi-ad9094-hpc", {{"sampling_frequency", "1000000000"}},
+			streamBufferAttributes());
+	for (unsigned int i = 0; i < 5; i++) {
+		struct iio_channel *chn = addScanChannel(dev, channelName(i), false, i,
+							 makeFormat(8, 8, 0, true));
+		chn->waveform = {SIM_SINE, 1e6 * (i + 1), 100, 0, 0, 1};
+	}
+}
+
+/*
+ * The M2K ADC inputs are shifted by the offset DAC (ad5625) and can be switched
+ * away from the front-end during calibration
+ */
+WAVEFORM_SETTINGS effectiveWaveform(const struct iio_channel *chn)
+{
+	const struct iio_device *dev = chn->dev;
+	if (dev->ctx->board != "m2k" || dev->name != "m2k-adc") {
+		return chn->waveform;
+	}
+
+	WAVEFORM_SETTINGS settings = chn->waveform;
+	struct iio_device *fabric = iio_context_find_device(dev->ctx, "m2k-fabric");
+	const std::string *mode = fabric ? findAttribute(fabric->attrs, "calibration_mode") : nullptr;
+	if (mode && *mode != "none") {
+		settings = {SIM_CONSTANT, 0, 0, 0, 0, chn->waveform.noise};
+		if (*mode == "adc_ref1") {
+			settings.offset = M2K_ADC_REF1_CODE;
+		} else if (*mode == "adc_ref2") {
+			settings.offset = M2K_ADC_REF2_CODE;
+		}
+	}
+
+	struct iio_device *offset_dac = iio_context_find_device(dev->ctx, "ad5625");
+	struct iio_channel *offset_chn = offset_dac ? iio_device_find_channel(offset_dac,
+					channelName(2 + chn->index).c_str(), true) : nullptr;
+	if (offset_chn) {
+		double raw_offset = attributeAsDouble(offset_chn->attrs, "raw", 2048) -
+				attributeAsDouble(chn->attrs, "calibbias", 2048);
+		settings.offset += raw_offset * M2K_ADC_CODES_PER_OFFSET_CODE;
+	}
+	return settings;
+}
+
+double evaluate(const WAVEFORM_SETTINGS &settings, double t, std::mt19937 &rng,
+		std::normal_distribution<double> &gaussian)
+{
+	double cycles = settings.frequency * t + settings.phase / SIM_TWO_PI + SIM_EDGE_EPSILON;
+	double fraction = cycles - std::floor(cycles);
+	double shape = 0;
+
+	switch (settings.type) {
+	case SIM_SINE:
+		shape = std::sin(SIM_TWO_PI * cycles);
+		break;
+	case SIM_SQUARE:
+		shape = (fraction < 0.5) ? 1 : -1;
+		break;
+	case SIM_TRIANGLE:
+		shape = (fraction < 0.5) ? (4 * fraction - 1) : (3 - 4 * fraction);
+		break;
+	case SIM_SAWTOOTH:
+		shape = 2 * fraction - 1;
+		break;
+	case SIM_NOISE:
+		shape = gaussian(rng);
+		break;
+	default:
+		break;
+	}
+
+	double value = settings.offset + settings.amplitude * shape;
+	if (settings.noise > 0) {
+		value += settings.noise * gaussian(rng);
+	}
+	return value;
+}
+
+}
+
+bool iio_sim::buildContext(struct iio_context *ctx, const std::string &board)
+{
+	if (board == "m2k") {
+		buildM2k(ctx);
+	} else if (board == "lidar") {
+		buildLidar(ctx);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+double iio_sim::getSampleRate(const struct iio_device *dev)
+{
+	double rate = attributeAsDouble(dev->attrs, "sampling_frequency", 0);
+	double oversampling = attributeAsDouble(dev->attrs, "oversampling_ratio", 1);
+	if (oversampling > 1) {
+		rate /= oversampling;
+	}
+	return rate;
+}
+
+bool iio_sim::readLinkedAttribute(const struct iio_channel *chn, const std::string &attr,
+				  std::string &value)
+{
+	const struct iio_device *dev = chn->dev;
+	if (dev->ctx->board != "m2k" || dev->name != "ad9963" || attr != "raw") {
+		return false;
+	}
+
+	/* The ad9963 monitors the user supplies driven by the ad5627 */
+	bool positive;
+	if (chn->id == "voltage2") {
+		positive = true;
+	} else if (chn->id == "voltage1") {
+		positive = false;
+	} else {
+		return false;
+	}
+
+	struct iio_device *supply = iio_context_find_device(dev->ctx, "ad5627");
+	struct iio_device *fabric = iio_context_find_device(dev->ctx, "m2k-fabric");
+	struct iio_channel *out = supply ? iio_device_find_channel(supply,
+					positive ? "voltage0" : "voltage1", true) : nullptr;
+	struct iio_channel *powerdown = fabric ? iio_device_find_channel(fabric,
+					positive ? "voltage2" : "voltage3", true) : nullptr;
+	if (!out || !powerdown) {
+		return false;
+	}
+
+	double volts = 0;
+	if (attributeAsDouble(powerdown->attrs, "user_supply_powerdown", 1) == 0) {
+		double full_scale = positive ? M2K_SUPPLY_POS_FULL_SCALE : M2K_SUPPLY_NEG_FULL_SCALE;
+		volts = attributeAsDouble(out->attrs, "raw", 0) * full_scale / 4095.0;
+	}
+	double read_scale = (positive ? 1 : -1) * M2K_SUPPLY_READ_FULL_SCALE / 4095.0;
+	value = std::to_string(std::lround(volts / read_scale));
+	return true;
+}
+
+void iio_sim::generateSamples(struct iio_buffer *buf, unsigned long long first_sample)
+{
+	struct iio_device *dev = buf->dev;
+	std::mt19937 &rng = dev->ctx->rng;
+	std::normal_distribution<double> gaussian(0.0, 1.0);
+	double rate = (buf->rate > 0) ? buf->rate : 1.0;
+
+	std::fill(buf->storage.begin(), buf->storage.end(), 0);
+	for (size_t c = 0; c < dev->channels.size(); c++) {
+		ptrdiff_t offset = buf->offsets.at(c);
+		if (offset < 0) {
+			continue;
+		}
+
+		const struct iio_channel *chn = dev->channels.at(c).get();
+		const struct iio_data_format &format = chn->format;
+		WAVEFORM_SETTINGS settings = effectiveWaveform(chn);
+		unsigned int length = std::min(format.length / 8, 8u);
+		unsigned int bits = std::min(format.bits, 63u);
+		long long min_code = format.is_signed ? -(1ll << (bits - 1)) : 0;
+		long long max_code = format.is_signed ? (1ll << (bits - 1)) - 1 : (1ll << bits) - 1;
+		uint64_t bits_mask = (1ull << bits) - 1;
+		uint64_t storage_mask = (length < 8) ? (1ull << (8 * length)) - 1 : ~0ull;
+		/* Signed samples owning their storage are sign extended to the full width */
+		bool sign_extend = format.is_signed && format.shift == 0;
+
+		char *ptr = buf->data + offset;
+		for (size_t i = 0; i < buf->samples_count; i++, ptr += buf->sample_size) {
+			double t = static_cast<double>(first_sample + i) / rate;
+			long long code = std::llround(evaluate(settings, t, rng, gaussian));
+			code = std::min(std::max(code, min_code), max_code);
+
+			uint64_t raw = static_cast<uint64_t>(code);
+			raw = sign_extend ? raw : ((raw & bits_mask) << format.shift);
+			raw &= storage_mask;
+
+			uint64_t word = 0;
+			memcpy(&word, ptr, length);
+			word |= raw;
+			memcpy(ptr, &word, length);
+		}
+	}
+}